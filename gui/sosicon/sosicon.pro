@@ -25,16 +25,28 @@ TARGET = sosicon
 #TEMPLATE = app
 
 SOURCES += main.cpp\
+    ../../src/async_file_writer.cpp \
     ../../src/byte_order.cpp \
     ../../src/command_line.cpp \
     ../../src/converter_sosi_stat.cpp \
     ../../src/converter_sosi2tsv.cpp \
+    ../../src/converter_sosi2topojson.cpp \
+    ../../src/converter_sosi2mvt.cpp \
+    ../../src/converter_sosi2arrow.cpp \
     ../../src/converter_sosi2xml.cpp \
     ../../src/factory.cpp \
     ../../src/utils.cpp \
+    ../../src/column_type.cpp \
     ../../src/converter_sosi2psql.cpp \
     ../../src/converter_sosi2shp.cpp \
     ../../src/coordinate_collection.cpp \
+    ../../src/curve_cache.cpp \
+    ../../src/geometry_kernels.cpp \
+    ../../src/projection.cpp \
+    ../../src/feature_filter.cpp \
+    ../../src/parse_cache.cpp \
+    ../../src/pipeline.cpp \
+    ../../src/work_stealing_pool.cpp \
     ../../src/parser.cpp \
     ../../src/parser_ragel.cpp \
     ../../src/sosi_north_east_height_ragel.cpp \
@@ -51,18 +63,41 @@ SOURCES += main.cpp\
     ../../src/sosi/sosi_translation_table.cpp \
     ../../src/shape/shapefile.cpp \
     ../../src/logger.cpp \
+    ../../src/profiler.cpp \
+    ../../src/progress.cpp \
     worker.cpp \
     mainfrm.cpp
 
 HEADERS  += \
+    ../../src/async_file_writer.h \
     ../../src/common_types.h \
     ../../src/converter_sosi2tsv.h \
+    ../../src/converter_sosi2topojson.h \
+    ../../src/converter_sosi2mvt.h \
+    ../../src/converter_sosi2arrow.h \
     ../../src/converter_sosi2xml.h \
     ../../src/coordinate.h \
+    ../../src/curve_cache.h \
+    ../../src/geometry_kernels.h \
+    ../../src/projection.h \
+    ../../src/protobuf_writer.h \
+    ../../src/flatbuffer_writer.h \
+    ../../src/wkb_writer.h \
     ../../src/factory.h \
     ../../src/inttypes.h \
     ../../src/utils.h \
+    ../../src/column_index.h \
+    ../../src/column_type.h \
+    ../../src/parse_cache.h \
+    ../../src/pipeline.h \
+    ../../src/work_stealing_pool.h \
+    ../../src/bounded_queue.h \
+    ../../src/mpsc_queue.h \
+    ../../src/profiler.h \
+    ../../src/progress.h \
     ../../src/parser.h \
+    ../../src/feature_event.h \
+    ../../src/feature_filter.h \
     ../../src/sosi/sosi_element_search.h \
     ../../src/sosi/sosi_junction_point.h \
     ../../src/sosi/sosi_origo_ne.h \
@@ -96,6 +131,7 @@ HEADERS  += \
     ../../src/interface/i_sosi_element.h \
     ../../src/interface/i_sosi_head_member.h \
     ../../src/interface/i_binary_streamable.h \
+    ../../src/interface/i_pipeline_job.h \
     ../../src/logger.h \
     ../../src/log_event.h \
     ../../src/event_dispatcher.h \
@@ -0,0 +1,305 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined( _WIN32 ) || defined( _WIN64 )
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "async_file_writer.h"
+
+namespace {
+
+    int openFile( const std::string& fileName ) {
+#if defined( _WIN32 ) || defined( _WIN64 )
+        return _open( fileName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE );
+#else
+        return open( fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+#endif
+    }
+
+    bool writeAt( int fd, const char* data, std::size_t size, int64_t offset ) {
+        while( size > 0 ) {
+#if defined( _WIN32 ) || defined( _WIN64 )
+            // Only the I/O thread writes, so seek and write need not be atomic
+            if( _lseeki64( fd, offset, SEEK_SET ) < 0 ) {
+                return false;
+            }
+            int written = _write( fd, data, static_cast<unsigned int>( size ) );
+#else
+            ssize_t written = pwrite( fd, data, size, static_cast<off_t>( offset ) );
+#endif
+            if( written < 0 ) {
+                if( errno == EINTR ) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    bool syncFile( int fd ) {
+#if defined( _WIN32 ) || defined( _WIN64 )
+        return _commit( fd ) == 0;
+#else
+        return fsync( fd ) == 0;
+#endif
+    }
+
+    void closeFile( int fd ) {
+#if defined( _WIN32 ) || defined( _WIN64 )
+        _close( fd );
+#else
+        ::close( fd );
+#endif
+    }
+
+} // namespace
+
+sosicon::AsyncFileWriter::Service::
+Service() {
+    mStop = false;
+    mBusy = false;
+    mSyncFailed = false;
+    mThread = std::thread( &Service::main, this );
+}
+
+sosicon::AsyncFileWriter::Service::
+~Service() {
+    {
+        std::unique_lock<std::mutex> lock( mMutex );
+        mStop = true;
+    }
+    mWork.notify_one();
+    mThread.join();
+}
+
+void sosicon::AsyncFileWriter::Service::
+closeLater( int fd ) {
+    {
+        std::unique_lock<std::mutex> lock( mMutex );
+        mPendingSync.push_back( fd );
+    }
+    mWork.notify_one();
+}
+
+bool sosicon::AsyncFileWriter::Service::
+flush() {
+    std::unique_lock<std::mutex> lock( mMutex );
+    while( mBusy || !mRequests.empty() || !mPendingSync.empty() ) {
+        mDone.wait( lock );
+    }
+    bool ok = !mSyncFailed;
+    mSyncFailed = false;
+    return ok;
+}
+
+void sosicon::AsyncFileWriter::Service::
+main() {
+    std::unique_lock<std::mutex> lock( mMutex );
+    for( ;; ) {
+        while( mRequests.empty() && mPendingSync.empty() && !mStop ) {
+            mWork.wait( lock );
+        }
+        if( !mRequests.empty() ) {
+            Request r = mRequests.front();
+            mRequests.pop_front();
+            mBusy = true;
+            lock.unlock();
+            bool ok = writeAt( r.file->mFd, r.file->mBuffers[ r.buffer ], r.size, r.offset );
+            lock.lock();
+            mBusy = false;
+            if( !ok ) {
+                r.file->mFailed = true;
+            }
+            r.file->mInFlight[ r.buffer ] = false;
+            mDone.notify_all();
+        }
+        else if( !mPendingSync.empty() ) {
+            syncPending( lock );
+        }
+        else {
+            break;
+        }
+    }
+}
+
+void sosicon::AsyncFileWriter::Service::
+submit( const Request& request ) {
+    {
+        std::unique_lock<std::mutex> lock( mMutex );
+        request.file->mInFlight[ request.buffer ] = true;
+        mRequests.push_back( request );
+    }
+    mWork.notify_one();
+}
+
+void sosicon::AsyncFileWriter::Service::
+syncPending( std::unique_lock<std::mutex>& lock ) {
+    std::vector<int> batch;
+    batch.swap( mPendingSync );
+    mBusy = true;
+    lock.unlock();
+    bool ok = true;
+    for( std::vector<int>::iterator i = batch.begin(); i != batch.end(); i++ ) {
+        ok = syncFile( *i ) && ok;
+        closeFile( *i );
+    }
+    lock.lock();
+    mBusy = false;
+    if( !ok ) {
+        mSyncFailed = true;
+    }
+    mDone.notify_all();
+}
+
+bool sosicon::AsyncFileWriter::Service::
+waitForBuffer( AsyncFileWriter* file, int buffer ) {
+    std::unique_lock<std::mutex> lock( mMutex );
+    while( file->mInFlight[ buffer ] ) {
+        mDone.wait( lock );
+    }
+    return !file->mFailed;
+}
+
+sosicon::AsyncFileWriter::Service& sosicon::AsyncFileWriter::
+service() {
+    static Service instance;
+    return instance;
+}
+
+sosicon::AsyncFileWriter::
+AsyncFileWriter() {
+    mFd = -1;
+    mCurrent = 0;
+    mOffset = 0;
+    mFailed = false;
+    for( int i = 0; i < 2; i++ ) {
+        mAllocated[ i ] = 0;
+        mBuffers[ i ] = 0;
+        mCapacity[ i ] = 0;
+        mInFlight[ i ] = false;
+    }
+}
+
+sosicon::AsyncFileWriter::
+~AsyncFileWriter() {
+    close();
+}
+
+bool sosicon::AsyncFileWriter::
+close( bool sync ) {
+    if( mFd < 0 ) {
+        return true;
+    }
+    Profiler::Scope scope( Profiler::stage_write );
+    submitBuffer();
+    bool ok = service().waitForBuffer( this, 0 );
+    ok = service().waitForBuffer( this, 1 ) && ok;
+    if( sync ) {
+        service().closeLater( mFd );
+    }
+    else {
+        closeFile( mFd );
+    }
+    mFd = -1;
+    setp( 0, 0 );
+    releaseBuffers();
+    return ok;
+}
+
+bool sosicon::AsyncFileWriter::
+flushAll() {
+    return service().flush();
+}
+
+bool sosicon::AsyncFileWriter::
+open( const std::string& fileName ) {
+    close();
+    mFd = openFile( fileName );
+    if( mFd < 0 ) {
+        return false;
+    }
+    mCurrent = 0;
+    mOffset = 0;
+    mFailed = false;
+    resetPutArea();
+    return true;
+}
+
+sosicon::AsyncFileWriter::int_type sosicon::AsyncFileWriter::
+overflow( int_type c ) {
+    if( mFd < 0 ) {
+        return traits_type::eof();
+    }
+    submitBuffer();
+    resetPutArea();
+    if( !traits_type::eq_int_type( c, traits_type::eof() ) ) {
+        *pptr() = traits_type::to_char_type( c );
+        pbump( 1 );
+    }
+    return traits_type::not_eof( c );
+}
+
+void sosicon::AsyncFileWriter::
+releaseBuffers() {
+    for( int i = 0; i < 2; i++ ) {
+        delete [ ] mAllocated[ i ];
+        mAllocated[ i ] = 0;
+        mBuffers[ i ] = 0;
+        mCapacity[ i ] = 0;
+    }
+}
+
+void sosicon::AsyncFileWriter::
+resetPutArea() {
+    std::size_t size = mOffset > 0 ? BUFFER_SIZE : INITIAL_BUFFER_SIZE;
+    if( mCapacity[ mCurrent ] < size ) {
+        delete [ ] mAllocated[ mCurrent ]; // Not in flight, see submitBuffer()
+        mAllocated[ mCurrent ] = new char[ size + BUFFER_ALIGNMENT ];
+        std::size_t misalignment = reinterpret_cast<std::size_t>( mAllocated[ mCurrent ] ) % BUFFER_ALIGNMENT;
+        mBuffers[ mCurrent ] = mAllocated[ mCurrent ] + ( misalignment ? BUFFER_ALIGNMENT - misalignment : 0 );
+        mCapacity[ mCurrent ] = size;
+    }
+    setp( mBuffers[ mCurrent ], mBuffers[ mCurrent ] + mCapacity[ mCurrent ] );
+}
+
+void sosicon::AsyncFileWriter::
+submitBuffer() {
+    std::size_t size = static_cast<std::size_t>( pptr() - pbase() );
+    if( size > 0 ) {
+        Request r;
+        r.file = this;
+        r.buffer = mCurrent;
+        r.size = size;
+        r.offset = mOffset;
+        service().submit( r );
+        Profiler::addBytesOut( size );
+        mOffset += size;
+        mCurrent ^= 1;
+        service().waitForBuffer( this, mCurrent );
+    }
+    setp( 0, 0 );
+}
@@ -0,0 +1,196 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ASYNC_FILE_WRITER_H__
+#define __ASYNC_FILE_WRITER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "profiler.h"
+
+namespace sosicon {
+
+    //! Asynchronous, double-buffered output file
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Output stream buffer that hands full buffers to a background I/O thread instead of
+        writing them itself. Each file owns two page-aligned buffers: the caller fills one
+        while the other is being written. The first buffer is small, so the many tiny files
+        some converters write cost little memory; buffers grow to full size once a file has
+        filled one. Use it through a std::ostream:
+
+        \code
+        AsyncFileWriter out;
+        out.open( "dump.sql" );
+        std::ostream os( &out );
+        os << "...";
+        out.close();
+        \endcode
+
+        All open files share one I/O thread, which writes each buffer at its file offset with
+        pwrite(). Any number of files may be written at the same time, e.g. the four parts
+        of a shapefile, also from different threads.
+
+        Files closed with \a sync set are fsync'ed in batches: the I/O thread runs the
+        pending fsyncs once it has no more buffers to write, so a converter writing many
+        small files never waits for the disk. Call flushAll() before exiting to wait for them.
+     */
+    class AsyncFileWriter : public std::streambuf {
+
+        //! Size of each buffer
+        static const std::size_t BUFFER_SIZE = 1 << 20;
+
+        //! Size of the first buffer of a file
+        static const std::size_t INITIAL_BUFFER_SIZE = 1 << 14;
+
+        //! Buffer alignment
+        static const std::size_t BUFFER_ALIGNMENT = 4096;
+
+        //! Buffer handed to the I/O thread
+        struct Request {
+            AsyncFileWriter* file; //!< Owner
+            int buffer;            //!< Index of buffer in owner
+            std::size_t size;      //!< Number of bytes to write
+            int64_t offset;        //!< File offset
+        };
+
+        //! Shared background I/O thread
+        class Service {
+
+            std::mutex mMutex;
+            std::condition_variable mWork;
+            std::condition_variable mDone;
+            std::deque<Request> mRequests;
+            std::vector<int> mPendingSync;
+            std::thread mThread;
+            bool mStop;
+            bool mBusy;
+            bool mSyncFailed;
+
+            void main();
+            void syncPending( std::unique_lock<std::mutex>& lock );
+
+        public:
+            Service();
+            ~Service();
+            void submit( const Request& request );
+            bool waitForBuffer( AsyncFileWriter* file, int buffer );
+            void closeLater( int fd );
+            bool flush();
+        };
+
+        //! The I/O service, started on first use
+        static Service& service();
+
+        //! File descriptor, or -1 if not open
+        int mFd;
+
+        //! Double buffer, aligned within mAllocated. Allocated while the file is open.
+        char* mBuffers[ 2 ];
+
+        //! Allocated memory for mBuffers
+        char* mAllocated[ 2 ];
+
+        //! Usable size of each of mBuffers
+        std::size_t mCapacity[ 2 ];
+
+        //! True while a buffer is owned by the I/O thread. Guarded by the service mutex.
+        bool mInFlight[ 2 ];
+
+        //! Index of buffer currently being filled
+        int mCurrent;
+
+        //! File offset of the start of the current buffer
+        int64_t mOffset;
+
+        //! Set by the I/O thread if a write failed. Guarded by the service mutex.
+        bool mFailed;
+
+        AsyncFileWriter( const AsyncFileWriter& );
+        AsyncFileWriter& operator = ( const AsyncFileWriter& );
+
+        //! Hand current buffer to the I/O thread and switch to the other one
+        /*!
+            Waits until the other buffer is free. The put area is left empty.
+         */
+        void submitBuffer();
+
+        //! Point the stream buffer at the start of mBuffers[ mCurrent ]
+        /*!
+            Buffers are allocated on first use, so small files only ever use one. A file gets
+            a buffer of INITIAL_BUFFER_SIZE until its first buffer is submitted, then
+            BUFFER_SIZE.
+         */
+        void resetPutArea();
+
+        //! Free both buffers
+        void releaseBuffers();
+
+    protected:
+
+        //! Called by std::ostream when the current buffer is full
+        virtual int_type overflow( int_type c );
+
+    public:
+
+        //! Constructor
+        AsyncFileWriter();
+
+        //! Destructor
+        /*!
+            Closes the file if still open.
+         */
+        virtual ~AsyncFileWriter();
+
+        //! Create or truncate file for writing
+        /*!
+            \param fileName Path to file.
+            \return False if the file could not be created.
+         */
+        bool open( const std::string& fileName );
+
+        //! Write remaining data and close file
+        /*!
+            Waits until all buffers of this file are written.
+            \param sync If true, the file is fsync'ed and closed later by the I/O thread, in
+                   a batch with other files. See flushAll().
+            \return False if any write failed.
+         */
+        bool close( bool sync = false );
+
+        //! Check if file is open
+        bool isOpen() const { return mFd >= 0; }
+
+        //! Wait for all pending writes and batched fsyncs
+        /*!
+            \return False if any fsync failed.
+         */
+        static bool flushAll();
+
+    }; // class AsyncFileWriter
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,606 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//! \file bench_suite.cpp Benchmarks for the parser, geometry building and converters
+/*!
+    Micro benchmarks time the hot paths one at a time on a parsed SOSI tree: line parsing,
+    NØ decoding, REF list parsing, CoordinateCollection::discoverCoords(), shape file building
+    and the PostGIS WKT expressions. Macro benchmarks run complete conversions through the
+    converter factory, as the command-line tool does.
+
+    Both run on a fixture generated with a fixed layout: a grid of surfaces built from shared
+    curves, with a point in every fourth cell, written in the same form as SOSI files from
+    Kartverket. The fixture is the same on every run, so results can be compared over
+    releases. SOSI files given on the command line are added to the macro benchmarks.
+
+    Results are printed as they are measured and written as JSON. Build and run with
+    "make bench". Options:
+
+    -o FILE     JSON report, default sosicon_bench.json
+    -cells N    Fixture grid size, N x N surfaces, default 120
+    -rounds N   Rounds of each micro benchmark, default 5
+    -runs N     Runs of each conversion, default 3
+
+    Output of the conversions is written to a temporary directory and removed. Uses POSIX
+    directory functions, like the makefile it is built with.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../command_line.h"
+#include "../converter_sosi2psql.h"
+#include "../coordinate_collection.h"
+#include "../curve_cache.h"
+#include "../factory.h"
+#include "../logger.h"
+#include "../parser.h"
+#include "../utils.h"
+#include "../shape/shapefile.h"
+#include "../sosi/sosi_element_search.h"
+#include "../sosi/sosi_north_east.h"
+#include "../sosi/sosi_ref_list.h"
+
+namespace {
+
+    using namespace sosicon;
+
+    //! Timings of one benchmark
+    struct Result {
+        std::string name;       //!< Benchmark name
+        std::string file;       //!< Source file, for conversions
+        std::string unit;       //!< What the items are
+        double items;           //!< Items per round
+        double bytes;           //!< Bytes per round, or 0
+        double best;            //!< Fastest round, in seconds
+        double median;          //!< Median round, in seconds
+    };
+
+    //! Discards everything written to it
+    class NullBuffer : public std::streambuf {
+    protected:
+        virtual int overflow( int c ) { return traits_type::not_eof( c ); }
+        virtual std::streamsize xsputn( const char*, std::streamsize n ) { return n; }
+    };
+
+    //! Keeps results from being optimized away
+    volatile double sink = 0;
+
+    double seconds( std::chrono::steady_clock::time_point t0 ) {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+    }
+
+    //! Fill in best and median round, and print the result
+    Result& finish( Result& r, std::vector<double>& times ) {
+        std::sort( times.begin(), times.end() );
+        r.best = times.front();
+        r.median = times[ times.size() / 2 ];
+        std::printf( "%-22s %10.3f ms %12.0f %s/s", r.name.c_str(), r.median * 1e3, r.items / r.median, r.unit.c_str() );
+        if( r.bytes > 0 ) {
+            std::printf( " %8.1f MB/s", r.bytes / r.median / 1e6 );
+        }
+        if( !r.file.empty() ) {
+            std::printf( "  %s", r.file.c_str() );
+        }
+        std::printf( "\n" );
+        std::fflush( stdout );
+        return r;
+    }
+
+    //! Generated SOSI fixture
+    class Fixture {
+
+        std::ostringstream mOut;
+        int mCells;
+        int mSerial;
+        int mFeatures;
+
+        //! Coordinate of grid node r, c with a small offset along a curve, in 1/100 metres
+        void node( int r, int c, int dn, int de ) {
+            mOut << ( 660000000L + r * 10000L + dn ) << " " << ( 50000000L + c * 10000L + de ) << "\n";
+        }
+
+        //! Wiggle for the inner points of a curve, the same for every surface using it
+        static int wiggle( int serial, int i ) {
+            return ( ( serial * 7 + i * 13 ) % 5 - 2 ) * 50;
+        }
+
+        //! Curve from node r, c along east (horizontal) or north
+        void curve( int r, int c, bool horizontal ) {
+            int serial = ++mSerial;
+            mOut << ".KURVE " << serial << ":\n"
+                 << "..OBJTYPE Arealbrukgrense\n"
+                 << "..KOMM 0301\n"
+                 << "..N\xD8\n";
+            for( int i = 0; i <= POINTS_PER_CURVE; i++ ) {
+                int along = i * 10000 / POINTS_PER_CURVE;
+                int across = i > 0 && i < POINTS_PER_CURVE ? wiggle( serial, i ) : 0;
+                if( horizontal ) {
+                    node( r, c, across, along );
+                }
+                else {
+                    node( r, c, along, across );
+                }
+            }
+            mFeatures++;
+        }
+
+    public:
+
+        //! Points along each curve, after the first
+        static const int POINTS_PER_CURVE = 8;
+
+        //! Generate grid of cells x cells surfaces
+        explicit Fixture( int cells ) : mCells( cells ), mSerial( 0 ), mFeatures( 0 ) {
+
+            mOut << ".HODE\n"
+                 << "..TEGNSETT ISO8859-1\n"
+                 << "..TRANSPAR\n"
+                 << "...KOORDSYS 22\n"
+                 << "...ORIGO-N\xD8 0 0\n"
+                 << "...ENHET 0.01\n"
+                 << "..OMR\xC5" "DE\n"
+                 << "...MIN-N\xD8 6600000 500000\n"
+                 << "...MAX-N\xD8 " << ( 6600000 + cells * 100 ) << " " << ( 500000 + cells * 100 ) << "\n"
+                 << "..SOSI-VERSJON 4.0\n";
+
+            // Curves along east first, row by row, then curves along north
+            for( int r = 0; r <= cells; r++ ) {
+                for( int c = 0; c < cells; c++ ) {
+                    curve( r, c, true );
+                }
+            }
+            for( int r = 0; r < cells; r++ ) {
+                for( int c = 0; c <= cells; c++ ) {
+                    curve( r, c, false );
+                }
+            }
+
+            const char* objTypes[] = { "Innsj\xF8", "Myr", "Skog", "Dyrket" };
+            int vertical = ( cells + 1 ) * cells;
+            for( int r = 0; r < cells; r++ ) {
+                for( int c = 0; c < cells; c++ ) {
+                    int south = 1 + r * cells + c;
+                    int north = south + cells;
+                    int west = 1 + vertical + r * ( cells + 1 ) + c;
+                    int east = west + 1;
+                    mOut << ".FLATE " << ++mSerial << ":\n"
+                         << "..OBJTYPE " << objTypes[ ( r + c ) % 4 ] << "\n"
+                         << "..KOMM 0301\n"
+                         << "..NAVN \"Omr\xE5" "de " << r << "-" << c << "\"\n"
+                         << "..DATAFANGSTDATO " << ( 20150101 + ( r % 12 ) * 100 ) << "\n"
+                         << "..REF :" << south << " :" << east << " :-" << north << " :-" << west << "\n"
+                         << "..N\xD8\n";
+                    node( r, c, 5000, 5000 );
+                    mFeatures++;
+                }
+            }
+            for( int r = 0; r < cells; r += 2 ) {
+                for( int c = 0; c < cells; c += 2 ) {
+                    mOut << ".PUNKT " << ++mSerial << ":\n"
+                         << "..OBJTYPE Terrengpunkt\n"
+                         << "..KOMM 0301\n"
+                         << "..H\xD8YDE " << ( 100 + ( r * 31 + c * 17 ) % 500 ) << ".5\n"
+                         << "..N\xD8\n";
+                    node( r, c, 2500, 2500 );
+                    mFeatures++;
+                }
+            }
+            mOut << ".SLUTT\n";
+        }
+
+        //! SOSI text
+        std::string text() const { return mOut.str(); }
+
+        //! Number of surfaces, curves and points
+        int features() const { return mFeatures; }
+
+        //! Grid size
+        int cells() const { return mCells; }
+
+    }; // class Fixture
+
+    //! Split text into lines, without line breaks
+    std::vector<std::string> splitLines( const std::string& text ) {
+        std::vector<std::string> lines;
+        std::string::size_type pos = 0, nl;
+        while( ( nl = text.find( '\n', pos ) ) != std::string::npos ) {
+            lines.push_back( text.substr( pos, nl - pos ) );
+            pos = nl + 1;
+        }
+        if( pos < text.size() ) {
+            lines.push_back( text.substr( pos ) );
+        }
+        return lines;
+    }
+
+    //! Count top-level elements other than the header and end in a SOSI file
+    double countFeatures( const std::string& fileName, double& bytes ) {
+        std::ifstream ifs( fileName.c_str(), std::ios::binary );
+        std::string line;
+        double features = 0;
+        bytes = 0;
+        while( std::getline( ifs, line ) ) {
+            bytes += line.size() + 1;
+            if( line.size() > 1 && line[ 0 ] == '.' && line[ 1 ] != '.' &&
+                line.compare( 0, 5, ".HODE" ) != 0 && line.compare( 0, 6, ".SLUTT" ) != 0 ) {
+                features++;
+            }
+        }
+        return features;
+    }
+
+    //! Remove the files in a directory, and the directory itself if requested
+    void removeFiles( const std::string& dir, bool self ) {
+        DIR* d = opendir( dir.c_str() );
+        if( d ) {
+            dirent* entry;
+            while( ( entry = readdir( d ) ) != 0 ) {
+                std::string name = entry->d_name;
+                if( name != "." && name != ".." ) {
+                    std::string path = dir + "/" + name;
+                    if( std::remove( path.c_str() ) != 0 ) {
+                        removeFiles( path, true );
+                    }
+                }
+            }
+            closedir( d );
+        }
+        if( self ) {
+            rmdir( dir.c_str() );
+        }
+    }
+
+    //! Top-level children of the given types
+    std::vector<ISosiElement*> children( ISosiElement* root, std::vector<sosi::ElementType> types ) {
+        std::vector<ISosiElement*> found;
+        sosi::SosiElementSearch src( types );
+        while( root->getChild( src ) ) {
+            found.push_back( src.element() );
+        }
+        return found;
+    }
+
+    //! Children of the given type of each element
+    std::vector<ISosiElement*> children( const std::vector<ISosiElement*>& parents, sosi::ElementType type ) {
+        std::vector<ISosiElement*> found;
+        for( std::vector<ISosiElement*>::const_iterator i = parents.begin(); i != parents.end(); i++ ) {
+            sosi::SosiElementSearch src( type );
+            while( ( *i )->getChild( src ) ) {
+                found.push_back( src.element() );
+            }
+        }
+        return found;
+    }
+
+    Result benchParse( const std::vector<std::string>& lines, double bytes, int rounds ) {
+        Result r = { "parse_lines", "", "lines", static_cast<double>( lines.size() ), bytes, 0, 0 };
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            CurveCache::getInstance()->clear();
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            {
+                Parser p;
+                for( std::vector<std::string>::const_iterator l = lines.begin(); l != lines.end(); l++ ) {
+                    p.ragelParseSosiLine( *l );
+                }
+                p.complete();
+                sink = sink + p.getRootElement()->children().size();
+            }
+            times.push_back( seconds( t0 ) );
+        }
+        return finish( r, times );
+    }
+
+    Result benchNorthEast( const std::vector<ISosiElement*>& coords, int rounds ) {
+        Result r = { "decode_north_east", "", "points", 0, 0, 0, 0 };
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            double points = 0, sum = 0;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for( std::vector<ISosiElement*>::const_iterator e = coords.begin(); e != coords.end(); e++ ) {
+                sosi::SosiNorthEast ne( *e );
+                ICoordinate* c = 0;
+                while( ne.getNext( c ) ) {
+                    sum += c->getE();
+                    points++;
+                }
+                ne.free();
+            }
+            times.push_back( seconds( t0 ) );
+            r.items = points;
+            sink = sink + sum;
+        }
+        return finish( r, times );
+    }
+
+    Result benchRefList( const std::vector<ISosiElement*>& refs, int rounds ) {
+        Result r = { "parse_ref_list", "", "refs", 0, 0, 0, 0 };
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            double count = 0;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for( std::vector<ISosiElement*>::const_iterator e = refs.begin(); e != refs.end(); e++ ) {
+                sosi::SosiRefList refList( *e );
+                sosi::GeometryRef* geometry = 0;
+                while( refList.getNextGeometry( geometry ) ) {
+                    count += geometry->size();
+                }
+            }
+            times.push_back( seconds( t0 ) );
+            r.items = count;
+        }
+        return finish( r, times );
+    }
+
+    Result benchDiscoverCoords( const std::vector<ISosiElement*>& features, int rounds ) {
+        Result r = { "discover_coords", "", "features", static_cast<double>( features.size() ), 0, 0, 0 };
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            CurveCache::getInstance()->clear(); // Decode the curves every round
+            double points = 0;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for( std::vector<ISosiElement*>::const_iterator e = features.begin(); e != features.end(); e++ ) {
+                CoordinateCollection cc;
+                cc.discoverCoords( *e );
+                points += cc.getNumPointsGeom();
+            }
+            times.push_back( seconds( t0 ) );
+            sink = sink + points;
+        }
+        return finish( r, times );
+    }
+
+    Result benchShapefile( ISosiElement* root, int rounds ) {
+        Result r = { "shapefile_build", "", "features", 0, 0, 0, 0 };
+        sosi::ElementType types[] = { sosi::sosi_element_point, sosi::sosi_element_curve, sosi::sosi_element_surface };
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            CurveCache::getInstance()->clear();
+            double count = 0;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for( int t = 0; t < 3; t++ ) {
+                shape::Shapefile shp;
+                count += shp.build( root, "", types[ t ] );
+            }
+            times.push_back( seconds( t0 ) );
+            r.items = count;
+        }
+        return finish( r, times );
+    }
+
+    Result benchPsqlWkt( const std::vector<ISosiElement*>& features, int rounds ) {
+        Result r = { "psql_wkt", "", "features", 0, 0, 0, 0 };
+        CurveCache::getInstance()->clear();
+        std::vector<CoordinateCollection*> lines, polygons;
+        for( std::vector<ISosiElement*>::const_iterator e = features.begin(); e != features.end(); e++ ) {
+            CoordinateCollection* cc = new CoordinateCollection();
+            cc->discoverCoords( *e );
+            ( ( *e )->getType() == sosi::sosi_element_surface ? polygons : lines ).push_back( cc );
+        }
+        r.items = static_cast<double>( lines.size() + polygons.size() );
+        std::vector<double> times;
+        for( int i = 0; i < rounds; i++ ) {
+            double bytes = 0;
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for( std::vector<CoordinateCollection*>::iterator cc = lines.begin(); cc != lines.end(); cc++ ) {
+                bytes += ConverterSosi2psql::lineStringExpression( **cc, "25832", "4326" ).size();
+            }
+            for( std::vector<CoordinateCollection*>::iterator cc = polygons.begin(); cc != polygons.end(); cc++ ) {
+                bytes += ConverterSosi2psql::polygonExpression( **cc, "25832", "4326" ).size();
+            }
+            times.push_back( seconds( t0 ) );
+            r.bytes = bytes;
+        }
+        for( std::vector<CoordinateCollection*>::iterator cc = lines.begin(); cc != lines.end(); cc++ ) {
+            delete *cc;
+        }
+        for( std::vector<CoordinateCollection*>::iterator cc = polygons.begin(); cc != polygons.end(); cc++ ) {
+            delete *cc;
+        }
+        return finish( r, times );
+    }
+
+    //! Run one conversion as the command-line tool does, with its output discarded
+    void convert( const std::string& args ) {
+        NullBuffer null;
+        std::streambuf* out = std::cout.rdbuf( &null );
+        {
+            CommandLine cmd;
+            cmd.mIsTtyIn = true; // Do not read file names from stdin
+            cmd.mIsTtyOut = false;
+            cmd.parse( "sosicon " + args );
+            IConverter* converter = 0;
+            Factory::get( converter, &cmd );
+            if( converter ) {
+                converter->run();
+                Factory::release( converter );
+            }
+        }
+        sosicon::logstream.drain();
+        std::cout.rdbuf( out );
+    }
+
+    Result benchConversion( const std::string& command, const std::string& options, const std::string& fileName,
+                            const std::string& label, const std::string& outDir, int runs ) {
+        Result r = { command, label, "features", 0, 0, 0, 0 };
+        r.items = countFeatures( fileName, r.bytes );
+        std::vector<double> times;
+        for( int i = 0; i < runs; i++ ) {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            convert( command + ( options.empty() ? "" : " " + options ) + " " + fileName );
+            times.push_back( seconds( t0 ) );
+            removeFiles( outDir, false );
+        }
+        return finish( r, times );
+    }
+
+    //! Write results as a JSON array
+    void writeResults( std::ostream& os, const std::vector<Result>& results ) {
+        os << "[";
+        for( std::vector<Result>::size_type i = 0; i < results.size(); i++ ) {
+            const Result& r = results[ i ];
+            os << ( i ? ",\n" : "\n" )
+               << "        { \"name\": " << utils::jsonQuote( r.name );
+            if( !r.file.empty() ) {
+                os << ", \"file\": " << utils::jsonQuote( r.file );
+            }
+            os << ", \"unit\": " << utils::jsonQuote( r.unit )
+               << std::fixed << std::setprecision( 0 )
+               << ", \"items\": " << r.items
+               << ", \"bytes\": " << r.bytes
+               << std::setprecision( 6 )
+               << ", \"best_seconds\": " << r.best
+               << ", \"median_seconds\": " << r.median
+               << std::setprecision( 1 )
+               << ", \"items_per_second\": " << r.items / r.median
+               << ", \"mb_per_second\": " << r.bytes / r.median / 1e6 << " }";
+        }
+        os << ( results.empty() ? "]" : "\n    ]" );
+    }
+
+}; // namespace
+
+int main( int argc, char* argv[] ) {
+
+    std::string reportFile = "sosicon_bench.json";
+    int cells = 120;
+    int rounds = 5;
+    int runs = 3;
+    std::vector<std::string> sourceFiles;
+    for( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[ i ];
+        if( "-o" == arg && i + 1 < argc ) {
+            reportFile = argv[ ++i ];
+        }
+        else if( "-cells" == arg && i + 1 < argc ) {
+            cells = std::max( 1, std::atoi( argv[ ++i ] ) );
+        }
+        else if( "-rounds" == arg && i + 1 < argc ) {
+            rounds = std::max( 1, std::atoi( argv[ ++i ] ) );
+        }
+        else if( "-runs" == arg && i + 1 < argc ) {
+            runs = std::max( 1, std::atoi( argv[ ++i ] ) );
+        }
+        else {
+            sourceFiles.push_back( arg );
+        }
+    }
+
+    const char* tmp = std::getenv( "TMPDIR" );
+    std::string dirTemplate = std::string( tmp && *tmp ? tmp : "/tmp" ) + "/sosicon_bench_XXXXXX";
+    std::vector<char> dirName( dirTemplate.begin(), dirTemplate.end() );
+    dirName.push_back( '\0' );
+    if( !mkdtemp( &dirName[ 0 ] ) ) {
+        std::printf( "Could not create a temporary directory\n" );
+        return 1;
+    }
+    std::string workDir = &dirName[ 0 ];
+    std::string outDir = workDir + "/out";
+    mkdir( outDir.c_str(), 0755 );
+
+    Fixture fixture( cells );
+    std::string text = fixture.text();
+    std::string fixtureFile = workDir + "/fixture.sos";
+    {
+        std::ofstream ofs( fixtureFile.c_str(), std::ios::binary );
+        ofs << text;
+    }
+    sourceFiles.insert( sourceFiles.begin(), fixtureFile );
+    std::vector<std::string> lines = splitLines( text );
+    std::printf( "Fixture: %dx%d surfaces, %d features, %u lines, %.1f MB\n\n",
+                 cells, cells, fixture.features(), static_cast<unsigned>( lines.size() ), text.size() / 1e6 );
+
+    // Micro benchmarks, on one parsed tree
+    std::vector<Result> micro;
+    micro.push_back( benchParse( lines, static_cast<double>( text.size() ), rounds ) );
+    {
+        CurveCache::getInstance()->clear();
+        Parser p;
+        for( std::vector<std::string>::iterator l = lines.begin(); l != lines.end(); l++ ) {
+            p.ragelParseSosiLine( *l );
+        }
+        p.complete();
+        ISosiElement* root = p.getRootElement();
+        std::vector<sosi::ElementType> featureTypes;
+        featureTypes.push_back( sosi::sosi_element_point );
+        featureTypes.push_back( sosi::sosi_element_curve );
+        featureTypes.push_back( sosi::sosi_element_surface );
+        std::vector<ISosiElement*> features = children( root, featureTypes );
+        std::vector<ISosiElement*> surfaces = children( root, std::vector<sosi::ElementType>( 1, sosi::sosi_element_surface ) );
+
+        micro.push_back( benchNorthEast( children( features, sosi::sosi_element_ne ), rounds ) );
+        micro.push_back( benchRefList( children( surfaces, sosi::sosi_element_ref ), rounds ) );
+        micro.push_back( benchDiscoverCoords( features, rounds ) );
+        micro.push_back( benchShapefile( root, rounds ) );
+        micro.push_back( benchPsqlWkt( features, rounds ) );
+        CurveCache::getInstance()->clear(); // Holds curves of the tree
+    }
+    std::printf( "\n" );
+
+    // Macro benchmarks, complete conversions
+    const char* commands[][ 2 ] = {
+        { "-2shp", "-d" },
+        { "-2psql", "-o" },
+        { "-2mysql", "-o" },
+        { "-2tsv", "-o" },
+        { "-2topojson", "-o" },
+        { "-2arrow", "-o" },
+        { "-2mvt -zoom 0-12", "-o" },
+        { "-stat", 0 }
+    };
+    const char* outputs[] = { "", "/out.sql", "/out.sql", "/out.tsv", "/out.json", "/out.arrow", "/tiles.tar", "" };
+    std::vector<Result> macro;
+    for( std::vector<std::string>::iterator f = sourceFiles.begin(); f != sourceFiles.end(); f++ ) {
+        for( std::size_t c = 0; c < sizeof( commands ) / sizeof( commands[ 0 ] ); c++ ) {
+            std::string options = commands[ c ][ 1 ] ? std::string( commands[ c ][ 1 ] ) + " " + outDir + outputs[ c ] : "";
+            std::string label = *f == fixtureFile ? "fixture" : *f;
+            macro.push_back( benchConversion( commands[ c ][ 0 ], options, *f, label, outDir, runs ) );
+        }
+    }
+    removeFiles( workDir, true );
+
+    std::ofstream os( reportFile.c_str(), std::ios::binary );
+    os << "{\n"
+       << "    \"fixture\": { \"cells\": " << fixture.cells()
+       << ", \"features\": " << fixture.features()
+       << ", \"lines\": " << lines.size()
+       << ", \"bytes\": " << text.size() << " },\n"
+       << "    \"rounds\": " << rounds << ",\n"
+       << "    \"runs\": " << runs << ",\n"
+       << "    \"micro\": ";
+    writeResults( os, micro );
+    os << ",\n    \"macro\": ";
+    writeResults( os, macro );
+    os << "\n}\n";
+    if( !os ) {
+        std::printf( "%s could not be written\n", reportFile.c_str() );
+        return 1;
+    }
+    std::printf( "\nResults written to %s\n", reportFile.c_str() );
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//! \file geometry_kernels_bench.cpp Microbenchmark for the geometry kernels
+/*!
+    Times the scalar and AVX2 versions of the kernels in sosicon::geometry on synthetic rings,
+    and checks that both versions agree. Build and run with "make bench".
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../geometry_kernels.h"
+
+namespace {
+
+    using namespace sosicon;
+
+    typedef double ( *AreaKernel )( const double*, std::size_t );
+    typedef void ( *BoxKernel )( const double*, std::size_t, double&, double&, double&, double& );
+    typedef std::size_t ( *DedupKernel )( double*, std::size_t );
+
+    //! Ring of n points around a circle, with every tenth point repeated
+    geometry::PointArray makeRing( std::size_t n, unsigned seed ) {
+        geometry::PointArray xy;
+        xy.reserve( 2 * n );
+        std::srand( seed );
+        double cx = 500000 + std::rand() % 100000, cy = 6600000 + std::rand() % 100000;
+        for( std::size_t i = 0; i < n; i++ ) {
+            double a = 2 * 3.14159265358979 * i / n;
+            double r = 100 + std::rand() % 20;
+            xy.push_back( cx + r * std::cos( a ) );
+            xy.push_back( cy + r * std::sin( a ) );
+            if( i % 10 == 0 ) {
+                xy.push_back( xy[ xy.size() - 2 ] );
+                xy.push_back( xy[ xy.size() - 2 ] );
+            }
+        }
+        return xy;
+    }
+
+    double seconds( std::chrono::steady_clock::time_point t0 ) {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+    }
+
+    void report( const char* kernel, const char* impl, double secs, std::size_t points ) {
+        std::printf( "%-18s %-7s %8.3f ms %8.2f Mpoints/s\n", kernel, impl, secs * 1e3, points / secs / 1e6 );
+    }
+
+    double benchArea( const char* impl, AreaKernel k, const std::vector<geometry::PointArray>& rings, int rounds ) {
+        double sum = 0;
+        std::size_t points = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for( int r = 0; r < rounds; r++ ) {
+            for( std::size_t i = 0; i < rings.size(); i++ ) {
+                sum += k( rings[ i ].data(), rings[ i ].size() / 2 );
+                points += rings[ i ].size() / 2;
+            }
+        }
+        report( "signedArea", impl, seconds( t0 ), points );
+        return sum;
+    }
+
+    double benchBox( const char* impl, BoxKernel k, const std::vector<geometry::PointArray>& rings, int rounds ) {
+        double sum = 0;
+        std::size_t points = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for( int r = 0; r < rounds; r++ ) {
+            for( std::size_t i = 0; i < rings.size(); i++ ) {
+                double minX = +1e300, minY = +1e300, maxX = -1e300, maxY = -1e300;
+                k( rings[ i ].data(), rings[ i ].size() / 2, minX, minY, maxX, maxY );
+                sum += minX + minY + maxX + maxY;
+                points += rings[ i ].size() / 2;
+            }
+        }
+        report( "expandBoundingBox", impl, seconds( t0 ), points );
+        return sum;
+    }
+
+    std::size_t benchDedup( const char* impl, DedupKernel k, const std::vector<geometry::PointArray>& rings, int rounds ) {
+        std::size_t kept = 0;
+        std::size_t points = 0;
+        double secs = 0;
+        geometry::PointArray work;
+        for( int r = 0; r < rounds; r++ ) {
+            for( std::size_t i = 0; i < rings.size(); i++ ) {
+                work = rings[ i ]; // Copy outside the timed region
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                kept += k( work.data(), work.size() / 2 );
+                secs += seconds( t0 );
+                points += work.size() / 2;
+            }
+        }
+        report( "removeDuplicates", impl, secs, points );
+        return kept;
+    }
+
+}; // namespace
+
+int main( int argc, char* argv[] ) {
+
+    std::size_t ringSize = argc > 1 ? std::atoi( argv[ 1 ] ) : 200;
+    std::size_t numRings = argc > 2 ? std::atoi( argv[ 2 ] ) : 5000;
+    int rounds = argc > 3 ? std::atoi( argv[ 3 ] ) : 20;
+
+    std::vector<geometry::PointArray> rings;
+    for( std::size_t i = 0; i < numRings; i++ ) {
+        rings.push_back( makeRing( ringSize, static_cast<unsigned>( i ) ) );
+    }
+    std::printf( "%u rings of about %u points, %d rounds, AVX2 %s\n",
+                 static_cast<unsigned>( numRings ), static_cast<unsigned>( ringSize ), rounds,
+                 geometry::hasAvx2() ? "available" : "not available" );
+
+    bool ok = true;
+    double area = benchArea( "scalar", geometry::scalar::signedArea, rings, rounds );
+    double box = benchBox( "scalar", geometry::scalar::expandBoundingBox, rings, rounds );
+    std::size_t kept = benchDedup( "scalar", geometry::scalar::removeDuplicates, rings, rounds );
+#ifdef SOSICON_AVX2_KERNELS
+    if( geometry::hasAvx2() ) {
+        ok = std::fabs( area - benchArea( "avx2", geometry::avx2::signedArea, rings, rounds ) ) <= 1e-9 * std::fabs( area ) && ok;
+        ok = box == benchBox( "avx2", geometry::avx2::expandBoundingBox, rings, rounds ) && ok;
+        ok = kept == benchDedup( "avx2", geometry::avx2::removeDuplicates, rings, rounds ) && ok;
+    }
+#endif
+    if( !ok ) {
+        std::printf( "Scalar and AVX2 results differ\n" );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sosicon {
+
+    //! Bounded single-producer, single-consumer queue
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Fixed-size ring buffer connecting two pipeline stages. Exactly one thread may push and
+        exactly one other thread may pop. Neither side takes a lock: the producer owns the tail
+        counter and the consumer owns the head counter, and each only reads the other's.
+
+        The blocking push() and pop() yield briefly while the queue is full or empty, then block
+        on a condition variable until the other side pops or pushes. A stage that is idle for
+        the whole conversion, like the writer of a converter that writes at the end, then does
+        not wake up until there is work. The lock is only taken when a thread is blocked.
+    */
+    template<typename T>
+    class BoundedQueue {
+
+        //! Ring buffer storage
+        std::vector<T> mSlots;
+
+        //! Number of items popped. Written by the consumer only.
+        std::atomic<std::size_t> mHead;
+
+        //! Number of items pushed. Written by the producer only.
+        std::atomic<std::size_t> mTail;
+
+        //! Number of threads blocked in block()
+        std::atomic<int> mWaiting;
+
+        //! Guards blocking waits
+        std::mutex mMutex;
+
+        //! Signalled on push and pop while a thread is blocked
+        std::condition_variable mChanged;
+
+        //! Yield rounds before blocking
+        static const unsigned int SPIN_ROUNDS = 64;
+
+        //! Block until ready() is true
+        template<typename Ready>
+        void block( Ready ready ) {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mWaiting.fetch_add( 1 );
+            std::atomic_thread_fence( std::memory_order_seq_cst ); // Pairs with notify()
+            mChanged.wait( lock, ready );
+            mWaiting.fetch_sub( 1 );
+        }
+
+        //! Wake blocked threads, if any
+        void notify() {
+            std::atomic_thread_fence( std::memory_order_seq_cst ); // Pairs with block()
+            if( mWaiting.load( std::memory_order_relaxed ) > 0 ) {
+                std::lock_guard<std::mutex> lock( mMutex );
+                mChanged.notify_all();
+            }
+        }
+
+        BoundedQueue( const BoundedQueue& );
+        BoundedQueue& operator = ( const BoundedQueue& );
+
+    public:
+
+        //! Construct queue holding at most \a capacity items
+        explicit BoundedQueue( std::size_t capacity ) : mSlots( capacity > 0 ? capacity : 1 ) {
+            mHead = 0;
+            mTail = 0;
+            mWaiting = 0;
+        }
+
+        //! Wait strategy for queues without blocking support
+        /*!
+            Yields for the first few rounds, then sleeps. Used by sosicon::MpscQueue and the
+            logger, whose waits are short.
+            \param rounds Number of times the caller has waited so far. Incremented.
+         */
+        static void wait( unsigned int& rounds ) {
+            if( ++rounds < SPIN_ROUNDS ) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+            }
+        }
+
+        //! Push item if there is room. Producer only.
+        bool tryPush( const T& item ) {
+            std::size_t tail = mTail.load( std::memory_order_relaxed );
+            if( tail - mHead.load( std::memory_order_acquire ) >= mSlots.size() ) {
+                return false;
+            }
+            mSlots[ tail % mSlots.size() ] = item;
+            mTail.store( tail + 1, std::memory_order_release );
+            notify();
+            return true;
+        }
+
+        //! Pop item if there is one. Consumer only.
+        bool tryPop( T& item ) {
+            std::size_t head = mHead.load( std::memory_order_relaxed );
+            if( head == mTail.load( std::memory_order_acquire ) ) {
+                return false;
+            }
+            item = mSlots[ head % mSlots.size() ];
+            mHead.store( head + 1, std::memory_order_release );
+            notify();
+            return true;
+        }
+
+        //! Wait for room after a failed tryPush(). Producer only.
+        /*!
+            Yields for the first few rounds, then blocks until the consumer pops.
+            \param rounds Number of times the caller has waited so far. Incremented.
+         */
+        void waitForRoom( unsigned int& rounds ) {
+            if( ++rounds < SPIN_ROUNDS ) {
+                std::this_thread::yield();
+                return;
+            }
+            block( [this]() {
+                return mTail.load( std::memory_order_relaxed ) - mHead.load( std::memory_order_acquire ) < mSlots.size();
+            } );
+        }
+
+        //! Wait for an item after a failed tryPop(). Consumer only.
+        /*!
+            Yields for the first few rounds, then blocks until the producer pushes.
+            \param rounds Number of times the caller has waited so far. Incremented.
+         */
+        void waitForItem( unsigned int& rounds ) {
+            if( ++rounds < SPIN_ROUNDS ) {
+                std::this_thread::yield();
+                return;
+            }
+            block( [this]() {
+                return mHead.load( std::memory_order_relaxed ) != mTail.load( std::memory_order_acquire );
+            } );
+        }
+
+        //! Push item, waiting for room. Producer only.
+        void push( const T& item ) {
+            unsigned int rounds = 0;
+            while( !tryPush( item ) ) {
+                waitForRoom( rounds );
+            }
+        }
+
+        //! Pop item, waiting for one to arrive. Consumer only.
+        void pop( T& item ) {
+            unsigned int rounds = 0;
+            while( !tryPop( item ) ) {
+                waitForItem( rounds );
+            }
+        }
+
+    }; // class BoundedQueue
+
+}; // namespace sosicon
+
+#endif
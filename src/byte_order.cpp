@@ -32,6 +32,18 @@ determine() {
     return endianness;
 }
 
+void sosicon::byteOrder::
+doublesToLittleEndian( const double* from, char* to, size_t count ) {
+    if( determine() == little && std::numeric_limits<double>::is_iec559 ) {
+        std::memcpy( to, from, count * sizeof( double ) );
+    }
+    else {
+        for( size_t i = 0; i < count; i++ ) {
+            doubleToLittleEndian( from[ i ], to + i * sizeof( double ) );
+        }
+    }
+}
+
 void sosicon::byteOrder::
 toBigEndian( const char* from, char* to, size_t bufSize ) {
     std::copy( from,
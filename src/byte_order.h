@@ -26,6 +26,8 @@
 #include "logger.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace sosicon {
 
@@ -61,6 +63,16 @@ namespace sosicon {
          */
         void doubleToLittleEndian( double from, char* to );
 
+        //! Writes little endian representation of an array of doubles
+        /*!
+            Same as calling doubleToLittleEndian() for each value, but copies the whole array
+            at once on little endian systems with IEEE 754 doubles.
+            \param from The values to write.
+            \param to Pointer to destination buffer, at least 8 * count bytes wide.
+            \param count Number of values.
+         */
+        void doublesToLittleEndian( const double* from, char* to, size_t count );
+
         //! Reverses buffer to big endian if required
         /*!
             Copies source buffer to destination buffer. If the program runs on a little-endian
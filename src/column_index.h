@@ -0,0 +1,103 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __COLUMN_INDEX_H__
+#define __COLUMN_INDEX_H__
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+namespace sosicon {
+
+    //! Column numbers for attribute rows
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Gives each field of the database exports a column number, so that rows can be
+        stored as arrays of values instead of maps keyed by field name. A file has only a
+        handful of distinct element names, so each one is converted to a field name with
+        utils::toFieldname() the first time it is seen, and looked up by name after that.
+        Element names that give the same field name share a column.
+    */
+    class ColumnIndex {
+
+        //! Column by element name
+        std::unordered_map<std::string, std::size_t> mElements;
+
+        //! Column by field name
+        std::map<std::string, std::size_t> mFields;
+
+        //! Field name by column
+        std::vector<std::string> mNames;
+
+    public:
+
+        //! Values by column. Rows created before a column was added may be shorter.
+        typedef std::vector<std::string> Row;
+
+        //! Column of a SOSI element, added if new
+        /*!
+            \param elementName Element name, as returned by ISosiElement::getName().
+            \return Column number.
+        */
+        std::size_t element( const std::string& elementName ) {
+            std::unordered_map<std::string, std::size_t>::iterator i = mElements.find( elementName );
+            if( i == mElements.end() ) {
+                i = mElements.insert( std::make_pair( elementName, field( utils::toFieldname( elementName ) ) ) ).first;
+            }
+            return i->second;
+        }
+
+        //! Column of a field, added if new
+        std::size_t field( const std::string& fieldName ) {
+            std::map<std::string, std::size_t>::iterator i = mFields.find( fieldName );
+            if( i == mFields.end() ) {
+                i = mFields.insert( std::make_pair( fieldName, mNames.size() ) ).first;
+                mNames.push_back( fieldName );
+            }
+            return i->second;
+        }
+
+        //! Field name of a column
+        const std::string& name( std::size_t column ) const { return mNames[ column ]; }
+
+        //! Number of columns
+        std::size_t size() const { return mNames.size(); }
+
+        //! Value of a column, for writing
+        static std::string& cell( Row& row, std::size_t column ) {
+            if( column >= row.size() ) {
+                row.resize( column + 1 );
+            }
+            return row[ column ];
+        }
+
+        //! Value of a column, or an empty string if the row has none
+        static const std::string& value( const Row& row, std::size_t column ) {
+            static const std::string empty;
+            return column < row.size() ? row[ column ] : empty;
+        }
+
+    }; // class ColumnIndex
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "column_type.h"
+
+namespace {
+
+    //! Compare with an uppercase keyword, ignoring ASCII case
+    bool keyword( const char* s, std::size_t n, const char* upper ) {
+        std::size_t len = std::strlen( upper );
+        if( n != len ) {
+            return false;
+        }
+        for( std::size_t i = 0; i < n; i++ ) {
+            char c = s[ i ];
+            if( c >= 'a' && c <= 'z' ) {
+                c = static_cast<char>( c - 'a' + 'A' );
+            }
+            if( c != upper[ i ] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Test if eight digits make a valid date
+    bool validDate( const char* s ) {
+        int y = ( s[ 0 ] - '0' ) * 1000 + ( s[ 1 ] - '0' ) * 100 + ( s[ 2 ] - '0' ) * 10 + ( s[ 3 ] - '0' );
+        int m = ( s[ 4 ] - '0' ) * 10 + ( s[ 5 ] - '0' );
+        int d = ( s[ 6 ] - '0' ) * 10 + ( s[ 7 ] - '0' );
+        static const int days[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        if( y < 1000 || m < 1 || m > 12 || d < 1 || d > days[ m - 1 ] ) {
+            return false;
+        }
+        return m != 2 || d < 29 || ( y % 4 == 0 && ( y % 100 != 0 || y % 400 == 0 ) );
+    }
+
+    //! Test if n digits are within a limit of the same length
+    bool withinLimit( const char* s, std::size_t n, const char* limit ) {
+        return n < std::strlen( limit ) || ( n == std::strlen( limit ) && std::memcmp( s, limit, n ) <= 0 );
+    }
+
+}; // namespace
+
+std::size_t sosicon::ColumnType::
+digits( const char* begin, const char* end ) {
+    const char* p = begin;
+    while( end - p >= 8 && eightDigits( p ) ) {
+        p += 8;
+    }
+    while( p < end && *p >= '0' && *p <= '9' ) {
+        p++;
+    }
+    return static_cast<std::size_t>( p - begin );
+}
+
+std::string::size_type sosicon::ColumnType::
+expand( const std::string& str ) {
+
+    std::string::size_type len = str.length();
+    mMinLength = std::min( mMinLength, len );
+    mMaxLength = std::max( mMaxLength, len );
+    mHasValues = true;
+
+    const char* s = str.data();
+    const char* end = s + len;
+    unsigned int found = 0;
+
+    if( keyword( s, len, "JA" ) || keyword( s, len, "NEI" ) || keyword( s, len, "TRUE" ) || keyword( s, len, "FALSE" ) ) {
+        found |= 1u << kind_boolean;
+    }
+
+    const char* p = s;
+    bool negative = p < end && *p == '-';
+    if( negative ) {
+        p++;
+    }
+    std::size_t intDigits = digits( p, end );
+    if( intDigits > 0 && !( intDigits > 1 && *p == '0' ) ) {
+        const char* q = p + intDigits;
+        if( q == end ) {
+            found |= 1u << kind_decimal;
+            if( withinLimit( p, intDigits, negative ? "2147483648" : "2147483647" ) ) {
+                found |= 1u << kind_int32;
+            }
+            if( withinLimit( p, intDigits, negative ? "9223372036854775808" : "9223372036854775807" ) ) {
+                found |= 1u << kind_int64;
+            }
+            mIntDigits = std::max( mIntDigits, static_cast<int>( intDigits ) );
+            mNegative = mNegative || negative;
+        }
+        else if( *q == '.' ) {
+            std::size_t fraction = digits( q + 1, end );
+            if( fraction > 0 && q + 1 + fraction == end ) {
+                found |= 1u << kind_decimal;
+                mIntDigits = std::max( mIntDigits, static_cast<int>( intDigits ) );
+                mScale = std::max( mScale, static_cast<int>( fraction ) );
+                mNegative = mNegative || negative;
+            }
+        }
+    }
+    if( !negative && len == 8 && intDigits == 8 && validDate( s ) ) {
+        found |= 1u << kind_date;
+    }
+
+    mCandidates &= found;
+    return mMaxLength;
+}
+
+sosicon::ColumnType::Kind sosicon::ColumnType::
+kind() const {
+    if( !mHasValues ) {
+        return kind_text;
+    }
+    if( mCandidates & ( 1u << kind_boolean ) ) {
+        return kind_boolean;
+    }
+    if( mCandidates & ( 1u << kind_date ) ) {
+        return kind_date;
+    }
+    if( mMinLength == mMaxLength ) {
+        // Treat fixed-length numerical data as character field, since they
+        // are in fact non-arithmetic types types like phone numbers or
+        // serial numbers.
+        return kind_text;
+    }
+    if( mCandidates & ( 1u << kind_int32 ) ) {
+        return kind_int32;
+    }
+    if( mCandidates & ( 1u << kind_int64 ) ) {
+        return kind_int64;
+    }
+    if( mCandidates & ( 1u << kind_decimal ) ) {
+        return kind_decimal;
+    }
+    return kind_text;
+}
+
+bool sosicon::ColumnType::
+isTrue( const std::string& str ) {
+    return keyword( str.data(), str.length(), "JA" ) || keyword( str.data(), str.length(), "TRUE" );
+}
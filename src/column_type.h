@@ -0,0 +1,146 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __COLUMN_TYPE_H__
+#define __COLUMN_TYPE_H__
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <stdint.h>
+
+namespace sosicon {
+
+    //! Column type inference
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Infers the type of a table column from the values it receives. Each value is
+        classified in a single pass, and narrows the set of types the column can still have.
+        Digit runs are tested eight bytes at a time in a 64-bit word, since most attribute
+        values in SOSI files are numbers, dates and codes.
+
+        Recognised types, in order of preference: boolean (JA, NEI, TRUE or FALSE), date
+        (valid YYYYMMDD), 32-bit integer, 64-bit integer and decimal number. Numbers with
+        leading zeros are codes, and so are columns where all numbers have the same length,
+        like phone numbers and serial numbers. These are kept as text.
+
+        Shared by the database exports and the DBF part of the shapefile export, so that
+        they agree on the type of each attribute.
+    */
+    class ColumnType {
+
+    public:
+
+        //! Inferred type
+        enum Kind {
+            kind_text,          //!< Text, or no values
+            kind_boolean,       //!< JA/NEI or TRUE/FALSE
+            kind_date,          //!< Date as YYYYMMDD
+            kind_int32,         //!< Integer within 32 bits
+            kind_int64,         //!< Integer within 64 bits
+            kind_decimal        //!< Decimal number, see precision() and scale()
+        };
+
+    private:
+
+        //! Bit for each Kind except kind_text, set while the column can still have it
+        unsigned int mCandidates;
+
+        //! Shortest value
+        std::string::size_type mMinLength;
+
+        //! Longest value
+        std::string::size_type mMaxLength;
+
+        //! Most digits before the decimal point
+        int mIntDigits;
+
+        //! Most digits after the decimal point
+        int mScale;
+
+        //! True if any value is negative
+        bool mNegative;
+
+        //! True once a value has been added
+        bool mHasValues;
+
+        //! Number of leading digits in [begin, end)
+        static std::size_t digits( const char* begin, const char* end );
+
+        //! Test if eight bytes are all ASCII digits
+        static bool eightDigits( const char* p ) {
+            uint64_t v;
+            std::memcpy( &v, p, 8 );
+            return ( ( v & 0xF0F0F0F0F0F0F0F0ull ) |
+                     ( ( ( v + 0x0606060606060606ull ) & 0xF0F0F0F0F0F0F0F0ull ) >> 4 ) ) == 0x3333333333333333ull;
+        }
+
+    public:
+
+        //! Constructor
+        ColumnType() : mCandidates( ~0u ), mMinLength( std::numeric_limits<std::string::size_type>::max() ),
+                       mMaxLength( 0 ), mIntDigits( 0 ), mScale( 0 ), mNegative( false ), mHasValues( false ) { }
+
+        //! Construct from first value
+        explicit ColumnType( const std::string& str ) : mCandidates( ~0u ),
+                       mMinLength( std::numeric_limits<std::string::size_type>::max() ),
+                       mMaxLength( 0 ), mIntDigits( 0 ), mScale( 0 ), mNegative( false ), mHasValues( false ) {
+            expand( str );
+        }
+
+        //! Add value
+        /*!
+            \param str Value, as written in the SOSI file.
+            \return Longest value so far.
+        */
+        std::string::size_type expand( const std::string& str );
+
+        //! Inferred type
+        Kind kind() const;
+
+        //! True for integer and decimal columns
+        bool isNumeric() const {
+            Kind k = kind();
+            return k == kind_int32 || k == kind_int64 || k == kind_decimal;
+        }
+
+        //! Longest value
+        std::string::size_type length() const { return mMaxLength; }
+
+        //! Most digits in total, for decimal columns
+        int precision() const { return mIntDigits + mScale; }
+
+        //! Most digits after the decimal point, for decimal columns
+        int scale() const { return mScale; }
+
+        //! True if any value is negative
+        bool negative() const { return mNegative; }
+
+        //! Value of a boolean column
+        /*!
+            \return True for JA and TRUE, false otherwise.
+        */
+        static bool isTrue( const std::string& str );
+
+    }; // class ColumnType
+
+}; // namespace sosicon
+
+#endif
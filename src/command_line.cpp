@@ -25,6 +25,15 @@ CommandLine() {
     mIsTtyIn = isatty( fileno( stdin ) ) != 0;
     mIsTtyOut = isatty( fileno( stdout ) ) != 0;
     mMakeSubDir = false;
+    mUseCache = false;
+    mSyncOutput = false;
+    mSimplifyTopology = false;
+    mMinZoom = 0;
+    mMaxZoom = 14;
+    mWkb = false;
+    mLoadData = false;
+    mParts = 0;
+    mValid = true;
 #if defined( _WIN32 )
     HANDLE out = GetStdHandle( STD_OUTPUT_HANDLE );
     CONSOLE_CURSOR_INFO ci;
@@ -46,6 +55,7 @@ CommandLine() {
 
 sosicon::CommandLine::
 ~CommandLine() {
+    sosicon::logstream.drain();
 #if defined( _WIN32 )
     HANDLE out = GetStdHandle( STD_OUTPUT_HANDLE );
     CONSOLE_CURSOR_INFO ci;
@@ -95,6 +105,7 @@ void sosicon::CommandLine::
 parse( int argc, char* argv[] ) {
 
     bool inputExpected = true;
+    bool valid = true;
     std::string inputLine = "";
 
     if( !mIsTtyIn ) {
@@ -119,6 +130,33 @@ parse( int argc, char* argv[] ) {
             if( "-a" == param ) {
                 mAppend = true;
             }
+            else if( "-bbox" == param && argc > ( ++i ) ) {
+                std::vector<std::string> bbox = utils::explode( ',', argv[ i ] );
+                mBbox.clear();
+                for( std::vector<std::string>::iterator b = bbox.begin(); b != bbox.end() && bbox.size() == 4; b++ ) {
+                    const char* begin = b->c_str();
+                    char* end = 0;
+                    double value = std::strtod( begin, &end );
+                    if( end == begin || *end || !std::isfinite( value ) ) {
+                        break;
+                    }
+                    mBbox.push_back( value );
+                }
+                if( mBbox.size() != 4 ) {
+                    mBbox.clear();
+                    std::cout << "-bbox takes four comma-separated numbers: minE,minN,maxE,maxN\n\n";
+                    valid = false;
+                }
+            }
+            else if( "-cache" == param ) {
+                mUseCache = true;
+            }
+            else if( "-fsync" == param ) {
+                mSyncOutput = true;
+            }
+            else if( "-profile" == param && argc > ( ++i ) ) {
+                mProfile = utils::unquote( argv[ i ] );
+            }
             else if( "-id" == param && argc > ( ++i ) ) {
                 mFilterSosiId = utils::explode( ',', argv[ i ] );
             }
@@ -149,15 +187,58 @@ parse( int argc, char* argv[] ) {
             else if( "-schema" == param && argc > ( ++i ) ) {
                 mDbSchema = argv[ i ];
             }
+            else if( "-simplify" == param && argc > ( ++i ) ) {
+                std::vector<std::string> tolerances = utils::explode( ',', argv[ i ] );
+                for( std::vector<std::string>::iterator t = tolerances.begin(); t != tolerances.end(); t++ ) {
+                    double tolerance = std::atof( t->c_str() );
+                    if( tolerance >= 0 && std::find( mSimplify.begin(), mSimplify.end(), tolerance ) == mSimplify.end() ) {
+                        mSimplify.push_back( tolerance );
+                    }
+                }
+                std::sort( mSimplify.begin(), mSimplify.end() );
+            }
             else if( "-srid" == param && argc > ( ++i ) ) {
                 mSrid = argv[ i ];
             }
+            else if( "-topology" == param ) {
+                mSimplifyTopology = true;
+            }
             else if( "-t" == param && argc > ( ++i ) ) {
                 mObjTypes = utils::explode( ',', utils::toLower( argv[ i ] ) );
             }
             else if( "-table" == param && argc > ( ++i ) ) {
                 mDbTable = argv[ i ];
             }
+            else if( "-where" == param && argc > ( ++i ) ) {
+                if( !mWhere.compile( argv[ i ] ) ) {
+                    std::cout << "Invalid -where expression: " << mWhere.error() << "\n\n";
+                    valid = false;
+                }
+            }
+            else if( "-parts" == param && argc > ( ++i ) ) {
+                mParts = std::atoi( argv[ i ] );
+                if( mParts < 1 ) {
+                    std::cout << "-parts takes a number of files, 1 or more\n\n";
+                    valid = false;
+                }
+            }
+            else if( "-zoom" == param && argc > ( ++i ) ) {
+                std::vector<std::string> zoom = utils::explode( '-', argv[ i ] );
+                if( zoom.size() == 1 || zoom.size() == 2 ) {
+                    mMinZoom = std::atoi( zoom.front().c_str() );
+                    mMaxZoom = std::atoi( zoom.back().c_str() );
+                }
+                if( zoom.size() < 1 || zoom.size() > 2 || mMinZoom < 0 || mMaxZoom > 24 || mMinZoom > mMaxZoom ) {
+                    std::cout << "-zoom takes a level or a range MIN-MAX between 0 and 24\n\n";
+                    valid = false;
+                }
+            }
+            else if( "-load" == param ) {
+                mLoadData = true;
+            }
+            else if( "-wkb" == param ) {
+                mWkb = true;
+            }
             else if( "-V" == param ) {
                 mVerbose = 2;
             }
@@ -176,6 +257,15 @@ parse( int argc, char* argv[] ) {
             else if( "-2tsv" == param ) {
                 mCommand = param;
             }
+            else if( "-2topojson" == param ) {
+                mCommand = param;
+            }
+            else if( "-2mvt" == param ) {
+                mCommand = param;
+            }
+            else if( "-2arrow" == param ) {
+                mCommand = param;
+            }
             else if( "-stat" == param ) {
                 mCommand = param;
             }
@@ -200,6 +290,14 @@ parse( int argc, char* argv[] ) {
         }
     }
 
+    sosicon::logstream.drain(); // Queued messages first, the ones below go straight to std::cout
+
+    if( !valid ) {
+        mCommand.clear();
+        mValid = false;
+        return;
+    }
+
     if( mCommand.empty() || ( inputExpected && mSourceFiles.size() == 0 ) ) {
         std::cout << "Missing input parameters.\n";
         std::cout << "Type sosicon -help for instructions.\n\n";
@@ -232,8 +330,40 @@ outputHelpText() {
     std::cout << "  -2psql\n";
     std::cout << "      Convert SOSI source to PostgreSQL/PostGIS dump.\n";
     std::cout << "\n";
+    std::cout << "  -2topojson\n";
+    std::cout << "      Convert SOSI source to TopoJSON, one object per OBJTYPE.\n";
+    std::cout << "      Each curve is written once, as an arc shared by the features\n";
+    std::cout << "      using it. Coordinates are quantized to a 1000000x1000000 grid\n";
+    std::cout << "      over the extent of the data. With -simplify, the arcs are\n";
+    std::cout << "      simplified to the first tolerance.\n";
+    std::cout << "\n";
+    std::cout << "  -2mvt\n";
+    std::cout << "      Convert SOSI source to Mapbox Vector Tiles, one layer per\n";
+    std::cout << "      OBJTYPE, for the zoom levels given by -zoom. Tiles are\n";
+    std::cout << "      written as z/x/y.pbf under the directory given by -o\n";
+    std::cout << "      (default sosicon_tiles), or into a single tar archive if\n";
+    std::cout << "      the -o name ends with .tar. A TileJSON metadata.json file\n";
+    std::cout << "      describes the layers.\n";
+    std::cout << "\n";
+    std::cout << "  -2arrow\n";
+    std::cout << "      Convert SOSI source to Apache Arrow IPC files (Feather v2),\n";
+    std::cout << "      one per geometry type: <NAME>_point.arrow,\n";
+    std::cout << "      <NAME>_linestring.arrow and <NAME>_polygon.arrow, where NAME\n";
+    std::cout << "      is given by -o (default sosicon). Geometries are stored as\n";
+    std::cout << "      GeoArrow columns, and attributes as dictionary-encoded\n";
+    std::cout << "      strings. The sources are read twice, since the schema is\n";
+    std::cout << "      written first.\n";
+    std::cout << "\n";
+    std::cout << "  -2tsv\n";
+    std::cout << "      Convert SOSI source to one tab separated file, with the\n";
+    std::cout << "      geometry as WKT in the first column and one column per\n";
+    std::cout << "      attribute. The file is written as CSV instead if the -o\n";
+    std::cout << "      name ends with .csv. Default name is sosicon.tsv. The\n";
+    std::cout << "      sources are read twice, since the header is written first.\n";
+    std::cout << "\n";
     std::cout << "  -stat\n";
-    std::cout << "      Print out statistics for a SOSI file.\n";
+    std::cout << "      Print out statistics for a SOSI file: element and OBJTYPE\n";
+    std::cout << "      counts, and vertex count and bounding box per OBJTYPE.\n";
     std::cout << "\n";
     std::cout << "\n";
     std::cout << "OPTIONS:\n";
@@ -250,14 +380,77 @@ outputHelpText() {
     std::cout << "      types. Use the -stat OPERATION to obtain a list of\n";
     std::cout << "      GEOMETRIES contained in a SOSI file.\n";
     std::cout << "\n";
+    std::cout << "  -bbox <MINE,MINN,MAXE,MAXN>\n";
+    std::cout << "      Export features whose bounding box intersects the given\n";
+    std::cout << "      box only. Coordinates are given as east, north, in the\n";
+    std::cout << "      coordinate system of the SOSI file. Curves outside the box\n";
+    std::cout << "      are still used for building surfaces that cross it.\n";
+    std::cout << "\n";
+    std::cout << "  -where <EXPRESSION>\n";
+    std::cout << "      Export features whose attributes match EXPRESSION only.\n";
+    std::cout << "      Comparisons are written NAME=VALUE, with the operators\n";
+    std::cout << "      = != < <= > >=, or NAME IN (VALUE,VALUE,...), and may be\n";
+    std::cout << "      combined with AND, OR, NOT and parentheses. An unquoted\n";
+    std::cout << "      VALUE ending with * after = or in an IN-list matches by\n";
+    std::cout << "      prefix. Ranges compare numerically when both sides are\n";
+    std::cout << "      numbers. Example:\n";
+    std::cout << "      -where \"KOMM IN (0301,0219) AND DATAFANGSTDATO>=20100101\"\n";
+    std::cout << "\n";
     std::cout << "  -o <FILENAME>\n";
     std::cout << "      Specify output file path and base name.\n";
     std::cout << "\n";
+    std::cout << "  -cache\n";
+    std::cout << "      Store parsed SOSI content in a .sosicache file next to\n";
+    std::cout << "      each source file, and reuse it on later runs as long as\n";
+    std::cout << "      the source file is unchanged.\n";
+    std::cout << "\n";
+    std::cout << "  -fsync\n";
+    std::cout << "      Flush output files to disk before exiting.\n";
+    std::cout << "\n";
+    std::cout << "  -profile <FILENAME>\n";
+    std::cout << "      Measure wall and CPU time, bytes read and written, features\n";
+    std::cout << "      per second, allocations and peak memory of each stage\n";
+    std::cout << "      (parse, refs, coordinates, convert, write), in total and\n";
+    std::cout << "      per source file, and write them to FILENAME as JSON.\n";
+    std::cout << "\n";
+    std::cout << "  -simplify <TOLERANCES>\n";
+    std::cout << "      Simplify lines and polygons, removing vertices that span\n";
+    std::cout << "      less than TOLERANCE squared with their neighbours\n";
+    std::cout << "      (Visvalingam-Whyatt). TOLERANCE is given in coordinate\n";
+    std::cout << "      units. With a comma-separated list, one layer is written\n";
+    std::cout << "      per tolerance: -2shp writes one file set per tolerance and\n";
+    std::cout << "      -2psql adds a geometry column for each tolerance after the\n";
+    std::cout << "      first. Extra layers are named with an _s<TOLERANCE> suffix.\n";
+    std::cout << "      0 gives the unsimplified layer. -2mysql uses the first\n";
+    std::cout << "      tolerance only.\n";
+    std::cout << "\n";
+    std::cout << "  -topology\n";
+    std::cout << "      With -simplify, simplify each curve once and build surfaces\n";
+    std::cout << "      from the simplified curves. Neighbouring polygons keep their\n";
+    std::cout << "      shared boundaries, without gaps or overlaps.\n";
+    std::cout << "\n";
     std::cout << "-shp options\n";
     std::cout << "  -d <DIRECTORY>\n";
     std::cout << "      Specify a destination directory where the generated files\n";
     std::cout << "      should be put.\n";
     std::cout << "\n";
+    std::cout << "-2mvt options\n";
+    std::cout << "  -zoom <MIN-MAX>\n";
+    std::cout << "      Specify the zoom levels to generate tiles for, as a range\n";
+    std::cout << "      or a single level. Default is 0-14.\n";
+    std::cout << "\n";
+    std::cout << "-2tsv options\n";
+    std::cout << "  -wkb\n";
+    std::cout << "      Write geometries as hex-encoded WKB instead of WKT.\n";
+    std::cout << "\n";
+    std::cout << "-2mysql options\n";
+    std::cout << "  -load\n";
+    std::cout << "      Write the rows to one tab separated file per geometry type,\n";
+    std::cout << "      with geometries as hex-encoded WKB, and load them from the\n";
+    std::cout << "      SQL script with LOAD DATA LOCAL INFILE. The spatial index is\n";
+    std::cout << "      added after the data is loaded. Run the script from the\n";
+    std::cout << "      directory sosicon was run from, with local_infile enabled.\n";
+    std::cout << "\n";
     std::cout << "-2psql options\n";
     std::cout << "  -schema <NAME>\n";
     std::cout << "      Specify database schema in which to create the data tables.\n";
@@ -270,6 +463,14 @@ outputHelpText() {
     std::cout << "      stored in that table. If this parameter is not specified,\n";
     std::cout << "      the default name 'object' will be used.\n";
     std::cout << "\n";
+    std::cout << "  -parts <N>\n";
+    std::cout << "      Split the dump for parallel loading. The main file creates\n";
+    std::cout << "      the tables UNLOGGED, and the rows of each table are spread\n";
+    std::cout << "      over N files named <NAME>_<GEOMETRY>_<PART>.sql, which can\n";
+    std::cout << "      be loaded by N psql sessions at once. <NAME>_finish.sql is\n";
+    std::cout << "      run last: it sets the tables LOGGED, creates GiST indexes,\n";
+    std::cout << "      clusters the tables on them and runs ANALYZE.\n";
+    std::cout << "\n";
     std::cout << "  -create\n";
     std::cout << "      Specify this flag to emit only the table creation script.\n";
     std::cout << "      No data will be exported, only the schema and table\n";
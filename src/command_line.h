@@ -19,6 +19,8 @@
 #define __COMMAND_LINE_H__
 
 #include <stdio.h>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -36,6 +38,7 @@
 #include <unistd.h>
 #endif
 #include "utils.h"
+#include "feature_filter.h"
 
 namespace sosicon {
 
@@ -103,6 +106,14 @@ namespace sosicon {
          */
         std::vector<std::string> mFilterSosiId;
 
+        //! Attribute filter
+        /*!
+            Compiled from the expression following the -where argument. Empty if all features
+            should be exported.
+            \sa sosicon::FeatureFilter
+         */
+        FeatureFilter mWhere;
+
         //! List of geometry types to output
         /*!
             String vector containing the geometry types for the elements to be included in the
@@ -179,12 +190,106 @@ namespace sosicon {
          */
         bool mMakeSubDir;
 
+        //! Simplification tolerances
+        /*!
+            Given by the -simplify switch, in ascending order. Empty if geometries should be
+            exported as they are. With more than one tolerance, converters that support it emit
+            one layer per tolerance.
+            \sa sosicon::CoordinateCollection::simplify()
+         */
+        std::vector<double> mSimplify;
+
+        //! Topology-preserving simplification
+        /*!
+            If the -topology switch is specified, this flag is set to true. Each curve is then
+            simplified once, and surfaces are assembled from the simplified curves, so
+            neighbouring polygons still share their boundaries exactly.
+            \sa sosicon::CurveCache::get()
+         */
+        bool mSimplifyTopology;
+
+        //! Bounding box filter
+        /*!
+            Given by the -bbox switch as minimum east, minimum north, maximum east and maximum
+            north. Empty if all features should be exported.
+            \sa sosicon::Parser::setBoundingBox()
+         */
+        std::vector<double> mBbox;
+
+        //! Zoom range for tiled exports
+        /*!
+            Given by the -zoom switch as MIN-MAX, or a single level. Defaults to 0-14.
+            \sa sosicon::ConverterSosi2mvt
+         */
+        int mMinZoom;
+
+        //! Highest zoom level for tiled exports, see mMinZoom
+        int mMaxZoom;
+
+        //! Number of data files for parallel loading
+        /*!
+            Given by the -parts switch. If greater than 0, the PostGIS export spreads the rows of
+            each table over this many files, to be loaded by parallel sessions, and creates
+            the tables UNLOGGED. A separate script then adds the indexes. 0 writes one dump.
+            \sa sosicon::ConverterSosi2psql
+         */
+        int mParts;
+
+        //! Bulk load output for MySQL
+        /*!
+            If the -load switch is specified, this flag is set to true. The MySQL export then
+            writes the rows to tab separated data files, with the geometries as WKB, and the
+            SQL script loads them with LOAD DATA LOCAL INFILE instead of INSERT statements.
+            \sa sosicon::ConverterSosi2mysql
+         */
+        bool mLoadData;
+
+        //! Write geometries as WKB
+        /*!
+            If the -wkb switch is specified, this flag is set to true. Tabular exports then
+            write the geometry column as hex-encoded well-known binary instead of text.
+            \sa sosicon::ConverterSosi2tsv
+         */
+        bool mWkb;
+
         //! Specifies SRID for exports
         /*!
             Used for grid conversion exports to postGIS or other conversions that supports this.
          */
         std::string mSrid;
 
+        //! Use parse cache
+        /*!
+            If the -cache switch is specified, this flag is set to true. The parsed content of
+            each source file is then stored in a .sosicache file next to the source, and reused
+            on later runs for as long as the source file is unchanged.
+            \sa sosicon::ParseCache
+         */
+        bool mUseCache;
+
+        //! Flush output to disk
+        /*!
+            If the -fsync switch is specified, this flag is set to true. Output files are then
+            fsync'ed before the conversion is reported as done.
+            \sa sosicon::AsyncFileWriter::close()
+         */
+        bool mSyncOutput;
+
+        //! Profiling report
+        /*!
+            Path given with the -profile switch, or empty. If set, time, memory and throughput
+            are measured by stage and written to this file as JSON when the conversion is done.
+            \sa sosicon::Profiler
+         */
+        std::string mProfile;
+
+        //! False if the command line has invalid parameters
+        /*!
+            Set by parse() when a parameter value is rejected, like a malformed -where
+            expression or -bbox. No conversion is run, and sosicon exits with an error status.
+         */
+        bool mValid;
+
         //! Verbose output
         /*!
             Verbose level. If this value is 0, no informative output will be emitted during file
@@ -0,0 +1,647 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "converter_sosi2arrow.h"
+
+namespace {
+
+    typedef sosicon::FlatBufferWriter::Offset Offset;
+
+    //! Arrow metadata version V5
+    const int16_t ARROW_VERSION = 4;
+
+    //! MessageHeader union members
+    enum MessageHeader {
+        header_schema = 1,
+        header_dictionary_batch = 2,
+        header_record_batch = 3
+    };
+
+    //! Type union members
+    enum ArrowType {
+        type_floating_point = 3,
+        type_utf8 = 5,
+        type_list = 12,
+        type_fixed_size_list = 16
+    };
+
+    //! Convert string from the SOSI file's character set to UTF-8
+    std::string toUtf8( const std::string& str ) {
+        sosicon::sosi::SosiCharsetSingleton* cs = sosicon::sosi::SosiCharsetSingleton::getInstance();
+        if( cs->getEncoding() == sosicon::sosi::sosi_charset_utf8 ) {
+            return str;
+        }
+        return sosicon::utils::iso8859_1ToUtf8( cs->toIso8859_1( str ) );
+    }
+
+    //! Write little-endian 32-bit integer
+    void writeInt32( std::ostream& os, int32_t value ) {
+        char bytes[ 4 ];
+        for( int i = 0; i < 4; i++ ) {
+            bytes[ i ] = static_cast<char>( static_cast<uint32_t>( value ) >> ( 8 * i ) );
+        }
+        os.write( bytes, 4 );
+    }
+
+    //! Record batch body, with its field nodes and buffer locations
+    struct Body {
+
+        std::string data;               //!< Buffers, each padded to 8 bytes
+        std::vector<int64_t> nodes;     //!< Length and null count of each array
+        std::vector<int64_t> buffers;   //!< Offset and length of each buffer
+
+        //! Add array
+        void node( int64_t length, int64_t nulls ) {
+            nodes.push_back( length );
+            nodes.push_back( nulls );
+        }
+
+        //! Add buffer
+        void buffer( const void* p, std::size_t size ) {
+            buffers.push_back( static_cast<int64_t>( data.size() ) );
+            buffers.push_back( static_cast<int64_t>( size ) );
+            data.append( static_cast<const char*>( p ), size );
+            data.append( ( 8 - size % 8 ) % 8, '\0' );
+        }
+
+        //! Add buffer from vector
+        template<typename T> void buffer( const std::vector<T>& v ) {
+            buffer( v.empty() ? 0 : &v[ 0 ], v.size() * sizeof( T ) );
+        }
+
+        //! Write RecordBatch table
+        Offset recordBatch( sosicon::FlatBufferWriter& fb, int64_t length ) {
+            Offset n = fb.structVector( nodes, 2 );
+            Offset b = fb.structVector( buffers, 2 );
+            fb.startTable();
+            fb.add<int64_t>( 0, length );
+            fb.addOffset( 1, n );
+            fb.addOffset( 2, b );
+            return fb.endTable();
+        }
+    };
+
+    //! Write Message table and finish the buffer
+    std::string message( sosicon::FlatBufferWriter& fb, MessageHeader type, Offset header, int64_t bodyLength ) {
+        fb.startTable();
+        fb.add<int16_t>( 0, ARROW_VERSION );
+        fb.add<uint8_t>( 1, static_cast<uint8_t>( type ) );
+        fb.addOffset( 2, header );
+        fb.add<int64_t>( 3, bodyLength );
+        return fb.finish( fb.endTable() );
+    }
+
+    //! Write empty table, for types without parameters
+    Offset emptyTable( sosicon::FlatBufferWriter& fb ) {
+        fb.startTable();
+        return fb.endTable();
+    }
+
+    //! Write KeyValue table
+    Offset keyValue( sosicon::FlatBufferWriter& fb, const std::string& key, const std::string& value ) {
+        Offset k = fb.string( key );
+        Offset v = fb.string( value );
+        fb.startTable();
+        fb.addOffset( 0, k );
+        fb.addOffset( 1, v );
+        return fb.endTable();
+    }
+
+    //! Write Field table
+    Offset field( sosicon::FlatBufferWriter& fb, const std::string& name, bool nullable,
+                  ArrowType type, Offset typeTable, const std::vector<Offset>& children,
+                  Offset dictionary = 0, const std::vector<Offset>& metadata = std::vector<Offset>() ) {
+        Offset n = fb.string( name );
+        Offset c = fb.offsetVector( children );
+        Offset m = metadata.empty() ? 0 : fb.offsetVector( metadata );
+        fb.startTable();
+        fb.addOffset( 0, n );
+        fb.add<uint8_t>( 1, nullable ? 1 : 0 );
+        fb.add<uint8_t>( 2, static_cast<uint8_t>( type ) );
+        fb.addOffset( 3, typeTable );
+        if( dictionary ) {
+            fb.addOffset( 4, dictionary );
+        }
+        fb.addOffset( 5, c );
+        if( m ) {
+            fb.addOffset( 6, m );
+        }
+        return fb.endTable();
+    }
+
+    //! Write List field
+    Offset listField( sosicon::FlatBufferWriter& fb, const std::string& name, Offset child,
+                      const std::vector<Offset>& metadata = std::vector<Offset>() ) {
+        return field( fb, name, true, type_list, emptyTable( fb ), std::vector<Offset>( 1, child ), 0, metadata );
+    }
+
+    //! Write field of interleaved x, y coordinates
+    Offset coordinateField( sosicon::FlatBufferWriter& fb, const std::string& name,
+                            const std::vector<Offset>& metadata = std::vector<Offset>() ) {
+        fb.startTable();
+        fb.add<int16_t>( 0, 2 ); // Double precision
+        Offset xy = field( fb, "xy", false, type_floating_point, fb.endTable(), std::vector<Offset>() );
+        fb.startTable();
+        fb.add<int32_t>( 0, 2 ); // List size
+        return field( fb, name, true, type_fixed_size_list, fb.endTable(), std::vector<Offset>( 1, xy ), 0, metadata );
+    }
+
+}; // namespace
+
+sosicon::FlatBufferWriter::Offset sosicon::ConverterSosi2arrow::Table::
+schema( FlatBufferWriter& fb ) {
+
+    std::vector<Offset> fields;
+
+    std::string extension;
+    switch( mType ) {
+        case wkt_point:
+            extension = "geoarrow.point";
+            break;
+        case wkt_linestring:
+            extension = "geoarrow.linestring";
+            break;
+        default:
+            extension = "geoarrow.multipolygon";
+    }
+    std::vector<Offset> metadata;
+    metadata.push_back( keyValue( fb, "ARROW:extension:name", extension ) );
+    metadata.push_back( keyValue( fb, "ARROW:extension:metadata", mCrs.empty() ? "{}" :
+                                  "{\"crs\":" + utils::jsonQuote( mCrs ) + ",\"crs_type\":\"authority_code\"}" ) );
+    switch( mType ) {
+        case wkt_point:
+            fields.push_back( coordinateField( fb, "geometry", metadata ) );
+            break;
+        case wkt_linestring:
+            fields.push_back( listField( fb, "geometry", coordinateField( fb, "vertices" ), metadata ) );
+            break;
+        default:
+            fields.push_back( listField( fb, "geometry", listField( fb, "polygons",
+                              listField( fb, "rings", coordinateField( fb, "vertices" ) ) ), metadata ) );
+    }
+
+    for( std::size_t c = 0; c < mColumns.size(); c++ ) {
+        fb.startTable();
+        fb.add<int32_t>( 0, 32 ); // Bit width
+        fb.add<uint8_t>( 1, 1 );  // Signed
+        Offset indexType = fb.endTable();
+        fb.startTable();
+        fb.add<int64_t>( 0, static_cast<int64_t>( c ) );
+        fb.addOffset( 1, indexType );
+        Offset dictionary = fb.endTable();
+        fields.push_back( field( fb, mColumns[ c ].name, true, type_utf8, emptyTable( fb ), std::vector<Offset>(), dictionary ) );
+    }
+
+    Offset f = fb.offsetVector( fields );
+    fb.startTable();
+    fb.add<int16_t>( 0, 0 ); // Little endian
+    fb.addOffset( 1, f );
+    return fb.endTable();
+}
+
+void sosicon::ConverterSosi2arrow::Table::
+writeMessage( const std::string& metadata, const std::string& body, std::vector<int64_t>* blocks ) {
+    std::size_t padding = ( 8 - metadata.size() % 8 ) % 8;
+    int64_t metadataLength = static_cast<int64_t>( 8 + metadata.size() + padding );
+    if( blocks ) {
+        blocks->push_back( mPosition );
+        blocks->push_back( metadataLength );
+        blocks->push_back( static_cast<int64_t>( body.size() ) );
+    }
+    writeInt32( mStream, -1 ); // Continuation marker
+    writeInt32( mStream, static_cast<int32_t>( metadata.size() + padding ) );
+    mStream.write( metadata.data(), metadata.size() );
+    mStream.write( "\0\0\0\0\0\0\0", padding );
+    mStream.write( body.data(), body.size() );
+    mPosition += metadataLength + static_cast<int64_t>( body.size() );
+}
+
+void sosicon::ConverterSosi2arrow::Table::
+resetBatch() {
+    mRows = 0;
+    mCoords.clear();
+    for( int i = 0; i < 3; i++ ) {
+        mOffsets[ i ].assign( 1, 0 );
+    }
+    for( std::vector<Column>::iterator c = mColumns.begin(); c != mColumns.end(); c++ ) {
+        c->keys.clear();
+        c->validity.clear();
+        c->nulls = 0;
+    }
+}
+
+void sosicon::ConverterSosi2arrow::Table::
+writeBatch() {
+
+    // Dictionary values first seen in this batch
+    for( std::size_t c = 0; c < mColumns.size(); c++ ) {
+        Column& col = mColumns[ c ];
+        if( col.written && col.pending.empty() ) {
+            continue;
+        }
+        std::vector<int32_t> offsets( 1, 0 );
+        std::string values;
+        for( std::vector<std::string>::iterator v = col.pending.begin(); v != col.pending.end(); v++ ) {
+            values += *v;
+            offsets.push_back( static_cast<int32_t>( values.size() ) );
+        }
+        Body body;
+        body.node( static_cast<int64_t>( col.pending.size() ), 0 );
+        body.buffer( 0, 0 );
+        body.buffer( offsets );
+        body.buffer( values.data(), values.size() );
+        FlatBufferWriter fb;
+        Offset data = body.recordBatch( fb, static_cast<int64_t>( col.pending.size() ) );
+        fb.startTable();
+        fb.add<int64_t>( 0, static_cast<int64_t>( c ) );
+        fb.addOffset( 1, data );
+        fb.add<uint8_t>( 2, col.written ? 1 : 0 ); // Delta
+        Offset batch = fb.endTable();
+        writeMessage( message( fb, header_dictionary_batch, batch, static_cast<int64_t>( body.data.size() ) ), body.data, &mDictionaryBlocks );
+        col.written = true;
+        col.pending.clear();
+    }
+
+    Body body;
+    int64_t rows = static_cast<int64_t>( mRows );
+    int64_t vertices = static_cast<int64_t>( mCoords.size() / 2 );
+    body.node( rows, 0 );
+    body.buffer( 0, 0 );
+    if( mType == wkt_polygon ) {
+        body.buffer( mOffsets[ 0 ] );
+        body.node( static_cast<int64_t>( mOffsets[ 0 ].back() ), 0 );
+        body.buffer( 0, 0 );
+        body.buffer( mOffsets[ 1 ] );
+        body.node( static_cast<int64_t>( mOffsets[ 1 ].back() ), 0 );
+        body.buffer( 0, 0 );
+        body.buffer( mOffsets[ 2 ] );
+        body.node( vertices, 0 );
+        body.buffer( 0, 0 );
+    }
+    else if( mType == wkt_linestring ) {
+        body.buffer( mOffsets[ 0 ] );
+        body.node( vertices, 0 );
+        body.buffer( 0, 0 );
+    }
+    body.node( 2 * vertices, 0 );
+    body.buffer( 0, 0 );
+    body.buffer( mCoords );
+
+    for( std::vector<Column>::iterator c = mColumns.begin(); c != mColumns.end(); c++ ) {
+        body.node( rows, c->nulls );
+        if( c->nulls > 0 ) {
+            body.buffer( c->validity );
+        }
+        else {
+            body.buffer( 0, 0 );
+        }
+        body.buffer( c->keys );
+    }
+
+    FlatBufferWriter fb;
+    Offset batch = body.recordBatch( fb, rows );
+    writeMessage( message( fb, header_record_batch, batch, static_cast<int64_t>( body.data.size() ) ), body.data, &mBatchBlocks );
+
+    mTotalRows += rows;
+    resetBatch();
+}
+
+void sosicon::ConverterSosi2arrow::Table::
+collect( ISosiElement* parent, bool discover ) {
+
+    sosi::SosiElementSearch srcData;
+    while( parent->getChild( srcData ) ) {
+
+        ISosiElement* dataElement = srcData.element();
+        sosi::ElementType type = dataElement->getType();
+        if( type == sosi::sosi_element_ne || type == sosi::sosi_element_neh || type == sosi::sosi_element_ref ) {
+            continue;
+        }
+
+        collect( dataElement, discover );
+
+        const std::string& data = dataElement->getData();
+        if( data.empty() ) {
+            continue;
+        }
+        std::string fieldName = utils::iso8859_1ToUtf8( utils::toFieldname( dataElement->getName() ) );
+        if( discover ) {
+            mColumnIndex.insert( std::make_pair( fieldName, 0 ) );
+            continue;
+        }
+        std::map<std::string, std::size_t>::iterator c = mColumnIndex.find( fieldName );
+        if( c == mColumnIndex.end() ) {
+            continue;
+        }
+        std::string value = toUtf8( utils::unquote( data ) );
+        if( mRowSet[ c->second ] ) {
+            mRow[ c->second ] += "|" + value;
+        }
+        else {
+            mRow[ c->second ] = value;
+            mRowSet[ c->second ] = true;
+        }
+    }
+}
+
+bool sosicon::ConverterSosi2arrow::Table::
+open( const std::string& fileName, const std::string& crs ) {
+
+    if( !mFile.open( fileName ) ) {
+        return false;
+    }
+    mFileName = fileName;
+    mCrs = crs;
+
+    // Columns follow the geometry in name order, as in the PostGIS tables
+    for( std::map<std::string, std::size_t>::iterator c = mColumnIndex.begin(); c != mColumnIndex.end(); c++ ) {
+        c->second = mColumns.size();
+        mColumns.push_back( Column() );
+        mColumns.back().name = c->first;
+    }
+    mRow.resize( mColumns.size() );
+    mRowSet.resize( mColumns.size() );
+    resetBatch();
+
+    mStream.write( "ARROW1\0\0", 8 );
+    mPosition = 8;
+    FlatBufferWriter fb;
+    Offset s = schema( fb );
+    writeMessage( message( fb, header_schema, s, 0 ), std::string(), 0 );
+    return true;
+}
+
+void sosicon::ConverterSosi2arrow::Table::
+append( CoordinateCollection& cc ) {
+
+    switch( mType ) {
+        case wkt_point:
+            if( cc.getGeom().size() >= 2 ) {
+                mCoords.insert( mCoords.end(), cc.getGeom().begin(), cc.getGeom().begin() + 2 );
+            }
+            else {
+                mCoords.resize( mCoords.size() + 2, std::numeric_limits<double>::quiet_NaN() ); // Empty point
+            }
+            break;
+        case wkt_linestring:
+            mCoords.insert( mCoords.end(), cc.getGeom().begin(), cc.getGeom().end() );
+            mOffsets[ 0 ].push_back( static_cast<int32_t>( mCoords.size() / 2 ) );
+            break;
+        default:
+            {
+                geometry::PointArray xy;
+                std::vector<int> sizes;
+                cc.getRings( xy, sizes );
+                mCoords.insert( mCoords.end(), xy.begin(), xy.end() );
+                int32_t vertex = mOffsets[ 2 ].back();
+                for( std::vector<int>::iterator s = sizes.begin(); s != sizes.end(); s++ ) {
+                    if( *s > 0 ) {
+                        mOffsets[ 1 ].push_back( mOffsets[ 1 ].back() );
+                    }
+                    vertex += std::abs( *s );
+                    mOffsets[ 2 ].push_back( vertex );
+                    mOffsets[ 1 ].back()++;
+                }
+                mOffsets[ 0 ].push_back( static_cast<int32_t>( mOffsets[ 1 ].size() - 1 ) );
+            }
+    }
+
+    for( std::size_t c = 0; c < mColumns.size(); c++ ) {
+        Column& col = mColumns[ c ];
+        if( mRows % 8 == 0 ) {
+            col.validity.push_back( 0 );
+        }
+        if( !mRowSet[ c ] ) {
+            col.keys.push_back( 0 );
+            col.nulls++;
+            continue;
+        }
+        std::unordered_map<std::string, int32_t>::iterator v = col.index.find( mRow[ c ] );
+        if( v == col.index.end() ) {
+            v = col.index.insert( std::make_pair( mRow[ c ], static_cast<int32_t>( col.index.size() ) ) ).first;
+            col.pending.push_back( mRow[ c ] );
+        }
+        col.keys.push_back( v->second );
+        col.validity.back() |= static_cast<unsigned char>( 1 << ( mRows % 8 ) );
+        mRowSet[ c ] = false;
+    }
+
+    if( ++mRows == BATCH_SIZE ) {
+        writeBatch();
+    }
+}
+
+bool sosicon::ConverterSosi2arrow::Table::
+close( bool sync ) {
+
+    if( mRows > 0 || mBatchBlocks.empty() ) {
+        writeBatch();
+    }
+    writeInt32( mStream, -1 ); // End of stream
+    writeInt32( mStream, 0 );
+
+    FlatBufferWriter fb;
+    Offset s = schema( fb );
+    Offset dictionaries = fb.structVector( mDictionaryBlocks, 3 );
+    Offset batches = fb.structVector( mBatchBlocks, 3 );
+    fb.startTable();
+    fb.add<int16_t>( 0, ARROW_VERSION );
+    fb.addOffset( 1, s );
+    fb.addOffset( 2, dictionaries );
+    fb.addOffset( 3, batches );
+    std::string footer = fb.finish( fb.endTable() );
+    mStream.write( footer.data(), footer.size() );
+    writeInt32( mStream, static_cast<int32_t>( footer.size() ) );
+    mStream.write( "ARROW1", 6 );
+
+    return mFile.close( sync );
+}
+
+sosicon::ConverterSosi2arrow::
+~ConverterSosi2arrow() {
+    for( std::map<Wkt, Table*>::iterator t = mTables.begin(); t != mTables.end(); t++ ) {
+        delete t->second;
+    }
+}
+
+void sosicon::ConverterSosi2arrow::
+checkCrs( ISosiElement* root ) {
+
+    mCrsChecked = true;
+
+    // Path: .HODE/..TRANSPAR/...KOORDSYS
+    sosi::SosiElementSearch srcHead( sosi::sosi_element_head );
+    sosi::SosiElementSearch srcTranspar( sosi::sosi_element_transpar );
+    sosi::SosiElementSearch srcCoordsys( sosi::sosi_element_coordsys );
+
+    std::string crs;
+    if( root &&
+        root->getChild( srcHead ) &&
+        srcHead.element()->getChild( srcTranspar ) &&
+        srcTranspar.element()->getChild( srcCoordsys ) )
+    {
+        std::stringstream ss;
+        int sysCode = 0;
+        ss << srcCoordsys.element()->getData();
+        ss >> sysCode;
+        if( sysCode > 0 && sysCode <= sosi::MAX_COORDSYS_TABLE ) {
+            sosi::SosiTranslationTable tt;
+            sosi::CoordSys& cs = tt.sysCodeToCoordSys( sysCode );
+            if( !cs.srid().empty() ) {
+                crs = "EPSG:" + cs.srid();
+            }
+        }
+    }
+
+    if( mDiscover ) {
+        if( mCrs.empty() ) {
+            mCrs = crs;
+        }
+        else if( mCrs != crs ) {
+            sosicon::logstream << mCurrentSourcefile << " has another coordinate system than the first file ("
+                               << ( crs.empty() ? "unknown" : crs ) << "), geometries are written unchanged\n";
+        }
+    }
+}
+
+bool sosicon::ConverterSosi2arrow::
+objTypeExcluded( ISosiElement* e )
+{
+    std::vector<std::string>& ot = mCmd->mObjTypes;
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
+void sosicon::ConverterSosi2arrow::
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
+
+    ISosiElement* e = event.mFeature;
+
+    if( !mCrsChecked ) {
+        checkCrs( e->getRoot() );
+    }
+    if( objTypeExcluded( e ) ) {
+        return;
+    }
+
+    Wkt type;
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            type = wkt_point;
+            break;
+        case sosi::sosi_element_curve:
+            type = wkt_linestring;
+            break;
+        case sosi::sosi_element_surface:
+            type = wkt_polygon;
+            break;
+        default:
+            return;
+    }
+    Table* table = mTables[ type ];
+
+    if( mDiscover ) {
+        table->count();
+        table->collect( e, true );
+        return;
+    }
+    if( table->fileName().empty() ) {
+        return; // Could not be created
+    }
+
+    CoordinateCollection cc( mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( e );
+    table->collect( e, false );
+    table->append( cc );
+}
+
+void sosicon::ConverterSosi2arrow::
+readSources( bool* cancel ) {
+    Pipeline pipeline( mCmd );
+    for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end() && !( cancel && *cancel ); f++ ) {
+        mCurrentSourcefile = *f;
+        if( !utils::fileExists( mCurrentSourcefile ) ) {
+            if( mDiscover ) {
+                sosicon::logstream << mCurrentSourcefile << " not found\n";
+            }
+        }
+        else {
+            sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            mCrsChecked = false;
+            Parser p;
+            p.addFeatureListener( this );
+            int n = 0;
+            pipeline.parse( mCurrentSourcefile, p, n, cancel );
+        }
+    }
+    pipeline.finish();
+}
+
+void sosicon::ConverterSosi2arrow::
+run( bool* cancel ) {
+
+    mTables[ wkt_point ] = new Table( wkt_point );
+    mTables[ wkt_linestring ] = new Table( wkt_linestring );
+    mTables[ wkt_polygon ] = new Table( wkt_polygon );
+
+    sosicon::logstream << "Building Arrow schema...\n";
+    mDiscover = true;
+    readSources( cancel );
+
+    std::string base = "sosicon";
+    if( !mCmd->mOutputFile.empty() ) {
+        std::string dir, tit, ext;
+        utils::getPathInfo( mCmd->mOutputFile, dir, tit, ext );
+        base = dir + tit;
+    }
+    const char* names[] = { "", "point", "linestring", "polygon" };
+    bool any = false;
+    for( std::map<Wkt, Table*>::iterator t = mTables.begin(); t != mTables.end(); t++ ) {
+        if( t->second->features() == 0 ) {
+            continue;
+        }
+        std::string fileName = utils::nonExistingFilename( base + "_" + names[ t->first ] + ".arrow" );
+        if( t->second->open( fileName, mCrs ) ) {
+            any = true;
+        }
+        else {
+            sosicon::logstream << "    > " << fileName << " could not be created\n";
+        }
+    }
+    if( !any ) {
+        sosicon::logstream << "Nothing to export\n";
+        return;
+    }
+
+    sosicon::logstream << "Building Arrow export...\n";
+    mDiscover = false;
+    readSources( cancel );
+
+    for( std::map<Wkt, Table*>::iterator t = mTables.begin(); t != mTables.end(); t++ ) {
+        Table* table = t->second;
+        if( table->fileName().empty() ) {
+            continue;
+        }
+        if( table->close( mCmd->mSyncOutput ) ) {
+            sosicon::logstream << "    > " << table->fileName() << " written (" << table->rows() << " rows)\n";
+        }
+        else {
+            sosicon::logstream << "    > " << table->fileName() << " could not be written\n";
+        }
+    }
+    sosicon::logstream << "Done!\n";
+}
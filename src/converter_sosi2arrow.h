@@ -0,0 +1,239 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __CONVERTER_SOSI2ARROW_H__
+#define __CONVERTER_SOSI2ARROW_H__
+
+#include "logger.h"
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+#include "interface/i_converter.h"
+#include "interface/i_sosi_element.h"
+#include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_translation_table.h"
+#include "sosi/sosi_types.h"
+#include "async_file_writer.h"
+#include "command_line.h"
+#include "common_types.h"
+#include "coordinate_collection.h"
+#include "flatbuffer_writer.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "feature_event.h"
+
+namespace sosicon {
+
+    /*!
+        \addtogroup converters
+        @{
+    */
+    //! SOSI to Apache Arrow converter
+    /*!
+        If command-line parameter -2arrow is specified, this converter will handle the output
+        generation. Produces one Arrow IPC file (Feather version 2) for each geometry type,
+        like the tables of the PostGIS export, that analytics tools can memory-map without
+        parsing.
+
+        Geometries are stored in a GeoArrow column with interleaved coordinates: points as
+        geoarrow.point, curves as geoarrow.linestring and surfaces as geoarrow.multipolygon.
+        Each attribute gets a dictionary-encoded string column.
+
+        An Arrow file starts with its schema, so the sources are read twice. The first pass
+        collects the attribute names, in the same way the PostGIS export builds its field
+        lists, and the second writes the rows in record batches of BATCH_SIZE rows as they
+        are received from the parser. Dictionary values are written ahead of the first batch
+        that uses them, as delta dictionary batches after the first.
+     */
+    class ConverterSosi2arrow : public IConverter, public FeatureEventDispatcher::Listener {
+
+        //! Number of rows in each record batch
+        static const std::size_t BATCH_SIZE = 65536;
+
+        //! Dictionary-encoded attribute column
+        struct Column {
+            std::string name;                                   //!< Column name
+            std::unordered_map<std::string, int32_t> index;     //!< Dictionary, value to index
+            std::vector<std::string> pending;                   //!< Dictionary values not yet written
+            bool written;                                       //!< True once the first dictionary batch is written
+            std::vector<int32_t> keys;                          //!< Dictionary indexes of the current batch
+            std::vector<unsigned char> validity;                //!< Validity bitmap of the current batch
+            int64_t nulls;                                      //!< Number of nulls in the current batch
+            Column() : written( false ), nulls( 0 ) { }
+        };
+
+        //! Arrow IPC file for one geometry type
+        class Table {
+
+            Wkt mType;                                  //!< Geometry type
+            std::string mCrs;                           //!< GeoArrow CRS metadata, or empty
+            std::string mFileName;                      //!< Output file
+            AsyncFileWriter mFile;                      //!< Output file writer
+            std::ostream mStream;                       //!< Stream on mFile
+            int64_t mPosition;                          //!< Bytes written so far
+            std::vector<int64_t> mDictionaryBlocks;     //!< Footer blocks of the dictionary batches
+            std::vector<int64_t> mBatchBlocks;          //!< Footer blocks of the record batches
+            std::map<std::string, std::size_t> mColumnIndex;    //!< Column index by name
+            std::vector<Column> mColumns;               //!< Attribute columns, in name order
+            std::vector<std::string> mRow;              //!< Attribute values of the row being built
+            std::vector<bool> mRowSet;                  //!< True for the attributes present in mRow
+            geometry::PointArray mCoords;               //!< Coordinates of the current batch
+            std::vector<int32_t> mOffsets[ 3 ];         //!< Geometry, polygon and ring offsets of the current batch
+            std::size_t mRows;                          //!< Rows in the current batch
+            int64_t mTotalRows;                         //!< Rows written
+            int64_t mFeatures;                          //!< Features seen in the first pass
+
+            //! Write the schema into a FlatBuffers message or footer
+            FlatBufferWriter::Offset schema( FlatBufferWriter& fb );
+
+            //! Write encapsulated IPC message
+            /*!
+                \param metadata FlatBuffers Message.
+                \param body Message body.
+                \param blocks Receives the footer block of the message, or 0.
+            */
+            void writeMessage( const std::string& metadata, const std::string& body, std::vector<int64_t>* blocks );
+
+            //! Write dictionary batches and record batch for the rows collected so far
+            void writeBatch();
+
+            //! Clear the batch buffers
+            void resetBatch();
+
+            Table( const Table& );
+            Table& operator = ( const Table& );
+
+        public:
+
+            //! Constructor
+            explicit Table( Wkt type ) : mType( type ), mStream( &mFile ), mPosition( 0 ),
+                                         mRows( 0 ), mTotalRows( 0 ), mFeatures( 0 ) { }
+
+            //! Geometry type
+            Wkt type() const { return mType; }
+
+            //! Output file name
+            const std::string& fileName() const { return mFileName; }
+
+            //! Rows written
+            int64_t rows() const { return mTotalRows; }
+
+            //! Features seen in the first pass
+            int64_t features() const { return mFeatures; }
+
+            //! Collect attribute names or values of a feature
+            /*!
+                Nested elements are flattened, as in the PostGIS export. Coordinates and
+                references are left out, since they make up the geometry column. Repeated
+                attributes are joined with |.
+                \param parent Feature element.
+                \param discover True in the first pass, to add the names to the schema.
+                       Otherwise, the values are stored in the row being built.
+            */
+            void collect( ISosiElement* parent, bool discover );
+
+            //! Count a feature in the first pass
+            void count() { mFeatures++; }
+
+            //! Create file and write schema
+            /*!
+                \param fileName Output file.
+                \param crs Coordinate reference system, such as EPSG:25833, or empty.
+                \return False if the file could not be created.
+            */
+            bool open( const std::string& fileName, const std::string& crs );
+
+            //! Add feature as a row
+            /*!
+                The attribute values must have been collected with collect() first.
+                \param cc Coordinates of the feature.
+            */
+            void append( CoordinateCollection& cc );
+
+            //! Write remaining rows and the file footer
+            /*!
+                \param sync Flush file to disk, see AsyncFileWriter::close().
+                \return False if the file could not be written.
+            */
+            bool close( bool sync );
+
+        }; // class Table
+
+        //! Command line wrapper
+        CommandLine* mCmd;
+
+        //! Souce file currently in process
+        std::string mCurrentSourcefile;
+
+        //! Output tables by geometry type
+        std::map<Wkt, Table*> mTables;
+
+        //! True during the first pass
+        bool mDiscover;
+
+        //! Coordinate reference system of the output, from the first source file
+        std::string mCrs;
+
+        //! True once the KOORDSYS of the current source file has been read
+        bool mCrsChecked;
+
+        //! Read KOORDSYS from the header of the current source file
+        void checkCrs( ISosiElement* root );
+
+        //! Test if current element is filtered out by -t parameter
+        bool objTypeExcluded( ISosiElement* e );
+
+        //! Read all sources, passing the features to onEvent()
+        void readSources( bool* cancel );
+
+    public:
+
+        //! Constructor
+        ConverterSosi2arrow() : mCmd( 0 ), mDiscover( true ), mCrsChecked( false ) { }
+
+        //! Destructor
+        virtual ~ConverterSosi2arrow();
+
+        //! Initialize converter
+        /*!
+            Implementation details in sosicon::IConverter::init()
+            \sa sosicon::IConverter::init()
+         */
+        virtual void init( CommandLine* cmd ) { mCmd = cmd; }
+
+        //! Receive feature from parser
+        virtual void onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& dispatcher );
+
+        //! Start conversion
+        /*!
+            Implementation details in sosicon::IConverter::run()
+            \sa sosicon::IConverter::run()
+         */
+        virtual void run( bool* cancel = 0x00 );
+
+    }; // class ConverterSosi2arrow
+   /*! @} end group converters */
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,764 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "converter_sosi2mvt.h"
+
+namespace {
+
+    //! Integer tile coordinates, as x, y pairs
+    typedef std::vector<int32_t> TilePoints;
+
+    //! Clipping box in tile coordinates
+    struct ClipBox {
+        double min;
+        double max;
+    };
+
+    //! Append point, rounded to the tile grid, unless it repeats the previous one
+    void appendQuantized( TilePoints& out, double x, double y ) {
+        int32_t qx = static_cast<int32_t>( std::floor( x + 0.5 ) );
+        int32_t qy = static_cast<int32_t>( std::floor( y + 0.5 ) );
+        std::size_t n = out.size();
+        if( n < 2 || out[ n - 2 ] != qx || out[ n - 1 ] != qy ) {
+            out.push_back( qx );
+            out.push_back( qy );
+        }
+    }
+
+    //! Twice the signed area of a ring, positive if clockwise on screen (y pointing down)
+    int64_t ringArea( const TilePoints& ring ) {
+        int64_t area = 0;
+        std::size_t n = ring.size() / 2;
+        for( std::size_t i = 0, j = n - 1; i < n; j = i++ ) {
+            area += static_cast<int64_t>( ring[ 2 * j ] ) * ring[ 2 * i + 1 ] -
+                    static_cast<int64_t>( ring[ 2 * i ] ) * ring[ 2 * j + 1 ];
+        }
+        return area;
+    }
+
+    //! Clip line against box (Liang-Barsky), appending the quantized parts that remain
+    void clipLine( const double* xy, std::size_t n, const ClipBox& box,
+                   std::vector<TilePoints>& parts ) {
+        TilePoints part;
+        for( std::size_t i = 1; i < n; i++ ) {
+            double x0 = xy[ 2 * i - 2 ], y0 = xy[ 2 * i - 1 ];
+            double dx = xy[ 2 * i ] - x0, dy = xy[ 2 * i + 1 ] - y0;
+            double p[ 4 ] = { -dx, dx, -dy, dy };
+            double q[ 4 ] = { x0 - box.min, box.max - x0, y0 - box.min, box.max - y0 };
+            double t0 = 0, t1 = 1;
+            bool inside = true;
+            for( int k = 0; k < 4 && inside; k++ ) {
+                if( p[ k ] == 0 ) {
+                    inside = q[ k ] >= 0;
+                }
+                else {
+                    double t = q[ k ] / p[ k ];
+                    if( p[ k ] < 0 ) {
+                        t0 = std::max( t0, t );
+                    }
+                    else {
+                        t1 = std::min( t1, t );
+                    }
+                    inside = t0 <= t1;
+                }
+            }
+            if( !inside ) {
+                continue;
+            }
+            if( t0 > 0 && part.size() >= 4 ) {
+                parts.push_back( part ); // Line re-enters the box
+            }
+            if( t0 > 0 || part.empty() ) {
+                part.clear();
+                appendQuantized( part, x0 + t0 * dx, y0 + t0 * dy );
+            }
+            appendQuantized( part, x0 + t1 * dx, y0 + t1 * dy );
+            if( t1 < 1 ) {
+                if( part.size() >= 4 ) {
+                    parts.push_back( part );
+                }
+                part.clear();
+            }
+        }
+        if( part.size() >= 4 ) {
+            parts.push_back( part );
+        }
+    }
+
+    //! Clip ring against one edge of the box (one Sutherland-Hodgman pass)
+    void clipRingEdge( const std::vector<double>& in, std::vector<double>& out,
+                       int axis, double limit, bool below ) {
+        out.clear();
+        std::size_t n = in.size() / 2;
+        if( n == 0 ) {
+            return;
+        }
+        for( std::size_t i = 0, j = n - 1; i < n; j = i++ ) {
+            double ax = in[ 2 * j ], ay = in[ 2 * j + 1 ];
+            double bx = in[ 2 * i ], by = in[ 2 * i + 1 ];
+            double a = axis == 0 ? ax : ay;
+            double b = axis == 0 ? bx : by;
+            bool aIn = below ? a <= limit : a >= limit;
+            bool bIn = below ? b <= limit : b >= limit;
+            if( aIn != bIn ) {
+                double t = ( limit - a ) / ( b - a );
+                out.push_back( axis == 0 ? limit : ax + t * ( bx - ax ) );
+                out.push_back( axis == 0 ? ay + t * ( by - ay ) : limit );
+            }
+            if( bIn ) {
+                out.push_back( bx );
+                out.push_back( by );
+            }
+        }
+    }
+
+    //! Clip ring against box, returning the quantized ring without its closing point
+    void clipRing( const double* xy, std::size_t n, const ClipBox& box, bool clip,
+                   std::vector<double>& a, std::vector<double>& b, TilePoints& ring ) {
+        a.assign( xy, xy + 2 * n );
+        if( clip ) {
+            clipRingEdge( a, b, 0, box.min, false );
+            clipRingEdge( b, a, 0, box.max, true );
+            clipRingEdge( a, b, 1, box.min, false );
+            clipRingEdge( b, a, 1, box.max, true );
+        }
+        ring.clear();
+        for( std::size_t i = 0; i < a.size(); i += 2 ) {
+            appendQuantized( ring, a[ i ], a[ i + 1 ] );
+        }
+        std::size_t m = ring.size();
+        if( m >= 4 && ring[ 0 ] == ring[ m - 2 ] && ring[ 1 ] == ring[ m - 1 ] ) {
+            ring.resize( m - 2 );
+        }
+    }
+
+    //! Command integer of the vector tile geometry encoding
+    uint32_t command( uint32_t id, std::size_t count ) {
+        return ( id & 0x7 ) | ( static_cast<uint32_t>( count ) << 3 );
+    }
+
+    //! Append MoveTo and LineTo commands for one part
+    void encodePart( const TilePoints& part, std::vector<uint32_t>& commands, int32_t& cx, int32_t& cy ) {
+        std::size_t n = part.size() / 2;
+        for( std::size_t i = 0; i < n; i++ ) {
+            if( i == 0 ) {
+                commands.push_back( command( 1, 1 ) );
+            }
+            else if( i == 1 ) {
+                commands.push_back( command( 2, n - 1 ) );
+            }
+            commands.push_back( sosicon::ProtobufWriter::zigzag( part[ 2 * i ] - cx ) );
+            commands.push_back( sosicon::ProtobufWriter::zigzag( part[ 2 * i + 1 ] - cy ) );
+            cx = part[ 2 * i ];
+            cy = part[ 2 * i + 1 ];
+        }
+    }
+
+    //! Write octal number into a tar header field, with terminating NUL
+    void tarField( char* field, std::size_t size, uint64_t value ) {
+        for( std::size_t i = size - 1; i-- > 0; ) {
+            field[ i ] = static_cast<char>( '0' + ( value & 7 ) );
+            value >>= 3;
+        }
+        field[ size - 1 ] = '\0';
+    }
+
+    //! Build ustar header for a regular file
+    void tarHeader( char* header, const std::string& name, std::size_t size ) {
+        std::fill( header, header + 512, '\0' );
+        std::string tit = name, prefix;
+        if( tit.size() > 100 ) {
+            std::string::size_type slash = tit.rfind( '/', 155 );
+            if( slash != std::string::npos ) {
+                prefix = tit.substr( 0, slash );
+                tit = tit.substr( slash + 1 );
+            }
+        }
+        tit.copy( header, 100 );
+        tarField( header + 100, 8, 0644 );              // Mode
+        tarField( header + 108, 8, 0 );                 // Owner
+        tarField( header + 116, 8, 0 );                 // Group
+        tarField( header + 124, 12, size );             // Size
+        tarField( header + 136, 12, static_cast<uint64_t>( time( 0 ) ) );
+        header[ 156 ] = '0';                            // Regular file
+        std::string( "ustar\0" "00", 8 ).copy( header + 257, 8 );
+        prefix.copy( header + 345, 155 );
+        std::fill( header + 148, header + 156, ' ' );   // Checksum is computed with blanks
+        unsigned int sum = 0;
+        for( int i = 0; i < 512; i++ ) {
+            sum += static_cast<unsigned char>( header[ i ] );
+        }
+        tarField( header + 148, 7, sum );
+    }
+
+}; // namespace
+
+bool sosicon::ConverterSosi2mvt::TileJob::
+encodeGeometry( const Feature& f, std::vector<uint32_t>& commands ) {
+
+    double scale = static_cast<double>( 1u << mZoom ) * TILE_EXTENT;
+    double x0 = static_cast<double>( mX ) * TILE_EXTENT;
+    double y0 = static_cast<double>( mY ) * TILE_EXTENT;
+    ClipBox box = { -TILE_BUFFER, TILE_EXTENT + TILE_BUFFER };
+
+    std::size_t numPoints = f.xy.size() / 2;
+    std::vector<double> xy( 2 * numPoints );
+    for( std::size_t i = 0; i < numPoints; i++ ) {
+        xy[ 2 * i ] = f.xy[ 2 * i ] * scale - x0;
+        xy[ 2 * i + 1 ] = f.xy[ 2 * i + 1 ] * scale - y0;
+    }
+    bool clip = f.minX * scale - x0 < box.min || f.maxX * scale - x0 > box.max ||
+                f.minY * scale - y0 < box.min || f.maxY * scale - y0 > box.max;
+
+    int32_t cx = 0, cy = 0;
+    commands.clear();
+
+    switch( f.type ) {
+        case geom_point:
+            {
+                TilePoints points;
+                for( std::size_t i = 0; i < numPoints; i++ ) {
+                    if( xy[ 2 * i ] >= box.min && xy[ 2 * i ] <= box.max &&
+                        xy[ 2 * i + 1 ] >= box.min && xy[ 2 * i + 1 ] <= box.max )
+                    {
+                        appendQuantized( points, xy[ 2 * i ], xy[ 2 * i + 1 ] );
+                    }
+                }
+                if( points.empty() ) {
+                    break;
+                }
+                commands.push_back( command( 1, points.size() / 2 ) );
+                for( std::size_t i = 0; i < points.size(); i += 2 ) {
+                    commands.push_back( ProtobufWriter::zigzag( points[ i ] - cx ) );
+                    commands.push_back( ProtobufWriter::zigzag( points[ i + 1 ] - cy ) );
+                    cx = points[ i ];
+                    cy = points[ i + 1 ];
+                }
+            }
+            break;
+        case geom_linestring:
+            {
+                std::vector<TilePoints> parts;
+                std::size_t start = 0;
+                for( std::vector<int>::const_iterator s = f.sizes.begin(); s != f.sizes.end(); s++ ) {
+                    std::size_t n = static_cast<std::size_t>( std::abs( *s ) );
+                    if( clip ) {
+                        clipLine( &xy[ 2 * start ], n, box, parts );
+                    }
+                    else {
+                        TilePoints part;
+                        for( std::size_t i = start; i < start + n; i++ ) {
+                            appendQuantized( part, xy[ 2 * i ], xy[ 2 * i + 1 ] );
+                        }
+                        if( part.size() >= 4 ) {
+                            parts.push_back( part );
+                        }
+                    }
+                    start += n;
+                }
+                for( std::vector<TilePoints>::iterator p = parts.begin(); p != parts.end(); p++ ) {
+                    encodePart( *p, commands, cx, cy );
+                }
+            }
+            break;
+        case geom_polygon:
+            {
+                std::vector<double> a, b;
+                TilePoints ring;
+                bool outerKept = false;
+                std::size_t start = 0;
+                for( std::vector<int>::const_iterator s = f.sizes.begin(); s != f.sizes.end(); s++ ) {
+                    bool hole = *s < 0;
+                    std::size_t n = static_cast<std::size_t>( std::abs( *s ) );
+                    std::size_t first = start;
+                    start += n;
+                    if( hole && !outerKept ) {
+                        continue; // Holes of a dropped outer ring
+                    }
+                    clipRing( &xy[ 2 * first ], n, box, clip, a, b, ring );
+                    int64_t area = ring.size() >= 6 ? ringArea( ring ) : 0;
+                    if( !hole ) {
+                        outerKept = area != 0;
+                    }
+                    if( area == 0 ) {
+                        continue;
+                    }
+                    if( ( area < 0 ) != hole ) {
+                        std::vector<int32_t> reversed( ring.size() );
+                        for( std::size_t i = 0, m = ring.size() / 2; i < m; i++ ) {
+                            reversed[ 2 * i ] = ring[ 2 * ( m - 1 - i ) ];
+                            reversed[ 2 * i + 1 ] = ring[ 2 * ( m - 1 - i ) + 1 ];
+                        }
+                        ring.swap( reversed );
+                    }
+                    encodePart( ring, commands, cx, cy );
+                    commands.push_back( command( 7, 1 ) );
+                }
+            }
+            break;
+    }
+    return !commands.empty();
+}
+
+void sosicon::ConverterSosi2mvt::TileJob::
+run() {
+
+    Profiler::Scope scope( Profiler::stage_write );
+    const std::vector<Feature>& features = mOwner->mFeatures;
+    const std::vector<Layer>& layers = mOwner->mLayers;
+
+    std::map<unsigned int, std::vector<uint32_t> > byLayer;
+    for( std::vector<uint32_t>::iterator i = mFeatures.begin(); i != mFeatures.end(); i++ ) {
+        byLayer[ features[ *i ].layer ].push_back( *i );
+    }
+
+    ProtobufWriter tile;
+    std::vector<uint32_t> commands;
+    std::vector<uint32_t> tags;
+
+    for( std::map<unsigned int, std::vector<uint32_t> >::iterator l = byLayer.begin(); l != byLayer.end(); l++ ) {
+
+        const Layer& layer = layers[ l->first ];
+        ProtobufWriter layerMsg;
+        layerMsg.uint( 15, 2 );                 // Version
+        layerMsg.bytes( 1, layer.name );
+
+        // Keys and values are renumbered, so that each tile only carries what it uses
+        std::unordered_map<uint32_t, uint32_t> keys, values;
+        std::vector<uint32_t> keyList, valueList;
+        int written = 0;
+
+        for( std::vector<uint32_t>::iterator i = l->second.begin(); i != l->second.end(); i++ ) {
+            const Feature& f = features[ *i ];
+            if( !encodeGeometry( f, commands ) ) {
+                continue;
+            }
+            tags.clear();
+            for( std::size_t t = 0; t + 1 < f.tags.size(); t += 2 ) {
+                std::unordered_map<uint32_t, uint32_t>::iterator k = keys.find( f.tags[ t ] );
+                if( k == keys.end() ) {
+                    k = keys.insert( std::make_pair( f.tags[ t ], static_cast<uint32_t>( keyList.size() ) ) ).first;
+                    keyList.push_back( f.tags[ t ] );
+                }
+                std::unordered_map<uint32_t, uint32_t>::iterator v = values.find( f.tags[ t + 1 ] );
+                if( v == values.end() ) {
+                    v = values.insert( std::make_pair( f.tags[ t + 1 ], static_cast<uint32_t>( valueList.size() ) ) ).first;
+                    valueList.push_back( f.tags[ t + 1 ] );
+                }
+                tags.push_back( k->second );
+                tags.push_back( v->second );
+            }
+            ProtobufWriter featureMsg;
+            if( f.id > 0 ) {
+                featureMsg.uint( 1, f.id );
+            }
+            if( !tags.empty() ) {
+                featureMsg.packed( 2, tags );
+            }
+            featureMsg.uint( 3, f.type );
+            featureMsg.packed( 4, commands );
+            layerMsg.message( 2, featureMsg );
+            written++;
+        }
+
+        if( written == 0 ) {
+            continue;
+        }
+        for( std::vector<uint32_t>::iterator k = keyList.begin(); k != keyList.end(); k++ ) {
+            layerMsg.bytes( 3, layer.keys[ *k ] );
+        }
+        for( std::vector<uint32_t>::iterator v = valueList.begin(); v != valueList.end(); v++ ) {
+            ProtobufWriter valueMsg;
+            valueMsg.bytes( 1, layer.values[ *v ] ); // string_value
+            layerMsg.message( 4, valueMsg );
+        }
+        layerMsg.uint( 5, TILE_EXTENT );
+        tile.message( 3, layerMsg );
+    }
+
+    mData = tile.data();
+}
+
+void sosicon::ConverterSosi2mvt::TileJob::
+complete() {
+    if( !mData.empty() ) {
+        std::stringstream ss;
+        ss << mZoom << "/" << mX << "/" << mY << ".pbf";
+        if( mOwner->writeOutput( ss.str(), mData ) ) {
+            mOwner->mTileCount++;
+        }
+    }
+}
+
+unsigned int sosicon::ConverterSosi2mvt::
+getLayer( const std::string& objType ) {
+    std::map<std::string, unsigned int>::iterator i = mLayerIndex.find( objType );
+    if( i != mLayerIndex.end() ) {
+        return i->second;
+    }
+    unsigned int index = static_cast<unsigned int>( mLayers.size() );
+    mLayers.push_back( Layer() );
+    mLayers.back().name = objType;
+    mLayerIndex[ objType ] = index;
+    return index;
+}
+
+void sosicon::ConverterSosi2mvt::
+extractProperties( ISosiElement* parent, Layer& layer, std::vector<uint32_t>& tags ) {
+
+    sosi::SosiElementSearch srcData;
+    while( parent->getChild( srcData ) ) {
+
+        ISosiElement* dataElement = srcData.element();
+        sosi::ElementType type = dataElement->getType();
+        if( type == sosi::sosi_element_ne || type == sosi::sosi_element_neh || type == sosi::sosi_element_ref ) {
+            continue;
+        }
+
+        extractProperties( dataElement, layer, tags );
+
+        const std::string& data = dataElement->getData();
+        if( data.empty() ) {
+            continue;
+        }
+        std::string key = utils::iso8859_1ToUtf8( utils::toFieldname( dataElement->getName() ) );
+        std::unordered_map<std::string, uint32_t>::iterator k = layer.keyIndex.find( key );
+        if( k == layer.keyIndex.end() ) {
+            k = layer.keyIndex.insert( std::make_pair( key, static_cast<uint32_t>( layer.keys.size() ) ) ).first;
+            layer.keys.push_back( key );
+        }
+        bool seen = false;
+        for( std::size_t t = 0; t < tags.size() && !seen; t += 2 ) {
+            seen = tags[ t ] == k->second;
+        }
+        if( seen ) {
+            continue; // First occurrence wins
+        }
+        std::string value = toUtf8( utils::unquote( data ) );
+        std::unordered_map<std::string, uint32_t>::iterator v = layer.valueIndex.find( value );
+        if( v == layer.valueIndex.end() ) {
+            v = layer.valueIndex.insert( std::make_pair( value, static_cast<uint32_t>( layer.values.size() ) ) ).first;
+            layer.values.push_back( value );
+        }
+        tags.push_back( k->second );
+        tags.push_back( v->second );
+    }
+}
+
+std::string sosicon::ConverterSosi2mvt::
+toUtf8( const std::string& str ) {
+    sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+    if( cs->getEncoding() == sosi::sosi_charset_utf8 ) {
+        return str;
+    }
+    return utils::iso8859_1ToUtf8( cs->toIso8859_1( str ) );
+}
+
+bool sosicon::ConverterSosi2mvt::
+objTypeExcluded( ISosiElement* e )
+{
+    std::vector<std::string>& ot = mCmd->mObjTypes;
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
+void sosicon::ConverterSosi2mvt::
+initProjection( ISosiElement* root ) {
+
+    // Path: .HODE/..TRANSPAR/...KOORDSYS
+    sosi::SosiElementSearch srcHead( sosi::sosi_element_head );
+    sosi::SosiElementSearch srcTranspar( sosi::sosi_element_transpar );
+    sosi::SosiElementSearch srcCoordsys( sosi::sosi_element_coordsys );
+
+    mProjection = geometry::TransverseMercator();
+    mProjectionChecked = true;
+
+    if( root &&
+        root->getChild( srcHead ) &&
+        srcHead.element()->getChild( srcTranspar ) &&
+        srcTranspar.element()->getChild( srcCoordsys ) )
+    {
+        std::stringstream ss;
+        int sysCode = 0;
+        ss << srcCoordsys.element()->getData();
+        ss >> sysCode;
+        if( sysCode > 0 && sysCode <= sosi::MAX_COORDSYS_TABLE ) {
+            sosi::SosiTranslationTable tt;
+            sosi::CoordSys& cs = tt.sysCodeToCoordSys( sysCode );
+            if( mProjection.init( cs.prjString() ) ) {
+                sosicon::logstream << "Coordinate system: " << cs.displayString() << "\n";
+                return;
+            }
+        }
+        sosicon::logstream << "KOORDSYS " << sysCode << " is not a supported projection, "
+                           << mCurrentSourcefile << " skipped\n";
+    }
+    else {
+        sosicon::logstream << "No KOORDSYS code found in sosi file, " << mCurrentSourcefile << " skipped\n";
+    }
+}
+
+void sosicon::ConverterSosi2mvt::
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
+
+    ISosiElement* e = event.mFeature;
+
+    if( !mProjectionChecked ) {
+        initProjection( e->getRoot() );
+    }
+    if( !mProjection.valid() || objTypeExcluded( e ) ) {
+        return;
+    }
+
+    Feature f;
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            f.type = geom_point;
+            break;
+        case sosi::sosi_element_curve:
+            f.type = geom_linestring;
+            break;
+        case sosi::sosi_element_surface:
+            f.type = geom_polygon;
+            break;
+        default:
+            return;
+    }
+
+    CoordinateCollection cc( mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( e );
+
+    if( f.type == geom_polygon ) {
+        cc.getRings( f.xy, f.sizes );
+    }
+    else {
+        f.xy = cc.getGeom();
+        f.sizes = cc.getGeomSizes();
+    }
+    if( f.xy.empty() ) {
+        return;
+    }
+
+    f.minX = f.minY = +9999999999;
+    f.maxX = f.maxY = -9999999999;
+    for( std::size_t i = 0; i < f.xy.size(); i += 2 ) {
+        double lon, lat;
+        mProjection.inverse( f.xy[ i ], f.xy[ i + 1 ], lon, lat );
+        geometry::webMercator( lon, lat, f.xy[ i ], f.xy[ i + 1 ] );
+    }
+    geometry::expandBoundingBox( f.xy.data(), f.xy.size() / 2, f.minX, f.minY, f.maxX, f.maxY );
+
+    f.id = std::strtoull( e->getSerial().c_str(), 0, 10 );
+    f.layer = getLayer( e->getObjType().empty() ? "sosi" : toUtf8( e->getObjType() ) );
+    extractProperties( e, mLayers[ f.layer ], f.tags );
+
+    mFeatures.push_back( Feature() );
+    std::swap( mFeatures.back(), f );
+}
+
+bool sosicon::ConverterSosi2mvt::
+makeDirectory( const std::string& path ) {
+    if( utils::fileExists( path ) ) {
+        return true;
+    }
+    std::string::size_type slash = path.find_last_of( '/' );
+    if( slash != std::string::npos && slash > 0 && !makeDirectory( path.substr( 0, slash ) ) ) {
+        return false;
+    }
+#ifdef _WIN32
+    mkdir( path.c_str() );
+#else
+    mkdir( path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH );
+#endif
+    return utils::fileExists( path );
+}
+
+bool sosicon::ConverterSosi2mvt::
+writeOutput( const std::string& name, const std::string& data ) {
+
+    if( mArchiveStream ) {
+        char header[ 512 ];
+        tarHeader( header, name, data.size() );
+        mArchiveStream->write( header, sizeof header );
+        mArchiveStream->write( data.data(), data.size() );
+        std::size_t padding = ( 512 - data.size() % 512 ) % 512;
+        std::fill( header, header + padding, '\0' );
+        mArchiveStream->write( header, padding );
+        return true;
+    }
+
+    std::string path = mOutput + "/" + name;
+    AsyncFileWriter out;
+    if( makeDirectory( path.substr( 0, path.find_last_of( '/' ) ) ) && out.open( path ) ) {
+        std::ostream os( &out );
+        os.write( data.data(), data.size() );
+        if( out.close( mCmd->mSyncOutput ) ) {
+            return true;
+        }
+    }
+    if( mTileErrors++ == 0 ) {
+        sosicon::logstream << "    > " << path << " could not be written\n";
+    }
+    return false;
+}
+
+void sosicon::ConverterSosi2mvt::
+writeMetadata( int minZoom, int maxZoom ) {
+
+    double xmin = +9999999999, ymin = +9999999999, xmax = -9999999999, ymax = -9999999999;
+    for( std::vector<Feature>::iterator f = mFeatures.begin(); f != mFeatures.end(); f++ ) {
+        xmin = std::min( xmin, f->minX );
+        ymin = std::min( ymin, f->minY );
+        xmax = std::max( xmax, f->maxX );
+        ymax = std::max( ymax, f->maxY );
+    }
+    double west = -180, south = -85.051129, east = 180, north = 85.051129;
+    if( xmin <= xmax ) {
+        geometry::webMercatorInverse( xmin, ymax, west, south );
+        geometry::webMercatorInverse( xmax, ymin, east, north );
+    }
+
+    std::stringstream os;
+    os.precision( 10 );
+    os << "{\"tilejson\":\"3.0.0\",\"name\":\"sosicon\",\"scheme\":\"xyz\",\"format\":\"pbf\","
+       << "\"tiles\":[\"{z}/{x}/{y}.pbf\"],"
+       << "\"minzoom\":" << minZoom << ",\"maxzoom\":" << maxZoom << ","
+       << "\"bounds\":[" << west << "," << south << "," << east << "," << north << "],"
+       << "\"center\":[" << ( west + east ) / 2 << "," << ( south + north ) / 2 << "," << minZoom << "],"
+       << "\"vector_layers\":[";
+    for( std::vector<Layer>::iterator l = mLayers.begin(); l != mLayers.end(); l++ ) {
+        os << ( l != mLayers.begin() ? ",\n" : "\n" )
+           << "{\"id\":" << utils::jsonQuote( l->name ) << ",\"minzoom\":" << minZoom << ",\"maxzoom\":" << maxZoom
+           << ",\"fields\":{";
+        for( std::vector<std::string>::iterator k = l->keys.begin(); k != l->keys.end(); k++ ) {
+            os << ( k != l->keys.begin() ? "," : "" ) << utils::jsonQuote( *k ) << ":\"String\"";
+        }
+        os << "}}";
+    }
+    os << "]}\n";
+
+    writeOutput( "metadata.json", os.str() );
+}
+
+void sosicon::ConverterSosi2mvt::
+writeZoomLevel( int z, WorkStealingPool& pool ) {
+
+    Profiler::Scope scope( Profiler::stage_write );
+    // Features are listed under every tile their bounding box overlaps, buffer included
+    double tiles = static_cast<double>( 1u << z );
+    double buffer = static_cast<double>( TILE_BUFFER ) / TILE_EXTENT;
+    uint32_t last = ( 1u << z ) - 1;
+    std::map<uint64_t, std::vector<uint32_t> > assigned;
+    for( std::vector<Feature>::size_type i = 0; i < mFeatures.size(); i++ ) {
+        const Feature& f = mFeatures[ i ];
+        uint32_t x0 = static_cast<uint32_t>( std::max( 0.0, std::floor( f.minX * tiles - buffer ) ) );
+        uint32_t y0 = static_cast<uint32_t>( std::max( 0.0, std::floor( f.minY * tiles - buffer ) ) );
+        uint32_t x1 = std::min( last, static_cast<uint32_t>( std::max( 0.0, std::floor( f.maxX * tiles + buffer ) ) ) );
+        uint32_t y1 = std::min( last, static_cast<uint32_t>( std::max( 0.0, std::floor( f.maxY * tiles + buffer ) ) ) );
+        for( uint32_t x = x0; x <= x1; x++ ) {
+            for( uint32_t y = y0; y <= y1; y++ ) {
+                assigned[ ( static_cast<uint64_t>( x ) << 32 ) | y ].push_back( static_cast<uint32_t>( i ) );
+            }
+        }
+    }
+
+    // Tiles are encoded in batches, to bound the memory held by encoded tiles
+    const std::size_t batchSize = 4096;
+    int before = mTileCount;
+    std::vector<IPipelineJob*> batch;
+    std::map<uint64_t, std::vector<uint32_t> >::iterator t = assigned.begin();
+    while( t != assigned.end() ) {
+        TileJob* job = new TileJob( this, z, static_cast<uint32_t>( t->first >> 32 ), static_cast<uint32_t>( t->first ) );
+        job->features().swap( t->second );
+        batch.push_back( job );
+        t++;
+        if( batch.size() == batchSize || t == assigned.end() ) {
+            pool.run( batch );
+            for( std::vector<IPipelineJob*>::iterator j = batch.begin(); j != batch.end(); j++ ) {
+                delete *j;
+            }
+            batch.clear();
+        }
+    }
+    sosicon::logstream << "    > Zoom level " << z << ": " << ( mTileCount - before ) << " tiles\n";
+}
+
+void sosicon::ConverterSosi2mvt::
+run( bool* cancel ) {
+
+    Pipeline pipeline( mCmd );
+    for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end() && !( cancel && *cancel ); f++ ) {
+        mCurrentSourcefile = *f;
+        if( !utils::fileExists( mCurrentSourcefile ) ) {
+            sosicon::logstream << mCurrentSourcefile << " not found\n";
+        }
+        else {
+            sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            sosicon::logstream << "Building vector tile export...\n";
+            mProjectionChecked = false; // Each file has its own KOORDSYS
+            Parser p;
+            p.addFeatureListener( this );
+            int n = 0;
+            pipeline.parse( mCurrentSourcefile, p, n, cancel );
+        }
+    }
+    pipeline.finish(); // Also ends the last file, tiles cover all files
+
+    std::string defaultOutput = mCmd->mOutputFile.empty() ? "sosicon_tiles" : utils::stripTrailingSlash( mCmd->mOutputFile );
+    mOutput = utils::nonExistingFilename( defaultOutput );
+    bool archive = mOutput.size() > 4 && utils::toLower( mOutput.substr( mOutput.size() - 4 ) ) == ".tar";
+
+    AsyncFileWriter archiveFile;
+    std::ostream archiveStream( &archiveFile );
+    if( archive ) {
+        if( !archiveFile.open( mOutput ) ) {
+            sosicon::logstream << "    > " << mOutput << " could not be created\n";
+            return;
+        }
+        mArchive = &archiveFile;
+        mArchiveStream = &archiveStream;
+    }
+    else if( !makeDirectory( mOutput ) ) {
+        sosicon::logstream << "    > " << mOutput << " could not be created\n";
+        return;
+    }
+
+    sosicon::logstream << "    > Converting SOSI data to vector tiles (" << mFeatures.size() << " features)...\n";
+    WorkStealingPool pool;
+    for( int z = mCmd->mMinZoom; z <= mCmd->mMaxZoom && z <= MAX_ZOOM && !( cancel && *cancel ); z++ ) {
+        writeZoomLevel( z, pool );
+    }
+    writeMetadata( mCmd->mMinZoom, mCmd->mMaxZoom );
+
+    if( archive ) {
+        char end[ 1024 ] = { 0 };
+        archiveStream.write( end, sizeof end );
+        mArchive = 0;
+        mArchiveStream = 0;
+        if( !archiveFile.close( mCmd->mSyncOutput ) ) {
+            mTileErrors++;
+        }
+    }
+
+    if( mTileErrors == 0 ) {
+        sosicon::logstream << "    > " << mOutput << " written (" << mTileCount << " tiles)\n";
+    }
+    else {
+        sosicon::logstream << "    > " << mOutput << " could not be written\n";
+    }
+    sosicon::logstream << "Done!\n";
+}
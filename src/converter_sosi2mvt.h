@@ -0,0 +1,259 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __CONVERTER_SOSI2MVT_H__
+#define __CONVERTER_SOSI2MVT_H__
+
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+#include "interface/i_converter.h"
+#include "interface/i_pipeline_job.h"
+#include "interface/i_sosi_element.h"
+#include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_translation_table.h"
+#include "sosi/sosi_types.h"
+#include "async_file_writer.h"
+#include "command_line.h"
+#include "coordinate_collection.h"
+#include "geometry_kernels.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "projection.h"
+#include "protobuf_writer.h"
+#include "feature_event.h"
+#include "work_stealing_pool.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir _mkdir
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace sosicon {
+
+    /*!
+        \addtogroup converters
+        @{
+    */
+    //! SOSI to Mapbox Vector Tile converter
+    /*!
+        If command-line parameter -2mvt is specified, this converter will handle the output
+        generation. Produces a pyramid of vector tiles (Mapbox Vector Tile specification 2.1)
+        over the zoom levels given by -zoom, with one layer per OBJTYPE, as the shapefile
+        export groups its files.
+
+        Features are received one at a time from the parser. Their coordinates are assembled
+        with sosicon::CoordinateCollection, projected to Web Mercator and kept until all
+        sources have been read. Each zoom level is then cut into tiles: features are assigned
+        to the tiles their bounding boxes overlap, and every tile is clipped, quantized and
+        encoded as a job on a sosicon::WorkStealingPool. Tiles are written in order by the
+        converter's own thread, either as a z/x/y.pbf directory tree or, if the output file
+        name ends with .tar, as a single tar archive. A TileJSON metadata.json file
+        describing the layers goes along with the tiles.
+     */
+    class ConverterSosi2mvt : public IConverter, public FeatureEventDispatcher::Listener {
+
+        //! Tile extent in integer coordinate units
+        static const int TILE_EXTENT = 4096;
+
+        //! Tile buffer in integer coordinate units, for clipping
+        static const int TILE_BUFFER = 64;
+
+        //! Highest zoom level supported
+        static const int MAX_ZOOM = 24;
+
+        //! MVT geometry types
+        enum GeomType {
+            geom_point = 1,
+            geom_linestring = 2,
+            geom_polygon = 3
+        };
+
+        //! Feature in Web Mercator coordinates
+        struct Feature {
+            unsigned int layer;               //!< Index of the layer in mLayers
+            GeomType type;                    //!< Point, line or polygon
+            uint64_t id;                      //!< SOSI serial number, or 0
+            geometry::PointArray xy;          //!< Normalized Web Mercator coordinates
+            std::vector<int> sizes;           //!< Points per line or ring. Holes are negative and follow their outer ring.
+            double minX;                      //!< Bounding box
+            double minY;                      //!< Bounding box
+            double maxX;                      //!< Bounding box
+            double maxY;                      //!< Bounding box
+            std::vector<uint32_t> tags;       //!< Key and value index pairs into the layer tables
+        };
+
+        //! Layer with its attribute tables
+        struct Layer {
+            std::string name;                                   //!< OBJTYPE, as UTF-8
+            std::vector<std::string> keys;                      //!< Attribute names
+            std::unordered_map<std::string, uint32_t> keyIndex; //!< Index of each name in keys
+            std::vector<std::string> values;                    //!< Attribute values
+            std::unordered_map<std::string, uint32_t> valueIndex; //!< Index of each value in values
+        };
+
+        //! Encodes one tile on a pool thread, and writes it on the converter thread
+        class TileJob : public IPipelineJob {
+
+            ConverterSosi2mvt* mOwner;         //!< Converter holding features and output
+            int mZoom;                         //!< Zoom level
+            uint32_t mX;                       //!< Tile column
+            uint32_t mY;                       //!< Tile row, from the north
+            std::vector<uint32_t> mFeatures;   //!< Features overlapping the tile, in layer order
+            std::string mData;                 //!< Encoded tile
+
+            //! Encode geometry of one feature, in tile coordinates
+            bool encodeGeometry( const Feature& f, std::vector<uint32_t>& commands );
+
+        public:
+
+            //! Constructor
+            TileJob( ConverterSosi2mvt* owner, int z, uint32_t x, uint32_t y ) :
+                mOwner( owner ), mZoom( z ), mX( x ), mY( y ) { }
+
+            //! Features overlapping the tile
+            std::vector<uint32_t>& features() { return mFeatures; }
+
+            //! Clip, quantize and encode tile
+            virtual void run();
+
+            //! Write tile
+            virtual void complete();
+
+        }; // class TileJob
+
+        friend class TileJob;
+
+        //! Command line wrapper
+        CommandLine* mCmd;
+
+        //! Souce file currently in process
+        std::string mCurrentSourcefile;
+
+        //! Projection of the current source file
+        geometry::TransverseMercator mProjection;
+
+        //! True once the coordinate system of the current source file has been looked up
+        bool mProjectionChecked;
+
+        //! All features, in the order they were received
+        std::vector<Feature> mFeatures;
+
+        //! Layers, one per OBJTYPE
+        std::vector<Layer> mLayers;
+
+        //! Layer index by OBJTYPE
+        std::map<std::string, unsigned int> mLayerIndex;
+
+        //! Output directory, or tar archive file name
+        std::string mOutput;
+
+        //! Tar archive, if writing to a single file
+        AsyncFileWriter* mArchive;
+
+        //! Stream on mArchive
+        std::ostream* mArchiveStream;
+
+        //! Number of tiles written
+        int mTileCount;
+
+        //! Number of tiles that could not be written
+        int mTileErrors;
+
+        //! Add attributes of a feature to the layer tables and the feature's tags
+        /*!
+            Nested elements are flattened, as in the database exports. Coordinates and
+            references are left out.
+            \param parent Feature element.
+            \param layer Layer of the feature.
+            \param tags Receives key and value index pairs.
+        */
+        void extractProperties( ISosiElement* parent, Layer& layer, std::vector<uint32_t>& tags );
+
+        //! Get layer index for OBJTYPE, creating the layer if needed
+        unsigned int getLayer( const std::string& objType );
+
+        //! Create directory, including missing parents
+        bool makeDirectory( const std::string& path );
+
+        //! Test if current element is filtered out by -t parameter
+        bool objTypeExcluded( ISosiElement* e );
+
+        //! Set up projection from the KOORDSYS of the file header
+        void initProjection( ISosiElement* root );
+
+        //! Convert string from the SOSI file's character set to UTF-8
+        std::string toUtf8( const std::string& str );
+
+        //! Write metadata.json
+        void writeMetadata( int minZoom, int maxZoom );
+
+        //! Write file to the tile directory or archive
+        /*!
+            \param name Path relative to the tile directory, such as 14/8712/4731.pbf.
+            \param data File content.
+            \return False if the file could not be written.
+        */
+        bool writeOutput( const std::string& name, const std::string& data );
+
+        //! Cut, encode and write all tiles of one zoom level
+        void writeZoomLevel( int z, WorkStealingPool& pool );
+
+    public:
+
+        //! Constructor
+        ConverterSosi2mvt() : mCmd( 0 ), mProjectionChecked( false ), mArchive( 0 ), mArchiveStream( 0 ),
+                              mTileCount( 0 ), mTileErrors( 0 ) { }
+
+        //! Destructor
+        virtual ~ConverterSosi2mvt() { }
+
+        //! Initialize converter
+        /*!
+            Implementation details in sosicon::IConverter::init()
+            \sa sosicon::IConverter::init()
+         */
+        virtual void init( CommandLine* cmd ) { mCmd = cmd; }
+
+        //! Receive feature from parser
+        virtual void onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& dispatcher );
+
+        //! Start conversion
+        /*!
+            Implementation details in sosicon::IConverter::run()
+            \sa sosicon::IConverter::run()
+         */
+        virtual void run( bool* cancel = 0x00 );
+
+    }; // class ConverterSosi2mvt
+   /*! @} end group converters */
+
+}; // namespace sosicon
+
+#endif
@@ -17,33 +17,209 @@
  */
 #include "converter_sosi2mysql.h"
 
+namespace {
+
+    //! Prepare value for a LOAD DATA file
+    /*!
+        Like sosicon::utils::sqlNormalize(), the surrounding quotes are removed. Instead of
+        doubling single quotes, the characters LOAD DATA treats specially are escaped.
+    */
+    std::string loadDataNormalize( const std::string& str ) {
+        std::string tmp = sosicon::utils::trim( str );
+        std::string::size_type len = tmp.length();
+        if( len > 2 && tmp.at( 0 ) == '\"' && tmp.at( len - 1 ) == '\"' ) {
+            tmp = tmp.substr( 1, len - 2 );
+        }
+        std::string res;
+        for( std::string::size_type n = 0; n < tmp.length(); n++ ) {
+            char c = tmp.at( n );
+            switch( c ) {
+                case '\t': res += "\\t"; break;
+                case '\n': res += "\\n"; break;
+                case '\r': res += "\\r"; break;
+                case '\\': res += "\\\\"; break;
+                default: res += c;
+            }
+        }
+        return res;
+    }
+
+    //! Quote string as an SQL literal
+    std::string sqlQuote( const std::string& str ) {
+        std::string res = "'";
+        for( std::string::size_type n = 0; n < str.length(); n++ ) {
+            char c = str.at( n );
+            if( c == '\'' || c == '\\' ) {
+                res += c;
+            }
+            res += c;
+        }
+        return res + "'";
+    }
+
+    //! Build point geometry from an east, north pair
+    /*!
+        \param geom The point.
+        \param sridSource Spatial reference grid ID for the source file.
+        \param wkb True for hex-encoded WKB, false for an ST_GeomFromText() expression.
+    */
+    std::string pointData( const sosicon::geometry::PointArray& geom,
+                           const std::string& sridSource,
+                           bool wkb ) {
+        if( wkb ) {
+            sosicon::WkbWriter w;
+            w.point( &geom[ 0 ] );
+            return w.data();
+        }
+        std::stringstream ss;
+        ss.precision( 5 );
+        ss  << std::fixed
+            << "ST_GeomFromText('POINT("
+            << geom[ 0 ]
+            << " "
+            << geom[ 1 ]
+            << ")',"
+            << sridSource
+            << ")";
+        return ss.str();
+    }
+
+    //! Build line geometry
+    /*!
+        \param theGeom Coordinates of the line, as east, north pairs.
+        \param sridSource Spatial reference grid ID for the source file.
+        \param wkb True for hex-encoded WKB, false for an ST_GeomFromText() expression.
+    */
+    std::string lineStringData( const sosicon::geometry::PointArray& theGeom,
+                                const std::string& sridSource,
+                                bool wkb ) {
+        if( wkb ) {
+            sosicon::WkbWriter w;
+            w.lineString( theGeom.empty() ? 0 : &theGeom[ 0 ], static_cast<int>( theGeom.size() / 2 ) );
+            return w.data();
+        }
+
+        std::stringstream ssGeomCoord;
+
+        ssGeomCoord.precision( 5 );
+        ssGeomCoord << std::fixed;
+
+        for( sosicon::geometry::PointArray::size_type i = 0; i + 1 < theGeom.size(); i += 2 ) {
+            ssGeomCoord << theGeom[ i ]
+                        << " "
+                        << theGeom[ i + 1 ]
+                        << ",";
+        }
+
+        std::string geom = ssGeomCoord.str();
+        geom.erase( geom.size() - 1 );
+
+        std::stringstream ss;
+        ss << "ST_GeomFromText('LINESTRING("
+           << geom
+           << ")',"
+           << sridSource
+           << ")";
+
+        return ss.str();
+    }
+
+    //! Build polygon geometry
+    /*!
+        \param theGeom Outer ring, as east, north pairs.
+        \param theHoles Holes, closed, as east, north pairs.
+        \param holeSizes Points per hole.
+        \param sridSource Spatial reference grid ID for the source file.
+        \param wkb True for hex-encoded WKB, false for an ST_GeomFromText() expression.
+    */
+    std::string polygonData( const sosicon::geometry::PointArray& theGeom,
+                             const sosicon::geometry::PointArray& theHoles,
+                             const std::vector<int>& holeSizes,
+                             const std::string& sridSource,
+                             bool wkb ) {
+        if( wkb ) {
+            // One ring for the whole outline, followed by the holes, as in the WKT below
+            sosicon::geometry::PointArray xy( theGeom );
+            xy.insert( xy.end(), theHoles.begin(), theHoles.end() );
+            std::vector<int> sizes( 1, static_cast<int>( theGeom.size() / 2 ) );
+            for( std::vector<int>::const_iterator i = holeSizes.begin(); i != holeSizes.end(); i++ ) {
+                sizes.push_back( -*i );
+            }
+            sosicon::WkbWriter w;
+            w.polygon( xy.empty() ? 0 : &xy[ 0 ], &sizes[ 0 ], sizes.size() );
+            return w.data();
+        }
+
+        std::stringstream ssGeomCoord;
+
+        ssGeomCoord.precision( 5 );
+        ssGeomCoord << std::fixed
+                    << "(";
+
+        for( sosicon::geometry::PointArray::size_type i = 0; i + 1 < theGeom.size(); i += 2 ) {
+            ssGeomCoord << theGeom[ i ]
+                        << " "
+                        << theGeom[ i + 1 ]
+                        << ",";
+        }
+
+        std::string geom = ssGeomCoord.str();
+        geom.erase( geom.size() - 1 );
+        geom += ")";
+
+        std::stringstream ssHolesCoord;
+        ssHolesCoord.precision( 5 );
+        ssHolesCoord << std::fixed;
+
+        sosicon::geometry::PointArray::size_type offset = 0; // Holes are closed by CoordinateCollection
+        for( std::vector<int>::const_iterator i = holeSizes.begin(); i != holeSizes.end(); i++ ) {
+            ssHolesCoord << ",(";
+            for( int j = 0; j < *i; j++, offset += 2 ) {
+                if( j > 0 ) {
+                    ssHolesCoord << ",";
+                }
+                ssHolesCoord << theHoles[ offset ]
+                             << " "
+                             << theHoles[ offset + 1 ];
+            }
+            ssHolesCoord << ")";
+        }
+        geom += ssHolesCoord.str();
+
+        std::stringstream ss;
+        ss << "ST_GeomFromText('POLYGON("
+           << geom
+           << ")',"
+           << sridSource
+           << ")";
+
+        return ss.str();
+    }
+
+    //! Test if a decimal column fits DECIMAL, which has at most 65 digits, 30 of them after the point
+    bool fitsDecimal( const sosicon::ColumnType& type ) {
+        return type.precision() <= 65 && type.scale() <= 30;
+    }
+
+}; // namespace
+
 std::string sosicon::ConverterSosi2mysql::
-buildCreateStatements( std::string sridDest,
-                       std::string dbSchema,
-                       std::string dbTable ) {
+buildCreateStatements( std::string dbTable ) {
     std::string sql;
 
     sql  = buildCreateStatement( wkt_point,
-                                 sridDest,
-                                 dbSchema,
                                  dbTable );
 
     sql += buildCreateStatement( wkt_linestring,
-                                 sridDest,
-                                 dbSchema,
                                  dbTable );
 
     sql += buildCreateStatement( wkt_polygon,
-                                 sridDest,
-                                 dbSchema,
                                  dbTable );
     return sql;
 }
 
 std::string sosicon::ConverterSosi2mysql::
 buildCreateStatement( Wkt wktGeom,
-                      std::string sridDest,
-                      std::string dbSchema,
                       std::string dbTable ) {
 
     std::string geometryType = utils::wktToStr( wktGeom );
@@ -69,18 +245,37 @@ buildCreateStatement( Wkt wktGeom,
         for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
            std::string field = itrFields->first;
            std::string::size_type len = itrFields->second.length();
-           bool isNumeric = itrFields->second.isNumeric();
+           const ColumnType& type = itrFields->second;
            if( field != geomField ) {
-               if( isNumeric && len < 10 ) {
+               if( type.kind() == ColumnType::kind_int32 ) {
                    ss << ","
                       << field
                       << " INT";
                }
-               else if( isNumeric && len < 19 ) {
+               else if( type.kind() == ColumnType::kind_int64 ) {
                    ss << ","
                       << field
                       << " BIGINT";
                }
+               else if( type.kind() == ColumnType::kind_decimal && fitsDecimal( type ) ) {
+                   ss << ","
+                      << field
+                      << " DECIMAL("
+                      << type.precision()
+                      << ","
+                      << type.scale()
+                      << ")";
+               }
+               else if( type.kind() == ColumnType::kind_date ) {
+                   ss << ","
+                      << field
+                      << " DATE";
+               }
+               else if( type.kind() == ColumnType::kind_boolean ) {
+                   ss << ","
+                      << field
+                      << " BOOLEAN";
+               }
                else if( len > 255 ) {
                    ss << ","
                       << field
@@ -107,31 +302,26 @@ buildCreateStatement( Wkt wktGeom,
 }
 
 void sosicon::ConverterSosi2mysql::
-buildInsertStatements( std::string dbSchema,
-                       std::string dbTable,
-                       std::ofstream& fs ) {
+buildInsertStatements( std::string dbTable,
+                       std::ostream& fs ) {
 
     buildInsertStatement( wkt_point,
-                          dbSchema,
                           dbTable,
                           fs );
 
     buildInsertStatement( wkt_linestring,
-                          dbSchema,
                           dbTable,
                           fs );
 
     buildInsertStatement( wkt_polygon,
-                          dbSchema,
                           dbTable,
                           fs );
 }
 
 void sosicon::ConverterSosi2mysql::
 buildInsertStatement( Wkt wktGeom,
-                      std::string dbSchema,
                       std::string dbTable,
-                      std::ofstream& fs ) {
+                      std::ostream& fs ) {
 
     std::string geometryType = utils::wktToStr( wktGeom );
 
@@ -149,7 +339,9 @@ buildInsertStatement( Wkt wktGeom,
         std::string geomField = dbTable + "_geom";
         std::string geomName = utils::toLower( geometryType );
 
+        std::vector<std::size_t> columns;
         for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
+            columns.push_back( mColumns.field( itrFields->first ) );
             if( sqlInsert.empty() ) {
 
                 sqlInsert += "INSERT INTO "
@@ -165,9 +357,9 @@ buildInsertStatement( Wkt wktGeom,
         sqlInsert += ") VALUES\n";
         int rowCount = 0;
         RowsList::size_type len = r->size();
-        sosicon::logstream << "    > Processing 0 of " << len << sosicon::flush;
+        Progress progress( "    > Processing", len );
         for( itrRows = r->begin(); itrRows != r->end(); itrRows++ ) {
-            std::map<std::string,std::string>* row = *itrRows;
+            ColumnIndex::Row* row = *itrRows;
             rowCount++;
             if( !sqlValues.empty() && rowCount % INSERT_CHUNK_SIZE == 0 ) {
                 sqlValues = sqlValues.substr( 0, sqlValues.length() - 2 );
@@ -175,23 +367,23 @@ buildInsertStatement( Wkt wktGeom,
                 fs << ( sqlInsert + sqlValues );
                 sqlValues.clear();
             }
-            if( rowCount % 1000 == 0 ) {
-                sosicon::logstream << "\r    > Processing " << rowCount << " of " << len << sosicon::flush;
-            }
+            progress.add();
             sqlValues += "(";
+            std::vector<std::size_t>::size_type column = 0;
             for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
-                std::string key = itrFields->first;
-                if( row->find( key ) == row->end() ) {
-                    ( *row )[ key ] = "";
-                }
-                std::string val = utils::trim( ( *row )[ key ] );
+                const std::string& key = itrFields->first;
+                std::string val = utils::trim( ColumnIndex::value( *row, columns[ column++ ] ) );
+                ColumnType::Kind kind = itrFields->second.kind();
                 if( val.empty() ) {
-                    sqlValues += itrFields->second.isNumeric() ? "NULL," : "'',";
+                    sqlValues += kind != ColumnType::kind_text ? "NULL," : "'',";
                 }
                 else if( key == geomField ) {
                     sqlValues += val + ",";
                 }
-                else if( itrFields->second.isNumeric() ) {
+                else if( kind == ColumnType::kind_boolean ) {
+                    sqlValues += ColumnType::isTrue( val ) ? "TRUE," : "FALSE,";
+                }
+                else if( itrFields->second.isNumeric() && ( kind != ColumnType::kind_decimal || fitsDecimal( itrFields->second ) ) ) {
                     sqlValues += utils::sqlNormalize( val ) + ",";
                 }
                 else {
@@ -207,6 +399,147 @@ buildInsertStatement( Wkt wktGeom,
     }
 }
 
+void sosicon::ConverterSosi2mysql::
+buildLoadStatements( std::string dbTable,
+                     std::string basePath,
+                     std::ostream& fs ) {
+
+    buildLoadStatement( wkt_point,
+                        dbTable,
+                        basePath,
+                        fs );
+
+    buildLoadStatement( wkt_linestring,
+                        dbTable,
+                        basePath,
+                        fs );
+
+    buildLoadStatement( wkt_polygon,
+                        dbTable,
+                        basePath,
+                        fs );
+}
+
+void sosicon::ConverterSosi2mysql::
+buildLoadStatement( Wkt wktGeom,
+                    std::string dbTable,
+                    std::string basePath,
+                    std::ostream& fs ) {
+
+    std::string geometryType = utils::wktToStr( wktGeom );
+
+    if( geometryType.empty() || mRowsListCollection[ wktGeom ]->size() == 0 ) {
+        return;
+    }
+
+    FieldsList* f = mFieldsListCollection[ wktGeom ];
+    RowsList* r = mRowsListCollection[ wktGeom ];
+
+    std::string geomField = dbTable + "_geom";
+    std::string geomName = utils::toLower( geometryType );
+    std::string sridField = sridKey();
+
+    std::string fileName = utils::nonExistingFilename( basePath + "_" + geomName + ".tsv" );
+    AsyncFileWriter out;
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream data( &out );
+
+    std::string columns;
+    std::vector<std::size_t> index;
+    for( FieldsList::iterator itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
+        index.push_back( mColumns.field( itrFields->first ) );
+        if( itrFields->first != geomField ) {
+            columns += itrFields->first + ",";
+        }
+    }
+    std::size_t sridColumn = mColumns.field( sridField );
+    std::size_t geomColumn = mColumns.field( geomField );
+
+    int rowCount = 0;
+    RowsList::size_type len = r->size();
+    Progress progress( "    > Processing", len );
+    std::string line;
+    for( RowsList::iterator itrRows = r->begin(); itrRows != r->end(); itrRows++ ) {
+        ColumnIndex::Row* row = *itrRows;
+        rowCount++;
+        progress.add();
+        line.clear();
+        std::vector<std::size_t>::size_type column = 0;
+        for( FieldsList::iterator itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
+            const std::string& val = ColumnIndex::value( *row, index[ column++ ] );
+            if( itrFields->first == geomField ) {
+                continue;
+            }
+            std::string v = loadDataNormalize( val );
+            ColumnType::Kind kind = itrFields->second.kind();
+            if( v.empty() && kind != ColumnType::kind_text ) {
+                line += "\\N";
+            }
+            else if( kind == ColumnType::kind_boolean ) {
+                line += ColumnType::isTrue( v ) ? "1" : "0";
+            }
+            else {
+                line += v;
+            }
+            line += '\t';
+        }
+        line += ColumnIndex::value( *row, sridColumn ) + '\t' + ColumnIndex::value( *row, geomColumn ) + '\n';
+        data << line;
+    }
+    sosicon::logstream << "\r    > " << rowCount << " " << geomName << "s processed               \n" << sosicon::flush;
+
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
+    }
+
+    fs << "LOAD DATA LOCAL INFILE "
+       << sqlQuote( fileName )
+       << " INTO TABLE "
+       << dbTable
+       << "_"
+       << geomName
+       << " CHARACTER SET latin1 ("
+       << columns
+       << "@srid,@geom) SET "
+       << geomField
+       << "=ST_GeomFromWKB(UNHEX(@geom),@srid);\n";
+}
+
+std::string sosicon::ConverterSosi2mysql::
+buildIndexStatements( std::string dbTable ) {
+
+    Wkt types[] = { wkt_point, wkt_linestring, wkt_polygon };
+    std::string geomField = dbTable + "_geom";
+
+    std::stringstream ss;
+    for( unsigned int i = 0; i < sizeof types / sizeof types[ 0 ]; i++ ) {
+        std::string geometryType = utils::wktToStr( types[ i ] );
+        ss << "ALTER TABLE "
+           << dbTable
+           << "_"
+           << utils::toLower( geometryType )
+           << " MODIFY "
+           << geomField
+           << " "
+           << geometryType
+           << " NOT NULL";
+        if( mSrids.size() == 1 ) {
+            ss << " SRID "
+               << *mSrids.begin();
+        }
+        ss << ", ADD SPATIAL INDEX("
+           << geomField
+           << ");\n";
+    }
+    return ss.str();
+}
+
 void sosicon::ConverterSosi2mysql::
 cleanup() {
     sosicon::logstream << "    > Clean-up...\n";
@@ -235,7 +568,7 @@ cleanup( Wkt wktGeom ) {
 void sosicon::ConverterSosi2mysql::
 extractData( ISosiElement* parent,
              FieldsList& hdr,
-             std::map<std::string,std::string>*& row ) {
+             ColumnIndex::Row*& row ) {
 
     sosi::SosiElementSearch srcData;
     while( parent->getChild( srcData ) ) {
@@ -244,22 +577,17 @@ extractData( ISosiElement* parent,
 
         extractData( dataElement, hdr, row );
 
-        std::string fieldName = utils::toFieldname( dataElement->getName() );
-        std::string data = dataElement->getData();
+        const std::string& data = dataElement->getData();
 
         if( data.empty() ) {
             continue;
         }
 
-        if( hdr.find( fieldName ) == hdr.end() ) {
-            hdr[ fieldName ] = Field( data );
-        }
-        else {
-          hdr[ fieldName ].expand( data );
-        }
+        std::size_t column = mColumns.element( dataElement->getName() );
+        hdr[ mColumns.name( column ) ].expand( data );
 
         if( row ) {
-            ( *row )[ fieldName ] = data;
+            ColumnIndex::cell( *row, column ) = data;
         }
     }
 }
@@ -305,10 +633,7 @@ getSrid( ISosiElement* sosiTree ) {
 }
 
 void sosicon::ConverterSosi2mysql::
-insertPoint( ISosiElement* point,
-             std::string sridSource,
-             std::string sridDest,
-             std::string geomField ) {
+insertPoint( ISosiElement* point ) {
 
     sosi::SosiElementSearch srcNe = sosi::SosiElementSearch( sosi::sosi_element_ne );
 
@@ -316,222 +641,144 @@ insertPoint( ISosiElement* point,
 
         sosi::SosiNorthEast ne = sosi::SosiNorthEast( srcNe.element() );
         ICoordinate* coord = ne.front();
-        std::stringstream ss;
-
-        std::map<std::string,std::string>* row = 0;
-
-        if( mCmd->mInsertStatements ) {
-            row = new std::map<std::string,std::string>();
-        }
-
-        ss.precision( 5 );
-        ss  << std::fixed
-            << "ST_GeomFromText('POINT("
-            << coord->getE()
-            << " "
-            << coord->getN()
-            << ")',"
-            << sridSource
-            << ")";
-
-        std::string data = ss.str();
-
-        if( mCmd->mInsertStatements ) {
-            ( *row )[ geomField ] = data;
-        }
-
-        FieldsList& hdr = ( *mFieldsListCollection[ wkt_point ] );
-        hdr[ geomField ].expand( data );
 
-        extractData( point, hdr, row );
-
-        if( mCmd->mInsertStatements ) {
-            mRowsListCollection[ wkt_point ]->push_back( row );
-        }
+        Feature& f = addFeature( point, wkt_point );
+        f.geom.push_back( coord->getE() );
+        f.geom.push_back( coord->getN() );
     }
 }
 
 void sosicon::ConverterSosi2mysql::
-insertLineString( ISosiElement* lineString,
-                  std::string sridSource,
-                  std::string sridDest,
-                  std::string geomField ) {
+insertLineString( ISosiElement* lineString ) {
 
-    CoordinateCollection cc;
+    CoordinateCollection cc( mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front(), mCmd->mSimplifyTopology );
     cc.discoverCoords( lineString );
 
-    std::vector<ICoordinate*> theGeom = cc.getGeom();
-    std::stringstream ssGeomCoord;
-
-    ssGeomCoord.precision( 5 );
-    ssGeomCoord << std::fixed;
+    Feature& f = addFeature( lineString, wkt_linestring );
+    f.geom = cc.getGeom();
+}
 
-    for( std::vector<ICoordinate*>::iterator i = theGeom.begin(); i != theGeom.end(); i++ ) {
-        ICoordinate* c = *i;
-        ssGeomCoord << c->getE()
-                    << " "
-                    << c->getN()
-                    << ",";
-    }
+void sosicon::ConverterSosi2mysql::
+insertPolygon( ISosiElement* polygon ) {
 
-    std::string geom = ssGeomCoord.str();
-    geom.erase( geom.size() - 1 );
+    CoordinateCollection cc( mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( polygon );
 
-    std::stringstream ss;
-    ss << "ST_GeomFromText('LINESTRING("
-       << geom
-       << ")',"
-       << sridSource
-       << ")";
+    Feature& f = addFeature( polygon, wkt_polygon );
+    f.geom = cc.getGeom();
+    f.holes = cc.getHoles();
+    f.holeSizes = cc.getHoleSizes();
+}
 
-    std::string data = ss.str();
+sosicon::ConverterSosi2mysql::Feature& sosicon::ConverterSosi2mysql::
+addFeature( ISosiElement* e, Wkt type ) {
 
-    std::map<std::string,std::string>* row = 0;
+    if( mBatch->size() >= BATCH_SIZE ) {
+        submitBatch();
+    }
+    mBatch->push_back( Feature() );
+    Feature& f = mBatch->back();
+    f.type = type;
+    f.row = 0;
     if( mCmd->mInsertStatements ) {
-        row = new std::map<std::string,std::string>();
-        ( *row )[ geomField ] = data;
+        f.row = new ColumnIndex::Row( mColumns.size() );
     }
+    extractData( e, *mFieldsListCollection[ type ], f.row );
+    return f;
+}
 
-    FieldsList& hdr = ( *mFieldsListCollection[ wkt_linestring ] );
-    hdr[ geomField ].expand( data );
-
-    extractData( lineString, hdr, row );
-
-    if( mCmd->mInsertStatements ) {
-        mRowsListCollection[ wkt_linestring ]->push_back( row );
+void sosicon::ConverterSosi2mysql::
+submitBatch() {
+    if( mBatch->empty() ) {
+        return;
     }
+    mPipeline->submit( new EncodeJob( this, mBatch, mSridSource, mCmd->mLoadData ) );
+    mBatch = new Batch();
 }
 
 void sosicon::ConverterSosi2mysql::
-insertPolygon( ISosiElement* polygon,
-               std::string sridSource,
-               std::string sridDest,
-               std::string geomField ) {
+insertRow( Feature& feature, const std::string& sridSource ) {
 
-    CoordinateCollection cc;
-    cc.discoverCoords( polygon );
+    FieldsList& hdr = ( *mFieldsListCollection[ feature.type ] );
+    hdr[ mGeomField ].expand( feature.data );
 
-    std::vector<ICoordinate*> theGeom = cc.getGeom();
-    std::vector<ICoordinate*> theHoles = cc.getHoles();
-    std::vector<int> holeSizes = cc.getHoleSizes();
-    std::stringstream ssGeomCoord;
-
-    ssGeomCoord.precision( 5 );
-    ssGeomCoord << std::fixed
-                << "(";
-
-    for( std::vector<ICoordinate*>::iterator i = theGeom.begin(); i != theGeom.end(); i++ ) {
-        ICoordinate* c = *i;
-        ssGeomCoord << c->getE()
-                    << " "
-                    << c->getN()
-                    << ",";
-    }
-
-    std::string geom = ssGeomCoord.str();
-    geom.erase( geom.size() - 1 );
-    geom += ")";
-
-    std::stringstream ssHolesCoord;
-    ssHolesCoord.precision( 5 );
-    ssHolesCoord << std::fixed;
-
-    int offset = 0;
-    ICoordinate* first = 0, * last = 0;
-    for( std::vector<int>::iterator i = holeSizes.begin(); i != holeSizes.end(); i++ ) {
-        ssHolesCoord << ",(";
-        for( int j = 0; j < *i; j++ ) {
-            ICoordinate* c = theHoles[ offset++ ];
-            if( j == 0 ) {
-                first = c;
-            }
-            else {
-                ssHolesCoord << ",";
-                last = c;
-            }
-            ssHolesCoord << c->getE()
-                         << " "
-                         << c->getN();
-        }
-        if( !first->equals( last ) ) {
-            // Close polygon if open
-            ssHolesCoord << ","
-                         << first->getE()
-                         << " "
-                         << first->getN();
+    if( feature.row ) {
+        ColumnIndex::cell( *feature.row, mColumns.field( mGeomField ) ).swap( feature.data );
+        if( mCmd->mLoadData ) {
+            ColumnIndex::cell( *feature.row, mColumns.field( sridKey() ) ) = sridSource;
         }
-        ssHolesCoord << ")";
+        mRowsListCollection[ feature.type ]->push_back( feature.row );
+        feature.row = 0;
     }
-    geom += ssHolesCoord.str();
-
-    std::stringstream ss;
-    ss << "ST_GeomFromText('POLYGON("
-       << geom
-       << ")',"
-       << sridSource
-       << ")";
-
-    std::string data = ss.str();
+}
 
-    std::map<std::string,std::string>* row = 0;
-    if( mCmd->mInsertStatements ) {
-        row = new std::map<std::string,std::string>();
-        ( *row )[ geomField ] = data;
+sosicon::ConverterSosi2mysql::EncodeJob::
+~EncodeJob() {
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        delete f->row; // Rows not handed over by complete()
     }
+    delete mBatch;
+}
 
-    FieldsList& hdr = ( *mFieldsListCollection[ wkt_polygon ] );
-    hdr[ geomField ].expand( data );
-
-    extractData( polygon, hdr, row );
+void sosicon::ConverterSosi2mysql::EncodeJob::
+run() {
+    Profiler::Scope scope( Profiler::stage_convert );
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        switch( f->type ) {
+            case wkt_point:
+                f->data = pointData( f->geom, mSridSource, mLoadData );
+                break;
+            case wkt_linestring:
+                f->data = lineStringData( f->geom, mSridSource, mLoadData );
+                break;
+            default:
+                f->data = polygonData( f->geom, f->holes, f->holeSizes, mSridSource, mLoadData );
+        }
+    }
+}
 
-    if( mCmd->mInsertStatements ) {
-        mRowsListCollection[ wkt_polygon ]->push_back( row );
+void sosicon::ConverterSosi2mysql::EncodeJob::
+complete() {
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        mConverter->insertRow( *f, mSridSource );
     }
 }
 
+bool sosicon::ConverterSosi2mysql::
+objTypeExcluded( ISosiElement* e )
+{
+    std::vector<std::string>& ot = mCmd->mObjTypes;
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
 void sosicon::ConverterSosi2mysql::
-makemysql( ISosiElement* sosiTree,
-          std::string sridDest,
-          std::string,
-          std::string dbTable ) {
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
 
-    std::string sridSource = getSrid( sosiTree );
-    std::string geomField = dbTable + "_geom";
-    sosi::SosiTranslationTable ttbl;
+    ISosiElement* e = event.mFeature;
 
-    std::vector<sosi::ElementType> pointTypes;
-    pointTypes.push_back( sosi::sosi_element_point );
-    pointTypes.push_back( sosi::sosi_element_text );
-    sosi::SosiElementSearch srcPoint = sosi::SosiElementSearch( pointTypes );
-    while( sosiTree->getChild( srcPoint ) ) {
-        if( objTypeExcluded( srcPoint ) ) continue;
-        insertPoint( srcPoint.element(), sridSource, sridDest, geomField );
+    if( mSridSource.empty() ) {
+        mSridSource = getSrid( e->getRoot() );
+        mSrids.insert( mSridSource );
     }
-
-    std::vector<sosi::ElementType> lineStringTypes;
-    lineStringTypes.push_back( sosi::sosi_element_curve );
-    sosi::SosiElementSearch srcLineString = sosi::SosiElementSearch( lineStringTypes );
-    while( sosiTree->getChild( srcLineString ) ) {
-        if( objTypeExcluded( srcLineString ) ) continue;
-        insertLineString( srcLineString.element(), sridSource, sridDest, geomField );
+    if( objTypeExcluded( e ) ) {
+        return;
     }
-
-    std::vector<sosi::ElementType> polygonTypes;
-    polygonTypes.push_back( sosi::sosi_element_surface );
-    sosi::SosiElementSearch srcPolygon = sosi::SosiElementSearch( polygonTypes );
-    while( sosiTree->getChild( srcPolygon ) ) {
-        if( objTypeExcluded( srcPolygon ) ) continue;
-        insertPolygon( srcPolygon.element(), sridSource, sridDest, geomField );
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            insertPoint( e );
+            break;
+        case sosi::sosi_element_curve:
+            insertLineString( e );
+            break;
+        case sosi::sosi_element_surface:
+            insertPolygon( e );
+            break;
+        default:
+            ;
     }
 }
 
-bool sosicon::ConverterSosi2mysql::
-objTypeExcluded( sosi::SosiElementSearch& src )
-{
-    std::vector<std::string>& ot = mCmd->mObjTypes;
-    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( src.element()->getObjType() ) ) == ot.end();
-}
-
 void sosicon::ConverterSosi2mysql::
 run( bool* ) {
 
@@ -543,16 +790,17 @@ run( bool* ) {
     mRowsListCollection[ wkt_linestring ] = new RowsList();
     mRowsListCollection[ wkt_polygon ] = new RowsList();
 
-    std::string sridDest = mCmd->mSrid.empty() ? "4326" : mCmd->mSrid;
-
-    std::string dbSchema = mCmd->mDbSchema.empty() ? "sosicon" : mCmd->mDbSchema;
     std::string dbTable = mCmd->mDbTable.empty() ? "object" : mCmd->mDbTable;
     std::string geomField = dbTable + "_geom";
+    mGeomField = geomField;
 
-    ( *mFieldsListCollection[ wkt_point ] )[ geomField ] = Field();
-    ( *mFieldsListCollection[ wkt_linestring ] )[ geomField ] = Field();
-    ( *mFieldsListCollection[ wkt_polygon ] )[ geomField ] = Field();
+    ( *mFieldsListCollection[ wkt_point ] )[ geomField ] = ColumnType();
+    ( *mFieldsListCollection[ wkt_linestring ] )[ geomField ] = ColumnType();
+    ( *mFieldsListCollection[ wkt_polygon ] )[ geomField ] = ColumnType();
 
+    Pipeline pipeline( mCmd );
+    mPipeline = &pipeline;
+    mBatch = new Batch();
     for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end(); f++ ) {
         mCurrentSourcefile = *f;
         if( !utils::fileExists( mCurrentSourcefile ) ) {
@@ -560,49 +808,56 @@ run( bool* ) {
         }
         else {
             sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            sosicon::logstream << "Building MySQL export...\n";
+            mSridSource.clear();
             Parser p;
-            char ln[ 1024 ];
-            std::ifstream ifs( mCurrentSourcefile.c_str() );
+            p.addFeatureListener( this );
             int n = 0;
-            while( !ifs.eof() ) {
-                if( ++n % 100 == 0 ) {
-                    sosicon::logstream << "\rParsing line " << n;
-                }
-               memset( ln, 0x00, sizeof ln );
-                ifs.getline( ln, sizeof ln );
-                p.ragelParseSosiLine( ln );
-            }
-            p.complete();
-
-            ifs.close();
-            sosicon::logstream << "\r" << n << " lines parsed        \n";
-            sosicon::logstream << "Building MySQL export...\n";
-            ISosiElement* root = p.getRootElement();
-            makemysql( root, sridDest, dbSchema, dbTable );
+            pipeline.parse( mCurrentSourcefile, p, n );
+            submitBatch(); // The batch carries the SRID of this file
         }
     }
-    writemysql( sridDest, dbSchema, dbTable );
+    pipeline.drain();
+    mPipeline = 0;
+    Profiler::endFile(); // Output covers all files
+    writemysql( dbTable );
     cleanup();
+    pipeline.finish();
     sosicon::logstream << "Done!\n";
 }
 
 void sosicon::ConverterSosi2mysql::
-writemysql( std::string sridDest,
-           std::string dbSchema,
-           std::string dbTable ) {
+writemysql( std::string dbTable ) {
 
-    std::ofstream fs;
+    Profiler::Scope scope( Profiler::stage_write );
+    AsyncFileWriter out;
     std::string defaultOutputFile = mCmd->mOutputFile.empty() ? "mysql_dump.sql" : mCmd->mOutputFile;
     std::string fileName = utils::nonExistingFilename( defaultOutputFile );
     sosicon::logstream << "    > Converting SOSI data to SQL...\n";
-    fs.open( fileName.c_str(), std::ios::out | std::ios::trunc );
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream fs( &out );
     fs.precision( 0 );
     fs << "SET NAMES 'LATIN1';\n";
-    fs <<  ( mCmd->mCreateStatements ? buildCreateStatements( sridDest, dbSchema, dbTable ) : "" );
-    if( mCmd->mInsertStatements ) {
-      buildInsertStatements( dbSchema, dbTable, fs );
+    fs <<  ( mCmd->mCreateStatements ? buildCreateStatements( dbTable ) : "" );
+    if( mCmd->mLoadData ) {
+        if( mCmd->mInsertStatements ) {
+            std::string dir, tit, ext;
+            utils::getPathInfo( fileName, dir, tit, ext );
+            buildLoadStatements( dbTable, dir + tit, fs );
+        }
+        fs << ( mCmd->mCreateStatements ? buildIndexStatements( dbTable ) : "" );
+    }
+    else if( mCmd->mInsertStatements ) {
+      buildInsertStatements( dbTable, fs );
     }
     fs << "SET NAMES 'UTF8';\n";
-    fs.close();
-    sosicon::logstream << "    > " << fileName << " written\n";
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
+    }
 }
@@ -27,7 +27,10 @@
 #include <climits>
 #include <cmath>
 #include <map>
+#include <set>
 #include "utils.h"
+#include "column_index.h"
+#include "column_type.h"
 #include "interface/i_converter.h"
 #include "interface/i_sosi_element.h"
 #include "sosi/sosi_types.h"
@@ -37,6 +40,9 @@
 #include "command_line.h"
 #include "common_types.h"
 #include "parser.h"
+#include "pipeline.h"
+#include "feature_event.h"
+#include "wkb_writer.h"
 
 namespace sosicon {
 
@@ -48,55 +54,61 @@ namespace sosicon {
     /*!
         If command-line parameter -2mysql is specified, this converter will handle the output
         generation. Produces a PostgreSQL/PostGIS dump file from the SOSI source(s).
+        Features are received one at a time from the parser, so the SOSI tree is never
+        held in memory as a whole.
+
+        With -load, the rows are written to one tab separated file per geometry type
+        instead, with the geometry as hex-encoded WKB, and the script loads them with
+        LOAD DATA LOCAL INFILE. The spatial index is added once the rows are in place.
+
+        The converter thread only copies the coordinates and attribute values out of each
+        feature. The WKT or WKB geometries are built from those copies in batches, by
+        EncodeJob on the pipeline's writer thread, while parsing carries on.
      */
-    class ConverterSosi2mysql : public IConverter {
+    class ConverterSosi2mysql : public IConverter, public FeatureEventDispatcher::Listener {
 
         //! Maximum number of objects per INSERT statement.
         const unsigned int INSERT_CHUNK_SIZE = 10000;
 
-        class Field {
-            std::string::size_type mMaxLength;
-            std::string::size_type mMinLength;
-            bool mIsNumeric;
-        public:
-            bool isNumeric() {
-                if( mMaxLength == mMinLength ) {
-                    // Treat fixed-length numerical data as character field, since they
-                    // are in fact non-arithmetic types types like dates, phone numbers
-                    // or serial numbers.
-                    mIsNumeric = false;
-                }
-                return mIsNumeric;
-            }
-            std::string::size_type length() {
-                return mMaxLength;
-            }
-            Field() {
-                mIsNumeric = true;
-                mMaxLength = 0;
-            }
-            Field( std::string& str ) {
-                mIsNumeric = true;
-                mMaxLength = 0;
-                mMinLength = std::numeric_limits<std::string::size_type>::max();
-                expand( str );
-            }
-            std::string::size_type expand( std::string& str ) {
-                std::string::size_type len = str.length();
-                mMinLength = std::min( mMinLength, len );
-                mMaxLength = std::max( mMaxLength, len );
-                if( mIsNumeric ) {
-                    mIsNumeric = utils::isNumeric( str );
-                }
-                return mMaxLength;
-            }
-        };
-
-        typedef std::map< std::string,Field > FieldsList;
+        typedef std::map< std::string,ColumnType > FieldsList;
         typedef std::map< Wkt, FieldsList* > FieldsListCollection;
-        typedef std::vector< std::map< std::string,std::string >* > RowsList;
+        typedef std::vector< ColumnIndex::Row* > RowsList;
         typedef std::map< Wkt, RowsList* > RowsListCollection;
 
+        //! Number of features per encode job
+        static const std::size_t BATCH_SIZE = 4096;
+
+        //! Feature waiting for its geometry, with the coordinates copied out of the element tree
+        struct Feature {
+            Wkt type;                       //!< Geometry type, selects the table
+            ColumnIndex::Row* row;          //!< Attribute values, or null without -insert
+            geometry::PointArray geom;      //!< Point, line or outer ring, as east, north pairs
+            geometry::PointArray holes;     //!< Holes, closed, as east, north pairs
+            std::vector<int> holeSizes;     //!< Points per hole
+            std::string data;               //!< WKT expression or hex-encoded WKB, set by EncodeJob
+        };
+
+        //! Features not yet handed to the writer thread
+        typedef std::vector<Feature> Batch;
+
+        //! Build the geometries of a batch. Run on the writer thread.
+        /*!
+            run() only reads the coordinates copied into the batch. complete() hands the rows
+            over to the converter, on the converter thread, in the order they were parsed.
+        */
+        class EncodeJob : public IPipelineJob {
+            ConverterSosi2mysql* mConverter;    //!< Converter receiving the rows
+            Batch* mBatch;                      //!< Features to encode, owned by the job
+            std::string mSridSource;            //!< Source SRID of the file the batch comes from
+            bool mLoadData;                     //!< Hex-encoded WKB for LOAD DATA instead of WKT
+        public:
+            EncodeJob( ConverterSosi2mysql* converter, Batch* batch, std::string sridSource, bool loadData ) :
+                mConverter( converter ), mBatch( batch ), mSridSource( sridSource ), mLoadData( loadData ) { }
+            virtual ~EncodeJob();
+            virtual void run();
+            virtual void complete();
+        };
+
         //! Command line wrapper
         CommandLine* mCmd;
 
@@ -109,20 +121,39 @@ namespace sosicon {
         //! Collection of rows, one item for each geometry type
         RowsListCollection mRowsListCollection;
 
+        //! Column numbers of the fields in the rows
+        ColumnIndex mColumns;
+
+        //! Source SRID for current file, resolved from the header on first feature
+        std::string mSridSource;
+
+        //! Name of the geometry field
+        std::string mGeomField;
+
+        //! Source SRIDs of all files, for the spatial index
+        std::set<std::string> mSrids;
+
+        //! Features not yet handed to the writer thread
+        Batch* mBatch;
+
+        //! Pipeline of the conversion in progress
+        Pipeline* mPipeline;
+
+        //! Row key holding the source SRID of the geometry, with -load
+        std::string sridKey() { return mGeomField + ":srid"; }
+
         //! Build SQL insert statements for all geometries
         /*!
             This function calls sosicon::ConverterSosi2mysql::buildInsertStatement
             for each of the WKT geometries types to export.
-            \param dbSchema String representing the name of the database schema.
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
             \see sosicon::ConverterSosi2mysql::buildInsertStatement()
             \return The SQL insertion script content.
         */
-        void buildInsertStatements( std::string dbSchema,
-                                    std::string dbTable,
-                                    std::ofstream& fs );
+        void buildInsertStatements( std::string dbTable,
+                                    std::ostream& fs );
 
         //! Build SQL insert statement for one geometry
         /*!
@@ -131,7 +162,6 @@ namespace sosicon {
             very large string, this method requires an output stream for writing
             the data in order to prevent memory exhaustion.
             \param wktGeom WKT geometry type for current insertion script.
-            \param dbSchema String representing the name of the database schema.
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
@@ -139,9 +169,51 @@ namespace sosicon {
             \see sosicon::ConverterSosi2mysql::buildInsertStatements()
         */
         void buildInsertStatement( Wkt wktGeom,
-                                   std::string dbSchema,
                                    std::string dbTable,
-                                   std::ofstream& fs );
+                                   std::ostream& fs );
+
+        //! Write data files and LOAD DATA statements for all geometries
+        /*!
+            This function calls sosicon::ConverterSosi2mysql::buildLoadStatement
+            for each of the WKT geometries types to export.
+            \param dbTable String representing the base name of the database table.
+            \param basePath Path and base name of the data files. The name of the
+                            geometry and .tsv is appended.
+            \param fs Output stream to which the statements are written.
+            \see sosicon::ConverterSosi2mysql::buildLoadStatement()
+        */
+        void buildLoadStatements( std::string dbTable,
+                                  std::string basePath,
+                                  std::ostream& fs );
+
+        //! Write data file and LOAD DATA statement for one geometry
+        /*!
+            Writes the rows of one WKT geometry to a tab separated file, in the
+            format LOAD DATA expects by default: tabs and line breaks within values
+            escaped with backslash, and \\N for NULL. Each row ends with the SRID
+            and the hex-encoded WKB of the geometry, which are combined by the
+            statement's SET clause.
+            \param wktGeom WKT geometry type for current data file.
+            \param dbTable String representing the base name of the database table.
+            \param basePath Path and base name of the data file.
+            \param fs Output stream to which the statement is written.
+            \see sosicon::ConverterSosi2mysql::buildLoadStatements()
+        */
+        void buildLoadStatement( Wkt wktGeom,
+                                 std::string dbTable,
+                                 std::string basePath,
+                                 std::ostream& fs );
+
+        //! Build statements adding the spatial index to each table
+        /*!
+            Bulk loading is much faster without the index, so it is added after the
+            LOAD DATA statements. A spatial index requires the column to be NOT NULL,
+            and MySQL only uses it if the column is restricted to one SRID, which is
+            done when all source files share the same coordinate system.
+            \param dbTable String representing the base name of the database table.
+            \return The SQL/DDL script content.
+        */
+        std::string buildIndexStatements( std::string dbTable );
 
         //! Build SQL create statements for all geometries
         /*!
@@ -150,22 +222,18 @@ namespace sosicon {
             Instead of returning the SQL data, which could result in a
             very large string, this method requires an output stream for writing
             the data in order to prevent memory exhaustion.
-            \param dbSchema String representing the name of the database schema.
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
             \param fs Output stream to which insert chunks are written.
             \see sosicon::ConverterSosi2mysql::buildCreateStatement()
         */
-        std::string buildCreateStatements( std::string sridDest,
-                                           std::string dbSchema,
-                                           std::string dbTable );
+        std::string buildCreateStatements( std::string dbTable );
 
          //! Build SQL create statements for one geometry
          /*!
              This function calls sosicon::ConverterSosi2mysql::buildCreateStatements
              for each of the WKT geometries types to export.
-             \param dbSchema String representing the name of the database schema.
              \param dbTable String representing the base name of the database table.
                             The name of the geometry for that table will be prepended
                             to the base name.
@@ -173,8 +241,6 @@ namespace sosicon {
              \return The SQL/DDL creation script content.
          */
         std::string buildCreateStatement( Wkt wktGeom,
-                                          std::string sridDest,
-                                          std::string dbSchema,
                                           std::string dbTable );
 
         // Free all heap allocations
@@ -196,19 +262,41 @@ namespace sosicon {
         */
         void cleanup( Wkt wktGeom );
 
+        //! Start a feature in the current batch
+        /*!
+            Submits the batch first if it is full, then extracts the attribute values of
+            the element, into a new row with -insert.
+            \param e SOSI feature element.
+            \param type WKT geometry type of the feature.
+            \return The feature, for the caller to add the coordinates to.
+        */
+        Feature& addFeature( ISosiElement* e, Wkt type );
+
+        //! Hand the current batch to the writer thread for encoding
+        void submitBatch();
+
+        //! Store an encoded feature
+        /*!
+            Called from EncodeJob::complete(). Updates the geometry column type and moves
+            the geometry into the row, which is kept.
+            \param feature Encoded feature. Its row is taken over.
+            \param sridSource Source SRID of the file the feature comes from.
+        */
+        void insertRow( Feature& feature, const std::string& sridSource );
+
         //! Fetch element data fields recursively
         /*!
             Traverses the SOSI element tree recursively, extracting plain data fields.
             The field names are stored in the hdr list, and the data values are stored
-            in the row list. The data size value associated wit each entry in hdr is
-            updated to reflect the longest encountered field length.
+            in the row, by column number from mColumns. The type associated with each
+            entry in hdr is updated with the values encountered.
             \param parent The SOSI (sub)tree to be traversed.
             \param hdr The fields list (table header).
             \param row The record set (table row).
         */
         void extractData( ISosiElement* parent,
                           FieldsList& hdr,
-                          std::map<std::string,std::string>*& row );
+                          ColumnIndex::Row*& row );
 
         //! Read current coordinate system from SOSI tree
         /*!
@@ -221,105 +309,61 @@ namespace sosicon {
 
         //! Convert curve geomery (sosi KURVE) to SQL export data
         /*!
-            Extracts the coordinates from the given SOSI element and builds
-            a linestring WKT geometry from it.
+            Extracts the coordinates from the given SOSI element and adds them to
+            the batch for a linestring geometry.
             \see sosicon::ConverterSosi2mysql::insertPoint()
             \see sosicon::ConverterSosi2mysql::insertPolygon()
             \param lineString SOSI geometry element (typically "KURVE").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
         */
-        void insertLineString( ISosiElement* lineString,
-                               std::string sridSource,
-                               std::string sridDest,
-                               std::string geomField );
+        void insertLineString( ISosiElement* lineString );
 
         //! Convert single point geomery (sosi PUNKT) to SQL export data
         /*!
-            Extracts the coordinate from the given SOSI element and builds
-            a point WKT geometry from it.
+            Extracts the coordinate from the given SOSI element and adds it to
+            the batch for a point geometry.
             \see sosicon::ConverterSosi2mysql::insertLineString()
             \see sosicon::ConverterSosi2mysql::insertPolygon()
             \param point SOSI geometry element (typically "PUNKT" or "TEKST").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
         */
-        void insertPoint( ISosiElement* point,
-                          std::string sridSource,
-                          std::string sridDest,
-                          std::string geomField );
+        void insertPoint( ISosiElement* point );
 
         //! Convert polygons (sosi FLATE) to SQL export data
         /*!
-            Extracts the coordinates from the given SOSI element and builds
-            a polygon WKT geometry from it.
+            Extracts the coordinates from the given SOSI element, holes included,
+            and adds them to the batch for a polygon geometry.
             \see sosicon::ConverterSosi2mysql::insertLineString()
             \see sosicon::ConverterSosi2mysql::insertPoint()
-            \param point SOSI geometry element (typically "FLATE").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
-        */
-        void insertPolygon( ISosiElement* polygon,
-                            std::string sridSource,
-                            std::string sridDest,
-                            std::string geomField );
-
-        //! Make SQL dump from SOSI tree
-        /*!
-            Iterates the SOSI tree once for each geometry to be exported, extracting
-            relevant elements and passing them on to one of the insertion routines.
-            \param sosiTree Pointer to the root SOSI element.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param dbSchema String representing the name of the database schema.
-            \param dbTable String representing the base name of the database table.
-                           The name of the geometry for that table will be prepended
-                           to the base name.
-            \see sosicon::ConverterSosi2mysql::insertPoint()
-            \see sosicon::ConverterSosi2mysql::insertLineString()
-            \see sosicon::ConverterSosi2mysql::insertPolygon()
+            \param polygon SOSI geometry element (typically "FLATE").
         */
-        void makemysql( ISosiElement* sosiTree,
-                       std::string sridDest,
-                       std::string dbSchema,
-                       std::string dbTable );
+        void insertPolygon( ISosiElement* polygon );
 
         //! Test if current element is filtered out by -t parameter
         /*!
             If the user uses the -t parameter to specify which OBJTYPE elements to
             include in the export, this function tests if current element is opted
             out of the export.
-            \param src SOSI element serch result to test.
+            \param e SOSI feature element to test.
             \return True if current element should be excluded from the export file.
         */
-        bool objTypeExcluded( sosi::SosiElementSearch& src );
+        bool objTypeExcluded( ISosiElement* e );
 
         //! Write SQL content
         /*!
             Assebles and prepares the SQL statements before writing them to the
             destination file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param dbSchema String representing the name of the database schema.
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
         */
-        void writemysql( std::string sridDest,
-                        std::string dbSchema,
-                        std::string dbTable );
+        void writemysql( std::string dbTable );
 
     public:
 
         //! Constructor
-        ConverterSosi2mysql() : mCmd( 0 ) { }
+        ConverterSosi2mysql() : mCmd( 0 ), mBatch( 0 ), mPipeline( 0 ) { }
 
         //! Destructor
-        virtual ~ConverterSosi2mysql() { }
+        virtual ~ConverterSosi2mysql() { delete mBatch; }
 
         //! Initialize converter
         /*!
@@ -336,6 +380,17 @@ namespace sosicon {
          */
         virtual void run( bool* cancel = 0x00 );
 
+        //! Receive feature from parser
+        /*!
+            Passes each completed PUNKT, TEKST, KURVE and FLATE element on to
+            one of the insertion routines.
+            \param e Feature event holding the element.
+            \see sosicon::ConverterSosi2mysql::insertPoint()
+            \see sosicon::ConverterSosi2mysql::insertLineString()
+            \see sosicon::ConverterSosi2mysql::insertPolygon()
+         */
+        virtual void onEvent( FeatureEvent& e, EventDispatcher<FeatureEvent>& );
+
     }; // class ConverterSosi2tsv
    /*! @} end group converters */
 
@@ -17,6 +17,29 @@
  */
 #include "converter_sosi2psql.h"
 
+namespace {
+
+    //! Build POINT geometry expression from an east, north pair
+    std::string pointExpression( const sosicon::geometry::PointArray& geom,
+                                 const std::string& sridSource,
+                                 const std::string& sridDest ) {
+        std::stringstream ss;
+        ss.precision( 5 );
+        ss  << std::fixed
+            << "ST_Transform(ST_GeomFromText('POINT("
+            << geom[ 0 ]
+            << " "
+            << geom[ 1 ]
+            << ")',"
+            << sridSource
+            << "),"
+            << sridDest
+            << ")";
+        return ss.str();
+    }
+
+}; // namespace
+
 std::string sosicon::ConverterSosi2psql::
 buildCreateStatements( std::string sridDest,
                        std::string dbSchema,
@@ -54,7 +77,7 @@ buildCreateStatement( Wkt wktGeom,
         std::string geomName = utils::toLower( geometryType );
         std::string geomField = dbTable + "_geom";
 
-        ss << "CREATE TABLE IF NOT EXISTS "
+        ss << ( mCmd->mParts > 0 ? "CREATE UNLOGGED TABLE IF NOT EXISTS " : "CREATE TABLE IF NOT EXISTS " )
            << dbSchema
            << "."
            << dbTable
@@ -77,18 +100,33 @@ buildCreateStatement( Wkt wktGeom,
         for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
            std::string field = itrFields->first;
            std::string::size_type len = itrFields->second.length();
-           bool isNumeric = itrFields->second.isNumeric();
-           if( field != geomField ) {
-               if( isNumeric && len < 10 ) {
+           const ColumnType& type = itrFields->second;
+           if( !isGeomField( field, geomField ) ) {
+               if( type.kind() == ColumnType::kind_int32 ) {
                    ss << ","
                       << field
                       << " INTEGER";
                }
-               else if( isNumeric && len < 19 ) {
+               else if( type.kind() == ColumnType::kind_int64 ) {
                    ss << ","
                       << field
                       << " BIGINT";
                }
+               else if( type.kind() == ColumnType::kind_decimal ) {
+                   ss << ","
+                      << field
+                      << " NUMERIC";
+               }
+               else if( type.kind() == ColumnType::kind_date ) {
+                   ss << ","
+                      << field
+                      << " DATE";
+               }
+               else if( type.kind() == ColumnType::kind_boolean ) {
+                   ss << ","
+                      << field
+                      << " BOOLEAN";
+               }
                else if( len > 255 ) {
                    ss << ","
                       << field
@@ -119,35 +157,64 @@ buildCreateStatement( Wkt wktGeom,
            << ",'"
            << geometryType
            << "',2);\n";
+
+        for( std::vector<double>::size_type level = 1; level < mTolerances.size(); level++ ) {
+            std::string field = geomFieldName( geomField, level );
+            if( f->find( field ) != f->end() ) {
+                ss << "SELECT AddGeometryColumn( '"
+                   << dbSchema
+                   << "','"
+                   << dbTable
+                   << "_"
+                   << geomName
+                   << "','"
+                   << field
+                   << "',"
+                   << sridDest
+                   << ",'"
+                   << geometryType
+                   << "',2);\n";
+            }
+        }
     }
     return ss.str();
 }
 
-std::string sosicon::ConverterSosi2psql::
+void sosicon::ConverterSosi2psql::
 buildInsertStatements( std::string dbSchema,
-                       std::string dbTable ) {
-
-    std::string sql;
-    sql  = buildInsertStatement( wkt_point,
-                                 dbSchema,
-                                 dbTable );
-
-    sql += buildInsertStatement( wkt_linestring,
-                                 dbSchema,
-                                 dbTable );
-
-    sql += buildInsertStatement( wkt_polygon,
-                                 dbSchema,
-                                 dbTable );
-    return sql;
+                       std::string dbTable,
+                       std::ostream& fs ) {
+
+    buildInsertStatement( wkt_point,
+                          dbSchema,
+                          dbTable,
+                          fs,
+                          0,
+                          1 );
+
+    buildInsertStatement( wkt_linestring,
+                          dbSchema,
+                          dbTable,
+                          fs,
+                          0,
+                          1 );
+
+    buildInsertStatement( wkt_polygon,
+                          dbSchema,
+                          dbTable,
+                          fs,
+                          0,
+                          1 );
 }
 
-std::string sosicon::ConverterSosi2psql::
+void sosicon::ConverterSosi2psql::
 buildInsertStatement( Wkt wktGeom,
                       std::string dbSchema,
-                      std::string dbTable ) {
+                      std::string dbTable,
+                      std::ostream& fs,
+                      int part,
+                      int parts ) {
 
-    std::string sqlComposite;
     std::string geometryType = utils::wktToStr( wktGeom );
 
     if( !geometryType.empty() && mRowsListCollection[ wktGeom ]->size() > 0 ) {
@@ -164,7 +231,9 @@ buildInsertStatement( Wkt wktGeom,
         std::string geomField = dbTable + "_geom";
         std::string geomName = utils::toLower( geometryType );
 
+        std::vector<std::size_t> columns;
         for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
+            columns.push_back( mColumns.field( itrFields->first ) );
             if( sqlInsert.empty() ) {
 
                 sqlInsert = "INSERT INTO "
@@ -182,31 +251,35 @@ buildInsertStatement( Wkt wktGeom,
         sqlInsert += ") VALUES\n";
         int rowCount = 0;
         RowsList::size_type len = r->size();
-        sosicon::logstream << "    > Processing 0 of " << len << sosicon::flush;
+        RowsList::size_type index = 0;
+        Progress progress( "    > Processing", len );
         for( itrRows = r->begin(); itrRows != r->end(); itrRows++ ) {
-            std::map<std::string,std::string>* row = *itrRows;
+            if( index++ % parts != static_cast<RowsList::size_type>( part ) ) {
+                continue;
+            }
+            ColumnIndex::Row* row = *itrRows;
             if( !sqlValues.empty() && ++rowCount % 50000 == 0 ) {
                 sqlValues = sqlValues.substr( 0, sqlValues.length() - 2 );
                 sqlValues += ";\n";
-                sqlComposite += ( sqlInsert + sqlValues );
+                fs << ( sqlInsert + sqlValues );
                 sqlValues.clear();
             }
-            if( rowCount % 1000 == 0 ) {
-                sosicon::logstream << "\r    > Processing " << rowCount << " of " << len << sosicon::flush;
-            }
+            progress.add();
             sqlValues += "(";
+            std::vector<std::size_t>::size_type column = 0;
             for( itrFields = f->begin(); itrFields != f->end(); itrFields++ ) {
-                std::string key = itrFields->first;
-                if( row->find( key ) == row->end() ) {
-                    ( *row )[ key ] = "";
-                }
-                std::string val = utils::trim( ( *row )[ key ] );
+                const std::string& key = itrFields->first;
+                std::string val = utils::trim( ColumnIndex::value( *row, columns[ column++ ] ) );
+                ColumnType::Kind kind = itrFields->second.kind();
                 if( val.empty() ) {
-                    sqlValues += itrFields->second.isNumeric() ? "NULL," : "'',";
+                    sqlValues += kind != ColumnType::kind_text ? "NULL," : "'',";
                 }
-                else if( key == geomField ) {
+                else if( isGeomField( key, geomField ) ) {
                     sqlValues += val + ",";
                 }
+                else if( kind == ColumnType::kind_boolean ) {
+                    sqlValues += ColumnType::isTrue( val ) ? "TRUE," : "FALSE,";
+                }
                 else if( itrFields->second.isNumeric() ) {
                     sqlValues += utils::sqlNormalize( val ) + ",";
                 }
@@ -220,9 +293,124 @@ buildInsertStatement( Wkt wktGeom,
         sosicon::logstream << "\r    > " << rowCount << " " << geomName << "s processed               \n" << sosicon::flush;
         sqlValues.erase( sqlValues.size() - 2 );
         sqlValues += ";\n";
-        sqlComposite += ( sqlInsert + sqlValues );
+        fs << ( sqlInsert + sqlValues );
+    }
+}
+
+std::string sosicon::ConverterSosi2psql::
+buildFinishStatements( std::string dbSchema,
+                       std::string dbTable ) {
+
+    Wkt types[] = { wkt_point, wkt_linestring, wkt_polygon };
+    std::string geomField = dbTable + "_geom";
+
+    std::stringstream ss;
+    for( unsigned int i = 0; i < sizeof types / sizeof types[ 0 ]; i++ ) {
+
+        FieldsList* f = mFieldsListCollection[ types[ i ] ];
+        std::string table = dbTable + "_" + utils::toLower( utils::wktToStr( types[ i ] ) );
+
+        ss << "ALTER TABLE "
+           << dbSchema
+           << "."
+           << table
+           << " SET LOGGED;\n";
+
+        for( std::vector<double>::size_type level = 0; level < mTolerances.size(); level++ ) {
+            std::string field = geomFieldName( geomField, level );
+            if( level == 0 || f->find( field ) != f->end() ) {
+                ss << "CREATE INDEX IF NOT EXISTS "
+                   << table
+                   << "_"
+                   << field
+                   << "_gist ON "
+                   << dbSchema
+                   << "."
+                   << table
+                   << " USING GIST("
+                   << field
+                   << ");\n";
+            }
+        }
+
+        ss << "CLUSTER "
+           << dbSchema
+           << "."
+           << table
+           << " USING "
+           << table
+           << "_"
+           << geomField
+           << "_gist;\n";
+
+        ss << "ANALYZE "
+           << dbSchema
+           << "."
+           << table
+           << ";\n";
+    }
+    return ss.str();
+}
+
+void sosicon::ConverterSosi2psql::
+writeParts( std::string dbSchema,
+            std::string dbTable,
+            std::string basePath,
+            std::string encoding,
+            std::ostream& fs ) {
+
+    Wkt types[] = { wkt_point, wkt_linestring, wkt_polygon };
+    int parts = mCmd->mParts; // Fewer for tables with fewer rows, so that no part is empty
+
+    fs << "-- Load these files in parallel, then run the finish script:\n";
+
+    for( unsigned int i = 0; i < sizeof types / sizeof types[ 0 ] && mCmd->mInsertStatements; i++ ) {
+        if( mRowsListCollection[ types[ i ] ]->empty() ) {
+            continue;
+        }
+        std::string geomName = utils::toLower( utils::wktToStr( types[ i ] ) );
+        int n = static_cast<int>( std::min<RowsList::size_type>( parts, mRowsListCollection[ types[ i ] ]->size() ) );
+        for( int part = 0; part < n; part++ ) {
+            std::stringstream ss;
+            ss << basePath << "_" << geomName << "_" << std::setw( 2 ) << std::setfill( '0' ) << ( part + 1 ) << ".sql";
+            std::string fileName = utils::nonExistingFilename( ss.str() );
+            AsyncFileWriter out;
+            if( !out.open( fileName ) ) {
+                sosicon::logstream << "    > " << fileName << " could not be created\n";
+                continue;
+            }
+            std::ostream ps( &out );
+            ps << encoding;
+            buildInsertStatement( types[ i ], dbSchema, dbTable, ps, part, n );
+            ps << "SET NAMES 'UTF8';\n";
+            if( out.close( mCmd->mSyncOutput ) ) {
+                sosicon::logstream << "    > " << fileName << " written\n";
+                fs << "--   " << fileName << "\n";
+            }
+            else {
+                sosicon::logstream << "    > " << fileName << " could not be written\n";
+            }
+        }
+    }
+
+    if( !mCmd->mCreateStatements ) {
+        return;
+    }
+    std::string fileName = utils::nonExistingFilename( basePath + "_finish.sql" );
+    AsyncFileWriter out;
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream ps( &out );
+    ps << buildFinishStatements( dbSchema, dbTable );
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written\n";
+        fs << "-- Finish script: " << fileName << "\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
     }
-    return sqlComposite;
 }
 
 void sosicon::ConverterSosi2psql::
@@ -253,7 +441,7 @@ cleanup( Wkt wktGeom ) {
 void sosicon::ConverterSosi2psql::
 extractData( ISosiElement* parent,
              FieldsList& hdr,
-             std::map<std::string,std::string>*& row ) {
+             ColumnIndex::Row*& row ) {
 
     sosi::SosiElementSearch srcData;
     while( parent->getChild( srcData ) ) {
@@ -262,25 +450,27 @@ extractData( ISosiElement* parent,
 
         extractData( dataElement, hdr, row );
 
-        std::string fieldName = utils::toFieldname( dataElement->getName() );
-        std::string data = dataElement->getData();
+        const std::string& data = dataElement->getData();
 
         if( data.empty() ) {
             continue;
         }
 
-        if( hdr.find( fieldName ) == hdr.end() ) {
-            hdr[ fieldName ] = Field( data );
-        }
+        std::size_t column = mColumns.element( dataElement->getName() );
+        ColumnType& type = hdr[ mColumns.name( column ) ];
 
         if( row ) {
-            if( row->find( fieldName ) == row->end() ) {
-                ( *row )[ fieldName ] = data;
+            std::string& value = ColumnIndex::cell( *row, column );
+            if( value.empty() ) {
+                value = data;
             }
             else {
-                ( *row )[ fieldName ].append( "|" + data );
+                value.append( "|" + data );
             }
-            hdr[ fieldName ].expand( ( *row )[ fieldName ] );
+            type.expand( value );
+        }
+        else {
+            type.expand( data );
         }
     }
 }
@@ -326,10 +516,7 @@ getSrid( ISosiElement* sosiTree ) {
 }
 
 void sosicon::ConverterSosi2psql::
-insertPoint( ISosiElement* point,
-             std::string sridSource,
-             std::string sridDest,
-             std::string geomField ) {
+insertPoint( ISosiElement* point ) {
 
     sosi::SosiElementSearch srcNe = sosi::SosiElementSearch( sosi::sosi_element_ne );
 
@@ -337,59 +524,50 @@ insertPoint( ISosiElement* point,
 
         sosi::SosiNorthEast ne = sosi::SosiNorthEast( srcNe.element() );
         ICoordinate* coord = ne.front();
-        std::stringstream ss;
-
-        std::map<std::string,std::string>* row = 0;
-
-        row = new std::map<std::string,std::string>();
 
-        ss.precision( 5 );
-        ss  << std::fixed
-            << "ST_Transform(ST_GeomFromText('POINT("
-            << coord->getE()
-            << " "
-            << coord->getN()
-            << ")',"
-            << sridSource
-            << "),"
-            << sridDest
-            << ")";
-
-        std::string data = ss.str();
-
-        ( *row )[ geomField ] = data;
-
-        FieldsList& hdr = ( *mFieldsListCollection[ wkt_point ] );
-        hdr[ geomField ].expand( data );
+        Feature& f = addFeature( point, wkt_point );
+        f.levels.resize( 1 ); // Points are not simplified
+        f.levels.front().geom.push_back( coord->getE() );
+        f.levels.front().geom.push_back( coord->getN() );
+    }
+}
 
-        extractData( point, hdr, row );
+std::string sosicon::ConverterSosi2psql::
+geomFieldName( std::string geomField, std::vector<double>::size_type level ) {
+    return level == 0 ? geomField : geomField + utils::simplifySuffix( mTolerances[ level ] );
+}
 
-        if( mCmd->mInsertStatements ) {
-            mRowsListCollection[ wkt_point ]->push_back( row );
+bool sosicon::ConverterSosi2psql::
+isGeomField( std::string field, std::string geomField ) {
+    for( std::vector<double>::size_type level = 0; level < mTolerances.size(); level++ ) {
+        if( field == geomFieldName( geomField, level ) ) {
+            return true;
         }
     }
+    return false;
 }
 
-void sosicon::ConverterSosi2psql::
-insertLineString( ISosiElement* lineString,
-                  std::string sridSource,
-                  std::string sridDest,
-                  std::string geomField ) {
+std::string sosicon::ConverterSosi2psql::
+lineStringExpression( CoordinateCollection& cc,
+                      std::string sridSource,
+                      std::string sridDest ) {
+    return lineStringExpression( cc.getGeom(), sridSource, sridDest );
+}
 
-    CoordinateCollection cc;
-    cc.discoverCoords( lineString );
+std::string sosicon::ConverterSosi2psql::
+lineStringExpression( const geometry::PointArray& theGeom,
+                      const std::string& sridSource,
+                      const std::string& sridDest ) {
 
-    std::vector<ICoordinate*> theGeom = cc.getGeom();
     std::stringstream ssGeomCoord;
 
     ssGeomCoord.precision( 5 );
     ssGeomCoord << std::fixed;
 
-    for( std::vector<ICoordinate*>::iterator i = theGeom.begin(); i != theGeom.end(); i++ ) {
-        ICoordinate* c = *i;
-        ssGeomCoord << c->getE()
+    for( geometry::PointArray::size_type i = 0; i + 1 < theGeom.size(); i += 2 ) {
+        ssGeomCoord << theGeom[ i ]
                     << " "
-                    << c->getN()
+                    << theGeom[ i + 1 ]
                     << ",";
     }
 
@@ -405,46 +583,33 @@ insertLineString( ISosiElement* lineString,
        << sridDest
        << ")";
 
-    std::string data = ss.str();
-
-    std::map<std::string,std::string>* row = 0;
-
-    row = new std::map<std::string,std::string>();
-    ( *row )[ geomField ] = data;
-
-    FieldsList& hdr = ( *mFieldsListCollection[ wkt_linestring ] );
-    hdr[ geomField ].expand( data );
-
-    extractData( lineString, hdr, row );
-
-    if( mCmd->mInsertStatements ) {
-        mRowsListCollection[ wkt_linestring ]->push_back( row );
-    }
+    return ss.str();
 }
 
-void sosicon::ConverterSosi2psql::
-insertPolygon( ISosiElement* polygon,
-               std::string sridSource,
-               std::string sridDest,
-               std::string geomField ) {
+std::string sosicon::ConverterSosi2psql::
+polygonExpression( CoordinateCollection& cc,
+                   std::string sridSource,
+                   std::string sridDest ) {
+    return polygonExpression( cc.getGeom(), cc.getHoles(), cc.getHoleSizes(), sridSource, sridDest );
+}
 
-    CoordinateCollection cc;
-    cc.discoverCoords( polygon );
+std::string sosicon::ConverterSosi2psql::
+polygonExpression( const geometry::PointArray& theGeom,
+                   const geometry::PointArray& theHoles,
+                   const std::vector<int>& holeSizes,
+                   const std::string& sridSource,
+                   const std::string& sridDest ) {
 
-    std::vector<ICoordinate*> theGeom = cc.getGeom();
-    std::vector<ICoordinate*> theHoles = cc.getHoles();
-    std::vector<int> holeSizes = cc.getHoleSizes();
     std::stringstream ssGeomCoord;
 
     ssGeomCoord.precision( 5 );
     ssGeomCoord << std::fixed
                 << "(";
 
-    for( std::vector<ICoordinate*>::iterator i = theGeom.begin(); i != theGeom.end(); i++ ) {
-        ICoordinate* c = *i;
-        ssGeomCoord << c->getE()
+    for( geometry::PointArray::size_type i = 0; i + 1 < theGeom.size(); i += 2 ) {
+        ssGeomCoord << theGeom[ i ]
                     << " "
-                    << c->getN()
+                    << theGeom[ i + 1 ]
                     << ",";
     }
 
@@ -456,29 +621,16 @@ insertPolygon( ISosiElement* polygon,
     ssHolesCoord.precision( 5 );
     ssHolesCoord << std::fixed;
 
-    int offset = 0;
-    ICoordinate* first = 0, * last = 0;
-    for( std::vector<int>::iterator i = holeSizes.begin(); i != holeSizes.end(); i++ ) {
+    geometry::PointArray::size_type offset = 0; // Holes are closed by CoordinateCollection
+    for( std::vector<int>::const_iterator i = holeSizes.begin(); i != holeSizes.end(); i++ ) {
         ssHolesCoord << ",(";
-        for( int j = 0; j < *i; j++ ) {
-            ICoordinate* c = theHoles[ offset++ ];
-            if( j == 0 ) {
-                first = c;
-            }
-            else {
+        for( int j = 0; j < *i; j++, offset += 2 ) {
+            if( j > 0 ) {
                 ssHolesCoord << ",";
-                last = c;
             }
-            ssHolesCoord << c->getE()
-                         << " "
-                         << c->getN();
-        }
-        if( !first->equals( last ) ) {
-            // Close polygon if open
-            ssHolesCoord << ","
-                         << first->getE()
+            ssHolesCoord << theHoles[ offset ]
                          << " "
-                         << first->getN();
+                         << theHoles[ offset + 1 ];
         }
         ssHolesCoord << ")";
     }
@@ -493,63 +645,158 @@ insertPolygon( ISosiElement* polygon,
        << sridDest
        << ")";
 
-    std::string data = ss.str();
+    return ss.str();
+}
 
-    std::map<std::string,std::string>* row = 0;
-    row = new std::map<std::string,std::string>();
-    ( *row )[ geomField ] = data;
+void sosicon::ConverterSosi2psql::
+insertLineString( ISosiElement* lineString ) {
 
-    FieldsList& hdr = ( *mFieldsListCollection[ wkt_polygon ] );
-    hdr[ geomField ].expand( data );
+    CoordinateCollection cc( mTolerances.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( lineString );
 
-    extractData( polygon, hdr, row );
+    Feature& f = addFeature( lineString, wkt_linestring );
+    f.levels.resize( mTolerances.size() );
 
-    if( mCmd->mInsertStatements ) {
-        mRowsListCollection[ wkt_polygon ]->push_back( row );
+    for( std::vector<double>::size_type level = 0; level < mTolerances.size(); level++ ) {
+        if( level > 0 ) {
+            cc.simplify( mTolerances[ level ] );
+        }
+        f.levels[ level ].geom = cc.getGeom();
     }
 }
 
 void sosicon::ConverterSosi2psql::
-makePsql( ISosiElement* sosiTree,
-          std::string sridDest,
-          std::string,
-          std::string dbTable ) {
+insertPolygon( ISosiElement* polygon ) {
 
-    std::string sridSource = getSrid( sosiTree );
-    std::string geomField = dbTable + "_geom";
-    sosi::SosiTranslationTable ttbl;
+    CoordinateCollection cc( mTolerances.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( polygon );
+
+    Feature& f = addFeature( polygon, wkt_polygon );
+    f.levels.resize( mTolerances.size() );
 
-    std::vector<sosi::ElementType> pointTypes;
-    pointTypes.push_back( sosi::sosi_element_point );
-    pointTypes.push_back( sosi::sosi_element_text );
-    sosi::SosiElementSearch srcPoint = sosi::SosiElementSearch( pointTypes );
-    while( sosiTree->getChild( srcPoint ) ) {
-        if( objTypeExcluded( srcPoint ) ) continue;
-        insertPoint( srcPoint.element(), sridSource, sridDest, geomField );
+    for( std::vector<double>::size_type level = 0; level < mTolerances.size(); level++ ) {
+        if( level > 0 ) {
+            cc.simplify( mTolerances[ level ] );
+        }
+        Geometry& g = f.levels[ level ];
+        g.geom = cc.getGeom();
+        g.holes = cc.getHoles();
+        g.holeSizes = cc.getHoleSizes();
+    }
+}
+
+sosicon::ConverterSosi2psql::Feature& sosicon::ConverterSosi2psql::
+addFeature( ISosiElement* e, Wkt type ) {
+
+    if( mBatch->size() >= BATCH_SIZE ) {
+        submitBatch();
+    }
+    mBatch->push_back( Feature() );
+    Feature& f = mBatch->back();
+    f.type = type;
+    f.row = new ColumnIndex::Row( mColumns.size() );
+    extractData( e, *mFieldsListCollection[ type ], f.row );
+    return f;
+}
+
+void sosicon::ConverterSosi2psql::
+submitBatch() {
+    if( mBatch->empty() ) {
+        return;
+    }
+    mPipeline->submit( new EncodeJob( this, mBatch, mSridSource, mSridDest ) );
+    mBatch = new Batch();
+}
+
+void sosicon::ConverterSosi2psql::
+insertRow( Feature& feature ) {
+
+    FieldsList& hdr = ( *mFieldsListCollection[ feature.type ] );
+    ColumnIndex::Row* row = feature.row;
+    feature.row = 0;
+
+    for( std::vector<std::string>::size_type level = 0; level < feature.data.size(); level++ ) {
+        std::string field = geomFieldName( mGeomField, level );
+        hdr[ field ].expand( feature.data[ level ] );
+        ColumnIndex::cell( *row, mColumns.field( field ) ).swap( feature.data[ level ] );
+    }
+
+    if( mCmd->mInsertStatements ) {
+        mRowsListCollection[ feature.type ]->push_back( row );
     }
+    else {
+        delete row;
+    }
+}
+
+sosicon::ConverterSosi2psql::EncodeJob::
+~EncodeJob() {
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        delete f->row; // Rows not handed over by complete()
+    }
+    delete mBatch;
+}
 
-    std::vector<sosi::ElementType> lineStringTypes;
-    lineStringTypes.push_back( sosi::sosi_element_curve );
-    sosi::SosiElementSearch srcLineString = sosi::SosiElementSearch( lineStringTypes );
-    while( sosiTree->getChild( srcLineString ) ) {
-        if( objTypeExcluded( srcLineString ) ) continue;
-        insertLineString( srcLineString.element(), sridSource, sridDest, geomField );
+void sosicon::ConverterSosi2psql::EncodeJob::
+run() {
+    Profiler::Scope scope( Profiler::stage_convert );
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        f->data.resize( f->levels.size() );
+        for( std::vector<Geometry>::size_type level = 0; level < f->levels.size(); level++ ) {
+            const Geometry& g = f->levels[ level ];
+            switch( f->type ) {
+                case wkt_point:
+                    f->data[ level ] = pointExpression( g.geom, mSridSource, mSridDest );
+                    break;
+                case wkt_linestring:
+                    f->data[ level ] = lineStringExpression( g.geom, mSridSource, mSridDest );
+                    break;
+                default:
+                    f->data[ level ] = polygonExpression( g.geom, g.holes, g.holeSizes, mSridSource, mSridDest );
+            }
+        }
     }
+}
 
-    std::vector<sosi::ElementType> polygonTypes;
-    polygonTypes.push_back( sosi::sosi_element_surface );
-    sosi::SosiElementSearch srcPolygon = sosi::SosiElementSearch( polygonTypes );
-    while( sosiTree->getChild( srcPolygon ) ) {
-        if( objTypeExcluded( srcPolygon ) ) continue;
-        insertPolygon( srcPolygon.element(), sridSource, sridDest, geomField );
+void sosicon::ConverterSosi2psql::EncodeJob::
+complete() {
+    for( Batch::iterator f = mBatch->begin(); f != mBatch->end(); f++ ) {
+        mConverter->insertRow( *f );
     }
 }
 
 bool sosicon::ConverterSosi2psql::
-objTypeExcluded( sosi::SosiElementSearch& src )
+objTypeExcluded( ISosiElement* e )
 {
     std::vector<std::string>& ot = mCmd->mObjTypes;
-    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( src.element()->getObjType() ) ) == ot.end();
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
+void sosicon::ConverterSosi2psql::
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
+
+    ISosiElement* e = event.mFeature;
+
+    if( mSridSource.empty() ) {
+        mSridSource = getSrid( e->getRoot() );
+    }
+    if( objTypeExcluded( e ) ) {
+        return;
+    }
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            insertPoint( e );
+            break;
+        case sosi::sosi_element_curve:
+            insertLineString( e );
+            break;
+        case sosi::sosi_element_surface:
+            insertPolygon( e );
+            break;
+        default:
+            ;
+    }
 }
 
 void sosicon::ConverterSosi2psql::
@@ -564,15 +811,25 @@ run( bool* ) {
     mRowsListCollection[ wkt_polygon ] = new RowsList();
 
     std::string sridDest = mCmd->mSrid.empty() ? "4326" : mCmd->mSrid;
+    mSridDest = sridDest;
 
     std::string dbSchema = mCmd->mDbSchema.empty() ? "sosicon" : utils::toLower( mCmd->mDbSchema );
     std::string dbTable = mCmd->mDbTable.empty() ? "object" : utils::toLower( mCmd->mDbTable );
     std::string geomField = dbTable + "_geom";
+    mGeomField = geomField;
+
+    mTolerances = mCmd->mSimplify;
+    if( mTolerances.empty() ) {
+        mTolerances.push_back( 0 );
+    }
 
-    ( *mFieldsListCollection[ wkt_point ] )[ geomField ] = Field();
-    ( *mFieldsListCollection[ wkt_linestring ] )[ geomField ] = Field();
-    ( *mFieldsListCollection[ wkt_polygon ] )[ geomField ] = Field();
+    ( *mFieldsListCollection[ wkt_point ] )[ geomField ] = ColumnType();
+    ( *mFieldsListCollection[ wkt_linestring ] )[ geomField ] = ColumnType();
+    ( *mFieldsListCollection[ wkt_polygon ] )[ geomField ] = ColumnType();
 
+    Pipeline pipeline( mCmd );
+    mPipeline = &pipeline;
+    mBatch = new Batch();
     for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end(); f++ ) {
         mCurrentSourcefile = *f;
         if( !utils::fileExists( mCurrentSourcefile ) ) {
@@ -580,31 +837,21 @@ run( bool* ) {
         }
         else {
             sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            sosicon::logstream << "Building postGIS export...\n";
+            mSridSource.clear();
             Parser p;
-            char ln[ 1024 ];
-            std::ifstream ifs( mCurrentSourcefile.c_str() );
+            p.addFeatureListener( this );
             int n = 0;
-            while( !ifs.eof() ) {
-                if( ++n % 100 == 0 ) {
-                    if( mCmd->mVerbose > 1 ) {
-                        sosicon::logstream << "\rParsing line " << n;
-                    }
-                }
-                memset( ln, 0x00, sizeof ln );
-                ifs.getline( ln, sizeof ln );
-                p.ragelParseSosiLine( ln );
-            }
-            p.complete();
-
-            ifs.close();
-            sosicon::logstream << "\r" << n << " lines parsed        \n";
-            sosicon::logstream << "Building postGIS export...\n";
-            ISosiElement* root = p.getRootElement();
-            makePsql( root, sridDest, dbSchema, dbTable );
+            pipeline.parse( mCurrentSourcefile, p, n );
+            submitBatch(); // The batch carries the SRID of this file
         }
     }
+    pipeline.drain();
+    mPipeline = 0;
+    Profiler::endFile(); // Output covers all files
     writePsql( sridDest, dbSchema, dbTable );
     cleanup();
+    pipeline.finish();
     sosicon::logstream << "Done!\n";
 }
 
@@ -613,18 +860,25 @@ writePsql( std::string sridDest,
            std::string dbSchema,
            std::string dbTable ) {
 
-    std::ofstream fs;
+    Profiler::Scope scope( Profiler::stage_write );
+    AsyncFileWriter out;
     std::string defaultOutputFile = mCmd->mOutputFile.empty() ? "postgis_dump.sql" : mCmd->mOutputFile;
     std::string fileName = utils::nonExistingFilename( defaultOutputFile );
     sosicon::logstream << "    > Converting SOSI data to SQL...\n";
-    fs.open( fileName.c_str(), std::ios::out | std::ios::trunc );
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream fs( &out );
     fs.precision( 0 );
     const sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
     const sosi::Charset sosiCharset = cs->getEncoding();
     const std::string encoding = utils::sosiEncodingToPsqlEncoding( sosiCharset );
+    std::string setNames;
     if( sosiCharset != sosi::Charset::sosi_charset_utf8 ) {
-      fs << "SET NAMES '" << encoding << "';\n";
+        setNames = "SET NAMES '" + encoding + "';\n";
     }
+    fs << setNames;
     if( mCmd->mCreateStatements ) {
         fs << "DO\n"
            << "$$\n"
@@ -643,9 +897,20 @@ writePsql( std::string sridDest,
            << "END\n"
            << "$$ LANGUAGE plpgsql;\n";
     }
-    fs <<  ( mCmd->mCreateStatements ? buildCreateStatements( sridDest, dbSchema, dbTable ) : "" )
-       <<  ( mCmd->mInsertStatements ? buildInsertStatements( dbSchema, dbTable ) : "" )
-       << "SET NAMES 'UTF8';\n";
-    fs.close();
-    sosicon::logstream << "    > " << fileName << " written\n";
+    fs <<  ( mCmd->mCreateStatements ? buildCreateStatements( sridDest, dbSchema, dbTable ) : "" );
+    if( mCmd->mParts > 0 ) {
+        std::string dir, tit, ext;
+        utils::getPathInfo( fileName, dir, tit, ext );
+        writeParts( dbSchema, dbTable, dir + tit, setNames, fs );
+    }
+    else if( mCmd->mInsertStatements ) {
+        buildInsertStatements( dbSchema, dbTable, fs );
+    }
+    fs << "SET NAMES 'UTF8';\n";
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
+    }
 }
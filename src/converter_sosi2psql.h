@@ -22,12 +22,15 @@
 
 #include "logger.h"
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <vector>
 #include <climits>
 #include <cmath>
 #include <map>
 #include "utils.h"
+#include "column_index.h"
+#include "column_type.h"
 #include "interface/i_converter.h"
 #include "interface/i_sosi_element.h"
 #include "sosi/sosi_types.h"
@@ -37,6 +40,8 @@
 #include "command_line.h"
 #include "common_types.h"
 #include "parser.h"
+#include "pipeline.h"
+#include "feature_event.h"
 
 namespace sosicon {
 
@@ -48,52 +53,64 @@ namespace sosicon {
     /*!
         If command-line parameter -2psql is specified, this converter will handle the output
         generation. Produces a PostgreSQL/PostGIS dump file from the SOSI source(s).
-     */
-    class ConverterSosi2psql : public IConverter {
+        Features are received one at a time from the parser, so the SOSI tree is never
+        held in memory as a whole.
 
-        class Field {
-            std::string::size_type mMaxLength;
-            std::string::size_type mMinLength;
-            bool mIsNumeric;
-        public:
-            bool isNumeric() {
-                if( mMaxLength == mMinLength ) {
-                    // Treat fixed-length numerical data as character field, since they
-                    // are in fact non-arithmetic types types like dates, phone numbers
-                    // or serial numbers.
-                    mIsNumeric = false;
-                }
-                return mIsNumeric;
-            }
-            std::string::size_type length() {
-                return mMaxLength;
-            }
-            Field() {
-                mIsNumeric = true;
-                mMaxLength = 0;
-            }
-            Field( std::string& str ) {
-                mIsNumeric = true;
-                mMaxLength = 0;
-                mMinLength = std::numeric_limits<std::string::size_type>::max();
-                expand( str );
-            }
-            std::string::size_type expand( std::string& str ) {
-                std::string::size_type len = str.length();
-                mMinLength = std::min( mMinLength, len );
-                mMaxLength = std::max( mMaxLength, len );
-                if( mIsNumeric ) {
-                    mIsNumeric = utils::isNumeric( str );
-                }
-                return mMaxLength;
-            }
-        };
+        The converter thread only copies the coordinates and attribute values out of each
+        feature. The geometry expressions are built from those copies in batches, by
+        EncodeJob on the pipeline's writer thread, while parsing carries on.
 
-        typedef std::map< std::string,Field > FieldsList;
+        With -parts, the dump is split for parallel loading: the main file creates the
+        tables UNLOGGED, the INSERT statements of each table are spread over a number of
+        part files, and a finish script makes the tables durable and indexes them once all
+        parts are loaded.
+     */
+    class ConverterSosi2psql : public IConverter, public FeatureEventDispatcher::Listener {
+
+        typedef std::map< std::string,ColumnType > FieldsList;
         typedef std::map< Wkt, FieldsList* > FieldsListCollection;
-        typedef std::vector< std::map< std::string,std::string >* > RowsList;
+        typedef std::vector< ColumnIndex::Row* > RowsList;
         typedef std::map< Wkt, RowsList* > RowsListCollection;
 
+        //! Number of features per encode job
+        static const std::size_t BATCH_SIZE = 4096;
+
+        //! Coordinates of one geometry column, copied out of the element tree
+        struct Geometry {
+            geometry::PointArray geom;      //!< Point, line or outer ring, as east, north pairs
+            geometry::PointArray holes;     //!< Holes, closed, as east, north pairs
+            std::vector<int> holeSizes;     //!< Points per hole
+        };
+
+        //! Feature waiting for its geometry expressions
+        struct Feature {
+            Wkt type;                       //!< Geometry type, selects the table
+            ColumnIndex::Row* row;          //!< Attribute values, extracted on the converter thread
+            std::vector<Geometry> levels;   //!< Coordinates of each geometry column, see mTolerances
+            std::vector<std::string> data;  //!< Expression of each geometry column, set by EncodeJob
+        };
+
+        //! Features not yet handed to the writer thread
+        typedef std::vector<Feature> Batch;
+
+        //! Build the geometry expressions of a batch. Run on the writer thread.
+        /*!
+            run() only reads the coordinates copied into the batch. complete() hands the rows
+            over to the converter, on the converter thread, in the order they were parsed.
+        */
+        class EncodeJob : public IPipelineJob {
+            ConverterSosi2psql* mConverter; //!< Converter receiving the rows
+            Batch* mBatch;                  //!< Features to encode, owned by the job
+            std::string mSridSource;        //!< Source SRID of the file the batch comes from
+            std::string mSridDest;          //!< Target SRID
+        public:
+            EncodeJob( ConverterSosi2psql* converter, Batch* batch, std::string sridSource, std::string sridDest ) :
+                mConverter( converter ), mBatch( batch ), mSridSource( sridSource ), mSridDest( sridDest ) { }
+            virtual ~EncodeJob();
+            virtual void run();
+            virtual void complete();
+        };
+
         //! Command line wrapper
         CommandLine* mCmd;
 
@@ -106,6 +123,31 @@ namespace sosicon {
         //! Collection of rows, one item for each geometry type
         RowsListCollection mRowsListCollection;
 
+        //! Column numbers of the fields in the rows
+        ColumnIndex mColumns;
+
+        //! Target SRID for current conversion
+        std::string mSridDest;
+
+        //! Source SRID for current file, resolved from the header on first feature
+        std::string mSridSource;
+
+        //! Name of the geometry field
+        std::string mGeomField;
+
+        //! Simplification tolerances, one geometry column for each
+        /*!
+            The first tolerance applies to the main geometry field, which is 0 unless -simplify
+            is given. Each of the following gets an extra geometry column, see geomFieldName().
+         */
+        std::vector<double> mTolerances;
+
+        //! Features not yet handed to the writer thread
+        Batch* mBatch;
+
+        //! Pipeline of the conversion in progress
+        Pipeline* mPipeline;
+
         //! Build SQL insert statements for all geometries
         /*!
             This function calls sosicon::ConverterSosi2psql::buildInsertStatement
@@ -114,27 +156,63 @@ namespace sosicon {
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
+            \param fs Output stream to which insert chunks are written.
             \see sosicon::ConverterSosi2psql::buildInsertStatement()
-            \return The SQL insertion script content.
         */
-        std::string buildInsertStatements( std::string dbSchema,
-                                           std::string dbTable );
+        void buildInsertStatements( std::string dbSchema,
+                                    std::string dbTable,
+                                    std::ostream& fs );
 
         //! Build SQL insert statement for one geometry
         /*!
             Creates the SQL statements required to insert the data for one WKT
-            geometry.
+            geometry. Instead of returning the SQL data, which could result in a
+            very large string, this method requires an output stream for writing
+            the data in order to prevent memory exhaustion.
             \param wktGeom WKT geometry type for current insertion script.
             \param dbSchema String representing the name of the database schema.
             \param dbTable String representing the base name of the database table.
                            The name of the geometry for that table will be prepended
                            to the base name.
+            \param fs Output stream to which insert chunks are written.
+            \param part Part to write, from 0, when the rows are split over several files.
+            \param parts Number of parts. Row n goes to part n % parts.
             \see sosicon::ConverterSosi2psql::buildInsertStatements()
-            \return The SQL insertion script content.
         */
-        std::string buildInsertStatement( Wkt wktGeom,
-                                          std::string dbSchema,
-                                          std::string dbTable );
+        void buildInsertStatement( Wkt wktGeom,
+                                   std::string dbSchema,
+                                   std::string dbTable,
+                                   std::ostream& fs,
+                                   int part,
+                                   int parts );
+
+        //! Build SQL statements to run after a split dump has been loaded
+        /*!
+            Sets each table LOGGED, creates a GiST index on each geometry column, clusters
+            the table on the index of the main geometry column and updates the planner
+            statistics. Building the indexes once, after the load, is far cheaper than
+            maintaining them row by row.
+            \param dbSchema String representing the name of the database schema.
+            \param dbTable String representing the base name of the database table.
+            \return The SQL/DDL script content.
+        */
+        std::string buildFinishStatements( std::string dbSchema,
+                                           std::string dbTable );
+
+        //! Write part files and finish script of a split dump
+        /*!
+            \param dbSchema String representing the name of the database schema.
+            \param dbTable String representing the base name of the database table.
+            \param basePath Path and base name of the files. The name of the geometry and
+                            the part number is appended.
+            \param encoding SET NAMES statement for the start of each file, or empty.
+            \param fs Main dump, where the load order is noted.
+        */
+        void writeParts( std::string dbSchema,
+                         std::string dbTable,
+                         std::string basePath,
+                         std::string encoding,
+                         std::ostream& fs );
 
         //! Build SQL create statements for all geometries
         /*!
@@ -186,19 +264,41 @@ namespace sosicon {
         */
         void cleanup( Wkt wktGeom );
 
+        //! Start a feature in the current batch
+        /*!
+            Submits the batch first if it is full, then extracts the attribute values of
+            the element into a new row.
+            \param e SOSI feature element.
+            \param type WKT geometry type of the feature.
+            \return The feature, for the caller to add the coordinates to.
+        */
+        Feature& addFeature( ISosiElement* e, Wkt type );
+
+        //! Hand the current batch to the writer thread for encoding
+        void submitBatch();
+
+        //! Store an encoded feature
+        /*!
+            Called from EncodeJob::complete(). Moves the geometry expressions into the row,
+            updates the geometry column types and keeps the row if insert statements are
+            written.
+            \param feature Encoded feature. Its row is taken over.
+        */
+        void insertRow( Feature& feature );
+
         //! Fetch element data fields recursively
         /*!
             Traverses the SOSI element tree recursively, extracting plain data fields.
             The field names are stored in the hdr list, and the data values are stored
-            in the row list. The data size value associated wit each entry in hdr is
-            updated to reflect the longest encountered field length.
+            in the row, by column number from mColumns. The type associated with each
+            entry in hdr is updated with the values encountered.
             \param parent The SOSI (sub)tree to be traversed.
             \param hdr The fields list (table header).
             \param row The record set (table row).
         */
         void extractData( ISosiElement* parent,
                           FieldsList& hdr,
-                          std::map<std::string,std::string>*& row );
+                          ColumnIndex::Row*& row );
 
         //! Read current coordinate system from SOSI tree
         /*!
@@ -211,83 +311,61 @@ namespace sosicon {
 
         //! Convert curve geomery (sosi KURVE) to SQL export data
         /*!
-            Extracts the coordinates from the given SOSI element and builds
-            a linestring WKT geometry from it.
+            Extracts the coordinates from the given SOSI element, simplified for each
+            geometry column, and adds them to the batch for a linestring WKT geometry.
             \see sosicon::ConverterSosi2psql::insertPoint()
             \see sosicon::ConverterSosi2psql::insertPolygon()
             \param lineString SOSI geometry element (typically "KURVE").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
         */
-        void insertLineString( ISosiElement* lineString,
-                               std::string sridSource,
-                               std::string sridDest,
-                               std::string geomField );
+        void insertLineString( ISosiElement* lineString );
+
+        //! Name of the geometry column for a simplification level
+        /*!
+            \param geomField Name of the main geometry field.
+            \param level Index into mTolerances.
+            \return geomField for level 0, otherwise geomField with the tolerance suffix
+                    from utils::simplifySuffix().
+        */
+        std::string geomFieldName( std::string geomField, std::vector<double>::size_type level );
+
+        //! Test if a field holds geometry
+        /*!
+            \param field Name of the field to test.
+            \param geomField Name of the main geometry field.
+            \return True if field is the main geometry field or one of the simplified ones.
+        */
+        bool isGeomField( std::string field, std::string geomField );
 
         //! Convert single point geomery (sosi PUNKT) to SQL export data
         /*!
-            Extracts the coordinate from the given SOSI element and builds
-            a point WKT geometry from it.
+            Extracts the coordinate from the given SOSI element and adds it to
+            the batch for a point WKT geometry.
             \see sosicon::ConverterSosi2psql::insertLineString()
             \see sosicon::ConverterSosi2psql::insertPolygon()
             \param point SOSI geometry element (typically "PUNKT" or "TEKST").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
         */
-        void insertPoint( ISosiElement* point,
-                          std::string sridSource,
-                          std::string sridDest,
-                          std::string geomField );
+        void insertPoint( ISosiElement* point );
 
         //! Convert polygons (sosi FLATE) to SQL export data
         /*!
-            Extracts the coordinates from the given SOSI element and builds
-            a polygon WKT geometry from it.
+            Extracts the coordinates from the given SOSI element, holes included and
+            simplified for each geometry column, and adds them to the batch for a
+            polygon WKT geometry.
             \see sosicon::ConverterSosi2psql::insertLineString()
             \see sosicon::ConverterSosi2psql::insertPoint()
-            \param point SOSI geometry element (typically "FLATE").
-            \param sridSource Spatial reference grid ID for the source file.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param geomField The name of the field within the recordset
-                             representing the geometry data.
-        */
-        void insertPolygon( ISosiElement* polygon,
-                            std::string sridSource,
-                            std::string sridDest,
-                            std::string geomField );
-
-        //! Make SQL dump from SOSI tree
-        /*!
-            Iterates the SOSI tree once for each geometry to be exported, extracting
-            relevant elements and passing them on to one of the insertion routines.
-            \param sosiTree Pointer to the root SOSI element.
-            \param sridDest Spatial reference grid ID for the target file.
-            \param dbSchema String representing the name of the database schema.
-            \param dbTable String representing the base name of the database table.
-                           The name of the geometry for that table will be prepended
-                           to the base name.
-            \see sosicon::ConverterSosi2psql::insertPoint()
-            \see sosicon::ConverterSosi2psql::insertLineString()
-            \see sosicon::ConverterSosi2psql::insertPolygon()
+            \param polygon SOSI geometry element (typically "FLATE").
         */
-        void makePsql( ISosiElement* sosiTree,
-                       std::string sridDest,
-                       std::string dbSchema,
-                       std::string dbTable );
+        void insertPolygon( ISosiElement* polygon );
 
         //! Test if current element is filtered out by -t parameter
         /*!
             If the user uses the -t parameter to specify which OBJTYPE elements to
             include in the export, this function tests if current element is opted
             out of the export.
-            \param src SOSI element serch result to test.
+            \param e SOSI feature element to test.
             \return True if current element should be excluded from the export file.
         */
-        bool objTypeExcluded( sosi::SosiElementSearch& src );
+        bool objTypeExcluded( ISosiElement* e );
 
         //! Write SQL content
         /*!
@@ -306,10 +384,10 @@ namespace sosicon {
     public:
 
         //! Constructor
-        ConverterSosi2psql() : mCmd( 0 ) { }
+        ConverterSosi2psql() : mCmd( 0 ), mBatch( 0 ), mPipeline( 0 ) { }
         
         //! Destructor
-        virtual ~ConverterSosi2psql() { }
+        virtual ~ConverterSosi2psql() { delete mBatch; }
 
         //! Initialize converter
         /*!
@@ -326,6 +404,66 @@ namespace sosicon {
          */
         virtual void run( bool* cancel = 0x00 );
 
+        //! Receive feature from parser
+        /*!
+            Passes each completed PUNKT, TEKST, KURVE and FLATE element on to
+            one of the insertion routines.
+            \param e Feature event holding the element.
+            \see sosicon::ConverterSosi2psql::insertPoint()
+            \see sosicon::ConverterSosi2psql::insertLineString()
+            \see sosicon::ConverterSosi2psql::insertPolygon()
+         */
+        virtual void onEvent( FeatureEvent& e, EventDispatcher<FeatureEvent>& );
+
+        //! Build LINESTRING geometry expression
+        /*!
+            Static and public, so bench/bench_suite.cpp can time it on its own.
+            \param cc Coordinates of the line.
+            \param sridSource Spatial reference grid ID for the source file.
+            \param sridDest Spatial reference grid ID for the target file.
+            \return ST_Transform() expression for the line.
+        */
+        static std::string lineStringExpression( CoordinateCollection& cc,
+                                                 std::string sridSource,
+                                                 std::string sridDest );
+
+        //! Build POLYGON geometry expression
+        /*!
+            \param cc Coordinates of the polygon, holes included.
+            \param sridSource Spatial reference grid ID for the source file.
+            \param sridDest Spatial reference grid ID for the target file.
+            \return ST_Transform() expression for the polygon.
+        */
+        static std::string polygonExpression( CoordinateCollection& cc,
+                                              std::string sridSource,
+                                              std::string sridDest );
+
+        //! Build LINESTRING geometry expression
+        /*!
+            \param geom Coordinates of the line, as east, north pairs.
+            \param sridSource Spatial reference grid ID for the source file.
+            \param sridDest Spatial reference grid ID for the target file.
+            \return ST_Transform() expression for the line.
+        */
+        static std::string lineStringExpression( const geometry::PointArray& geom,
+                                                 const std::string& sridSource,
+                                                 const std::string& sridDest );
+
+        //! Build POLYGON geometry expression
+        /*!
+            \param geom Outer ring, as east, north pairs.
+            \param holes Holes, closed, as east, north pairs.
+            \param holeSizes Points per hole.
+            \param sridSource Spatial reference grid ID for the source file.
+            \param sridDest Spatial reference grid ID for the target file.
+            \return ST_Transform() expression for the polygon.
+        */
+        static std::string polygonExpression( const geometry::PointArray& geom,
+                                              const geometry::PointArray& holes,
+                                              const std::vector<int>& holeSizes,
+                                              const std::string& sridSource,
+                                              const std::string& sridDest );
+
     }; // class ConverterSosi2tsv
    /*! @} end group converters */
     
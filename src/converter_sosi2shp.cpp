@@ -17,9 +17,90 @@
  */
 #include "converter_sosi2shp.h"
 
+sosicon::ConverterSosi2shp::WriteJob::
+WriteJob( shape::Shapefile* shp, const std::string& basePath, bool sync ) {
+    mShapefile = shp;
+    mBasePath = basePath;
+    mSync = sync;
+    std::stringstream ss;
+    ss << *( static_cast<IShapefilePrjPart*>( shp ) );
+    mPrj = ss.str();
+}
+
+void sosicon::ConverterSosi2shp::WriteJob::
+run() {
+    writeFile<IShapefileShpPart>( 0, "shp" );
+    writeFile<IShapefileShxPart>( 1, "shx" );
+    writeFile<IShapefileDbfPart>( 2, "dbf" );
+    mFileNames[ 3 ] = mBasePath + ".prj";
+    mWritten[ 3 ] = mFiles[ 3 ].open( mFileNames[ 3 ] );
+    if( mWritten[ 3 ] ) {
+        std::ostream os( &mFiles[ 3 ] );
+        os << mPrj;
+    }
+    for( int i = 0; i < 4; i++ ) {
+        mWritten[ i ] = mFiles[ i ].close( mSync ) && mWritten[ i ];
+    }
+}
+
+void sosicon::ConverterSosi2shp::WriteJob::
+complete() {
+    for( int i = 0; i < 4; i++ ) {
+        if( mWritten[ i ] ) {
+            std::cout << "    > " << mFileNames[ i ] << " written\n";
+        }
+        else {
+            std::cout << "    > " << mFileNames[ i ] << " could not be written\n";
+        }
+    }
+}
+
 void sosicon::ConverterSosi2shp::
-makeShp( ISosiElement* sosiTree, bool* cancel ) {
+makeLayers( ISosiElement* sosiTree, const std::string& objType, sosi::ElementType geometry,
+            const std::string& layerName, Pipeline& pipeline ) {
+
+    std::vector<double> tolerances;
+    if( geometry == sosi::sosi_element_curve || geometry == sosi::sosi_element_surface ) {
+        tolerances = mCmd->mSimplify;
+    }
+    if( tolerances.empty() ) {
+        tolerances.push_back( 0 );
+    }
 
+    sosi::SosiTranslationTable ttbl;
+    std::string geometryName = ttbl.sosiTypeToName( geometry );
+
+    for( std::vector<double>::iterator t = tolerances.begin(); t != tolerances.end(); t++ ) {
+
+        shape::Shapefile* f = new shape::Shapefile();
+        if( !mCmd->mFilterSosiId.empty() ) {
+            f->filterSosiId( mCmd->mFilterSosiId );
+        }
+        f->setTolerance( *t, mCmd->mSimplifyTopology );
+
+        std::string name = layerName;
+        if( tolerances.size() > 1 && *t > 0 ) {
+            name += utils::simplifySuffix( *t );
+        }
+        std::string basePath = makeBasePath( name );
+
+        int count = f->build( sosiTree, objType, geometry );
+
+        if( count > 0 ) {
+            sosicon::logstream << "  (" << count << " elements of type " << geometryName << ")\n";
+            pipeline.submit( new WriteJob( f, basePath, mCmd->mSyncOutput ) );
+        }
+        else {
+            delete f;
+            break; // Simplification never adds elements
+        }
+    }
+}
+
+void sosicon::ConverterSosi2shp::
+makeShp( ISosiElement* sosiTree, Pipeline& pipeline, bool* cancel ) {
+
+    Profiler::Scope scope( Profiler::stage_convert );
     sosi::SosiTranslationTable ttbl;
 
     std::map<std::string,int> objTypes;
@@ -28,7 +109,7 @@ makeShp( ISosiElement* sosiTree, bool* cancel ) {
 
     while( sosiTree->getChild( src ) ) {
         ISosiElement* sosi = src.element();
-        std::string objType = sosi->getObjType();
+        const std::string& objType = sosi->getObjType();
         if( !objType.empty() ) {
             if( objTypes.find( objType ) == objTypes.end() ) {
                 objTypes[ objType ] = 1;
@@ -59,18 +140,16 @@ makeShp( ISosiElement* sosiTree, bool* cancel ) {
             std::string objTypeName = i->first;
             sosicon::logstream << "\rProcessing OBJTYPE " << objTypeName << "\n";
 
-            for( unsigned int j = 0; j < sizeof geometries; j++ ) {
+            for( unsigned int j = 0; j < sizeof geometries / sizeof geometries[ 0 ]; j++ ) {
 
                 if( cancel && *cancel ) {
                     return;
                 }
 
                 sosi::ElementType geometry = geometries[ j ];
-                shape::Shapefile f;
-                if( !mCmd->mFilterSosiId.empty() ) {
-                    f.filterSosiId( mCmd->mFilterSosiId );
+                if( ( sosiTree->getChildTypes() & sosi::elementTypeBit( geometry ) ) == 0 ) {
+                    continue;
                 }
-
                 std::string geometryName = ttbl.sosiTypeToName( geometry );
 
                 std::vector<std::string>& gt = mCmd->mGeomTypes;
@@ -79,17 +158,7 @@ makeShp( ISosiElement* sosiTree, bool* cancel ) {
                     continue;
                 }
 
-                std::string basePath = makeBasePath( objTypeName + "_" + geometryName );
-
-                int count = f.build( sosiTree, i->first, geometry );
-
-                if( count > 0 ) {
-                    sosicon::logstream << "  (" << count << " elements of type " << geometryName << ")\n";
-                    writeFile<IShapefileShpPart>( f, basePath, "shp" );
-                    writeFile<IShapefileShxPart>( f, basePath, "shx" );
-                    writeFile<IShapefileDbfPart>( f, basePath, "dbf" );
-                    writeFile<IShapefilePrjPart>( f, basePath, "prj" );
-                }
+                makeLayers( sosiTree, i->first, geometry, objTypeName + "_" + geometryName, pipeline );
             }
         }
         sosicon::logstream << "\rProcessing OBJTYPEs done\n";
@@ -104,20 +173,11 @@ makeShp( ISosiElement* sosiTree, bool* cancel ) {
                 return;
             }
 
-            shape::Shapefile f;
             sosi::ElementType geometry = geometries[ j ];
-            std::string geometryName = ttbl.sosiTypeToName( geometry );
-            std::string basePath = makeBasePath( geometryName );
-
-            int count = f.build( sosiTree, "", geometry );
-
-            if( count > 0 ) {
-                sosicon::logstream << "  (" << count << " elements of type " << geometryName << ")\n";
-                writeFile<IShapefileShpPart>( f, basePath, "shp" );
-                writeFile<IShapefileShxPart>( f, basePath, "shx" );
-                writeFile<IShapefileDbfPart>( f, basePath, "dbf" );
-                writeFile<IShapefilePrjPart>( f, basePath, "prj" );
+            if( ( sosiTree->getChildTypes() & sosi::elementTypeBit( geometry ) ) == 0 ) {
+                continue;
             }
+            makeLayers( sosiTree, "", geometry, ttbl.sosiTypeToName( geometry ), pipeline );
         }
     }
 }
@@ -172,7 +232,7 @@ makeBasePath( std::string objTypeName ) {
 
 void sosicon::ConverterSosi2shp::
 run( bool* cancel ) {
-    bool userAborted = false;
+    Pipeline pipeline( mCmd );
     for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end() && !( cancel && *cancel ); f++ ) {
         mCurrentSourcefile = *f;
         if( !utils::fileExists( mCurrentSourcefile ) ) {
@@ -181,29 +241,14 @@ run( bool* cancel ) {
         else {
             sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
             Parser p;
-            char ln[ 1024 ];
-            std::ifstream ifs( ( mCurrentSourcefile ).c_str() );
             int n = 0;
-            while( !ifs.eof() ) {
-                if( ++n % 100 == 0 ) {
-                    if( cancel && *cancel ) {
-                        userAborted = true;
-                        break;
-                    }
-                    sosicon::logstream << "\rParsing line " << n;
-                }
-                memset( ln, 0x00, sizeof ln );
-                ifs.getline( ln, sizeof ln );
-                p.ragelParseSosiLine( ln );
-            }
-            p.complete();
-            ifs.close();
-            if( !userAborted ) {
-                sosicon::logstream << "\r" << n << " lines parsed        \n";
+            if( pipeline.parse( mCurrentSourcefile, p, n, cancel ) ) {
                 sosicon::logstream << "Building shape file...\n";
                 ISosiElement* root = p.getRootElement();
-                makeShp( root, cancel );
+                makeShp( root, pipeline, cancel );
+                pipeline.drain(); // Next file may reuse the same base paths
             }
         }
     }
+    pipeline.finish();
 }
@@ -28,6 +28,9 @@
 #include "interface/i_sosi_element.h"
 #include "command_line.h"
 #include "parser.h"
+#include "async_file_writer.h"
+#include "pipeline.h"
+#include "interface/i_pipeline_job.h"
 #include "utils.h"
 #include "shape/shapefile.h"
 #if defined( _WIN32 ) || defined( _WIN64 )
@@ -59,35 +62,80 @@ namespace sosicon {
      */
     class ConverterSosi2shp : public IConverter {
 
-        //! Save specific shapefile part
+        //! Shapefile output job
         /*!
-            The shapefile format consists of several files. Use corresponding interface to cast
-            a instance of IShapefile to the correct file part for writing. The shapefile parts
-            interfaces are:
+            Writes the parts of a finished shapefile on the pipeline's writer thread, while the
+            converter builds the next one. The shapefile format consists of several files. Use
+            corresponding interface to cast a instance of IShapefile to the correct file part
+            for writing. The shapefile parts interfaces are:
 
             - IShapefileShpPart
             - IShapefileShxPart
             - IShapefileDbfPart
             - IShapefilePrjPart
 
-            \param shp Reference to the source ShapeFile instance.
-            \param basePath Path and file title for the file to be written, without extension.
-            \param extension additional file extensions to be appended before the main extension,
-                   which is one of the following:
-                   - shp (shapefile part)
-                   - shx (index part)
-                   - dbf (attributes part)
-                   - prj (projection part)
-        */
-        template<typename T>
-        void writeFile( shape::Shapefile& shp, std::string basePath, std::string extension ) {
-            std::ofstream fs;
-            std::string fileName = basePath + "." + extension;
-            fs.open( fileName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary );
-            fs << *( static_cast<T*>( &shp ) );
-            fs.close();
-            std::cout << "    > " << fileName << " written\n";
-        }
+            The projection part is rendered when the job is created, since it is read from
+            the element tree, which belongs to the converter thread. All parts are open at
+            the same time, so the I/O thread writes one part while the next is serialized.
+         */
+        class WriteJob : public IPipelineJob {
+
+            //! Shapefile to write, owned by the job
+            shape::Shapefile* mShapefile;
+
+            //! Path and file title for the files to be written, without extension
+            std::string mBasePath;
+
+            //! Projection part content
+            std::string mPrj;
+
+            //! Flush written files to disk
+            bool mSync;
+
+            //! Output files, one for each part
+            AsyncFileWriter mFiles[ 4 ];
+
+            //! File names, one for each part
+            std::string mFileNames[ 4 ];
+
+            //! Write status, one for each part
+            bool mWritten[ 4 ];
+
+            //! Save specific shapefile part
+            /*!
+                \param part Index of the part in mFiles.
+                \param extension File extension of the part, one of shp, shx or dbf.
+            */
+            template<typename T>
+            void writeFile( int part, std::string extension ) {
+                mFileNames[ part ] = mBasePath + "." + extension;
+                mWritten[ part ] = mFiles[ part ].open( mFileNames[ part ] );
+                if( mWritten[ part ] ) {
+                    std::ostream os( &mFiles[ part ] );
+                    os << *( static_cast<T*>( mShapefile ) );
+                }
+            }
+
+        public:
+
+            //! Constructor
+            /*!
+                \param shp Finished shapefile. The job takes ownership.
+                \param basePath Path and file title for the files to be written.
+                \param sync Flush written files to disk, see AsyncFileWriter::close().
+             */
+            WriteJob( shape::Shapefile* shp, const std::string& basePath, bool sync );
+
+            //! Destructor
+            virtual ~WriteJob() { delete mShapefile; }
+
+            //! Write shapefile parts
+            virtual void run();
+
+            //! Report written files
+            virtual void complete();
+
+        }; // class WriteJob
 
         //! Command line wrapper
         CommandLine* mCmd;
@@ -95,7 +143,22 @@ namespace sosicon {
         //! Souce file currently in process
         std::string mCurrentSourcefile;
 
-        void makeShp( ISosiElement* sosiTree, bool* cancel );
+        void makeShp( ISosiElement* sosiTree, Pipeline& pipeline, bool* cancel );
+
+        //! Build and submit the shapefiles of one layer
+        /*!
+            Builds one shapefile per simplification tolerance given on the command line, or
+            a single unsimplified one if there are none. Points are never simplified, and
+            get a single layer. With several tolerances, the file
+            names of the simplified layers get a suffix from utils::simplifySuffix().
+            \param sosiTree Root element of the parsed source.
+            \param objType OBJTYPE to export, empty for all.
+            \param geometry Geometry type to export.
+            \param layerName Base file name of the layer, see makeBasePath().
+            \param pipeline Pipeline receiving the write jobs.
+        */
+        void makeLayers( ISosiElement* sosiTree, const std::string& objType, sosi::ElementType geometry,
+                         const std::string& layerName, Pipeline& pipeline );
 
         //! Make base file path for destination files
         /*!
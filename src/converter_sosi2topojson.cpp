@@ -0,0 +1,364 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "converter_sosi2topojson.h"
+
+int sosicon::ConverterSosi2topojson::
+getArc( ISosiElement* curve ) {
+    const std::string& serial = curve->getSerial();
+    if( !serial.empty() ) {
+        std::unordered_map<std::string, int>::iterator i = mArcIndex.find( serial );
+        if( i != mArcIndex.end() ) {
+            return i->second;
+        }
+    }
+    int index = static_cast<int>( mArcArea.size() );
+    CurveView view = CurveCache::getInstance()->get( curve, false, mTolerance );
+    std::size_t start = mArcPoints.size() / 2;
+    view.appendTo( mArcPoints );
+    std::size_t end = mArcPoints.size() / 2;
+    double area = 0;
+    for( std::size_t p = start + 1; p < end; p++ ) {
+        area -= ( mArcPoints[ 2 * p ] - mArcPoints[ 2 * p - 2 ] ) * ( mArcPoints[ 2 * p + 1 ] + mArcPoints[ 2 * p - 1 ] );
+    }
+    mArcStart.push_back( end );
+    mArcArea.push_back( area );
+    if( !serial.empty() ) {
+        mArcIndex[ serial ] = index;
+    }
+    return index;
+}
+
+double sosicon::ConverterSosi2topojson::
+ringArea( const Ring& ring ) {
+    double area = 0;
+    for( Ring::const_iterator i = ring.begin(); i != ring.end(); i++ ) {
+        area += *i < 0 ? -mArcArea[ ~*i ] : mArcArea[ *i ];
+    }
+    return area;
+}
+
+void sosicon::ConverterSosi2topojson::
+reverseRing( Ring& ring ) {
+    std::reverse( ring.begin(), ring.end() );
+    for( Ring::iterator i = ring.begin(); i != ring.end(); i++ ) {
+        *i = ~*i;
+    }
+}
+
+bool sosicon::ConverterSosi2topojson::
+ringInside( const Ring& ring, const Ring& outer ) {
+    if( ring.empty() ) {
+        return false;
+    }
+    int arc = ring.front();
+    std::size_t first = arc < 0 ? mArcStart[ ~arc + 1 ] - 1 : mArcStart[ arc ];
+    double xmin = +9999999999, ymin = +9999999999, xmax = -9999999999, ymax = -9999999999;
+    for( Ring::const_iterator i = outer.begin(); i != outer.end(); i++ ) {
+        int a = *i < 0 ? ~*i : *i;
+        geometry::expandBoundingBox( &mArcPoints[ 2 * mArcStart[ a ] ], mArcStart[ a + 1 ] - mArcStart[ a ],
+                                     xmin, ymin, xmax, ymax );
+    }
+    double x = mArcPoints[ 2 * first ];
+    double y = mArcPoints[ 2 * first + 1 ];
+    return x >= xmin && x <= xmax && y >= ymin && y <= ymax;
+}
+
+void sosicon::ConverterSosi2topojson::
+makePolygon( ISosiElement* surface, Geometry& g ) {
+
+    Profiler::Scope scope( Profiler::stage_refs );
+    std::vector<Ring> outers;
+    std::vector<Ring> holes;
+
+    sosi::SosiElementSearch srcRef( sosi::sosi_element_ref );
+    while( surface->getChild( srcRef ) ) {
+        ISosiElement* rawRefElement = srcRef.element();
+        sosi::SosiRefList refList( rawRefElement );
+        sosi::GeometryRef* geometry = 0;
+        while( refList.getNextGeometry( geometry ) ) {
+            if( geometry->empty() ) {
+                continue;
+            }
+            // The reference parser stores the references of a ring last to first
+            Ring ring;
+            for( sosi::GeometryRef::reverse_iterator i = geometry->rbegin(); i != geometry->rend(); i++ ) {
+                ISosiElement* curve = rawRefElement->find( ( *i )->serial );
+                if( curve ) {
+                    int arc = getArc( curve );
+                    ring.push_back( ( *i )->reverse ? ~arc : arc );
+                }
+            }
+            if( ring.empty() ) {
+                continue;
+            }
+            bool hole = ( *geometry )[ 0 ]->subtract;
+            if( ( ringArea( ring ) < 0 ) != hole ) {
+                reverseRing( ring );
+            }
+            ( hole ? holes : outers ).push_back( ring );
+        }
+    }
+
+    for( std::vector<Ring>::iterator i = outers.begin(); i != outers.end(); i++ ) {
+        g.polygons.push_back( Polygon( 1, *i ) );
+    }
+    for( std::vector<Ring>::iterator i = holes.begin(); i != holes.end(); i++ ) {
+        if( g.polygons.empty() ) {
+            g.polygons.push_back( Polygon() );
+        }
+        std::vector<Polygon>::size_type owner = 0;
+        for( std::vector<Polygon>::size_type j = 0; g.polygons.size() > 1 && j < g.polygons.size(); j++ ) {
+            if( ringInside( *i, g.polygons[ j ].front() ) ) {
+                owner = j;
+                break;
+            }
+        }
+        g.polygons[ owner ].push_back( *i );
+    }
+}
+
+void sosicon::ConverterSosi2topojson::
+extractProperties( ISosiElement* parent, std::string& props ) {
+
+    sosi::SosiElementSearch srcData;
+    while( parent->getChild( srcData ) ) {
+
+        ISosiElement* dataElement = srcData.element();
+        sosi::ElementType type = dataElement->getType();
+        if( type == sosi::sosi_element_ne || type == sosi::sosi_element_neh || type == sosi::sosi_element_ref ) {
+            continue;
+        }
+
+        extractProperties( dataElement, props );
+
+        const std::string& data = dataElement->getData();
+        if( data.empty() ) {
+            continue;
+        }
+        std::string key = utils::jsonQuote( utils::iso8859_1ToUtf8( utils::toFieldname( dataElement->getName() ) ) ) + ":";
+        if( props.find( key ) == 0 || props.find( "," + key ) != std::string::npos ) {
+            continue; // First occurrence wins
+        }
+        if( !props.empty() ) {
+            props += ",";
+        }
+        props += key + utils::jsonQuote( toUtf8( utils::unquote( data ) ) );
+    }
+}
+
+std::string sosicon::ConverterSosi2topojson::
+toUtf8( const std::string& str ) {
+    sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+    if( cs->getEncoding() == sosi::sosi_charset_utf8 ) {
+        return str;
+    }
+    return utils::iso8859_1ToUtf8( cs->toIso8859_1( str ) );
+}
+
+bool sosicon::ConverterSosi2topojson::
+objTypeExcluded( ISosiElement* e )
+{
+    std::vector<std::string>& ot = mCmd->mObjTypes;
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
+void sosicon::ConverterSosi2topojson::
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
+
+    ISosiElement* e = event.mFeature;
+
+    if( objTypeExcluded( e ) ) {
+        return;
+    }
+
+    Geometry g;
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            {
+                DecodedCurve point( e );
+                if( point.getNumPoints() == 0 ) {
+                    return;
+                }
+                g.type = wkt_point;
+                g.e = point.getPoints()[ 0 ];
+                g.n = point.getPoints()[ 1 ];
+            }
+            break;
+        case sosi::sosi_element_curve:
+            g.type = wkt_linestring;
+            g.polygons.push_back( Polygon( 1, Ring( 1, getArc( e ) ) ) );
+            break;
+        case sosi::sosi_element_surface:
+            g.type = wkt_polygon;
+            makePolygon( e, g );
+            break;
+        default:
+            return;
+    }
+    extractProperties( e, g.properties );
+
+    std::string name = e->getObjType().empty() ? "sosi" : toUtf8( e->getObjType() );
+    mObjects[ name ].push_back( g );
+}
+
+void sosicon::ConverterSosi2topojson::
+writeArcs( std::ostream& os, double x0, double y0, double kx, double ky ) {
+    os << "\"arcs\":[";
+    for( std::vector<double>::size_type a = 0; a < mArcArea.size(); a++ ) {
+        os << ( a > 0 ? ",[" : "[" );
+        long px = 0, py = 0;
+        std::size_t written = 0;
+        std::size_t end = mArcStart[ a + 1 ];
+        for( std::size_t p = mArcStart[ a ]; p < end; p++ ) {
+            long qx = static_cast<long>( std::floor( ( mArcPoints[ 2 * p ] - x0 ) / kx + 0.5 ) );
+            long qy = static_cast<long>( std::floor( ( mArcPoints[ 2 * p + 1 ] - y0 ) / ky + 0.5 ) );
+            // Points falling on the same grid cell are dropped, but every arc keeps two
+            if( written > 0 && qx == px && qy == py && !( written == 1 && p + 1 == end ) ) {
+                continue;
+            }
+            os << ( written > 0 ? ",[" : "[" ) << qx - px << "," << qy - py << "]";
+            px = qx;
+            py = qy;
+            written++;
+        }
+        os << "]";
+    }
+    os << "]";
+}
+
+void sosicon::ConverterSosi2topojson::
+writeGeometry( std::ostream& os, const Geometry& g, double x0, double y0, double kx, double ky ) {
+    switch( g.type ) {
+        case wkt_point:
+            os << "{\"type\":\"Point\",\"coordinates\":["
+               << static_cast<long>( std::floor( ( g.e - x0 ) / kx + 0.5 ) ) << ","
+               << static_cast<long>( std::floor( ( g.n - y0 ) / ky + 0.5 ) ) << "]";
+            break;
+        case wkt_linestring:
+            os << "{\"type\":\"LineString\",\"arcs\":[" << g.polygons[ 0 ][ 0 ][ 0 ] << "]";
+            break;
+        case wkt_polygon:
+            if( g.polygons.empty() ) {
+                os << "{\"type\":null";
+                break;
+            }
+            os << ( g.polygons.size() > 1 ? "{\"type\":\"MultiPolygon\",\"arcs\":[" : "{\"type\":\"Polygon\",\"arcs\":" );
+            for( std::vector<Polygon>::const_iterator p = g.polygons.begin(); p != g.polygons.end(); p++ ) {
+                os << ( p != g.polygons.begin() ? ",[" : "[" );
+                for( Polygon::const_iterator r = p->begin(); r != p->end(); r++ ) {
+                    os << ( r != p->begin() ? ",[" : "[" );
+                    for( Ring::const_iterator a = r->begin(); a != r->end(); a++ ) {
+                        os << ( a != r->begin() ? "," : "" ) << *a;
+                    }
+                    os << "]";
+                }
+                os << "]";
+            }
+            os << ( g.polygons.size() > 1 ? "]" : "" );
+            break;
+        default:
+            ;
+    }
+    os << ",\"properties\":{" << g.properties << "}}";
+}
+
+void sosicon::ConverterSosi2topojson::
+writeTopoJson() {
+
+    Profiler::Scope scope( Profiler::stage_write );
+    double xmin = +9999999999, ymin = +9999999999, xmax = -9999999999, ymax = -9999999999;
+    geometry::expandBoundingBox( mArcPoints.data(), mArcPoints.size() / 2, xmin, ymin, xmax, ymax );
+    for( std::map<std::string, GeometryList>::iterator o = mObjects.begin(); o != mObjects.end(); o++ ) {
+        for( GeometryList::iterator g = o->second.begin(); g != o->second.end(); g++ ) {
+            if( g->type == wkt_point ) {
+                xmin = std::min( xmin, g->e );
+                ymin = std::min( ymin, g->n );
+                xmax = std::max( xmax, g->e );
+                ymax = std::max( ymax, g->n );
+            }
+        }
+    }
+    if( xmin > xmax ) {
+        xmin = ymin = xmax = ymax = 0;
+    }
+    double kx = xmax > xmin ? ( xmax - xmin ) / ( DEFAULT_QUANTIZATION - 1 ) : 1;
+    double ky = ymax > ymin ? ( ymax - ymin ) / ( DEFAULT_QUANTIZATION - 1 ) : 1;
+
+    AsyncFileWriter out;
+    std::string defaultOutputFile = mCmd->mOutputFile.empty() ? "sosicon.topojson" : mCmd->mOutputFile;
+    std::string fileName = utils::nonExistingFilename( defaultOutputFile );
+    sosicon::logstream << "    > Converting SOSI data to TopoJSON...\n";
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream os( &out );
+    os.precision( 15 );
+    os << "{\"type\":\"Topology\","
+       << "\"bbox\":[" << xmin << "," << ymin << "," << xmax << "," << ymax << "],"
+       << "\"transform\":{\"scale\":[" << kx << "," << ky << "],\"translate\":[" << xmin << "," << ymin << "]},"
+       << "\"objects\":{";
+    for( std::map<std::string, GeometryList>::iterator o = mObjects.begin(); o != mObjects.end(); o++ ) {
+        os << ( o != mObjects.begin() ? ",\n" : "\n" )
+           << utils::jsonQuote( o->first ) << ":{\"type\":\"GeometryCollection\",\"geometries\":[";
+        for( GeometryList::iterator g = o->second.begin(); g != o->second.end(); g++ ) {
+            os << ( g != o->second.begin() ? ",\n" : "\n" );
+            writeGeometry( os, *g, xmin, ymin, kx, ky );
+        }
+        os << "]}";
+    }
+    os << "},\n";
+    writeArcs( os, xmin, ymin, kx, ky );
+    os << "}\n";
+
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written (" << mArcArea.size() << " arcs)\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
+    }
+}
+
+void sosicon::ConverterSosi2topojson::
+run( bool* ) {
+
+    mTolerance = mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front();
+    mArcStart.assign( 1, 0 );
+
+    Pipeline pipeline( mCmd );
+    for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end(); f++ ) {
+        mCurrentSourcefile = *f;
+        if( !utils::fileExists( mCurrentSourcefile ) ) {
+            sosicon::logstream << mCurrentSourcefile << " not found\n";
+        }
+        else {
+            sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            sosicon::logstream << "Building TopoJSON export...\n";
+            mArcIndex.clear(); // Serial numbers are unique within a file only
+            Parser p;
+            p.addFeatureListener( this );
+            int n = 0;
+            pipeline.parse( mCurrentSourcefile, p, n );
+        }
+    }
+    Profiler::endFile(); // Output covers all files
+    writeTopoJson();
+    pipeline.finish();
+    sosicon::logstream << "Done!\n";
+}
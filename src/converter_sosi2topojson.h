@@ -0,0 +1,192 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __CONVERTER_SOSI2TOPOJSON_H__
+#define __CONVERTER_SOSI2TOPOJSON_H__
+
+#include "logger.h"
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+#include "interface/i_converter.h"
+#include "interface/i_sosi_element.h"
+#include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_ref_list.h"
+#include "sosi/sosi_types.h"
+#include "async_file_writer.h"
+#include "command_line.h"
+#include "common_types.h"
+#include "curve_cache.h"
+#include "geometry_kernels.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "feature_event.h"
+
+namespace sosicon {
+
+    /*!
+        \addtogroup converters
+        @{
+    */
+    //! SOSI to TopoJSON converter
+    /*!
+        If command-line parameter -2topojson is specified, this converter will handle the
+        output generation. Produces one TopoJSON file from the SOSI source(s), with one
+        object per OBJTYPE.
+
+        SOSI surfaces are already built from shared curves: a FLATE lists the serial numbers
+        of the KURVE elements around it, with a minus sign for curves that run the other way.
+        This maps directly onto TopoJSON, where a polygon lists the indexes of its arcs and
+        reversed arcs are given as ~index. Each curve is therefore written once, as one arc,
+        no matter how many features use it.
+
+        Arcs are quantized and delta-encoded when the file is written, since the transform
+        depends on the extent of all sources. Features are received one at a time from the
+        parser, and only their arc indexes and properties are kept until then.
+     */
+    class ConverterSosi2topojson : public IConverter, public FeatureEventDispatcher::Listener {
+
+        //! Default number of quantization steps along each axis
+        static const long DEFAULT_QUANTIZATION = 1000000;
+
+        //! Arc indexes of one ring. Reversed arcs are stored as ~index.
+        typedef std::vector<int> Ring;
+
+        //! Outer ring first, then holes
+        typedef std::vector<Ring> Polygon;
+
+        //! Converted feature
+        struct Geometry {
+            Wkt type;                         //!< Point, linestring or polygon
+            double e;                         //!< East, for points
+            double n;                         //!< North, for points
+            std::vector<Polygon> polygons;    //!< Arcs of a line or the rings of polygons
+            std::string properties;           //!< Attributes as a JSON object
+        };
+
+        typedef std::vector<Geometry> GeometryList;
+
+        //! Command line wrapper
+        CommandLine* mCmd;
+
+        //! Souce file currently in process
+        std::string mCurrentSourcefile;
+
+        //! Features by OBJTYPE
+        std::map<std::string, GeometryList> mObjects;
+
+        //! Coordinates of all arcs, as east, north pairs
+        geometry::PointArray mArcPoints;
+
+        //! Index of the first point of each arc in mArcPoints. Ends with the total.
+        std::vector<std::size_t> mArcStart;
+
+        //! Twice the signed area each arc adds to a ring it is part of
+        std::vector<double> mArcArea;
+
+        //! Arc index by curve serial number, for the current source file
+        std::unordered_map<std::string, int> mArcIndex;
+
+        //! Simplification tolerance for arcs, or 0
+        double mTolerance;
+
+        //! Get arc index of a curve, adding the curve as a new arc if needed
+        /*!
+            \param curve KURVE element.
+            \return Index of the arc.
+        */
+        int getArc( ISosiElement* curve );
+
+        //! Twice the signed area of a ring, positive if counter-clockwise
+        double ringArea( const Ring& ring );
+
+        //! Reverse ring direction
+        void reverseRing( Ring& ring );
+
+        //! Test if the first point of ring lies within the bounding box of another
+        bool ringInside( const Ring& ring, const Ring& outer );
+
+        //! Convert FLATE feature
+        /*!
+            Builds rings from the REF lists of the surface. Outer rings are made
+            counter-clockwise and holes clockwise, as in GeoJSON. If the surface has more
+            than one outer ring, each hole goes with the first outer ring that contains it.
+            \param surface FLATE element.
+            \param g Geometry to receive the rings.
+        */
+        void makePolygon( ISosiElement* surface, Geometry& g );
+
+        //! Collect attributes of a feature as a JSON object
+        /*!
+            Nested elements are flattened, as in the database exports. Coordinates and
+            references are left out.
+            \param parent Feature element.
+            \param props Receives the members, separated by commas.
+        */
+        void extractProperties( ISosiElement* parent, std::string& props );
+
+        //! Convert string from the SOSI file's character set to UTF-8
+        std::string toUtf8( const std::string& str );
+
+        //! Test if current element is filtered out by -t parameter
+        bool objTypeExcluded( ISosiElement* e );
+
+        //! Write quantized, delta-encoded arcs
+        void writeArcs( std::ostream& os, double x0, double y0, double kx, double ky );
+
+        //! Write one feature
+        void writeGeometry( std::ostream& os, const Geometry& g, double x0, double y0, double kx, double ky );
+
+        //! Write TopoJSON file
+        void writeTopoJson();
+
+    public:
+
+        //! Constructor
+        ConverterSosi2topojson() : mCmd( 0 ), mTolerance( 0 ) { }
+
+        //! Destructor
+        virtual ~ConverterSosi2topojson() { }
+
+        //! Initialize converter
+        /*!
+            Implementation details in sosicon::IConverter::init()
+            \sa sosicon::IConverter::init()
+         */
+        virtual void init( CommandLine* cmd ) { mCmd = cmd; }
+
+        //! Receive feature from parser
+        virtual void onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& dispatcher );
+
+        //! Start conversion
+        /*!
+            Implementation details in sosicon::IConverter::run()
+            \sa sosicon::IConverter::run()
+         */
+        virtual void run( bool* cancel = 0x00 );
+
+    }; // class ConverterSosi2topojson
+   /*! @} end group converters */
+
+}; // namespace sosicon
+
+#endif
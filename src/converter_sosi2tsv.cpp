@@ -17,7 +17,479 @@
  */
 #include "converter_sosi2tsv.h"
 
+namespace {
+
+    //! Convert string from the SOSI file's character set to UTF-8
+    std::string toUtf8( const std::string& str ) {
+        sosicon::sosi::SosiCharsetSingleton* cs = sosicon::sosi::SosiCharsetSingleton::getInstance();
+        if( cs->getEncoding() == sosicon::sosi::sosi_charset_utf8 ) {
+            return str;
+        }
+        return sosicon::utils::iso8859_1ToUtf8( cs->toIso8859_1( str ) );
+    }
+
+    //! Append number with a fixed number of decimals
+    /*!
+        Coordinates are stored in whole multiples of the file's ENHET, so rounding to the
+        matching number of decimals is exact. Avoids the locale and stream overhead of
+        std::ostream, which dominates the export time otherwise.
+    */
+    void appendNumber( std::string& out, double v, int decimals ) {
+        static const double scales[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+        double scale = scales[ decimals ];
+        if( !( std::fabs( v ) * scale < 9e15 ) ) {
+            char buf[ 64 ];
+            int n = std::snprintf( buf, sizeof buf, "%.*f", decimals, v );
+            out.append( buf, n > 0 ? n : 0 );
+            return;
+        }
+        long long q = std::llround( v * scale );
+        if( q < 0 ) {
+            out += '-';
+            q = -q;
+        }
+        char buf[ 32 ];
+        char* p = buf + sizeof buf;
+        for( int i = 0; i < decimals; i++ ) {
+            *--p = static_cast<char>( '0' + q % 10 );
+            q /= 10;
+        }
+        if( decimals > 0 ) {
+            *--p = '.';
+        }
+        do {
+            *--p = static_cast<char>( '0' + q % 10 );
+            q /= 10;
+        } while( q > 0 );
+        out.append( p, buf + sizeof buf - p );
+    }
+
+    //! Append WKT coordinate list, without parentheses
+    void appendPoints( std::string& out, const double* xy, int count, int decimals ) {
+        for( int i = 0; i < count; i++ ) {
+            if( i > 0 ) {
+                out += ',';
+            }
+            appendNumber( out, xy[ 2 * i ], decimals );
+            out += ' ';
+            appendNumber( out, xy[ 2 * i + 1 ], decimals );
+        }
+    }
+
+    //! Append text field, escaped for TSV or CSV
+    void appendField( std::string& out, const char* s, std::size_t size, bool csv ) {
+        if( csv ) {
+            const char* special = static_cast<const char*>( 0 );
+            for( std::size_t i = 0; i < size && !special; i++ ) {
+                char ch = s[ i ];
+                if( ch == ',' || ch == '"' || ch == '\n' || ch == '\r' ) {
+                    special = s + i;
+                }
+            }
+            if( !special ) {
+                out.append( s, size );
+                return;
+            }
+            out += '"';
+            for( std::size_t i = 0; i < size; i++ ) {
+                if( s[ i ] == '"' ) {
+                    out += '"';
+                }
+                out += s[ i ];
+            }
+            out += '"';
+            return;
+        }
+        std::size_t start = 0;
+        for( std::size_t i = 0; i < size; i++ ) {
+            const char* escape;
+            switch( s[ i ] ) {
+                case '\t': escape = "\\t"; break;
+                case '\n': escape = "\\n"; break;
+                case '\r': escape = "\\r"; break;
+                case '\\': escape = "\\\\"; break;
+                default: continue;
+            }
+            out.append( s + start, i - start );
+            out.append( escape, 2 );
+            start = i + 1;
+        }
+        out.append( s + start, size - start );
+    }
+
+    //! Append field from string
+    void appendField( std::string& out, const std::string& s, bool csv ) {
+        appendField( out, s.data(), s.size(), csv );
+    }
+
+}; // namespace
+
+void sosicon::ConverterSosi2tsv::ChunkJob::
+run() {
+
+    Profiler::Scope scope( Profiler::stage_write );
+    const Batch& b = *mBatch;
+    bool csv = mLayout->csv;
+    bool wkb = mLayout->wkb;
+    char separator = csv ? ',' : '\t';
+    std::string geometry;
+    WkbWriter wkbWriter;
+
+    for( std::size_t r = mFrom; r < mTo; r++ ) {
+
+        std::size_t part = b.partStart[ r ];
+        std::size_t parts = b.partStart[ r + 1 ] - part;
+        const int* sizes = parts > 0 ? &b.sizes[ part ] : 0;
+        const double* xy = b.coords.empty() ? 0 : &b.coords[ 0 ] + 2 * b.vertexStart[ r ];
+
+        geometry.clear();
+        switch( b.types[ r ] ) {
+            case wkt_point:
+                if( wkb ) {
+                    wkbWriter.point( parts > 0 ? xy : 0 );
+                }
+                else if( parts > 0 ) {
+                    geometry += "POINT(";
+                    appendPoints( geometry, xy, 1, b.decimals );
+                    geometry += ')';
+                }
+                else {
+                    geometry += "POINT EMPTY";
+                }
+                break;
+            case wkt_linestring:
+                if( wkb ) {
+                    wkbWriter.lineString( xy, parts > 0 ? sizes[ 0 ] : 0 );
+                }
+                else if( parts > 0 && sizes[ 0 ] > 0 ) {
+                    geometry += "LINESTRING(";
+                    appendPoints( geometry, xy, sizes[ 0 ], b.decimals );
+                    geometry += ')';
+                }
+                else {
+                    geometry += "LINESTRING EMPTY";
+                }
+                break;
+            default:
+                {
+                    // Each outer ring starts a polygon, followed by its holes
+                    std::size_t polygons = 0;
+                    for( std::size_t i = 0; i < parts; i++ ) {
+                        polygons += sizes[ i ] > 0 ? 1 : 0;
+                    }
+                    bool multi = polygons > 1;
+                    if( wkb ) {
+                        wkbWriter.polygon( xy, sizes, parts );
+                    }
+                    else if( polygons == 0 ) {
+                        geometry += "POLYGON EMPTY";
+                    }
+                    else {
+                        geometry += multi ? "MULTIPOLYGON(" : "POLYGON";
+                        for( std::size_t i = 0; i < parts; i++ ) {
+                            int n = std::abs( sizes[ i ] );
+                            if( sizes[ i ] > 0 ) {
+                                geometry += i > 0 ? ",((" : "((";
+                            }
+                            else {
+                                geometry += ",(";
+                            }
+                            appendPoints( geometry, xy, n, b.decimals );
+                            geometry += ')';
+                            xy += 2 * n;
+                            if( i + 1 == parts || sizes[ i + 1 ] > 0 ) {
+                                geometry += ')';
+                            }
+                        }
+                        if( multi ) {
+                            geometry += ')';
+                        }
+                    }
+                }
+        }
+        if( wkb ) {
+            mText += wkbWriter.data();
+            wkbWriter.clear();
+        }
+        else {
+            appendField( mText, geometry, csv );
+        }
+
+        std::size_t v = b.valueStart[ r ];
+        std::size_t end = b.valueStart[ r + 1 ];
+        for( std::size_t c = 0; c < mLayout->columns; c++ ) {
+            mText += separator;
+            if( v < end && b.columns[ v ] == c ) {
+                std::size_t from = v > 0 ? b.valueEnd[ v - 1 ] : 0;
+                appendField( mText, b.text.data() + from, b.valueEnd[ v ] - from, csv );
+                v++;
+            }
+        }
+        mText += '\n';
+    }
+}
+
+void sosicon::ConverterSosi2tsv::BatchJob::
+run() {
+    std::vector<IPipelineJob*> jobs;
+    for( std::size_t r = 0; r < mBatch->rows(); r += CHUNK_SIZE ) {
+        jobs.push_back( new ChunkJob( mBatch, mLayout, r, std::min( r + CHUNK_SIZE, mBatch->rows() ), mOut ) );
+    }
+    mPool->run( jobs );
+    for( std::vector<IPipelineJob*>::iterator j = jobs.begin(); j != jobs.end(); j++ ) {
+        delete *j;
+    }
+}
+
+void sosicon::ConverterSosi2tsv::
+checkUnit( ISosiElement* root ) {
+
+    // Path: .HODE/..TRANSPAR/...ENHET
+    sosi::SosiElementSearch srcHead( sosi::sosi_element_head );
+    sosi::SosiElementSearch srcTranspar( sosi::sosi_element_transpar );
+    sosi::SosiElementSearch srcUnit( sosi::sosi_element_unit );
+
+    sosi::SosiUnit unit;
+    if( root &&
+        root->getChild( srcHead ) &&
+        srcHead.element()->getChild( srcTranspar ) &&
+        srcTranspar.element()->getChild( srcUnit ) )
+    {
+        unit.init( srcUnit.element() );
+    }
+    int decimals = static_cast<int>( std::floor( std::log10( static_cast<double>( unit.getDivisor() ) ) + 0.5 ) );
+    mDecimals = std::max( 0, std::min( 9, decimals ) );
+}
+
+void sosicon::ConverterSosi2tsv::
+collect( ISosiElement* parent ) {
+
+    sosi::SosiElementSearch srcData;
+    while( parent->getChild( srcData ) ) {
+
+        ISosiElement* dataElement = srcData.element();
+        sosi::ElementType type = dataElement->getType();
+        if( type == sosi::sosi_element_ne || type == sosi::sosi_element_neh || type == sosi::sosi_element_ref ) {
+            continue;
+        }
+
+        collect( dataElement );
+
+        const std::string& data = dataElement->getData();
+        if( data.empty() ) {
+            continue;
+        }
+        std::string fieldName = utils::iso8859_1ToUtf8( utils::toFieldname( dataElement->getName() ) );
+        if( mDiscover ) {
+            mColumnIndex.insert( std::make_pair( fieldName, 0 ) );
+            continue;
+        }
+        std::map<std::string, std::size_t>::iterator c = mColumnIndex.find( fieldName );
+        if( c == mColumnIndex.end() ) {
+            continue;
+        }
+        std::string value = toUtf8( utils::unquote( data ) );
+        if( mRowSet[ c->second ] ) {
+            mRow[ c->second ] += "|" + value;
+        }
+        else {
+            mRow[ c->second ] = value;
+            mRowSet[ c->second ] = true;
+        }
+    }
+}
+
 void sosicon::ConverterSosi2tsv::
-run( bool* ) {
+append( Wkt type, CoordinateCollection& cc ) {
+
+    if( mBatch->rows() > 0 && mBatch->decimals != mDecimals ) {
+        submitBatch();
+    }
+    Batch& b = *mBatch;
+    b.decimals = mDecimals;
+    b.types.push_back( type );
+
+    const geometry::PointArray& geom = cc.getGeom();
+    switch( type ) {
+        case wkt_point:
+            if( geom.size() >= 2 ) {
+                b.coords.insert( b.coords.end(), geom.begin(), geom.begin() + 2 );
+                b.sizes.push_back( 1 );
+            }
+            break;
+        case wkt_linestring:
+            b.coords.insert( b.coords.end(), geom.begin(), geom.end() );
+            b.sizes.push_back( static_cast<int>( geom.size() / 2 ) );
+            break;
+        default:
+            {
+                geometry::PointArray xy;
+                std::vector<int> sizes;
+                cc.getRings( xy, sizes );
+                b.coords.insert( b.coords.end(), xy.begin(), xy.end() );
+                for( std::vector<int>::iterator s = sizes.begin(); s != sizes.end(); s++ ) {
+                    if( *s != 0 ) {
+                        b.sizes.push_back( *s );
+                    }
+                }
+            }
+    }
+    b.partStart.push_back( b.sizes.size() );
+    b.vertexStart.push_back( b.coords.size() / 2 );
+
+    for( std::size_t c = 0; c < mRow.size(); c++ ) {
+        if( mRowSet[ c ] ) {
+            b.text += mRow[ c ];
+            b.columns.push_back( c );
+            b.valueEnd.push_back( b.text.size() );
+            mRowSet[ c ] = false;
+        }
+    }
+    b.valueStart.push_back( b.columns.size() );
+
+    mRows++;
+    if( b.rows() == BATCH_SIZE ) {
+        submitBatch();
+    }
+}
+
+void sosicon::ConverterSosi2tsv::
+submitBatch() {
+    if( !mBatch || mBatch->rows() == 0 ) {
+        return;
+    }
+    mPipeline->submit( new BatchJob( mBatch, &mLayout, mPool, mOut ) );
+    mBatch = new Batch();
+}
+
+bool sosicon::ConverterSosi2tsv::
+objTypeExcluded( ISosiElement* e )
+{
+    std::vector<std::string>& ot = mCmd->mObjTypes;
+    return ot.size() > 0 && std::find( ot.begin(), ot.end(), utils::toLower( e->getObjType() ) ) == ot.end();
+}
+
+void sosicon::ConverterSosi2tsv::
+onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& ) {
+
+    ISosiElement* e = event.mFeature;
+
+    if( objTypeExcluded( e ) ) {
+        return;
+    }
+
+    Wkt type;
+    switch( e->getType() ) {
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            type = wkt_point;
+            break;
+        case sosi::sosi_element_curve:
+            type = wkt_linestring;
+            break;
+        case sosi::sosi_element_surface:
+            type = wkt_polygon;
+            break;
+        default:
+            return;
+    }
+
+    if( mDiscover ) {
+        mRows++;
+        collect( e );
+        return;
+    }
+    if( mDecimals < 0 ) {
+        checkUnit( e->getRoot() );
+    }
+
+    CoordinateCollection cc( mCmd->mSimplify.empty() ? 0 : mCmd->mSimplify.front(), mCmd->mSimplifyTopology );
+    cc.discoverCoords( e );
+    collect( e );
+    append( type, cc );
+}
+
+void sosicon::ConverterSosi2tsv::
+readSources( bool* cancel ) {
+    Pipeline pipeline( mCmd );
+    mPipeline = &pipeline;
+    for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end() && !( cancel && *cancel ); f++ ) {
+        mCurrentSourcefile = *f;
+        if( !utils::fileExists( mCurrentSourcefile ) ) {
+            if( mDiscover ) {
+                sosicon::logstream << mCurrentSourcefile << " not found\n";
+            }
+        }
+        else {
+            sosicon::logstream << "Reading " << mCurrentSourcefile << "\n";
+            mDecimals = -1;
+            Parser p;
+            p.addFeatureListener( this );
+            int n = 0;
+            pipeline.parse( mCurrentSourcefile, p, n, cancel );
+        }
+    }
+    submitBatch();
+    pipeline.drain();
+    mPipeline = 0;
+    pipeline.finish();
+}
+
+void sosicon::ConverterSosi2tsv::
+run( bool* cancel ) {
+
+    sosicon::logstream << "Building TSV header...\n";
+    mDiscover = true;
+    mRows = 0;
+    readSources( cancel );
+    if( mRows == 0 ) {
+        sosicon::logstream << "Nothing to export\n";
+        return;
+    }
+
+    std::string fileName = utils::nonExistingFilename( mCmd->mOutputFile.empty() ? "sosicon.tsv" : mCmd->mOutputFile );
+    AsyncFileWriter out;
+    if( !out.open( fileName ) ) {
+        sosicon::logstream << "    > " << fileName << " could not be created\n";
+        return;
+    }
+    std::ostream os( &out );
+
+    std::string dir, tit, ext;
+    utils::getPathInfo( fileName, dir, tit, ext );
+    mLayout.csv = utils::toLower( ext ) == ".csv";
+    mLayout.wkb = mCmd->mWkb;
+    mLayout.columns = mColumnIndex.size();
+
+    // Columns follow the geometry in name order, as in the PostGIS tables
+    std::string header;
+    appendField( header, "geometry", mLayout.csv );
+    for( std::map<std::string, std::size_t>::iterator c = mColumnIndex.begin(); c != mColumnIndex.end(); c++ ) {
+        c->second = mRow.size();
+        mRow.push_back( std::string() );
+        header += mLayout.csv ? ',' : '\t';
+        appendField( header, c->first, mLayout.csv );
+    }
+    header += '\n';
+    os.write( header.data(), header.size() );
+    mRowSet.assign( mRow.size(), false );
+
+    sosicon::logstream << "Building TSV export...\n";
+    WorkStealingPool pool;
+    mPool = &pool;
+    mOut = &os;
+    mBatch = new Batch();
+    mDiscover = false;
+    mRows = 0;
+    readSources( cancel );
+    mPool = 0;
+    mOut = 0;
 
+    if( out.close( mCmd->mSyncOutput ) ) {
+        sosicon::logstream << "    > " << fileName << " written (" << mRows << " rows)\n";
+    }
+    else {
+        sosicon::logstream << "    > " << fileName << " could not be written\n";
+    }
+    sosicon::logstream << "Done!\n";
 }
@@ -18,12 +18,32 @@
 #ifndef __CONVERTER_SOSI2TSV_H__
 #define __CONVERTER_SOSI2TSV_H__
 
-#include <iostream>
-#include <fstream>
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
 #include <vector>
+#include "utils.h"
 #include "interface/i_converter.h"
+#include "interface/i_pipeline_job.h"
+#include "interface/i_sosi_element.h"
+#include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_types.h"
+#include "sosi/sosi_unit.h"
+#include "async_file_writer.h"
 #include "command_line.h"
+#include "common_types.h"
+#include "coordinate_collection.h"
 #include "parser.h"
+#include "pipeline.h"
+#include "feature_event.h"
+#include "wkb_writer.h"
+#include "work_stealing_pool.h"
 
 namespace sosicon {
 
@@ -34,27 +54,161 @@ namespace sosicon {
     //! SOSI to TSV converter
     /*!
         If command-line parameter -2tsv is specified, this converter will handle the output
-        generation. Produces a TSV file (tab separated values) SOSI source.
+        generation. Produces one TSV file (tab separated values) from the SOSI source(s), or
+        a CSV file if the output name ends with .csv. The first column holds the geometry as
+        WKT, or as hex-encoded WKB with -wkb, and the attributes follow in name order.
+
+        The header lists every attribute of every feature, so the sources are read twice:
+        the first pass collects the attribute names, and the second captures the rows as they
+        are received from the parser. Rows are handed to the pipeline's writer thread in
+        batches of BATCH_SIZE, where they are formatted in chunks on a WorkStealingPool and
+        appended to the file in source order.
      */
-    class ConverterSosi2tsv : public IConverter {
+    class ConverterSosi2tsv : public IConverter, public FeatureEventDispatcher::Listener {
+
+        //! Number of rows handed to the writer thread at a time
+        static const std::size_t BATCH_SIZE = 16384;
+
+        //! Number of rows formatted by each pool job
+        static const std::size_t CHUNK_SIZE = 1024;
+
+        //! Output layout, shared by all batches
+        struct Layout {
+            bool csv;               //!< RFC 4180 quoting instead of backslash escapes
+            bool wkb;               //!< Hex-encoded WKB instead of WKT
+            std::size_t columns;    //!< Number of attribute columns
+        };
+
+        //! Captured rows, in flat arrays
+        struct Batch {
+            int decimals;                           //!< Decimals written per coordinate
+            std::vector<Wkt> types;                 //!< Geometry type of each row
+            std::vector<std::size_t> partStart;     //!< First entry in sizes of each row. Ends with the total.
+            std::vector<int> sizes;                 //!< Points per ring or line. Holes are negative.
+            std::vector<std::size_t> vertexStart;   //!< First point in coords of each row. Ends with the total.
+            geometry::PointArray coords;            //!< Coordinates, as east, north pairs
+            std::vector<std::size_t> valueStart;    //!< First entry in columns of each row. Ends with the total.
+            std::vector<std::size_t> columns;       //!< Column of each value, ascending within a row
+            std::vector<std::size_t> valueEnd;      //!< End offset of each value in text
+            std::string text;                       //!< Attribute values
+            Batch() : decimals( 0 ), partStart( 1, 0 ), vertexStart( 1, 0 ), valueStart( 1, 0 ) { }
+            std::size_t rows() const { return types.size(); }
+        };
+
+        //! Format part of a batch. Run on a WorkStealingPool.
+        class ChunkJob : public IPipelineJob {
+            const Batch* mBatch;        //!< Rows to format
+            const Layout* mLayout;      //!< Output layout
+            std::size_t mFrom;          //!< First row
+            std::size_t mTo;            //!< Row after the last
+            std::ostream* mOut;         //!< Output stream
+            std::string mText;          //!< Formatted rows
+        public:
+            ChunkJob( const Batch* batch, const Layout* layout, std::size_t from, std::size_t to, std::ostream* out ) :
+                mBatch( batch ), mLayout( layout ), mFrom( from ), mTo( to ), mOut( out ) { }
+            virtual void run();
+            virtual void complete() { mOut->write( mText.data(), mText.size() ); }
+        };
+
+        //! Format batch and append it to the output. Run on the writer thread.
+        /*!
+            Batches are run one at a time, in order, so each batch has the pool and the
+            output stream to itself.
+        */
+        class BatchJob : public IPipelineJob {
+            Batch* mBatch;              //!< Rows to format, owned by the job
+            const Layout* mLayout;      //!< Output layout
+            WorkStealingPool* mPool;    //!< Pool to format the chunks on
+            std::ostream* mOut;         //!< Output stream
+        public:
+            BatchJob( Batch* batch, const Layout* layout, WorkStealingPool* pool, std::ostream* out ) :
+                mBatch( batch ), mLayout( layout ), mPool( pool ), mOut( out ) { }
+            virtual ~BatchJob() { delete mBatch; }
+            virtual void run();
+            virtual void complete() { }
+        };
 
         //! Command line wrapper
         CommandLine* mCmd;
 
+        //! Souce file currently in process
+        std::string mCurrentSourcefile;
+
+        //! True during the first pass
+        bool mDiscover;
+
+        //! Column index by attribute name
+        std::map<std::string, std::size_t> mColumnIndex;
+
+        //! Attribute values of the row being built
+        std::vector<std::string> mRow;
+
+        //! True for the attributes present in mRow
+        std::vector<bool> mRowSet;
+
+        //! Output layout
+        Layout mLayout;
+
+        //! Rows not yet handed to the writer thread
+        Batch* mBatch;
+
+        //! Decimals per coordinate in the current source file, or -1 until read from the header
+        int mDecimals;
+
+        //! Rows captured in the first or second pass
+        long mRows;
+
+        //! Pipeline of the current pass
+        Pipeline* mPipeline;
+
+        //! Pool for formatting, used by the writer thread only
+        WorkStealingPool* mPool;
+
+        //! Output stream
+        std::ostream* mOut;
+
+        //! Read ENHET from the header of the current source file
+        void checkUnit( ISosiElement* root );
+
+        //! Collect attribute names or values of a feature
+        /*!
+            Nested elements are flattened, as in the PostGIS export. Coordinates and
+            references are left out, since they make up the geometry column. Repeated
+            attributes are joined with |.
+            \param parent Feature element.
+        */
+        void collect( ISosiElement* parent );
+
+        //! Add feature and its collected attributes to the current batch
+        void append( Wkt type, CoordinateCollection& cc );
+
+        //! Hand the current batch to the writer thread
+        void submitBatch();
+
+        //! Test if current element is filtered out by -t parameter
+        bool objTypeExcluded( ISosiElement* e );
+
+        //! Read all sources, passing the features to onEvent()
+        void readSources( bool* cancel );
+
     public:
+
         //! Constructor
-        ConverterSosi2tsv() : mCmd( 0 ) { };
+        ConverterSosi2tsv() : mCmd( 0 ), mDiscover( true ), mBatch( 0 ), mDecimals( -1 ), mRows( 0 ),
+                              mPipeline( 0 ), mPool( 0 ), mOut( 0 ) { }
 
         //! Destructor
-        virtual ~ConverterSosi2tsv() { };
-
+        virtual ~ConverterSosi2tsv() { delete mBatch; }
 
         //! Initialize converter
         /*!
             Implementation details in sosicon::IConverter::init()
             \sa sosicon::IConverter::init()
          */
-        virtual void init( CommandLine* cmd ) { mCmd = cmd; };
+        virtual void init( CommandLine* cmd ) { mCmd = cmd; }
+
+        //! Receive feature from parser
+        virtual void onEvent( FeatureEvent& event, EventDispatcher<FeatureEvent>& dispatcher );
 
         //! Start conversion
         /*!
@@ -65,7 +219,7 @@ namespace sosicon {
 
     }; // class ConverterSosi2tsv
    /*! @} end group converters */
-    
-}; // namespace sosi2tsv
+
+}; // namespace sosicon
 
 #endif
@@ -17,39 +17,178 @@
  */
 #include "converter_sosi_stat.h"
 
+namespace {
+
+    //! Parse one numeric token
+    double parseNumber( const char* p, const char* end ) {
+        bool negative = false;
+        const char* q = p;
+        if( q < end && ( *q == '-' || *q == '+' ) ) {
+            negative = *q == '-';
+            q++;
+        }
+        double value = 0;
+        while( q < end && *q >= '0' && *q <= '9' ) {
+            value = value * 10 + ( *q - '0' );
+            q++;
+        }
+        if( q < end ) {
+            // Decimals or exponent, let the library handle it
+            std::string token( p, end );
+            return strtod( token.c_str(), 0 );
+        }
+        return negative ? -value : value;
+    }
+
+    //! Skip leading and trailing blanks
+    void trimRange( const char*& p, const char*& end ) {
+        while( p < end && ( *p == ' ' || *p == '\t' ) ) p++;
+        while( end > p && ( end[ -1 ] == ' ' || end[ -1 ] == '\t' ) ) end--;
+    }
+
+    //! Cut range at comment
+    const char* commentStart( const char* p, const char* end ) {
+        const char* c = static_cast<const char*>( memchr( p, '!', end - p ) );
+        return c ? c : end;
+    }
+
+}; // namespace
+
 void sosicon::ConverterSosiStat::
-makeStat( ISosiElement* parent ) {
+applyTranspar() {
+    sosi::SosiTranslationTable tt;
+    for( HeadItemList::iterator i = mTranspar.begin(); i != mTranspar.end(); i++ ) {
+        sosi::ElementType type = tt.sosiNameToType( i->first );
+        std::stringstream ss( i->second );
+        if( type == sosi::sosi_element_origo_ne ) {
+            ss >> mOrigoN >> mOrigoE;
+        }
+        else if( type == sosi::sosi_element_unit ) {
+            double d = 0;
+            ss >> d;
+            mDivisor = 1.0 / ( d > 0.0 ? d : 1.0 ); // Not truncated: ENHET may be above 1
+        }
+    }
+    mTransparApplied = true;
+}
+
+void sosicon::ConverterSosiStat::
+beginElement( int level, const char* name, const char* nameEnd, const char* data, const char* dataEnd ) {
 
-    sosi::SosiElementSearch src;
-    while( parent->getChild( src ) ) {
-        makeStat( src.element() );
+    mKey.assign( name, nameEnd );
+    std::unordered_map<std::string, NameCount>::iterator i = mNameCounts.find( mKey );
+    if( i == mNameCounts.end() ) {
+        sosi::SosiTranslationTable tt;
+        NameCount nc;
+        nc.count = 0;
+        nc.type = tt.sosiNameToType( mKey );
+        std::string isoName = sosi::SosiCharsetSingleton::getInstance()->toIso8859_1( mKey );
+        nc.dimensions = isoName == "N\xD8" ? 2 : isoName == "N\xD8H" ? 3 : 0;
+        i = mNameCounts.insert( std::make_pair( mKey, nc ) ).first;
     }
-    std::string elementName = parent->getName();
-    if( mGeoTypes.find( elementName ) == mGeoTypes.end() ) {
-        mGeoTypes[ elementName ] = 1;
+    NameCount& nc = i->second;
+    nc.count++;
+
+    // Junction point markers (...KP) may interrupt a coordinate list
+    if( mCoordLevel > 0 && ( level <= mCoordLevel || nc.type != sosi::sosi_element_kp ) ) {
+        mCoordLevel = 0;
     }
-    else {
-        mGeoTypes[ elementName ]++;
+
+    mHeadItemData = 0;
+    if( level == 1 ) {
+        endFeature();
+        mInHead = nc.type == sosi::sosi_element_head;
+        mInTranspar = false;
+        mInFeature = !mInHead;
+        if( mInFeature && !mTransparApplied ) {
+            applyTranspar();
+        }
     }
-    if( parent->getType() == sosi::sosi_element_objtype ) {
-        std::string objtype = parent->getData();
-        if( mObjTypes.find( objtype ) == mObjTypes.end() ) {
-            mObjTypes[ objtype ] = 1;
+    else if( level == 2 ) {
+        mInTranspar = mInHead && nc.type == sosi::sosi_element_transpar;
+    }
+
+    if( mInHead ) {
+        if( level == 2 ) {
+            mHead.push_back( std::make_pair( mKey, std::string( data, dataEnd ) ) );
+            mHeadItemData = &mHead.back().second;
+            if( nc.type == sosi::sosi_element_charset ) {
+                sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+                if( cs->getEncoding() == sosi::sosi_charset_undetermined ) {
+                    cs->init( *mHeadItemData );
+                }
+            }
         }
-        else {
-            mObjTypes[ objtype ]++;
+        else if( level == 3 && mInTranspar ) {
+            mTranspar.push_back( std::make_pair( mKey, std::string( data, dataEnd ) ) );
+            mHeadItemData = &mTranspar.back().second;
+        }
+    }
+
+    if( nc.type == sosi::sosi_element_objtype ) {
+        mKey.assign( data, dataEnd );
+        mObjTypes[ mKey ]++;
+        if( mInFeature && level == 2 ) {
+            mFeatureObjType = mKey;
+        }
+    }
+    else if( nc.dimensions > 0 && mInFeature ) {
+        mCoordLevel = level;
+        mCoordDimensions = nc.dimensions;
+        mCoordIndex = 0;
+        scanCoordinates( data, dataEnd );
+    }
+}
+
+void sosicon::ConverterSosiStat::
+endFeature() {
+    if( mInFeature && !mFeatureObjType.empty() ) {
+        std::map<std::string, ObjTypeExtent>::iterator i = mObjTypeExtents.find( mFeatureObjType );
+        if( i == mObjTypeExtents.end() ) {
+            mObjTypeExtents[ mFeatureObjType ] = mFeatureExtent;
+        }
+        else if( mFeatureExtent.vertices > 0 ) {
+            ObjTypeExtent& x = i->second;
+            x.vertices += mFeatureExtent.vertices;
+            x.minN = std::min( x.minN, mFeatureExtent.minN );
+            x.minE = std::min( x.minE, mFeatureExtent.minE );
+            x.maxN = std::max( x.maxN, mFeatureExtent.maxN );
+            x.maxE = std::max( x.maxE, mFeatureExtent.maxE );
+        }
+    }
+    mInFeature = false;
+    mFeatureObjType.clear();
+    mFeatureExtent.vertices = 0;
+    mFeatureExtent.minN = mFeatureExtent.minE = +9999999999;
+    mFeatureExtent.maxN = mFeatureExtent.maxE = -9999999999;
+    mCoordLevel = 0;
+}
+
+void sosicon::ConverterSosiStat::
+printExtents( int padding ) {
+    for( std::map<std::string, ObjTypeExtent>::iterator i = mObjTypeExtents.begin(); i != mObjTypeExtents.end(); i++ ) {
+        ObjTypeExtent& x = i->second;
+        std::string label = i->first;
+        label.resize( padding, '.' );
+        std::stringstream ss;
+        ss << std::setw( 8 ) << x.vertices;
+        if( x.vertices > 0 ) {
+            ss << std::fixed << std::setprecision( 2 )
+               << "  " << x.minN << " " << x.minE
+               << "  " << x.maxN << " " << x.maxE;
         }
+        sosicon::logstream << " " << label << ": " << ss.str() << "\n";
     }
 }
 
 void sosicon::ConverterSosiStat::
-printElementData( ISosiElement* e, sosi::SosiElementSearch src, int padding ) {
-    while( e->getChild( src ) ) {
-        ISosiElement* child = src.element();
-        if( !child->getData().empty() ) {
-            std::string label = child->getName();
+printHeadItems( HeadItemList& items, int padding ) {
+    sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+    for( HeadItemList::iterator i = items.begin(); i != items.end(); i++ ) {
+        if( !i->second.empty() ) {
+            std::string label = cs->toIso8859_1( i->first );
             label.resize( padding, '.' );
-            sosicon::logstream << " " << label << ": " << child->getData() << "\n";
+            sosicon::logstream << " " << label << ": " << i->second << "\n";
         }
     }
 }
@@ -73,55 +212,183 @@ printTableHeader( std::string col1, std::string col2, int padding ) {
     sosicon::logstream << "------------------------------------------\n";
 }
 
+void sosicon::ConverterSosiStat::
+reset() {
+    mNameCounts.clear();
+    mObjTypes.clear();
+    mObjTypeExtents.clear();
+    mHead.clear();
+    mTranspar.clear();
+    mHeadItemData = 0;
+    mInHead = false;
+    mInTranspar = false;
+    mTransparApplied = false;
+    mOrigoN = 0;
+    mOrigoE = 0;
+    mDivisor = 1;
+    mInFeature = false;
+    mCoordLevel = 0;
+    mCoordDimensions = 0;
+    mCoordIndex = 0;
+    mCoordN = 0;
+    endFeature();
+}
+
 void sosicon::ConverterSosiStat::
 run( bool* ) {
     for( std::vector<std::string>::iterator f = mCmd->mSourceFiles.begin(); f != mCmd->mSourceFiles.end(); f++ ) {
         sosicon::logstream << "\nGenerating statistics for " << *f << "\n";
-        Parser p;
-        char ln[ 1024 ];
-        std::ifstream ifs( ( *f ).c_str() );
-        int c = 0;
-        while( !ifs.eof() ) {
-            c++;
-            if( mCmd->mIsTtyOut && ( c % 100 ) == 0 ) {
-                sosicon::logstream << "\rParsing " << c << " lines...";
-            }
-            memset( ln, 0x00, sizeof ln );
-            ifs.getline( ln, sizeof ln );
-            p.ragelParseSosiLine( ln );
+        reset();
+        long lines = 0;
+        if( !scanFile( *f, lines ) ) {
+            sosicon::logstream << *f << " not found\n";
+            continue;
         }
-        sosicon::logstream << "\n" << c << " lines in file   \n\n";
-        p.complete();
-        ifs.close();
-
-        ISosiElement* root = p.getRootElement();
-        makeStat( root );
+        sosicon::logstream << "\n" << lines << " lines in file   \n\n";
 
-        sosi::SosiElementSearch srcHead( sosi::sosi_element_head );
-        if( root->getChild( srcHead ) ) {
-            sosi::SosiElementSearch srcHeadItem;
-            
+        if( !mHead.empty() ) {
             printTableHeader( "SOSI HEADER", "VALUE", 22 );
-            printElementData( srcHead.element(), sosi::SosiElementSearch(), 22 );
+            printHeadItems( mHead, 22 );
+            sosicon::logstream << "\n\n";
+        }
+        if( !mTranspar.empty() ) {
+            printTableHeader( "SOSI HEADER/TRANSPAR", "VALUE", 22 );
+            printHeadItems( mTranspar, 22 );
             sosicon::logstream << "\n\n";
-            
-            sosi::SosiElementSearch srcTranspar( sosi::sosi_element_transpar );
-            if( srcHead.element()->getChild( srcTranspar ) ) {
-                sosi::SosiElementSearch srcTransparItem;
-                printTableHeader( "SOSI HEADER/TRANSPAR", "VALUE", 22 );
-                printElementData( srcTranspar.element(), sosi::SosiElementSearch(), 22 );
-                sosicon::logstream << "\n\n";
-            }
         }
 
+        sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+        std::map<std::string, int> elements;
+        for( std::unordered_map<std::string, NameCount>::iterator i = mNameCounts.begin(); i != mNameCounts.end(); i++ ) {
+            elements[ cs->toIso8859_1( i->first ) ] += i->second.count;
+        }
         printTableHeader( "SOSI ELEMENT", "COUNT", 30 );
-        printListContent( mGeoTypes, 30 );
+        printListContent( elements, 30 );
         sosicon::logstream << "\n\n";
 
+        std::map<std::string, int> objTypes( mObjTypes.begin(), mObjTypes.end() );
         printTableHeader( "OBJTYPE", "COUNT", 30 );
-        printListContent( mObjTypes, 30 );
+        printListContent( objTypes, 30 );
+        sosicon::logstream << "\n\n";
+
+        printTableHeader( "OBJTYPE", "VERTICES  MIN-N MIN-E  MAX-N MAX-E", 30 );
+        printExtents( 30 );
         sosicon::logstream << "\n\n";
+    }
+}
+
+void sosicon::ConverterSosiStat::
+scanCoordinates( const char* p, const char* end ) {
+    while( p < end ) {
+        while( p < end && ( *p == ' ' || *p == '\t' ) ) p++;
+        const char* token = p;
+        while( p < end && *p != ' ' && *p != '\t' ) p++;
+        if( token == p ) {
+            break;
+        }
+        if( *token == '.' ) {
+            // Element marker on coordinate line (e.g. ...KP 1)
+            break;
+        }
+        double value = parseNumber( token, p );
+        if( mCoordIndex == 0 ) {
+            mCoordN = value;
+        }
+        else if( mCoordIndex == 1 ) {
+            double n = mOrigoN + mCoordN / mDivisor;
+            double e = mOrigoE + value / mDivisor;
+            mFeatureExtent.vertices++;
+            mFeatureExtent.minN = std::min( mFeatureExtent.minN, n );
+            mFeatureExtent.minE = std::min( mFeatureExtent.minE, e );
+            mFeatureExtent.maxN = std::max( mFeatureExtent.maxN, n );
+            mFeatureExtent.maxE = std::max( mFeatureExtent.maxE, e );
+        }
+        mCoordIndex = ( mCoordIndex + 1 ) % mCoordDimensions;
+    }
+}
 
+bool sosicon::ConverterSosiStat::
+scanFile( const std::string& fileName, long& lines ) {
+
+    FILE* fp = fopen( fileName.c_str(), "rb" );
+    if( !fp ) {
+        return false;
     }
+
+    Profiler::beginFile( fileName );
+    Profiler::Scope scope( Profiler::stage_parse );
+    std::vector<char> buf( SCAN_BUFFER_SIZE );
+    size_t carry = 0;
+    lines = 0;
+    fseek( fp, 0, SEEK_END );
+    Progress progress( "Scanning", static_cast<uint64_t>( std::max( ftell( fp ), 0L ) ), true );
+    fseek( fp, 0, SEEK_SET );
+    for( ;; ) {
+        size_t n = fread( &buf[ carry ], 1, buf.size() - carry, fp );
+        if( mCmd->mIsTtyOut ) {
+            progress.add( n );
+        }
+        Profiler::addBytesIn( n );
+        if( n == 0 ) {
+            if( carry > 0 ) {
+                scanLine( &buf[ 0 ], &buf[ 0 ] + carry );
+                lines++;
+            }
+            break;
+        }
+        const char* line = &buf[ 0 ];
+        const char* end = line + carry + n;
+        const char* nl;
+        while( ( nl = static_cast<const char*>( memchr( line, '\n', end - line ) ) ) != 0 ) {
+            scanLine( line, nl );
+            lines++;
+            line = nl + 1;
+        }
+        carry = end - line;
+        memmove( &buf[ 0 ], line, carry );
+        if( carry == buf.size() ) {
+            // Line longer than buffer
+            buf.resize( buf.size() * 2 );
+        }
+    }
+    fclose( fp );
+    endFeature();
+    return true;
 }
 
+void sosicon::ConverterSosiStat::
+scanLine( const char* p, const char* end ) {
+
+    if( end > p && end[ -1 ] == '\r' ) {
+        end--;
+    }
+
+    if( p < end && *p == '.' ) {
+        int level = 0;
+        while( p < end && *p == '.' ) {
+            level++;
+            p++;
+        }
+        const char* name = p;
+        while( p < end && *p != ' ' && *p != '\t' && *p != '.' ) {
+            p++;
+        }
+        const char* nameEnd = p;
+        end = commentStart( p, end );
+        trimRange( p, end );
+        beginElement( level, name, nameEnd, p, end );
+    }
+    else {
+        end = commentStart( p, end );
+        if( mCoordLevel > 0 ) {
+            scanCoordinates( p, end );
+        }
+        else if( mHeadItemData ) {
+            trimRange( p, end );
+            if( p < end ) {
+                mHeadItemData->append( " " );
+                mHeadItemData->append( p, end );
+            }
+        }
+    }
+}
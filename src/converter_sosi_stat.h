@@ -19,15 +19,21 @@
 #define __CONVERTER_SOSI_STAT_H__
 
 #include "logger.h"
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include "interface/i_converter.h"
-#include "interface/i_sosi_element.h"
 #include "sosi/sosi_types.h"
-#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_translation_table.h"
+#include "sosi/sosi_charset_singleton.h"
 #include "command_line.h"
 #include "utils.h"
-#include "parser.h"
+#include "profiler.h"
+#include "progress.h"
 
 namespace sosicon {
 
@@ -44,38 +50,143 @@ namespace sosicon {
         - -stat: sosicon::ConverterSosiStat SOSI statistics (printout)
         @{
     */
-    //! SOSI to ESRI Shape converter
+    //! SOSI statistics
     /*!
         If command-line parameter -stat is specified, this converter will handle the output
-        generation. Produces an ESRI Shape-file from SOSI source.
+        generation. Prints a summary of the SOSI source: header values, element and OBJTYPE
+        counts, and the number of vertices and bounding box for each OBJTYPE.
+
+        The source file is scanned line by line straight from a read buffer. No element tree is
+        built, and the only allocations made are for the distinct names and OBJTYPEs found.
      */
     class ConverterSosiStat : public IConverter {
 
+        //! Size of file read buffer
+        static const size_t SCAN_BUFFER_SIZE = 1 << 20;
+
+        //! Element name entry
+        struct NameCount {
+            int count;                //!< Number of occurrences
+            sosi::ElementType type;   //!< Element type
+            int dimensions;           //!< 2 for NØ, 3 for NØH, otherwise 0
+        };
+
+        //! Geometry summary for one OBJTYPE
+        struct ObjTypeExtent {
+            long vertices;            //!< Number of coordinates
+            double minN;              //!< Bounding box, minimum north
+            double minE;              //!< Bounding box, minimum east
+            double maxN;              //!< Bounding box, maximum north
+            double maxE;              //!< Bounding box, maximum east
+        };
+
+        typedef std::vector< std::pair<std::string, std::string> > HeadItemList;
+
         //! Command line wrapper
         CommandLine* mCmd;
 
+        //! Element counts by untranslated element name
+        std::unordered_map<std::string, NameCount> mNameCounts;
+
         //! Map keeping count of objtypes
-        std::map<std::string, int> mObjTypes;
-        
-        //! Map keeping count of geometry
-        std::map<std::string, int> mGeoTypes;
+        std::unordered_map<std::string, int> mObjTypes;
+
+        //! Vertex count and extent by objtype
+        std::map<std::string, ObjTypeExtent> mObjTypeExtents;
+
+        //! Second level HODE elements (name, data)
+        HeadItemList mHead;
+
+        //! Elements of HODE/TRANSPAR (name, data)
+        HeadItemList mTranspar;
+
+        //! Scratch key for name lookups
+        std::string mKey;
+
+        //! Header item receiving continuation lines, if any
+        std::string* mHeadItemData;
+
+        //! Currently inside HODE
+        bool mInHead;
+
+        //! Currently inside HODE/TRANSPAR
+        bool mInTranspar;
+
+        //! Origo and unit have been read from TRANSPAR
+        bool mTransparApplied;
+
+        //! ORIGO-NØ north offset
+        double mOrigoN;
+
+        //! ORIGO-NØ east offset
+        double mOrigoE;
+
+        //! Coordinate divisor, derived from ENHET
+        double mDivisor;
+
+        //! A top-level feature is open
+        bool mInFeature;
 
-        //! Output simple element attributes
-        void printElementData( ISosiElement* e, sosi::SosiElementSearch src, int padding );
+        //! OBJTYPE of open feature
+        std::string mFeatureObjType;
+
+        //! Vertex count and extent of open feature
+        ObjTypeExtent mFeatureExtent;
+
+        //! Level of the coordinate element currently open, or 0
+        int mCoordLevel;
+
+        //! Number of values per vertex in current coordinate element
+        int mCoordDimensions;
+
+        //! Index of next value within current vertex
+        int mCoordIndex;
+
+        //! North value of vertex in progress
+        double mCoordN;
+
+        //! Start new element
+        void beginElement( int level, const char* name, const char* nameEnd, const char* data, const char* dataEnd );
+
+        //! Add open feature to the objtype summary
+        void endFeature();
+
+        //! Read coordinate values
+        void scanCoordinates( const char* p, const char* end );
+
+        //! Scan SOSI file
+        /*!
+            \param fileName Path to the SOSI file.
+            \param lines Receives number of lines in file.
+            \return False if the file could not be opened.
+         */
+        bool scanFile( const std::string& fileName, long& lines );
+
+        //! Process one line
+        void scanLine( const char* p, const char* end );
+
+        //! Read ORIGO-NØ and ENHET from collected TRANSPAR items
+        void applyTranspar();
+
+        //! Clear statistics before scanning next file
+        void reset();
+
+        //! Output name/data pairs
+        void printHeadItems( HeadItemList& items, int padding );
 
         //! Output content of map<string,int>
         void printListContent( std::map<std::string, int> list, int padding );
 
-        //! Output simple element attributes
-        void printTableHeader( std::string col1, std::string col2, int padding );
+        //! Output vertex count and bounding box for each objtype
+        void printExtents( int padding );
 
         //! Output table header with column titles
-        void makeStat( ISosiElement* parent );
+        void printTableHeader( std::string col1, std::string col2, int padding );
 
     public:
 
         //! Constructor
-        ConverterSosiStat() : mCmd( 0 ) { };
+        ConverterSosiStat() : mCmd( 0 ) { reset(); };
 
         //! Destructor
         virtual ~ConverterSosiStat() { };
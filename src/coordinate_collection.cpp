@@ -17,85 +17,78 @@
  */
 #include "coordinate_collection.h"
 
-bool sosicon::
-getNext( ICoordinate*& coord, sosi::NorthEastList& list, sosi::NorthEastList::iterator& i ) {
-    if( 0 == coord ) {
-        i = list.begin();
-    }
-    if( i == list.end() ) {
-        return false;
-    }
-    if( false == ( *i )->getNext( coord ) ) {
-        i++;
-        coord = 0;
-        if( i != list.end() ) {
-            return false;
-        }
-        else {
-            ( *i )->getNext( coord );
-        }
-    }
-    return true;
-}
-
-bool sosicon::
-getNextOffset( int& offset, std::vector<int>& offsets, std::vector<int>::iterator& iterator ) {
-    if( -1 == offset ) {
-        iterator = offsets.begin();
-    }
-    if( iterator == offsets.end() ) {
-        return false;
-    }
-    offset = *iterator;
-    iterator++;
-    return true;
-}
-
-bool sosicon::
-isCounterClockwise( std::vector<ICoordinate*>::iterator& begin, std::vector<ICoordinate*>::iterator& end ) {
-    return !isClockwise( begin, end );
+sosicon::CoordinateCollection::
+~CoordinateCollection() {
+    free();
 }
 
-bool sosicon::
-isClockwise( std::vector<ICoordinate*>::iterator& begin, std::vector<ICoordinate*>::iterator& end ) {
-    double edgeSum = 0.0;
-    ICoordinate* v1 = 0, * v2 = 0;
-    for( std::vector<ICoordinate*>::iterator i = begin; i != end; i++ ) {
-        v1 = *i;
-        v2 = *( ( i + 1 != end ) ? i + 1 : begin );
-        edgeSum += ( v2->getE() - v1->getE() ) * ( v2->getN() + v1->getN() );
-    }
-    return edgeSum > 0;
+void sosicon::CoordinateCollection::
+free() {
+    geometry::PointArray().swap( mGeom );
+    geometry::PointArray().swap( mHoles );
 }
 
-void sosicon::
-neListToCoordList( sosi::NorthEastList& neList, std::vector<ICoordinate*>& coordList ) {
-    coordList.clear();
-    for( sosi::NorthEastList::iterator i = neList.begin(); i != neList.end(); i++ ) {
-        sosi::SosiNorthEast* ne = *i;
-        ICoordinate* c = 0;
-        while( ne->getNext( c ) ) {
-            coordList.push_back( c );
+void sosicon::CoordinateCollection::
+assembleRing( ISosiElement* refElement,
+              sosi::GeometryRef& geometry,
+              geometry::PointArray& target,
+              std::vector<int>& sizes,
+              bool clockwise,
+              double tolerance ) {
+
+    // Fetch all referenced curves first, so the target can be sized in one go.
+    // The reference parser stores the references of a ring last to first.
+    CurveCache* cache = CurveCache::getInstance();
+    std::vector<CurveView> curves;
+    std::size_t numPoints = 0;
+    for( sosi::GeometryRef::reverse_iterator i = geometry.rbegin(); i != geometry.rend(); i++ ) {
+        sosi::ReferenceData* refData = *i;
+        ISosiElement* referencedElement = refElement->find( refData->serial );
+        if( referencedElement ) {
+            CurveView curve = cache->get( referencedElement, refData->reverse, tolerance );
+            curve.getCurve()->expandBoundingBox( mXmin, mYmin, mXmax, mYmax );
+            numPoints += curve.size();
+            curves.push_back( curve );
         }
     }
-}
+    if( 0 == numPoints ) {
+        return;
+    }
 
-sosicon::CoordinateCollection::
-~CoordinateCollection() {
-    free();
-}
+    // Append each curve in its own direction, then drop repeated points
+    // such as the junction point shared by consecutive curves
+    std::size_t ringStart = target.size() / 2;
+    target.reserve( target.size() + 2 * ( numPoints + 1 ) );
+    for( std::vector<CurveView>::iterator i = curves.begin(); i != curves.end(); i++ ) {
+        i->appendTo( target );
+    }
+    numPoints = geometry::removeDuplicates( &target[ 2 * ringStart ], numPoints );
+    target.resize( 2 * ( ringStart + numPoints ) );
+    geometry::closeRing( target, ringStart );
+    numPoints = target.size() / 2 - ringStart;
+    if( numPoints < 4 && tolerance > 0 ) {
+        target.resize( 2 * ringStart );
+        assembleRing( refElement, geometry, target, sizes, clockwise, 0 );
+        return;
+    }
 
-void sosicon::CoordinateCollection::
-free() {
-    sosi::deleteNorthEasts( mGeom );
-    sosi::deleteNorthEasts( mHoles );
+    // Outer rings run clockwise, holes counter-clockwise
+    double* ring = &target[ 2 * ringStart ];
+    if( ( geometry::signedArea( ring, numPoints ) < 0 ) != clockwise ) {
+        geometry::reversePoints( ring, numPoints );
+    }
+    sizes.push_back( static_cast<int>( numPoints ) );
 }
 
 void sosicon::CoordinateCollection::
 discoverCoords( ISosiElement* e ) {
+    mSource = e;
+    double curveTolerance = mTopology ? mTolerance : 0;
     switch( e->getType() ) {
         case sosi::sosi_element_surface:
             {
+                Profiler::Scope scope( Profiler::stage_refs );
+                mRings = true;
                 sosi::SosiElementSearch srcRef( sosi::sosi_element_ref );
                 ISosiElement* rawRefElement = 0;
                 while( e->getChild( srcRef ) ) {
@@ -103,35 +96,18 @@ discoverCoords( ISosiElement* e ) {
                     sosi::SosiRefList refList( rawRefElement );
                     sosi::GeometryRef* geometry = 0;
                     while( refList.getNextGeometry( geometry ) ) {
-                        bool isHole = ( *geometry )[ 0 ]->subtract;
-                        int numPoints = 0;
-                        sosi::NorthEastList tmpNEList;
-                        for( sosi::GeometryRef::iterator i = geometry->begin(); i != geometry->end(); i++ ) {
-                            sosi::ReferenceData* refData = *i;
-                            ISosiElement* referencedElement = rawRefElement->find( refData->serial );
-                            if( referencedElement ) {
-
-                                extractPath( referencedElement,
-                                             refData->reverse,
-                                             numPoints,
-                                             isHole? mHoles : mGeom ); // target&
-
-                            }
-                        }
-
-                        if( isHole ) {
-                            mHoleSizes.insert( mHoleSizes.begin(), numPoints );
-                            mNumPointsHoles += numPoints;
-                            mNumPartsHoles++;
+                        if( ( *geometry )[ 0 ]->subtract ) {
+                            assembleRing( rawRefElement, *geometry, mHoles, mHoleSizes, false, curveTolerance );
                         }
                         else {
-                            mGeomSizes.insert( mGeomSizes.begin(), numPoints );
-                            mNumPointsGeom += numPoints;
-                            mNumPartsGeom++;
+                            assembleRing( rawRefElement, *geometry, mGeom, mGeomSizes, true, curveTolerance );
                         }
-
                     }
                 }
+                mNumPartsGeom = static_cast<int>( mGeomSizes.size() );
+                mNumPartsHoles = static_cast<int>( mHoleSizes.size() );
+                mNumPointsGeom = static_cast<int>( mGeom.size() / 2 );
+                mNumPointsHoles = static_cast<int>( mHoles.size() / 2 );
             }
             break;
         case sosi::sosi_element_text:
@@ -140,13 +116,16 @@ discoverCoords( ISosiElement* e ) {
             {
                 mNumPartsGeom = 1;
                 mNumPartsHoles = 0;
-                int numPoints = 0;
-                sosi::SosiElementSearch srcNe( sosi::sosi_element_ne );
-                while( e->getChild( srcNe ) ) {
-                    sosi::SosiNorthEast* ne = new sosi::SosiNorthEast( srcNe.element() );
-                    mGeom.push_back( ne );
-                    numPoints += ne->getNumPoints();
-                    ne->expandBoundingBox( mXmin, mYmin, mXmax, mYmax );
+                CurveView curve = sosi::sosi_element_curve == e->getType()
+                                ? CurveCache::getInstance()->get( e, false, curveTolerance )
+                                : CurveView( DecodedCurvePtr( new DecodedCurve( e ) ), false );
+                curve.appendTo( mGeom );
+                if( curve.getCurve() ) {
+                    curve.getCurve()->expandBoundingBox( mXmin, mYmin, mXmax, mYmax );
+                }
+                int numPoints = static_cast<int>( curve.size() );
+                if( numPoints > 1 && !( geometry::signedArea( &mGeom[ 0 ], numPoints ) < 0 ) ) {
+                    geometry::reversePoints( &mGeom[ 0 ], numPoints ); // Lines are stored clockwise
                 }
                 mGeomSizes.push_back( numPoints );
                 mNumPointsGeom = numPoints;
@@ -155,76 +134,97 @@ discoverCoords( ISosiElement* e ) {
         default:
             ;
     }
+    if( mTolerance > 0 && !mTopology ) {
+        simplify( mTolerance );
+    }
 }
 
-void sosicon::CoordinateCollection::
-extractPath( ISosiElement* referencedElement,
-             bool reverse,
-             int& numPoints,
-             sosi::NorthEastList& target ) {
+namespace {
 
-    sosi::SosiElementSearch  src( sosi::sosi_element_ne );
-    std::string obj = referencedElement->getObjType();
-    sosi::NorthEastList tmpLst;
+    //! Shared working buffers, geometries are built on the converter thread only
+    sosicon::geometry::Simplifier simplifier;
 
-    while( referencedElement->getChild( src ) ) {
-        sosi::SosiNorthEast* ne = new sosi::SosiNorthEast( src.element() );
-        if( reverse ) {
-            ne->reverse();
-            if( tmpLst.size() == 0 ) {
-                tmpLst.push_back( ne );
+    //! Simplify each part in place, moving the parts down to close the gaps
+    void simplifyParts( sosicon::geometry::PointArray& xy, std::vector<int>& sizes, double tolerance, bool rings ) {
+        std::size_t from = 0;
+        std::size_t to = 0;
+        for( std::vector<int>::iterator i = sizes.begin(); i != sizes.end(); i++ ) {
+            std::size_t n = static_cast<std::size_t>( *i );
+            if( to != from ) {
+                std::copy( xy.begin() + 2 * from, xy.begin() + 2 * ( from + n ), xy.begin() + 2 * to );
             }
-            else {
-                tmpLst.insert( tmpLst.begin(), ne );
+            double* part = xy.empty() ? 0 : &xy[ 2 * to ];
+            double area = rings ? sosicon::geometry::signedArea( part, n ) : 0;
+            std::size_t kept = simplifier.simplify( part, n, tolerance, rings ? 4 : 2 );
+            if( rings && ( sosicon::geometry::signedArea( part, kept ) < 0 ) != ( area < 0 ) ) {
+                sosicon::geometry::reversePoints( part, kept );
             }
+            from += n;
+            to += kept;
+            *i = static_cast<int>( kept );
         }
-        else {
-            tmpLst.push_back( ne );
-        }
-        numPoints += ne->getNumPoints();
-        ne->expandBoundingBox( mXmin, mYmin, mXmax, mYmax );
+        xy.resize( 2 * to );
     }
-    target.insert( target.begin(), tmpLst.begin(), tmpLst.end() );
-}
 
-std::vector<sosicon::ICoordinate*>& sosicon::CoordinateCollection::
-getGeom() {
+}; // namespace
+
+void sosicon::CoordinateCollection::
+getRings( geometry::PointArray& xy, std::vector<int>& sizes ) const {
 
-    neListToCoordList( mGeom, mGeomNormalized );
-    if( mGeomNormalized.size() > 1 ) {
-        std::vector<ICoordinate*>::iterator i0 = mGeomNormalized.begin();
-        std::vector<ICoordinate*>::iterator i1 = mGeomNormalized.end();
-        if( isCounterClockwise( i0, i1 ) ) {
-            std::reverse( mGeomNormalized.begin(), mGeomNormalized.end() );
+    std::vector< std::vector<std::size_t> > owned( mGeomSizes.size() );
+    std::vector<std::size_t> holeStart( 1, 0 );
+    for( std::size_t h = 0; h < mHoleSizes.size(); h++ ) {
+        holeStart.push_back( holeStart.back() + mHoleSizes[ h ] );
+    }
+    for( std::size_t h = 0; h < mHoleSizes.size() && !mGeomSizes.empty(); h++ ) {
+        std::size_t owner = 0;
+        std::size_t start = 0;
+        double x = mHoles[ 2 * holeStart[ h ] ], y = mHoles[ 2 * holeStart[ h ] + 1 ];
+        for( std::size_t g = 0; mGeomSizes.size() > 1 && g < mGeomSizes.size(); g++ ) {
+            double xmin = +9999999999, ymin = +9999999999, xmax = -9999999999, ymax = -9999999999;
+            geometry::expandBoundingBox( &mGeom[ 2 * start ], mGeomSizes[ g ], xmin, ymin, xmax, ymax );
+            start += mGeomSizes[ g ];
+            if( x >= xmin && x <= xmax && y >= ymin && y <= ymax ) {
+                owner = g;
+                break;
+            }
         }
+        owned[ owner ].push_back( h );
     }
-    return mGeomNormalized;
-}
 
-std::vector<sosicon::ICoordinate*>& sosicon::CoordinateCollection::
-getHoles() {
-
-    neListToCoordList( mHoles, mHolesNormalized );
-    if( mHolesNormalized.size() > 1 ) {
-        std::vector<ICoordinate*>::size_type p0 = 0;
-        std::vector<ICoordinate*>::size_type p1 = 0;
-        for( std::vector<int>::iterator i = mHoleSizes.begin(); i != mHoleSizes.end(); i++ ) {
-            int size = *i;
-            p1 += size;
-            if( size > 1 ) {
-                std::vector<ICoordinate*>::iterator i0 = mHolesNormalized.begin() + p0;
-                std::vector<ICoordinate*>::iterator i1 = p1 < mHolesNormalized.size() ? mHolesNormalized.begin() + p1 : mHolesNormalized.end();
-                if( isClockwise( i0, i1 ) ) {
-                    std::reverse( i0, i1 );
-                }
-            }
-            p0 += size;
+    std::size_t start = 0;
+    for( std::size_t g = 0; g < mGeomSizes.size(); g++ ) {
+        xy.insert( xy.end(), mGeom.begin() + 2 * start, mGeom.begin() + 2 * ( start + mGeomSizes[ g ] ) );
+        sizes.push_back( mGeomSizes[ g ] );
+        start += mGeomSizes[ g ];
+        for( std::vector<std::size_t>::iterator h = owned[ g ].begin(); h != owned[ g ].end(); h++ ) {
+            xy.insert( xy.end(), mHoles.begin() + 2 * holeStart[ *h ], mHoles.begin() + 2 * holeStart[ *h + 1 ] );
+            sizes.push_back( -mHoleSizes[ *h ] );
         }
     }
-    return mHolesNormalized;
 }
 
-bool sosicon::CoordinateCollection::
-getNextInGeom( ICoordinate*& coord ) {
-    return getNext( coord, mGeom, mGeomIndex );
+void sosicon::CoordinateCollection::
+simplify( double tolerance ) {
+    if( mTopology ) {
+        ISosiElement* source = mSource;
+        free();
+        mGeomSizes.clear();
+        mHoleSizes.clear();
+        mXmin = mYmin = +9999999999;
+        mXmax = mYmax = -9999999999;
+        mTolerance = tolerance;
+        if( source ) {
+            discoverCoords( source );
+        }
+        return;
+    }
+    simplifyParts( mGeom, mGeomSizes, tolerance, mRings );
+    simplifyParts( mHoles, mHoleSizes, tolerance, mRings );
+    mNumPointsGeom = static_cast<int>( mGeom.size() / 2 );
+    mNumPointsHoles = static_cast<int>( mHoles.size() / 2 );
+    mXmin = mYmin = +9999999999;
+    mXmax = mYmax = -9999999999;
+    geometry::expandBoundingBox( mGeom.data(), mGeom.size() / 2, mXmin, mYmin, mXmax, mYmax );
+    geometry::expandBoundingBox( mHoles.data(), mHoles.size() / 2, mXmin, mYmin, mXmax, mYmax );
 }
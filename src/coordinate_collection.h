@@ -23,65 +23,31 @@
 #include <vector>
 #include "logger.h"
 #include "common_types.h"
+#include "curve_cache.h"
+#include "geometry_kernels.h"
 #include "sosi/sosi_types.h"
 #include "sosi/sosi_element_search.h"
 #include "sosi/sosi_ref_list.h"
-#include "sosi/sosi_north_east.h"
-#include "interface/i_coordinate.h"
 #include "interface/i_sosi_element.h"
 
 namespace sosicon {
 
-    typedef std::vector<ICoordinate*> CoordinateList;
-
-    //! Get next coordinate in list
-    bool getNext( ICoordinate*& coord, sosi::NorthEastList& list, sosi::NorthEastList::iterator& i );
-    
-    //! Get next offset in part offsets list
-    bool getNextOffset( int& offset, std::vector<int>& offsets, std::vector<int>::iterator& iterator );
-
-    //! Analyzes polygon direction
-    /*!
-        Checks a series of coordinates to see if they are ordered in a clockwise manner.
-        \param begin Iterator to the first item to be analyzed.
-        \param end Iterator to the end item, one item past the last one to be analyzed.
-        \return true if the coordinates are ordered clockwise.
-    */
-    bool isClockwise( std::vector<ICoordinate*>::iterator& begin, std::vector<ICoordinate*>::iterator& end );
-
-    //! Analyzes polygon direction
-    /*!
-        Checks a series of coordinates to see if they are ordered in a counter-clockwise manner.
-        \param begin Iterator to the first item to be analyzed.
-        \param end Iterator to the end item, one item past the last one to be analyzed.
-        \return true if the coordinates are ordered counter-clockwise.
-    */
-    bool isCounterClockwise( std::vector<ICoordinate*>::iterator& begin, std::vector<ICoordinate*>::iterator& end );
-
-    //! Extracts single coordinates from list of North-East elements
-    /*!
-        Converts a vector of NE elements to a vector of coordinates.
-
-        \param neList The source vector.
-        \param coordList The destination vector.
-    */
-    void neListToCoordList( sosi::NorthEastList& neList, std::vector<ICoordinate*>& coordList );
-
     //! Coordinate container
     /*!
         \author Espen Andersen
         \copyright GNU General Public License
 
-        Stores a collection of geographical positions.
+        Stores a collection of geographical positions. Coordinates are kept in contiguous
+        arrays of interleaved east, north pairs (see sosicon::geometry), ready to be written
+        by the output formats.
      */
     class CoordinateCollection {
 
-        //! Stores collection of pointers to coordinates for geometries
-        sosi::NorthEastList mGeom;
-        std::vector<ICoordinate*> mGeomNormalized;
+        //! Outer rings or line coordinates
+        geometry::PointArray mGeom;
 
-        sosi::NorthEastList mHoles;
-        std::vector<ICoordinate*> mHolesNormalized;
+        //! Hole coordinates
+        geometry::PointArray mHoles;
 
         int mNumPartsGeom;
         int mNumPartsHoles;
@@ -92,18 +58,44 @@ namespace sosicon {
         std::vector<int> mGeomSizes;
         std::vector<int> mHoleSizes;
 
-        sosi::NorthEastList::iterator mGeomIndex;
-
         double mXmin;
         double mYmin;
         double mXmax;
         double mYmax;
 
-        //! Get coordinate values from SOSI element
-        void extractPath( ISosiElement* referencedElement,
-                          bool reverse,
-                          int& numPoints,
-                          sosi::NorthEastList& target );
+        //! Simplification tolerance applied by discoverCoords(), or 0
+        double mTolerance;
+
+        //! True if the parts are polygon rings rather than lines
+        bool mRings;
+
+        //! True if lines and rings are built from simplified curves, see CurveCache::get()
+        bool mTopology;
+
+        //! Element passed to discoverCoords()
+        ISosiElement* mSource;
+
+        //! Assemble one polygon ring from referenced curves
+        /*!
+            Fetches the curves referenced by one ring of a surface from the shared
+            sosicon::CurveCache, appends their coordinates to target in a single pass and
+            records the ring size. Repeated points, such as the junction point shared by
+            consecutive curves, are only stored once, and the ring is closed and oriented
+            before returning.
+            \param refElement The REF element holding the references.
+            \param geometry References making up the ring.
+            \param target Coordinate array to which the ring is appended.
+            \param sizes Ring size list to which the number of points is appended.
+            \param clockwise true for outer rings, false for holes.
+            \param tolerance Build the ring from curves simplified to this tolerance. If
+                             the ring collapses, it is built from the unsimplified curves.
+        */
+        void assembleRing( ISosiElement* refElement,
+                           sosi::GeometryRef& geometry,
+                           geometry::PointArray& target,
+                           std::vector<int>& sizes,
+                           bool clockwise,
+                           double tolerance );
 
     public:
 
@@ -111,7 +103,13 @@ namespace sosicon {
         virtual ~CoordinateCollection();
 
         //! Constructor
-        CoordinateCollection() :
+        /*!
+            \param tolerance Simplify geometries to this tolerance while they are assembled
+                             (see simplify()). 0 keeps all points.
+            \param topology Simplify the curves that lines and surfaces are built from,
+                            rather than each feature on its own.
+        */
+        CoordinateCollection( double tolerance = 0, bool topology = false ) :
             mNumPartsGeom( 0 ),
             mNumPartsHoles( 0 ),
             mNumPointsGeom( 0 ),
@@ -119,7 +117,11 @@ namespace sosicon {
             mXmin( +9999999999 ),
             mYmin( +9999999999 ),
             mXmax( -9999999999 ),
-            mYmax( -9999999999 ) { };
+            mYmax( -9999999999 ),
+            mTolerance( tolerance ),
+            mRings( false ),
+            mTopology( topology ),
+            mSource( 0 ) { };
 
         //!< Free allocated memory
         void free();
@@ -135,28 +137,38 @@ namespace sosicon {
         */
         void discoverCoords( ISosiElement* sosi );
 
-        //! Retrieve next coordinate in collection
+        //! Simplify geometry
         /*!
-            Iterates through the coordinate list until it reaches the end,
-            passing a pointer to the next element to the coord reference. 
-            Tne value of coord must be zero on the first pass in order to
-            start the iteration on the first ISosiElement.
-            \return The function returns true if there are more coordinates in
-                    the collection, or false if the last coordinate is
-                    encoutered.
+            Simplifies every line and ring in place with geometry::Simplifier, and updates point
+            counts and bounding box. Rings keep at least three distinct points, and their
+            orientation. May be called repeatedly with growing tolerances to produce coarser
+            versions of the same feature. In topology mode, the feature is rebuilt from its
+            curves simplified to the new tolerance instead.
+            \param tolerance Distance in coordinate units.
         */
-        bool getNextInGeom( ICoordinate*& coord );
+        void simplify( double tolerance );
 
-        std::vector<ICoordinate*>& getGeom();
+        //! Outer rings, or the coordinates of a point or line, as east, north pairs
+        const geometry::PointArray& getGeom() const { return mGeom; };
         std::vector<int>& getGeomSizes() { return mGeomSizes; };
         int getNumPointsGeom() { return mNumPointsGeom; };
         int getNumPartsGeom() { return mNumPartsGeom; };
 
-        std::vector<ICoordinate*>& getHoles();
+        //! Holes, as east, north pairs
+        const geometry::PointArray& getHoles() const { return mHoles; };
         std::vector<int>& getHoleSizes() { return mHoleSizes; };
         int getNumPointsHoles() { return mNumPointsHoles; };
         int getNumPartsHoles() { return mNumPartsHoles; };
 
+        //! Rings of a polygon, with each outer ring followed by its holes
+        /*!
+            Each hole goes with the first outer ring whose bounding box holds its first point.
+            \param xy Receives the coordinates, as east, north pairs.
+            \param sizes Receives the number of points of each ring. Holes are given as
+                         negative numbers.
+        */
+        void getRings( geometry::PointArray& xy, std::vector<int>& sizes ) const;
+
         double getXmin() { return mXmin == +9999999999 ? 0 : mXmin; };
 
         double getYmin() { return mYmin == +9999999999 ? 0 : mYmin; };
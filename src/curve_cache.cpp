@@ -0,0 +1,163 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "curve_cache.h"
+
+sosicon::CurveCache* sosicon::CurveCache::mInstance = 0;
+
+sosicon::DecodedCurve::
+DecodedCurve( ISosiElement* e ) :
+    mXmin( +9999999999 ),
+    mYmin( +9999999999 ),
+    mXmax( -9999999999 ),
+    mYmax( -9999999999 ) {
+
+    Profiler::Scope scope( Profiler::stage_coordinates );
+    sosi::SosiElementSearch src( sosi::sosi_element_ne );
+    while( e->getChild( src ) ) {
+        sosi::SosiNorthEast ne( src.element() );
+        mPoints.reserve( mPoints.size() + 2 * ne.getNumPoints() );
+        ICoordinate* c = 0;
+        while( ne.getNext( c ) ) {
+            mPoints.push_back( c->getE() );
+            mPoints.push_back( c->getN() );
+        }
+        ne.free();
+    }
+    geometry::expandBoundingBox( mPoints.data(), getNumPoints(), mXmin, mYmin, mXmax, mYmax );
+}
+
+sosicon::DecodedCurve::
+DecodedCurve( const DecodedCurve& source, double tolerance, geometry::Simplifier& simplifier ) :
+    mPoints( source.mPoints ),
+    mXmin( +9999999999 ),
+    mYmin( +9999999999 ),
+    mXmax( -9999999999 ),
+    mYmax( -9999999999 ) {
+
+    std::size_t n = getNumPoints();
+    if( n > 2 ) {
+        std::size_t minPoints = geometry::isClosed( mPoints.data(), n ) ? 4 : 2;
+        mPoints.resize( 2 * simplifier.simplify( mPoints.data(), n, tolerance, minPoints ) );
+        geometry::PointArray( mPoints ).swap( mPoints );
+    }
+    geometry::expandBoundingBox( mPoints.data(), getNumPoints(), mXmin, mYmin, mXmax, mYmax );
+}
+
+void sosicon::DecodedCurve::
+expandBoundingBox( double& minX, double& minY, double& maxX, double& maxY ) const {
+    minX = std::min( minX, mXmin );
+    minY = std::min( minY, mYmin );
+    maxX = std::max( maxX, mXmax );
+    maxY = std::max( maxY, mYmax );
+}
+
+void sosicon::CurveView::
+appendTo( geometry::PointArray& target ) const {
+    if( mCurve ) {
+        const geometry::PointArray& points = mCurve->getPoints();
+        std::size_t start = target.size() / 2;
+        target.insert( target.end(), points.begin(), points.end() );
+        if( mReverse ) {
+            geometry::reversePoints( &target[ 2 * start ], mCurve->getNumPoints() );
+        }
+    }
+}
+
+sosicon::CurveCache::
+CurveCache() :
+    mNumPoints( 0 ),
+    mCapacity( DEFAULT_CAPACITY ),
+    mHits( 0 ),
+    mMisses( 0 ) {
+}
+
+void sosicon::CurveCache::
+clear() {
+    mEntries.clear();
+    mRecent.clear();
+    mNumPoints = 0;
+}
+
+void sosicon::CurveCache::
+evict() {
+    while( mNumPoints > mCapacity && !mRecent.empty() ) {
+        Entries::iterator i = mEntries.find( mRecent.back() );
+        mNumPoints -= i->second.curve->getNumPoints();
+        mEntries.erase( i );
+        mRecent.pop_back();
+    }
+}
+
+sosicon::DecodedCurvePtr sosicon::CurveCache::
+find( ISosiElement* e, double tolerance ) {
+    Key key;
+    key.serial = e->getSerial();
+    key.tolerance = tolerance;
+    if( key.serial.empty() || ( 0 == mCapacity && 0 == tolerance ) ) {
+        DecodedCurvePtr curve( new DecodedCurve( e ) );
+        if( tolerance > 0 ) {
+            curve.reset( new DecodedCurve( *curve, tolerance, mSimplifier ) );
+        }
+        return curve;
+    }
+    Entries::iterator i = mEntries.find( key );
+    if( i != mEntries.end() ) {
+        mHits++;
+        if( 0 == tolerance ) {
+            mRecent.splice( mRecent.begin(), mRecent, i->second.recent );
+        }
+        return i->second.curve;
+    }
+    mMisses++;
+    DecodedCurvePtr curve;
+    if( tolerance > 0 ) {
+        // Simplified curves are kept until the cache is cleared, so that each curve is
+        // simplified once. Use the unsimplified curve if it is at hand, but don't cache
+        // it just for this.
+        key.tolerance = 0;
+        i = mEntries.find( key );
+        key.tolerance = tolerance;
+        if( i != mEntries.end() ) {
+            curve.reset( new DecodedCurve( *i->second.curve, tolerance, mSimplifier ) );
+        }
+        else {
+            curve.reset( new DecodedCurve( DecodedCurve( e ), tolerance, mSimplifier ) );
+        }
+        mEntries[ key ].curve = curve;
+        return curve;
+    }
+    curve.reset( new DecodedCurve( e ) );
+    mRecent.push_front( key );
+    Entry& entry = mEntries[ key ];
+    entry.curve = curve;
+    entry.recent = mRecent.begin();
+    mNumPoints += curve->getNumPoints();
+    evict();
+    return curve;
+}
+
+sosicon::CurveView sosicon::CurveCache::
+get( ISosiElement* e, bool reverse, double tolerance ) {
+    return CurveView( find( e, tolerance ), reverse );
+}
+
+void sosicon::CurveCache::
+setCapacity( std::size_t capacity ) {
+    mCapacity = capacity;
+    evict();
+}
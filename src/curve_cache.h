@@ -0,0 +1,228 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __CURVE_CACHE_H__
+#define __CURVE_CACHE_H__
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "geometry_kernels.h"
+#include "profiler.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_north_east.h"
+#include "interface/i_sosi_element.h"
+
+namespace sosicon {
+
+    //! Decoded coordinates of one SOSI element
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Holds the NØ/NØH children of an element decoded to one contiguous coordinate array.
+        Heights are dropped, as no output format uses them.
+     */
+    class DecodedCurve {
+
+        //! All points in file order
+        geometry::PointArray mPoints;
+
+        double mXmin;
+        double mYmin;
+        double mXmax;
+        double mYmax;
+
+        DecodedCurve( const DecodedCurve& );
+        DecodedCurve& operator=( const DecodedCurve& );
+
+    public:
+
+        //! Decode the coordinates of e
+        DecodedCurve( ISosiElement* e );
+
+        //! Simplified copy of source
+        /*!
+            End points are always kept, so curves meeting at a junction still meet after
+            simplification. Closed curves keep at least four points.
+            \param source Curve to simplify.
+            \param tolerance See geometry::Simplifier::simplify().
+            \param simplifier Simplifier whose buffers to use.
+         */
+        DecodedCurve( const DecodedCurve& source, double tolerance, geometry::Simplifier& simplifier );
+
+        //! Points in file order
+        const geometry::PointArray& getPoints() const { return mPoints; }
+
+        //! Number of points
+        std::size_t getNumPoints() const { return mPoints.size() / 2; }
+
+        //! Grow the given bounding box to include this curve
+        void expandBoundingBox( double& minX, double& minY, double& maxX, double& maxY ) const;
+
+    }; // class DecodedCurve
+
+    //! Shared reference to a decoded curve
+    typedef std::shared_ptr<DecodedCurve> DecodedCurvePtr;
+
+    //! Read-only view of a decoded curve
+    /*!
+        Presents a decoded curve in either direction without touching the shared
+        points. Keeps the curve alive even if the cache evicts it.
+     */
+    class CurveView {
+
+        DecodedCurvePtr mCurve;
+        bool mReverse;
+
+    public:
+
+        //! Construct empty view
+        CurveView() : mReverse( false ) { }
+
+        //! Construct view of curve, optionally read last to first
+        CurveView( DecodedCurvePtr curve, bool reverse ) : mCurve( curve ), mReverse( reverse ) { }
+
+        //! Decoded curve, or null for an empty view
+        const DecodedCurvePtr& getCurve() const { return mCurve; }
+
+        //! Number of points
+        std::size_t size() const { return mCurve ? mCurve->getNumPoints() : 0; }
+
+        //! Append points to target in view order
+        void appendTo( geometry::PointArray& target ) const;
+
+    }; // class CurveView
+
+    //! Cache of decoded curves
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Every boundary curve in a SOSI file is referenced by the surfaces on both sides,
+        and is often exported as a curve feature as well. Decoding the NØ text of such a
+        curve once and sharing the result between all geometry builders saves most of
+        the coordinate parsing for surfaces.
+
+        Curves are keyed by serial number and simplification tolerance. The cache is
+        bounded by the total number of points it holds, and evicts the least recently
+        used curves first.
+
+        Simplified curves are not evicted, so each curve is simplified only once per
+        tolerance. Surfaces assembled from them keep the topology of the source: two
+        neighbours see the same simplified version of their common boundary. A
+        simplified curve is never larger than its source, which bounds the memory
+        this takes.
+
+        Serial numbers are only unique within a file, so the cache must be cleared before a new
+        file is parsed (sosicon::Pipeline::parse() does this).
+
+        Used from the converter thread only, like the element tree it is built from.
+     */
+    class CurveCache {
+
+        struct Key {
+            std::string serial;
+            double tolerance;
+            bool operator==( const Key& k ) const { return tolerance == k.tolerance && serial == k.serial; }
+        };
+
+        struct KeyHash {
+            std::size_t operator()( const Key& k ) const {
+                return std::hash<std::string>()( k.serial ) ^ std::hash<double>()( k.tolerance );
+            }
+        };
+
+        struct Entry {
+            DecodedCurvePtr curve;
+            std::list<Key>::iterator recent;
+        };
+
+        typedef std::unordered_map<Key, Entry, KeyHash> Entries;
+
+        static CurveCache* mInstance;
+
+        //! Cached curves by serial number and tolerance
+        Entries mEntries;
+
+        //! Keys of unsimplified curves, most recently used first
+        std::list<Key> mRecent;
+
+        //! Total number of points in the unsimplified curves of the cache
+        std::size_t mNumPoints;
+
+        //! Maximum number of points to keep
+        std::size_t mCapacity;
+
+        unsigned long long mHits;
+        unsigned long long mMisses;
+
+        //! Buffers for simplifying curves
+        geometry::Simplifier mSimplifier;
+
+        //! Look up a curve, or build and cache it on a miss
+        DecodedCurvePtr find( ISosiElement* e, double tolerance );
+
+        //! Declared private because it's a singleton
+        CurveCache();
+
+        //! Evict least recently used curves until the cache fits its capacity
+        void evict();
+
+    public:
+
+        //! Default capacity, in points
+        static const std::size_t DEFAULT_CAPACITY = 1 << 20;
+
+        static CurveCache* getInstance() {
+            if( 0 == mInstance ) {
+                mInstance = new CurveCache();
+            }
+            return mInstance;
+        }
+
+        //! Drop all cached curves
+        void clear();
+
+        //! Get decoded curve
+        /*!
+            Looks up e by its serial number, decoding and caching it on a miss.
+            Elements without a serial number are decoded without being cached.
+            \param e SOSI element holding NØ or NØH children.
+            \param reverse true to read the curve last to first.
+            \param tolerance If above 0, get the curve simplified to this tolerance.
+                             The simplified curve is built from the cached unsimplified
+                             one, and cached along with it.
+            \return View of the decoded curve.
+         */
+        CurveView get( ISosiElement* e, bool reverse = false, double tolerance = 0 );
+
+        unsigned long long getHits() const { return mHits; }
+
+        unsigned long long getMisses() const { return mMisses; }
+
+        //! Set maximum number of unsimplified points to keep. Zero disables caching them.
+        void setCapacity( std::size_t capacity );
+
+    }; // class CurveCache
+
+}; // namespace sosicon
+
+#endif
@@ -65,6 +65,10 @@ namespace sosicon {
             }
         }
 
+        bool empty() const {
+            return mListeners.empty();
+        }
+
         void Dispatch( Event& e ) {
             for( typename ListenerLst::iterator i = mListeners.begin(); i != mListeners.end(); i++ ) {
                 ( *i )->onEvent( e, *this );
@@ -39,6 +39,18 @@ get( sosicon::IConverter* &converter, sosicon::CommandLine* cmd ) {
         converter = new ConverterSosi2mysql();
         converter->init( cmd );
     }
+    else if( cmd->mCommand == "-2topojson" ) {
+        converter = new ConverterSosi2topojson();
+        converter->init( cmd );
+    }
+    else if( cmd->mCommand == "-2mvt" ) {
+        converter = new ConverterSosi2mvt();
+        converter->init( cmd );
+    }
+    else if( cmd->mCommand == "-2arrow" ) {
+        converter = new ConverterSosi2arrow();
+        converter->init( cmd );
+    }
     else if( cmd->mCommand == "-stat" ) {
         converter = new ConverterSosiStat();
         converter->init( cmd );
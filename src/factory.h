@@ -24,6 +24,9 @@
 #include "converter_sosi2tsv.h"
 #include "converter_sosi2psql.h"
 #include "converter_sosi2mysql.h"
+#include "converter_sosi2topojson.h"
+#include "converter_sosi2mvt.h"
+#include "converter_sosi2arrow.h"
 #include "converter_sosi_stat.h"
 
 namespace sosicon {
@@ -0,0 +1,52 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __FEATURE_EVENT_H__
+#define __FEATURE_EVENT_H__
+
+#include "event_dispatcher.h"
+#include "interface/i_sosi_element.h"
+
+namespace sosicon {
+
+    //! Feature event
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Emitted by the Parser for each completed top-level SOSI feature (PUNKT, KURVE, FLATE or
+        TEKST) when one or more feature listeners are attached. The feature element, including
+        its attribute subtree, is valid only for the duration of the onEvent() call.
+        FLATE features are emitted once every curve they reference has been parsed.
+
+        \sa sosicon::Parser::addFeatureListener()
+    */
+    class FeatureEvent {
+
+    public:
+        FeatureEvent( ISosiElement* feature )
+            : mFeature( feature ) { }
+
+        ISosiElement* mFeature;
+
+    }; // class FeatureEvent
+
+    class FeatureEventDispatcher : public EventDispatcher<FeatureEvent> { };
+
+} // namespace sosicon
+
+#endif
@@ -0,0 +1,401 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "feature_filter.h"
+
+int sosicon::FeatureFilter::
+addNode( Op op, int left, int right ) {
+    Node node;
+    node.op = op;
+    node.left = left;
+    node.right = right;
+    node.type = sosi::sosi_element_unknown;
+    node.number = 0;
+    node.numeric = false;
+    mNodes.push_back( node );
+    return static_cast<int>( mNodes.size() ) - 1;
+}
+
+bool sosicon::FeatureFilter::
+compile( const std::string& expression ) {
+    mNodes.clear();
+    mRoot = -1;
+    mError.clear();
+    mExpression = expression;
+    utils::utf8ToIso8859_1( expression, mExpression ); // Element names are ISO8859-1
+    mPos = 0;
+    if( peekToken().kind == token_end ) {
+        return true; // Empty expression, everything passes
+    }
+    int node = -1;
+    if( !parseExpression( node ) ) {
+        mNodes.clear();
+        return false;
+    }
+    if( peekToken().kind != token_end ) {
+        mNodes.clear();
+        return syntaxError( "unexpected " + peekToken().text );
+    }
+    mRoot = node;
+    return true;
+}
+
+bool sosicon::FeatureFilter::
+evaluate( int index, ISosiElement* e ) {
+
+    const Node& node = mNodes[ index ];
+
+    switch( node.op ) {
+        case op_and:
+            return evaluate( node.left, e ) && evaluate( node.right, e );
+        case op_or:
+            return evaluate( node.left, e ) || evaluate( node.right, e );
+        case op_not:
+            return !evaluate( node.left, e );
+        default:
+            break;
+    }
+
+    ISosiElement* attribute = findAttribute( e, node );
+    if( !attribute ) {
+        return false;
+    }
+    const std::string* data = &attribute->getData();
+    std::string converted;
+    sosi::SosiCharsetSingleton* cs = sosi::SosiCharsetSingleton::getInstance();
+    switch( cs->getEncoding() ) {
+        case sosi::sosi_charset_decn7:
+        case sosi::sosi_charset_dosn8:
+        case sosi::sosi_charset_nd7:
+        case sosi::sosi_charset_utf8:
+            converted = cs->toIso8859_1( *data );
+            data = &converted;
+            break;
+        default:
+            break; // Already ISO8859-1
+    }
+    std::string unquoted;
+    const std::string* value = data;
+    if( !data->empty() && ( ( *data )[ 0 ] == '"' || ( *data )[ 0 ] == '\'' ) ) {
+        unquoted = utils::unquote( *data );
+        value = &unquoted;
+    }
+
+    double number = 0;
+    int cmp = 0;
+    switch( node.op ) {
+        case op_prefix:
+            return value->compare( 0, node.value.size(), node.value ) == 0;
+        case op_in:
+            if( node.values.find( *value ) != node.values.end() ) {
+                return true;
+            }
+            for( std::vector<std::string>::const_iterator p = node.prefixes.begin(); p != node.prefixes.end(); p++ ) {
+                if( value->compare( 0, p->size(), *p ) == 0 ) {
+                    return true;
+                }
+            }
+            return false;
+        case op_eq:
+        case op_ne:
+            {
+                bool equal = *value == node.value || ( node.numeric && toNumber( *value, number ) && number == node.number );
+                return node.op == op_eq ? equal : !equal;
+            }
+        default:
+            if( node.numeric && toNumber( *value, number ) ) {
+                cmp = number < node.number ? -1 : number > node.number ? 1 : 0;
+            }
+            else {
+                cmp = value->compare( node.value );
+            }
+    }
+    switch( node.op ) {
+        case op_lt:
+            return cmp < 0;
+        case op_le:
+            return cmp <= 0;
+        case op_gt:
+            return cmp > 0;
+        case op_ge:
+            return cmp >= 0;
+        default:
+            return false;
+    }
+}
+
+sosicon::ISosiElement* sosicon::FeatureFilter::
+findAttribute( ISosiElement* e, const Node& node ) {
+    if( node.type != sosi::sosi_element_unknown ) {
+        sosi::ElementTypeMask bit = sosi::elementTypeBit( node.type );
+        if( ( e->getSubtreeTypes() & bit ) == 0 ) {
+            return 0;
+        }
+        sosi::SosiElementSearch src;
+        while( e->getChild( src ) ) {
+            ISosiElement* child = src.element();
+            if( child->getType() == node.type ) {
+                return child;
+            }
+            if( ( child->getSubtreeTypes() & bit ) != 0 ) {
+                ISosiElement* found = findAttribute( child, node );
+                if( found ) {
+                    return found;
+                }
+            }
+        }
+        return 0;
+    }
+    sosi::SosiElementSearch src;
+    while( e->getChild( src ) ) {
+        ISosiElement* child = src.element();
+        if( child->getName() == node.name ) {
+            return child;
+        }
+        ISosiElement* found = findAttribute( child, node );
+        if( found ) {
+            return found;
+        }
+    }
+    return 0;
+}
+
+bool sosicon::FeatureFilter::
+isKeyword( const Token& token, const char* keyword ) {
+    if( token.kind != token_word ) {
+        return false;
+    }
+    std::string::size_type i = 0;
+    for( ; i < token.text.size() && keyword[ i ]; i++ ) {
+        if( std::toupper( static_cast<unsigned char>( token.text[ i ] ) ) != keyword[ i ] ) {
+            return false;
+        }
+    }
+    return i == token.text.size() && !keyword[ i ];
+}
+
+sosicon::FeatureFilter::Token sosicon::FeatureFilter::
+nextToken() {
+    Token token;
+    const std::string& s = mExpression;
+    while( mPos < s.size() && std::isspace( static_cast<unsigned char>( s[ mPos ] ) ) ) {
+        mPos++;
+    }
+    if( mPos >= s.size() ) {
+        token.kind = token_end;
+        token.text = "end of expression";
+        return token;
+    }
+    char c = s[ mPos ];
+    if( c == '"' || c == '\'' ) {
+        std::string::size_type end = s.find( c, mPos + 1 );
+        if( end == std::string::npos ) {
+            end = s.size();
+        }
+        token.kind = token_string;
+        token.text = s.substr( mPos + 1, end - mPos - 1 );
+        mPos = std::min( end + 1, s.size() );
+    }
+    else if( c == '(' || c == ')' || c == ',' ) {
+        token.kind = token_symbol;
+        token.text = c;
+        mPos++;
+    }
+    else if( c == '=' || c == '!' || c == '<' || c == '>' ) {
+        token.kind = token_symbol;
+        token.text = c;
+        mPos++;
+        if( mPos < s.size() && ( s[ mPos ] == '=' || ( c == '<' && s[ mPos ] == '>' ) ) ) {
+            token.text += s[ mPos++ ];
+        }
+    }
+    else {
+        std::string::size_type start = mPos;
+        while( mPos < s.size() && !std::isspace( static_cast<unsigned char>( s[ mPos ] ) ) &&
+               std::string( "()',=!<>\"" ).find( s[ mPos ] ) == std::string::npos )
+        {
+            mPos++;
+        }
+        token.kind = token_word;
+        token.text = s.substr( start, mPos - start );
+    }
+    return token;
+}
+
+bool sosicon::FeatureFilter::
+parseComparison( const std::string& name, int& node ) {
+
+    Token op = nextToken();
+    node = addNode( op_eq );
+
+    sosi::SosiTranslationTable translation;
+    mNodes[ node ].type = translation.sosiNameToType( name );
+    mNodes[ node ].name = name;
+
+    if( isKeyword( op, "IN" ) ) {
+        mNodes[ node ].op = op_in;
+        if( nextToken().text != "(" ) {
+            return syntaxError( "expected ( after IN" );
+        }
+        for( ;; ) {
+            Token value = nextToken();
+            if( value.kind != token_word && value.kind != token_string ) {
+                return syntaxError( "expected value in IN-list, found " + value.text );
+            }
+            if( value.kind == token_word && !value.text.empty() && value.text[ value.text.size() - 1 ] == '*' ) {
+                mNodes[ node ].prefixes.push_back( value.text.substr( 0, value.text.size() - 1 ) );
+            }
+            else {
+                mNodes[ node ].values.insert( value.text );
+            }
+            Token separator = nextToken();
+            if( separator.text == ")" ) {
+                break;
+            }
+            if( separator.text != "," ) {
+                return syntaxError( "expected , or ) in IN-list, found " + separator.text );
+            }
+        }
+        return true;
+    }
+
+    if( op.kind != token_symbol ) {
+        return syntaxError( "expected operator after " + name + ", found " + op.text );
+    }
+    if( op.text == "=" ) {
+        mNodes[ node ].op = op_eq;
+    }
+    else if( op.text == "!=" || op.text == "<>" ) {
+        mNodes[ node ].op = op_ne;
+    }
+    else if( op.text == "<" ) {
+        mNodes[ node ].op = op_lt;
+    }
+    else if( op.text == "<=" ) {
+        mNodes[ node ].op = op_le;
+    }
+    else if( op.text == ">" ) {
+        mNodes[ node ].op = op_gt;
+    }
+    else if( op.text == ">=" ) {
+        mNodes[ node ].op = op_ge;
+    }
+    else {
+        return syntaxError( "unknown operator " + op.text );
+    }
+
+    Token value = nextToken();
+    if( value.kind != token_word && value.kind != token_string ) {
+        return syntaxError( "expected value after " + name + op.text + ", found " + value.text );
+    }
+    Node& n = mNodes[ node ];
+    n.value = value.text;
+    if( value.kind == token_word && n.op == op_eq && !n.value.empty() && n.value[ n.value.size() - 1 ] == '*' ) {
+        n.op = op_prefix;
+        n.value.erase( n.value.size() - 1 );
+    }
+    n.numeric = toNumber( n.value, n.number );
+    return true;
+}
+
+bool sosicon::FeatureFilter::
+parseExpression( int& node ) {
+    if( !parseTerm( node ) ) {
+        return false;
+    }
+    while( isKeyword( peekToken(), "OR" ) ) {
+        nextToken();
+        int right = -1;
+        if( !parseTerm( right ) ) {
+            return false;
+        }
+        node = addNode( op_or, node, right );
+    }
+    return true;
+}
+
+bool sosicon::FeatureFilter::
+parseFactor( int& node ) {
+    Token token = nextToken();
+    if( isKeyword( token, "NOT" ) ) {
+        int operand = -1;
+        if( !parseFactor( operand ) ) {
+            return false;
+        }
+        node = addNode( op_not, operand );
+        return true;
+    }
+    if( token.kind == token_symbol && token.text == "(" ) {
+        if( !parseExpression( node ) ) {
+            return false;
+        }
+        if( nextToken().text != ")" ) {
+            return syntaxError( "missing )" );
+        }
+        return true;
+    }
+    if( token.kind != token_word ) {
+        return syntaxError( "expected attribute name, found " + token.text );
+    }
+    std::string name = token.text;
+    for( std::string::iterator i = name.begin(); i != name.end(); i++ ) {
+        *i = static_cast<char>( std::toupper( static_cast<unsigned char>( *i ) ) );
+    }
+    return parseComparison( name, node );
+}
+
+bool sosicon::FeatureFilter::
+parseTerm( int& node ) {
+    if( !parseFactor( node ) ) {
+        return false;
+    }
+    while( isKeyword( peekToken(), "AND" ) ) {
+        nextToken();
+        int right = -1;
+        if( !parseFactor( right ) ) {
+            return false;
+        }
+        node = addNode( op_and, node, right );
+    }
+    return true;
+}
+
+sosicon::FeatureFilter::Token sosicon::FeatureFilter::
+peekToken() {
+    std::string::size_type pos = mPos;
+    Token token = nextToken();
+    mPos = pos;
+    return token;
+}
+
+bool sosicon::FeatureFilter::
+syntaxError( const std::string& message ) {
+    if( mError.empty() ) {
+        mError = message;
+    }
+    return false;
+}
+
+bool sosicon::FeatureFilter::
+toNumber( const std::string& str, double& number ) {
+    if( str.empty() || str.find_first_not_of( "0123456789+-.eE" ) != std::string::npos ) {
+        return false; // Also keeps strtod from reading nan, inf and hex
+    }
+    char* end = 0;
+    number = std::strtod( str.c_str(), &end );
+    return end == str.c_str() + str.size() && std::isfinite( number );
+}
@@ -0,0 +1,194 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __FEATURE_FILTER_H__
+#define __FEATURE_FILTER_H__
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "utils.h"
+#include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_element_search.h"
+#include "sosi/sosi_translation_table.h"
+#include "sosi/sosi_types.h"
+#include "interface/i_sosi_element.h"
+
+namespace sosicon {
+
+    //! Attribute filter
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Compiled form of the -where expression. The expression is parsed once, into a small
+        tree of comparisons that is evaluated for each feature as the parser completes it.
+        Attribute names known to the translation table are looked up by element type, which
+        also lets features without the attribute be rejected from their subtree type mask.
+        IN-lists are compiled into hash sets. The expression is converted from UTF-8 to
+        ISO8859-1 if it is valid UTF-8, and attribute values from the file's character set, so
+        names and values with æ, ø and å match the way the parser stores them.
+
+        \verbatim
+        expression  := term { OR term }
+        term        := factor { AND factor }
+        factor      := NOT factor | ( expression ) | comparison
+        comparison  := NAME op value | NAME IN ( value { , value } )
+        op          := = | != | <> | < | <= | > | >=
+        \endverbatim
+
+        Values may be quoted with ' or ". An unquoted value ending with * after = or in an
+        IN-list matches by prefix. The ordering operators compare numerically if both sides are numbers, and as
+        strings otherwise. Attributes may be nested at any level within the feature; the first
+        occurrence is used. Features without the attribute match no comparison.
+
+        Example: <tt>KOMM IN (0301,0219) AND DATAFANGSTDATO>=20100101</tt>
+     */
+    class FeatureFilter {
+
+        //! Expression node operators
+        enum Op {
+            op_and,
+            op_or,
+            op_not,
+            op_eq,
+            op_ne,
+            op_lt,
+            op_le,
+            op_gt,
+            op_ge,
+            op_prefix,
+            op_in
+        };
+
+        //! Expression node
+        struct Node {
+            Op op;                                  //!< Operator
+            int left;                               //!< First operand of and, or, not
+            int right;                              //!< Second operand of and, or
+            sosi::ElementType type;                 //!< Attribute type, or unknown
+            std::string name;                       //!< Attribute name, if type is unknown
+            std::string value;                      //!< Value to compare with
+            double number;                          //!< Value as number
+            bool numeric;                           //!< True if value is a number
+            std::unordered_set<std::string> values; //!< Values of an IN-list
+            std::vector<std::string> prefixes;      //!< Prefixes of an IN-list
+        };
+
+        //! Token kinds
+        enum TokenKind {
+            token_end,
+            token_word,
+            token_string,
+            token_symbol
+        };
+
+        //! Lexical token
+        struct Token {
+            TokenKind kind;
+            std::string text;
+        };
+
+        //! Compiled nodes
+        std::vector<Node> mNodes;
+
+        //! Index of the top node, or -1 if the filter is empty
+        int mRoot;
+
+        //! Expression being compiled
+        std::string mExpression;
+
+        //! Compile position in mExpression
+        std::string::size_type mPos;
+
+        //! Description of the last compile error
+        std::string mError;
+
+        //! Add node, returning its index
+        int addNode( Op op, int left = -1, int right = -1 );
+
+        //! Evaluate node for feature
+        bool evaluate( int node, ISosiElement* e );
+
+        //! Find first element of given attribute below e
+        ISosiElement* findAttribute( ISosiElement* e, const Node& node );
+
+        //! Read next token
+        Token nextToken();
+
+        //! Read next token without consuming it
+        Token peekToken();
+
+        //! Parse OR expression
+        bool parseExpression( int& node );
+
+        //! Parse AND term
+        bool parseTerm( int& node );
+
+        //! Parse NOT, parenthesis or comparison
+        bool parseFactor( int& node );
+
+        //! Parse comparison
+        bool parseComparison( const std::string& name, int& node );
+
+        //! Set compile error
+        bool syntaxError( const std::string& message );
+
+        //! Test token against keyword, ignoring case
+        static bool isKeyword( const Token& token, const char* keyword );
+
+        //! Parse value as finite decimal number
+        static bool toNumber( const std::string& str, double& number );
+
+    public:
+
+        //! Constructor
+        FeatureFilter() : mRoot( -1 ), mPos( 0 ) { }
+
+        //! Destructor
+        virtual ~FeatureFilter() { }
+
+        //! Compile filter expression
+        /*!
+            \param expression Filter expression, as given with -where.
+            \return False if the expression has syntax errors. The filter is then left empty,
+                    and error() describes the problem.
+         */
+        bool compile( const std::string& expression );
+
+        //! True if no expression has been compiled
+        bool empty() const { return mRoot < 0; }
+
+        //! Description of the last compile error
+        const std::string& error() const { return mError; }
+
+        //! Test feature against filter
+        /*!
+            \param e Top-level feature element.
+            \return True if the feature matches, or if the filter is empty.
+         */
+        bool match( ISosiElement* e ) { return mRoot < 0 || evaluate( mRoot, e ); }
+
+    }; // class FeatureFilter
+
+}; // namespace sosicon
+
+#endif
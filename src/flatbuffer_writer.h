@@ -0,0 +1,198 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __FLATBUFFER_WRITER_H__
+#define __FLATBUFFER_WRITER_H__
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace sosicon {
+
+    //! FlatBuffers encoder
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Minimal writer for the FlatBuffers binary format, covering what the Arrow IPC
+        metadata needs: tables of scalars and references, strings, and vectors of scalars,
+        references and structs.
+
+        As in the reference implementation, the buffer is built back to front: an object is
+        written before anything that refers to it, and every reference then points forward.
+        Objects are identified by their distance from the end of the buffer, which does not
+        change as more is prepended. Bytes are stored in reverse order, and the buffer is
+        turned around by finish().
+    */
+    class FlatBufferWriter {
+    public:
+
+        //! Position of an object, counted from the end of the buffer
+        typedef uint32_t Offset;
+
+    private:
+
+        //! Buffer content, last byte first
+        std::vector<unsigned char> mData;
+
+        //! Largest alignment required so far
+        std::size_t mMinAlign;
+
+        //! Size of the buffer when the current table was started
+        std::size_t mTableStart;
+
+        //! Fields of the current table, as field number and position
+        std::vector< std::pair<uint16_t, Offset> > mFields;
+
+        //! Current position
+        Offset size() const { return static_cast<Offset>( mData.size() ); }
+
+        //! Pad so that the buffer is aligned to alignment once extra bytes have been added
+        void align( std::size_t alignment, std::size_t extra = 0 ) {
+            if( alignment > mMinAlign ) {
+                mMinAlign = alignment;
+            }
+            while( ( mData.size() + extra ) % alignment != 0 ) {
+                mData.push_back( 0 );
+            }
+        }
+
+        //! Prepend little-endian scalar
+        template<typename T> void push( T value ) {
+            for( int i = sizeof( T ) - 1; i >= 0; i-- ) {
+                mData.push_back( static_cast<unsigned char>( static_cast<uint64_t>( value ) >> ( 8 * i ) ) );
+            }
+        }
+
+        //! Prepend reference to an object written earlier
+        void pushOffset( Offset target ) {
+            push<uint32_t>( size() + 4 - target );
+        }
+
+    public:
+
+        //! Constructor
+        FlatBufferWriter() : mMinAlign( 1 ), mTableStart( 0 ) { }
+
+        //! Write string
+        Offset string( const std::string& str ) {
+            align( 4, str.size() + 1 );
+            mData.push_back( 0 );
+            mData.insert( mData.end(), str.rbegin(), str.rend() );
+            push<uint32_t>( static_cast<uint32_t>( str.size() ) );
+            return size();
+        }
+
+        //! Write vector of scalars
+        template<typename T> Offset vector( const std::vector<T>& values ) {
+            align( sizeof( T ) > 4 ? sizeof( T ) : 4, values.size() * sizeof( T ) );
+            for( typename std::vector<T>::const_reverse_iterator i = values.rbegin(); i != values.rend(); i++ ) {
+                push<T>( *i );
+            }
+            push<uint32_t>( static_cast<uint32_t>( values.size() ) );
+            return size();
+        }
+
+        //! Write vector of references to tables or strings
+        Offset offsetVector( const std::vector<Offset>& values ) {
+            align( 4, values.size() * 4 );
+            for( std::vector<Offset>::const_reverse_iterator i = values.rbegin(); i != values.rend(); i++ ) {
+                pushOffset( *i );
+            }
+            push<uint32_t>( static_cast<uint32_t>( values.size() ) );
+            return size();
+        }
+
+        //! Write vector of structs made up of 64-bit words
+        /*!
+            A 32-bit member followed by padding is given as a 64-bit word of the same value.
+            \param words Members of all structs, in order.
+            \param wordsPerStruct Number of words in each struct.
+        */
+        Offset structVector( const std::vector<int64_t>& words, std::size_t wordsPerStruct ) {
+            align( 8, words.size() * 8 );
+            for( std::vector<int64_t>::const_reverse_iterator i = words.rbegin(); i != words.rend(); i++ ) {
+                push<int64_t>( *i );
+            }
+            push<uint32_t>( static_cast<uint32_t>( words.size() / wordsPerStruct ) );
+            return size();
+        }
+
+        //! Start table. Add its fields before calling endTable().
+        void startTable() {
+            mFields.clear();
+            mTableStart = mData.size();
+        }
+
+        //! Add scalar field to current table
+        template<typename T> void add( uint16_t field, T value ) {
+            align( sizeof( T ) );
+            push<T>( value );
+            mFields.push_back( std::make_pair( field, size() ) );
+        }
+
+        //! Add reference field to current table
+        void addOffset( uint16_t field, Offset target ) {
+            align( 4 );
+            pushOffset( target );
+            mFields.push_back( std::make_pair( field, size() ) );
+        }
+
+        //! Finish current table and write its vtable in front of it
+        Offset endTable() {
+            align( 4 );
+            push<int32_t>( 0 );
+            Offset table = size();
+            uint16_t numFields = 0;
+            for( std::size_t i = 0; i < mFields.size(); i++ ) {
+                numFields = std::max<uint16_t>( numFields, mFields[ i ].first + 1 );
+            }
+            std::vector<uint16_t> entries( numFields, 0 );
+            for( std::size_t i = 0; i < mFields.size(); i++ ) {
+                entries[ mFields[ i ].first ] = static_cast<uint16_t>( table - mFields[ i ].second );
+            }
+            for( int i = numFields - 1; i >= 0; i-- ) {
+                push<uint16_t>( entries[ i ] );
+            }
+            push<uint16_t>( static_cast<uint16_t>( table - mTableStart ) );
+            push<uint16_t>( static_cast<uint16_t>( 4 + 2 * numFields ) );
+            int32_t vtable = static_cast<int32_t>( size() - table );
+            for( int i = 0; i < 4; i++ ) {
+                mData[ table - 1 - i ] = static_cast<unsigned char>( static_cast<uint32_t>( vtable ) >> ( 8 * i ) );
+            }
+            return table;
+        }
+
+        //! Complete buffer with a reference to its root table
+        /*!
+            \param root Root table.
+            \return The finished buffer.
+        */
+        std::string finish( Offset root ) {
+            align( mMinAlign, 4 );
+            pushOffset( root );
+            return std::string( mData.rbegin(), mData.rend() );
+        }
+
+    }; // class FlatBufferWriter
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "geometry_kernels.h"
+
+#ifdef SOSICON_AVX2_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SOSICON_TARGET_AVX2
+#else
+#define SOSICON_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+namespace {
+
+    bool detectAvx2() {
+#if defined( SOSICON_AVX2_KERNELS ) && defined( _MSC_VER )
+        int info[ 4 ];
+        __cpuid( info, 0 );
+        if( info[ 0 ] < 7 ) {
+            return false;
+        }
+        __cpuid( info, 1 );
+        bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+        bool avx = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+        if( !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 ) {
+            return false; // The OS does not save the YMM registers
+        }
+        __cpuidex( info, 7, 0 );
+        return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#elif defined( SOSICON_AVX2_KERNELS )
+        __builtin_cpu_init();
+        return __builtin_cpu_supports( "avx2" ) != 0;
+#else
+        return false;
+#endif
+    }
+
+    //! Contribution of edge i to the shoelace sum, wrapping around after the last point
+    inline double edgeSum( const double* xy, std::size_t i, std::size_t n ) {
+        std::size_t j = i + 1 < n ? i + 1 : 0;
+        return ( xy[ 2 * j ] - xy[ 2 * i ] ) * ( xy[ 2 * j + 1 ] + xy[ 2 * i + 1 ] );
+    }
+
+    //! Area of the triangle formed by points a, b and c
+    inline double triangleArea( const double* xy, std::size_t a, std::size_t b, std::size_t c ) {
+        double area = ( xy[ 2 * a ] - xy[ 2 * c ] ) * ( xy[ 2 * b + 1 ] - xy[ 2 * a + 1 ] ) -
+                      ( xy[ 2 * a ] - xy[ 2 * b ] ) * ( xy[ 2 * c + 1 ] - xy[ 2 * a + 1 ] );
+        return 0.5 * ( area < 0 ? -area : area );
+    }
+
+}; // namespace
+
+bool sosicon::geometry::
+hasAvx2() {
+    static const bool avx2 = detectAvx2();
+    return avx2;
+}
+
+void sosicon::geometry::
+closeRing( PointArray& xy, std::size_t start ) {
+    std::size_t n = xy.size() / 2 - start;
+    if( n > 1 && !isClosed( &xy[ 2 * start ], n ) ) {
+        double x = xy[ 2 * start ];
+        double y = xy[ 2 * start + 1 ];
+        xy.push_back( x );
+        xy.push_back( y );
+    }
+}
+
+void sosicon::geometry::
+expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY ) {
+#ifdef SOSICON_AVX2_KERNELS
+    if( hasAvx2() ) {
+        avx2::expandBoundingBox( xy, n, minX, minY, maxX, maxY );
+        return;
+    }
+#endif
+    scalar::expandBoundingBox( xy, n, minX, minY, maxX, maxY );
+}
+
+bool sosicon::geometry::
+isClosed( const double* xy, std::size_t n ) {
+    return n > 1 && xy[ 0 ] == xy[ 2 * n - 2 ] && xy[ 1 ] == xy[ 2 * n - 1 ];
+}
+
+std::size_t sosicon::geometry::
+removeDuplicates( double* xy, std::size_t n ) {
+#ifdef SOSICON_AVX2_KERNELS
+    if( hasAvx2() ) {
+        return avx2::removeDuplicates( xy, n );
+    }
+#endif
+    return scalar::removeDuplicates( xy, n );
+}
+
+void sosicon::geometry::
+reversePoints( double* xy, std::size_t n ) {
+    for( std::size_t i = 0, j = n - 1; n > 0 && i < j; i++, j-- ) {
+        std::swap( xy[ 2 * i ], xy[ 2 * j ] );
+        std::swap( xy[ 2 * i + 1 ], xy[ 2 * j + 1 ] );
+    }
+}
+
+double sosicon::geometry::
+signedArea( const double* xy, std::size_t n ) {
+#ifdef SOSICON_AVX2_KERNELS
+    if( hasAvx2() ) {
+        return avx2::signedArea( xy, n );
+    }
+#endif
+    return scalar::signedArea( xy, n );
+}
+
+void sosicon::geometry::scalar::
+expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY ) {
+    for( std::size_t i = 0; i < n; i++ ) {
+        minX = std::min( minX, xy[ 2 * i ] );
+        minY = std::min( minY, xy[ 2 * i + 1 ] );
+        maxX = std::max( maxX, xy[ 2 * i ] );
+        maxY = std::max( maxY, xy[ 2 * i + 1 ] );
+    }
+}
+
+std::size_t sosicon::geometry::scalar::
+removeDuplicates( double* xy, std::size_t n ) {
+    if( n < 2 ) {
+        return n;
+    }
+    std::size_t kept = 1;
+    for( std::size_t i = 1; i < n; i++ ) {
+        if( xy[ 2 * i ] != xy[ 2 * kept - 2 ] || xy[ 2 * i + 1 ] != xy[ 2 * kept - 1 ] ) {
+            xy[ 2 * kept ] = xy[ 2 * i ];
+            xy[ 2 * kept + 1 ] = xy[ 2 * i + 1 ];
+            kept++;
+        }
+    }
+    return kept;
+}
+
+void sosicon::geometry::Simplifier::
+push( std::size_t index, double area ) {
+    mAreas[ index ] = area;
+    Candidate c = { area, index };
+    mHeap.push_back( c );
+    std::push_heap( mHeap.begin(), mHeap.end() );
+}
+
+std::size_t sosicon::geometry::Simplifier::
+simplify( double* xy, std::size_t n, double tolerance, std::size_t minPoints ) {
+    if( n < 3 || n <= minPoints || !( tolerance > 0 ) ) {
+        return n;
+    }
+    const std::size_t removed = n; // Marks a removed point in mPrev
+    double threshold = tolerance * tolerance;
+    mAreas.resize( n );
+    mPrev.resize( n );
+    mNext.resize( n );
+    mHeap.clear();
+    for( std::size_t i = 0; i < n; i++ ) {
+        mPrev[ i ] = i - 1;
+        mNext[ i ] = i + 1;
+    }
+    for( std::size_t i = 1; i + 1 < n; i++ ) {
+        push( i, triangleArea( xy, i - 1, i, i + 1 ) );
+    }
+
+    std::size_t remaining = n;
+    while( !mHeap.empty() && remaining > minPoints ) {
+        std::pop_heap( mHeap.begin(), mHeap.end() );
+        Candidate c = mHeap.back();
+        mHeap.pop_back();
+        if( mPrev[ c.index ] == removed || c.area != mAreas[ c.index ] ) {
+            continue; // Stale entry
+        }
+        if( c.area >= threshold ) {
+            break;
+        }
+        std::size_t p = mPrev[ c.index ];
+        std::size_t q = mNext[ c.index ];
+        mNext[ p ] = q;
+        mPrev[ q ] = p;
+        mPrev[ c.index ] = removed;
+        remaining--;
+        if( p > 0 ) {
+            push( p, std::max( triangleArea( xy, mPrev[ p ], p, q ), c.area ) );
+        }
+        if( q + 1 < n ) {
+            push( q, std::max( triangleArea( xy, p, q, mNext[ q ] ), c.area ) );
+        }
+    }
+
+    std::size_t kept = 0;
+    for( std::size_t i = 0; i < n; i = mNext[ i ] ) {
+        xy[ 2 * kept ] = xy[ 2 * i ];
+        xy[ 2 * kept + 1 ] = xy[ 2 * i + 1 ];
+        kept++;
+    }
+    return kept;
+}
+
+double sosicon::geometry::scalar::
+signedArea( const double* xy, std::size_t n ) {
+    double sum = 0.0;
+    for( std::size_t i = 0; i < n; i++ ) {
+        sum += edgeSum( xy, i, n );
+    }
+    return -0.5 * sum;
+}
+
+#ifdef SOSICON_AVX2_KERNELS
+
+SOSICON_TARGET_AVX2 void sosicon::geometry::avx2::
+expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY ) {
+    // Lanes hold x, y, x, y, so each load covers two points
+    __m256d lo = _mm256_set_pd( minY, minX, minY, minX );
+    __m256d hi = _mm256_set_pd( maxY, maxX, maxY, maxX );
+    std::size_t i = 0;
+    for( ; i + 1 < n; i += 2 ) {
+        __m256d p = _mm256_loadu_pd( xy + 2 * i );
+        lo = _mm256_min_pd( lo, p );
+        hi = _mm256_max_pd( hi, p );
+    }
+    double l[ 4 ], h[ 4 ];
+    _mm256_storeu_pd( l, lo );
+    _mm256_storeu_pd( h, hi );
+    minX = std::min( l[ 0 ], l[ 2 ] );
+    minY = std::min( l[ 1 ], l[ 3 ] );
+    maxX = std::max( h[ 0 ], h[ 2 ] );
+    maxY = std::max( h[ 1 ], h[ 3 ] );
+    scalar::expandBoundingBox( xy + 2 * i, n - i, minX, minY, maxX, maxY );
+}
+
+SOSICON_TARGET_AVX2 std::size_t sosicon::geometry::avx2::
+removeDuplicates( double* xy, std::size_t n ) {
+    if( n < 2 ) {
+        return n;
+    }
+    // Compare points i, i + 1 with their predecessors i - 1, i. A point is dropped if it equals
+    // its predecessor. Points are only written below the ones still to be read, or over
+    // themselves, so the comparisons always see the original values.
+    std::size_t kept = 1;
+    std::size_t i = 1;
+    for( ; i + 1 < n; i += 2 ) {
+        __m256d prev = _mm256_loadu_pd( xy + 2 * i - 2 );
+        __m256d curr = _mm256_loadu_pd( xy + 2 * i );
+        int eq = _mm256_movemask_pd( _mm256_cmp_pd( prev, curr, _CMP_EQ_OQ ) );
+        bool repeat0 = ( eq & 3 ) == 3;
+        bool repeat1 = ( eq & 12 ) == 12;
+        if( !repeat0 && !repeat1 ) {
+            _mm256_storeu_pd( xy + 2 * kept, curr );
+            kept += 2;
+        }
+        else {
+            if( !repeat0 ) {
+                xy[ 2 * kept ] = xy[ 2 * i ];
+                xy[ 2 * kept + 1 ] = xy[ 2 * i + 1 ];
+                kept++;
+            }
+            if( !repeat1 ) {
+                xy[ 2 * kept ] = xy[ 2 * i + 2 ];
+                xy[ 2 * kept + 1 ] = xy[ 2 * i + 3 ];
+                kept++;
+            }
+        }
+    }
+    if( i < n && ( xy[ 2 * i ] != xy[ 2 * i - 2 ] || xy[ 2 * i + 1 ] != xy[ 2 * i - 1 ] ) ) {
+        xy[ 2 * kept ] = xy[ 2 * i ];
+        xy[ 2 * kept + 1 ] = xy[ 2 * i + 1 ];
+        kept++;
+    }
+    return kept;
+}
+
+SOSICON_TARGET_AVX2 double sosicon::geometry::avx2::
+signedArea( const double* xy, std::size_t n ) {
+    // Two edges per iteration: ( x1 - x0 ) * ( y1 + y0 ) ends up in lanes 0 and 2
+    __m256d acc = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for( ; i + 2 < n; i += 2 ) {
+        __m256d a = _mm256_loadu_pd( xy + 2 * i );
+        __m256d b = _mm256_loadu_pd( xy + 2 * i + 2 );
+        __m256d d = _mm256_sub_pd( b, a );
+        __m256d s = _mm256_permute_pd( _mm256_add_pd( b, a ), 5 );
+        acc = _mm256_add_pd( acc, _mm256_mul_pd( d, s ) );
+    }
+    double lanes[ 4 ];
+    _mm256_storeu_pd( lanes, acc );
+    double sum = lanes[ 0 ] + lanes[ 2 ];
+    for( ; i < n; i++ ) {
+        sum += edgeSum( xy, i, n );
+    }
+    return -0.5 * sum;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __GEOMETRY_KERNELS_H__
+#define __GEOMETRY_KERNELS_H__
+
+#include <cstddef>
+#include <vector>
+
+#if defined( _M_X64 ) || ( defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) )
+//! Defined when the AVX2 kernels are compiled in. They are only used if the CPU supports them.
+#define SOSICON_AVX2_KERNELS
+#endif
+
+namespace sosicon {
+
+    //! Geometry kernels
+    /*!
+        Basic computations over contiguous coordinate arrays. Points are stored as interleaved
+        x (east), y (north) pairs, so a ring of n points occupies 2n doubles.
+
+        The functions in this namespace pick the AVX2 implementation at run time when the CPU
+        supports it, and the scalar one otherwise. Both are exposed for benchmarking.
+     */
+    namespace geometry {
+
+        //! Interleaved x (east), y (north) coordinate pairs
+        typedef std::vector<double> PointArray;
+
+        //! True if the AVX2 kernels are compiled in and supported by the CPU
+        bool hasAvx2();
+
+        //! Signed area of a ring
+        /*!
+            Computes the shoelace sum over the ring, including the edge from the last point back
+            to the first, so closed and open rings give the same result.
+            \param xy Interleaved coordinates.
+            \param n Number of points.
+            \return Area, positive for counter-clockwise and negative for clockwise rings.
+         */
+        double signedArea( const double* xy, std::size_t n );
+
+        //! Grow bounding box to include points
+        /*!
+            \param xy Interleaved coordinates.
+            \param n Number of points.
+            \param minX, minY, maxX, maxY Bounding box, updated in place.
+         */
+        void expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY );
+
+        //! Remove repeated points
+        /*!
+            Drops every point equal to the point before it, moving the remaining points down.
+            \param xy Interleaved coordinates, compacted in place.
+            \param n Number of points.
+            \return Number of points left.
+         */
+        std::size_t removeDuplicates( double* xy, std::size_t n );
+
+        //! True if the first and last points are equal
+        bool isClosed( const double* xy, std::size_t n );
+
+        //! Close ring
+        /*!
+            Appends the first point of the ring if it differs from the last one.
+            \param xy Coordinate array holding the ring at its end.
+            \param start Index of the first point of the ring.
+         */
+        void closeRing( PointArray& xy, std::size_t start );
+
+        //! Reverse point order
+        void reversePoints( double* xy, std::size_t n );
+
+        //! Visvalingam-Whyatt simplification
+        /*!
+            Removes the vertices that contribute least to the shape of a line or ring, one at a
+            time, until every remaining vertex spans a triangle with its neighbours of at least
+            tolerance² area. Removing a vertex changes the areas of its two neighbours only, so
+            with a binary heap the whole run is O(n log n). An area never drops below the area of
+            a vertex removed before it, so a vertex is never dropped before a less significant
+            one.
+
+            The end points are always kept. Simplification is done in place, and the working
+            buffers are kept between calls, so one instance should be reused for many features.
+            Not thread-safe.
+         */
+        class Simplifier {
+
+            struct Candidate {
+                double area;
+                std::size_t index;
+                bool operator<( const Candidate& c ) const { return area > c.area; } //!< Min-heap
+            };
+
+            std::vector<double> mAreas;
+            std::vector<std::size_t> mPrev;
+            std::vector<std::size_t> mNext;
+            std::vector<Candidate> mHeap;
+
+            void push( std::size_t index, double area );
+
+        public:
+
+            //! Simplify line or ring
+            /*!
+                \param xy Interleaved coordinates, compacted in place.
+                \param n Number of points.
+                \param tolerance Distance in coordinate units. Vertices with an effective area
+                                 below tolerance² are removed.
+                \param minPoints Never reduce the line below this number of points.
+                \return Number of points left.
+             */
+            std::size_t simplify( double* xy, std::size_t n, double tolerance, std::size_t minPoints );
+
+        }; // class Simplifier
+
+        //! Portable implementations
+        namespace scalar {
+            double signedArea( const double* xy, std::size_t n );
+            void expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY );
+            std::size_t removeDuplicates( double* xy, std::size_t n );
+        };
+
+#ifdef SOSICON_AVX2_KERNELS
+        //! AVX2 implementations. Must only be called if hasAvx2() returns true.
+        namespace avx2 {
+            double signedArea( const double* xy, std::size_t n );
+            void expandBoundingBox( const double* xy, std::size_t n, double& minX, double& minY, double& maxX, double& maxY );
+            std::size_t removeDuplicates( double* xy, std::size_t n );
+        };
+#endif
+
+    }; // namespace geometry
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __I_PIPELINE_JOB_H__
+#define __I_PIPELINE_JOB_H__
+
+namespace sosicon {
+
+    /*!
+        \addtogroup interfaces Interfaces
+        @{
+    */
+    //! Interface: Pipeline output job
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Unit of work handed to the output stage of a sosicon::Pipeline. run() is executed on
+        the pipeline's writer thread, so it must only touch data owned by the job itself: no
+        element tree, no logger. complete() is called afterwards on the converter's own thread,
+        and is the place to report the result.
+
+        \sa sosicon::Pipeline::submit()
+    */
+    class IPipelineJob {
+    public:
+
+        //! Destructor
+        virtual ~IPipelineJob() { };
+
+        //! Perform the job. Called on the writer thread.
+        virtual void run() = 0;
+
+        //! Report the result. Called on the converter thread once run() has returned.
+        virtual void complete() = 0;
+
+    };
+   /*! @} end group interfaces */
+}; // namespace sosicon
+
+#endif
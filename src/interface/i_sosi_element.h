@@ -47,6 +47,9 @@ namespace sosicon {
        associated with their unique keys, while collections of other data objects, such as
        address units and cadastral units, are retrieved one-by-one by sequential calls to 
        getData(). 
+
+       The string accessors return references into the element's own storage, which stay
+       valid for the lifetime of the element. Copy the value if it must outlive the element.
     */
     class ISosiElement {
 
@@ -58,21 +61,21 @@ namespace sosicon {
 		
 		virtual void addChild( ISosiElement* child ) = 0;
 
-        virtual std::string getName() = 0;
+        virtual const std::string& getName() = 0;
 
         virtual bool getChild( sosi::SosiElementSearch& src ) = 0;
 
-        virtual std::string getData() = 0;
+        virtual const std::string& getData() = 0;
 
         virtual int getLevel() = 0;
 
         virtual sosi::ElementType getType() = 0;
 
-        virtual std::string getObjType() = 0;
+        virtual const std::string& getObjType() = 0;
 
         virtual ISosiElement* getRoot() = 0;
 
-        virtual std::string getSerial() = 0;
+        virtual const std::string& getSerial() = 0;
 
         virtual void deleteChildren() = 0;
 
@@ -80,6 +83,18 @@ namespace sosicon {
 
         virtual ISosiElement* find( std::string ref ) = 0;
 
+        //! Types of the direct children of this element
+        virtual sosi::ElementTypeMask getChildTypes() = 0;
+
+        //! Types of all elements below this element
+        virtual sosi::ElementTypeMask getSubtreeTypes() = 0;
+
+        //! Merge types into the subtree mask of this element and its ancestors
+        virtual void addSubtreeTypes( sosi::ElementTypeMask types ) = 0;
+
+        //! Set parent element. Called by addChild().
+        virtual void setParent( ISosiElement* parent ) = 0;
+
     };
    /*! @} end group interfaces */
 
@@ -16,62 +16,176 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "logger.h"
-#include "sosi/sosi_charset_singleton.h"
 
 sosicon::Logger sosicon::logstream;
 
-sosicon::Logger&
-sosicon::Logger::operator << ( std::string v )
-{
-    static bool updateable = false;
-    std::cout << v.c_str();
-    if( v.find( "\r", 0 ) != std::string::npos ) {
-        std::string msgStr = sosicon::utils::purgeCrLf( sosicon::utils::trim( sosi::SosiCharsetSingleton::getInstance()->toIso8859_1( mMsgStream.str() ) ) );
-        if( !msgStr.empty() ) {
-            LogEvent e( sosicon::utils::purgeCrLf( mMsgStream.str() ), updateable );
-            updateable = true;
-            mMsgStream.str( std::string() );
-            mMsgStream << sosicon::utils::purgeCrLf( v );
-            mLogEventDispatcher.EventDispatcher<LogEvent>::Dispatch( e );
+sosicon::Logger::Pending::
+~Pending() {
+    if( !text.empty() ) {
+        logstream.submit( Record::record_text, text );
+    }
+}
+
+sosicon::Logger::Pending& sosicon::Logger::
+pending() {
+    static thread_local Pending p;
+    return p;
+}
+
+sosicon::Logger::
+~Logger() {
+    if( mStarted ) {
+        submit( Record::record_stop, std::string() );
+        mWriter.join();
+    }
+}
+
+void sosicon::Logger::
+append( const std::string& v ) {
+    std::string& text = pending().text;
+    if( !v.empty() && v[ 0 ] == '\r' && !text.empty() ) {
+        submit( Record::record_text, text );
+        text.clear();
+    }
+    text += v;
+    if( v.find( '\n' ) != std::string::npos ) {
+        submit( Record::record_text, text );
+        text.clear();
+    }
+}
+
+void sosicon::Logger::
+submit( Record::Kind kind, const std::string& text, std::atomic<bool>* done ) {
+    if( !mStarted.load( std::memory_order_acquire ) ) {
+        std::lock_guard<std::mutex> lock( mStartMutex );
+        if( !mStarted.load( std::memory_order_relaxed ) ) {
+            mWriter = std::thread( &Logger::writeRecords, this );
+            mStarted.store( true, std::memory_order_release );
+        }
+    }
+    Record r;
+    r.kind = kind;
+    r.text = text;
+    r.done = done;
+    mQueue.push( r );
+    std::lock_guard<std::mutex> lock( mWakeMutex ); // Not between the writer's check and its wait
+    mWake.notify_one();
+}
+
+void sosicon::Logger::
+writeRecords() {
+    Record r;
+    unsigned int rounds = 0;
+    for( ;; ) {
+        if( !mQueue.tryPop( r ) ) {
+            if( rounds == 0 ) {
+                std::cout << std::flush;
+            }
+            if( ++rounds < 64 ) {
+                std::this_thread::yield();
+            }
+            else {
+                std::unique_lock<std::mutex> lock( mWakeMutex );
+                mWake.wait( lock, [this]() { return !mQueue.empty(); } ); // record_stop is queued too
+            }
+            continue;
+        }
+        rounds = 0;
+        if( r.kind == Record::record_stop ) {
+            break;
         }
+        if( r.kind == Record::record_sync ) {
+            std::cout << std::flush;
+            r.done->store( true, std::memory_order_release );
+            continue;
+        }
+        write( r.text );
+    }
+    std::cout << std::flush;
+}
+
+void sosicon::Logger::
+write( const std::string& text ) {
+    std::cout << text;
+    std::lock_guard<std::mutex> lock( mListenerMutex );
+    if( mLogEventDispatcher.empty() ) {
+        return;
     }
-    else if( v.find( "\n", 0 ) != std::string::npos ) {
-        mMsgStream << v;
-        updateable = false;
-        std::string msgStr = sosicon::utils::purgeCrLf( sosicon::utils::trim( sosi::SosiCharsetSingleton::getInstance()->toIso8859_1( mMsgStream.str() ) ) );
+    for( std::string::const_iterator c = text.begin(); c != text.end(); c++ ) {
+        if( *c != '\r' && *c != '\n' ) {
+            mMessage += *c;
+            continue;
+        }
+        std::string msgStr = sosicon::utils::trim( mMessage );
+        mMessage.clear();
         if( !msgStr.empty() ) {
-            LogEvent e( msgStr, updateable );
+            LogEvent e( msgStr, mUpdate );
             mLogEventDispatcher.EventDispatcher<LogEvent>::Dispatch( e );
+            mUpdate = *c == '\r';
         }
-        mMsgStream.str( std::string() );
     }
-    else {
-        mMsgStream << v;
+}
+
+void sosicon::Logger::
+flush() {
+    std::string& text = pending().text;
+    if( !text.empty() ) {
+        submit( Record::record_text, text );
+        text.clear();
+    }
+}
+
+void sosicon::Logger::
+drain() {
+    flush();
+    if( mStarted.load( std::memory_order_acquire ) ) {
+        std::atomic<bool> done( false );
+        submit( Record::record_sync, std::string(), &done );
+        unsigned int rounds = 0;
+        while( !done.load( std::memory_order_acquire ) ) {
+            BoundedQueue<Record>::wait( rounds );
+        }
     }
+}
+
+void sosicon::Logger::
+addEventListener( LogEventDispatcher::Listener *listener ) {
+    std::lock_guard<std::mutex> lock( mListenerMutex );
+    mLogEventDispatcher.addEventListener( listener );
+}
+
+void sosicon::Logger::
+removeEventListener( LogEventDispatcher::Listener *listener ) {
+    drain();
+    std::lock_guard<std::mutex> lock( mListenerMutex );
+    mLogEventDispatcher.removeEventListener( listener );
+}
+
+sosicon::Logger&
+sosicon::Logger::operator << ( std::string v )
+{
+    append( v );
     return *this;
 }
 
 sosicon::Logger&
 sosicon::Logger::operator << ( std::string::size_type v )
 {
-    mMsgStream << v;
-    std::cout << v;
+    append( std::to_string( v ) );
     return *this;
 }
 
 sosicon::Logger&
 sosicon::Logger::operator << ( int v )
 {
-    mMsgStream << v;
-    std::cout << v;
+    append( std::to_string( v ) );
     return *this;
 }
 
 sosicon::Logger&
 sosicon::Logger::operator << ( long v )
 {
-    mMsgStream << v;
-    std::cout << v;
+    append( std::to_string( v ) );
     return *this;
 }
 
@@ -84,6 +198,6 @@ sosicon::Logger::operator << ( sosicon::Logger& ( *func ) ( sosicon::Logger& ) )
 sosicon::Logger&
 sosicon::flush( sosicon::Logger& l )
 {
-    std::cout << std::flush;
+    l.flush();
     return l;
 }
@@ -21,10 +21,15 @@
 #include "utils.h"
 #include "log_event.h"
 #include "event_dispatcher.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <algorithm>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 
 namespace sosicon {
 
@@ -33,23 +38,104 @@ namespace sosicon {
         \author Espen Andersen
         \copyright GNU General Public License
 
-        User output logger. Redirects to stdin, or a dedicated ILogReceiver implementation.
+        User output logger. Redirects to stdout, and to any LogEvent listeners.
+
+        Output is written by a background thread, so logging never waits for the terminal.
+        Each thread collects its text until a line is complete, a progress line is replaced
+        (text starting with \\r), or the stream is flushed, and then queues it as one record.
+        Lines from parallel workers are therefore never mixed up. Use drain() before writing
+        to std::cout directly.
     */
     class Logger {
 
+        //! Queued output
+        struct Record {
+            enum Kind {
+                record_text,    //!< Text to write
+                record_sync,    //!< Flush std::cout and set done
+                record_stop     //!< Stop the writer thread
+            };
+            Kind kind;                  //!< Record type
+            std::string text;           //!< Text, for record_text
+            std::atomic<bool>* done;    //!< Set when written, for record_sync
+            Record() : kind( record_text ), done( 0 ) { }
+        };
+
+        //! Text logged by one thread since its last record
+        struct Pending {
+            std::string text;   //!< Incomplete output
+            ~Pending();         //!< Queue what is left when the thread ends
+        };
+
+        //! Number of records that may wait for the writer
+        static const std::size_t QUEUE_CAPACITY = 1024;
+
         LogEventDispatcher mLogEventDispatcher;
-        std::stringstream mMsgStream;
+
+        //! Guards the listener list, which the writer thread reads
+        std::mutex mListenerMutex;
+
+        //! Records waiting for the writer
+        MpscQueue<Record> mQueue;
+
+        //! Writer thread, started with the first record
+        std::thread mWriter;
+
+        //! True once mWriter has been started
+        std::atomic<bool> mStarted;
+
+        //! Guards starting the writer
+        std::mutex mStartMutex;
+
+        //! Wakes the idle writer
+        std::condition_variable mWake;
+
+        //! Used with mWake
+        std::mutex mWakeMutex;
+
+        //! Message being collected for the listeners. Writer thread only.
+        std::string mMessage;
+
+        //! True if the next message replaces the previous one. Writer thread only.
+        bool mUpdate;
+
+        //! Pending output of the calling thread
+        static Pending& pending();
+
+        //! Add text from the calling thread
+        void append( const std::string& v );
+
+        //! Queue record
+        void submit( Record::Kind kind, const std::string& text, std::atomic<bool>* done = 0 );
+
+        //! Writer thread main loop
+        void writeRecords();
+
+        //! Write text to stdout and pass complete messages to the listeners
+        void write( const std::string& text );
 
     public:
 
+        //! Constructor
+        Logger() : mQueue( QUEUE_CAPACITY ), mStarted( false ), mUpdate( false ) { }
+
+        //! Destructor. Writes all queued output.
+        ~Logger();
+
         Logger& operator << ( std::string v );
         Logger& operator << ( int v );
         Logger& operator << ( long v );
         Logger& operator << ( std::string::size_type v );
         Logger& operator << ( Logger& ( *func ) ( Logger& ) );
 
-        void addEventListener( LogEventDispatcher::Listener *listener ) { mLogEventDispatcher.addEventListener( listener ); }
-        void removeEventListener( LogEventDispatcher::Listener *listener ) { mLogEventDispatcher.removeEventListener( listener ); }
+        //! Queue the calling thread's pending output
+        void flush();
+
+        //! Wait until everything logged so far has been written
+        void drain();
+
+        void addEventListener( LogEventDispatcher::Listener *listener );
+        void removeEventListener( LogEventDispatcher::Listener *listener );
     };
     Logger& flush( Logger& l );
     extern Logger logstream;
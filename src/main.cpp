@@ -23,9 +23,16 @@ int main ( int argc, char* argv[] ) {
 
     sosicon::CommandLine cmd;
     cmd.parse( argc, argv );
+    if( !cmd.mProfile.empty() ) {
+        sosicon::Profiler::enable();
+    }
 
     int res;
 
+    if( !cmd.mValid ) {
+        return -1;
+    }
+
     try {
         sosicon::IConverter* converter = 0;
         sosicon::Factory::get( converter, &cmd );
@@ -33,6 +40,14 @@ int main ( int argc, char* argv[] ) {
             converter->run();
             sosicon::Factory::release( converter );
         }
+        if( !cmd.mProfile.empty() ) {
+            if( sosicon::Profiler::write( cmd.mProfile, cmd.mCommand ) ) {
+                sosicon::logstream << "Profile written to " << cmd.mProfile << "\n";
+            }
+            else {
+                sosicon::logstream << "Profile could not be written to " << cmd.mProfile << "\n";
+            }
+        }
         res = 0;
     }
     catch( std::exception ex ) {
@@ -25,6 +25,7 @@
 #include "command_line.h"
 #include "factory.h"
 #include "logger.h"
+#include "profiler.h"
 #include "interface/i_converter.h"
 
 //! Application root
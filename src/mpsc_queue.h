@@ -0,0 +1,139 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __MPSC_QUEUE_H__
+#define __MPSC_QUEUE_H__
+
+#include <atomic>
+#include <utility>
+#include <vector>
+#include "bounded_queue.h"
+
+namespace sosicon {
+
+    //! Bounded multiple-producer, single-consumer queue
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Fixed-size ring buffer that any number of threads may push to, and one thread pops
+        from. Each slot carries a sequence number telling whether it is free for the
+        producer claiming that position or filled for the consumer. Producers claim
+        positions with a compare-and-swap on the tail counter, so none of them takes a
+        lock, and a slow producer only holds up the consumer at its own slot.
+
+        The capacity is rounded up to a power of two. Waits use BoundedQueue::wait().
+    */
+    template<typename T>
+    class MpscQueue {
+
+        //! Ring buffer entry
+        struct Slot {
+            std::atomic<std::size_t> sequence; //!< Position + 1 when filled, position when free
+            T item;                            //!< Queued item
+        };
+
+        //! Ring buffer storage
+        std::vector<Slot> mSlots;
+
+        //! Capacity - 1
+        std::size_t mMask;
+
+        //! Number of positions claimed by producers
+        std::atomic<std::size_t> mTail;
+
+        //! Number of items popped. Written by the consumer only.
+        std::atomic<std::size_t> mHead;
+
+        MpscQueue( const MpscQueue& );
+        MpscQueue& operator = ( const MpscQueue& );
+
+        //! Smallest power of two not less than n
+        static std::size_t roundUp( std::size_t n ) {
+            std::size_t size = 1;
+            while( size < n ) {
+                size <<= 1;
+            }
+            return size;
+        }
+
+    public:
+
+        //! Construct queue holding at least \a capacity items
+        explicit MpscQueue( std::size_t capacity ) : mSlots( roundUp( capacity ) ) {
+            mMask = mSlots.size() - 1;
+            for( std::size_t i = 0; i < mSlots.size(); i++ ) {
+                mSlots[ i ].sequence.store( i, std::memory_order_relaxed );
+            }
+            mTail = 0;
+            mHead = 0;
+        }
+
+        //! Push item if there is room. Any thread.
+        bool tryPush( const T& item ) {
+            std::size_t pos = mTail.load( std::memory_order_relaxed );
+            for( ;; ) {
+                Slot& slot = mSlots[ pos & mMask ];
+                std::size_t seq = slot.sequence.load( std::memory_order_acquire );
+                if( seq == pos ) {
+                    if( mTail.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                        slot.item = item;
+                        slot.sequence.store( pos + 1, std::memory_order_release );
+                        return true;
+                    }
+                }
+                else if( seq < pos ) {
+                    return false; // Full: the consumer has not freed this slot yet
+                }
+                else {
+                    pos = mTail.load( std::memory_order_relaxed );
+                }
+            }
+        }
+
+        //! Pop item if there is one. Consumer only.
+        bool tryPop( T& item ) {
+            std::size_t pos = mHead.load( std::memory_order_relaxed );
+            Slot& slot = mSlots[ pos & mMask ];
+            if( slot.sequence.load( std::memory_order_acquire ) != pos + 1 ) {
+                return false;
+            }
+            item = std::move( slot.item );
+            slot.sequence.store( pos + mMask + 1, std::memory_order_release );
+            mHead.store( pos + 1, std::memory_order_relaxed );
+            return true;
+        }
+
+        //! True if tryPop() would fail. Consumer only.
+        bool empty() const {
+            std::size_t pos = mHead.load( std::memory_order_relaxed );
+            return mSlots[ pos & mMask ].sequence.load( std::memory_order_acquire ) != pos + 1;
+        }
+
+        //! Push item, waiting for room. Any thread.
+        void push( const T& item ) {
+            unsigned int rounds = 0;
+            while( !tryPush( item ) ) {
+                BoundedQueue<T>::wait( rounds );
+            }
+        }
+
+    }; // class MpscQueue
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "parse_cache.h"
+#include "parser.h"
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined( _WIN32 ) || defined( _WIN64 )
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+    const char CACHE_MAGIC[ 8 ] = { 'S', 'O', 'S', 'I', 'C', 'A', 'C', 'H' };
+    const uint32_t CACHE_VERSION = 2;
+    const uint32_t CACHE_BYTE_ORDER_MARK = 0x01020304;
+
+    //! Number of bytes hashed at each end of the source file
+    const long HASH_SPAN = 64 * 1024;
+
+    //! FNV-1a, 64 bit
+    uint64_t fnv1a( const char* buf, size_t len, uint64_t hash ) {
+        for( size_t i = 0; i < len; i++ ) {
+            hash ^= static_cast<unsigned char>( buf[ i ] );
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+}; // namespace
+
+sosicon::ParseCache::
+ParseCache( const std::string& sourceFile ) {
+    mSourceFile = sourceFile;
+    mCacheFile = sourceFile + ".sosicache";
+    mMapped = 0;
+    mMappedSize = 0;
+}
+
+sosicon::ParseCache::
+~ParseCache() {
+    unmap();
+}
+
+bool sosicon::ParseCache::
+identify( Header& header ) {
+    struct stat st;
+    if( stat( mSourceFile.c_str(), &st ) != 0 ) {
+        return false;
+    }
+    header.sourceSize = static_cast<uint64_t>( st.st_size );
+    header.sourceMtime = static_cast<int64_t>( st.st_mtime );
+
+    FILE* fp = fopen( mSourceFile.c_str(), "rb" );
+    if( !fp ) {
+        return false;
+    }
+    std::vector<char> buf( HASH_SPAN );
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t n = fread( &buf[ 0 ], 1, buf.size(), fp );
+    hash = fnv1a( &buf[ 0 ], n, hash );
+    if( st.st_size > HASH_SPAN ) {
+        fseek( fp, -HASH_SPAN, SEEK_END );
+        n = fread( &buf[ 0 ], 1, buf.size(), fp );
+        hash = fnv1a( &buf[ 0 ], n, hash );
+    }
+    fclose( fp );
+    header.sourceHash = hash;
+    return true;
+}
+
+sosicon::ParseCache::PoolString sosicon::ParseCache::
+intern( const std::string& str ) {
+    PoolString ps;
+    ps.length = str.length();
+    if( str.length() <= MAX_INTERNED_LENGTH ) {
+        std::unordered_map<std::string, uint64_t>::iterator i = mInterned.find( str );
+        if( i != mInterned.end() ) {
+            ps.offset = i->second;
+            return ps;
+        }
+        mInterned[ str ] = mPool.size();
+    }
+    ps.offset = mPool.size();
+    mPool.append( str );
+    return ps;
+}
+
+bool sosicon::ParseCache::
+inPool( const PoolString& str, uint64_t poolSize ) {
+    return str.offset <= poolSize && str.length <= poolSize - str.offset;
+}
+
+bool sosicon::ParseCache::
+load( Parser& parser, int& lines ) {
+
+    if( !utils::fileExists( mCacheFile ) || !map() ) {
+        return false;
+    }
+
+    Header source;
+    const Header* header = reinterpret_cast<const Header*>( mMapped );
+    bool valid = mMappedSize >= sizeof( Header ) &&
+                 memcmp( header->magic, CACHE_MAGIC, sizeof CACHE_MAGIC ) == 0 &&
+                 header->version == CACHE_VERSION &&
+                 header->byteOrderMark == CACHE_BYTE_ORDER_MARK &&
+                 identify( source ) &&
+                 header->sourceSize == source.sourceSize &&
+                 header->sourceMtime == source.sourceMtime &&
+                 header->sourceHash == source.sourceHash &&
+                 header->elementCount <= ( mMappedSize - sizeof( Header ) ) / sizeof( Record ) &&
+                 header->poolSize == mMappedSize - sizeof( Header ) - header->elementCount * sizeof( Record );
+
+    const Record* records = reinterpret_cast<const Record*>( mMapped + sizeof( Header ) );
+    for( uint32_t i = 0; valid && i < header->elementCount; i++ ) {
+        const Record& r = records[ i ];
+        valid = inPool( r.name, header->poolSize ) && inPool( r.serial, header->poolSize ) && inPool( r.data, header->poolSize );
+    }
+
+    if( !valid ) {
+        sosicon::logstream << "Cache " << mCacheFile << " is out of date\n";
+        unmap();
+        return false;
+    }
+
+    const char* pool = mMapped + sizeof( Header ) + header->elementCount * sizeof( Record );
+    std::string name, serial, data;
+    for( uint32_t i = 0; i < header->elementCount; i++ ) {
+        const Record& r = records[ i ];
+        name.assign( pool + r.name.offset, static_cast<size_t>( r.name.length ) );
+        serial.assign( pool + r.serial.offset, static_cast<size_t>( r.serial.length ) );
+        data.assign( pool + r.data.offset, static_cast<size_t>( r.data.length ) );
+        parser.appendElement( name, serial, data, r.level );
+    }
+    lines = static_cast<int>( header->lines );
+    sosicon::logstream << "Read " << static_cast<long>( header->elementCount ) << " elements from " << mCacheFile << "\n";
+    unmap();
+    return true;
+}
+
+bool sosicon::ParseCache::
+map() {
+#if defined( _WIN32 ) || defined( _WIN64 )
+    std::ifstream ifs( mCacheFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate );
+    if( !ifs ) {
+        return false;
+    }
+    std::streamoff size = ifs.tellg();
+    ifs.seekg( 0 );
+    mBuffer.resize( static_cast<size_t>( size ) );
+    if( size > 0 && !ifs.read( &mBuffer[ 0 ], size ) ) {
+        mBuffer.clear();
+        return false;
+    }
+    mMapped = mBuffer.empty() ? 0 : &mBuffer[ 0 ];
+    mMappedSize = mBuffer.size();
+#else
+    int fd = open( mCacheFile.c_str(), O_RDONLY );
+    if( fd < 0 ) {
+        return false;
+    }
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+        close( fd );
+        return false;
+    }
+    void* p = mmap( 0, static_cast<size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED ) {
+        return false;
+    }
+    madvise( p, static_cast<size_t>( st.st_size ), MADV_SEQUENTIAL );
+    mMapped = static_cast<const char*>( p );
+    mMappedSize = static_cast<size_t>( st.st_size );
+#endif
+    return mMapped != 0;
+}
+
+void sosicon::ParseCache::
+record( const std::string& name, const std::string& serial, const std::string& data, int level ) {
+    Record r;
+    r.name = intern( name );
+    r.serial = intern( serial );
+    r.data = intern( data );
+    r.level = level;
+    r.reserved = 0;
+    mRecords.push_back( r );
+}
+
+bool sosicon::ParseCache::
+save( int lines ) {
+
+    Header header;
+    memset( &header, 0x00, sizeof header );
+    if( mRecords.size() > UINT32_MAX || !identify( header ) ) {
+        return false;
+    }
+    memcpy( header.magic, CACHE_MAGIC, sizeof CACHE_MAGIC );
+    header.version = CACHE_VERSION;
+    header.byteOrderMark = CACHE_BYTE_ORDER_MARK;
+    header.lines = static_cast<uint32_t>( lines );
+    header.elementCount = static_cast<uint32_t>( mRecords.size() );
+    header.poolSize = mPool.size();
+
+    // Write to temporary file first, so that an interrupted run never leaves a
+    // truncated cache behind.
+    std::string tmpFile = mCacheFile + ".tmp";
+    FILE* fp = fopen( tmpFile.c_str(), "wb" );
+    if( !fp ) {
+        sosicon::logstream << "Unable to write " << mCacheFile << "\n";
+        return false;
+    }
+    bool ok = fwrite( &header, sizeof header, 1, fp ) == 1;
+    if( ok && !mRecords.empty() ) {
+        ok = fwrite( &mRecords[ 0 ], sizeof( Record ), mRecords.size(), fp ) == mRecords.size();
+    }
+    if( ok && !mPool.empty() ) {
+        ok = fwrite( mPool.data(), 1, mPool.size(), fp ) == mPool.size();
+    }
+    ok = fclose( fp ) == 0 && ok;
+    remove( mCacheFile.c_str() );
+    if( !ok || rename( tmpFile.c_str(), mCacheFile.c_str() ) != 0 ) {
+        remove( tmpFile.c_str() );
+        sosicon::logstream << "Unable to write " << mCacheFile << "\n";
+        return false;
+    }
+    sosicon::logstream << "Wrote " << static_cast<long>( mRecords.size() ) << " elements to " << mCacheFile << "\n";
+
+    mRecords.clear();
+    mPool.clear();
+    mInterned.clear();
+    return true;
+}
+
+void sosicon::ParseCache::
+unmap() {
+#if defined( _WIN32 ) || defined( _WIN64 )
+    mBuffer.clear();
+#else
+    if( mMapped ) {
+        munmap( const_cast<char*>( mMapped ), mMappedSize );
+    }
+#endif
+    mMapped = 0;
+    mMappedSize = 0;
+}
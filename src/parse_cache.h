@@ -0,0 +1,174 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PARSE_CACHE_H__
+#define __PARSE_CACHE_H__
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "logger.h"
+#include "utils.h"
+
+namespace sosicon {
+
+    class Parser;
+
+    //! Persistent parse cache
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Binary snapshot of the element sequence produced by the parser for one SOSI file,
+        stored next to the source file as <file>.sosicache. When the cache is valid, the
+        elements are fed straight back into a Parser instance, skipping the line-by-line
+        Ragel parsing of the source file.
+
+        The cache file is laid out as follows, with all offsets relative to the start of the
+        string pool so that the file can be memory-mapped at any address:
+
+        \verbatim
+        Header      Magic, format version, byte order mark, source file identity and counts
+        Elements    One fixed-size Record per element, in document (pre-order) sequence
+        String pool Element names, serials and data. Short strings are interned.
+        \endverbatim
+
+        The source file identity is its size, modification time and a hash of its first and
+        last 64 KiB. If any of these differ, or a record points outside the string pool, the
+        cache is considered stale and is rebuilt. Pool offsets are 64 bit: nearly every N
+        string is unique, so the pool grows to about the size of the source file.
+     */
+    class ParseCache {
+
+        //! Cache file header
+        struct Header {
+            char magic[ 8 ];          //!< "SOSICACH"
+            uint32_t version;         //!< Cache format version
+            uint32_t byteOrderMark;   //!< 0x01020304 in host byte order
+            uint64_t sourceSize;      //!< Size of source file in bytes
+            int64_t sourceMtime;      //!< Modification time of source file
+            uint64_t sourceHash;      //!< Partial content hash of source file
+            uint32_t lines;           //!< Number of lines in source file
+            uint32_t elementCount;    //!< Number of element records
+            uint64_t poolSize;        //!< Size of string pool in bytes
+        };
+
+        //! Reference to string in pool
+        struct PoolString {
+            uint64_t offset;          //!< Offset from start of string pool
+            uint64_t length;          //!< Length in bytes
+        };
+
+        //! Element record
+        struct Record {
+            PoolString name;          //!< Element name, without leading dots
+            PoolString serial;        //!< Serial number, if any
+            PoolString data;          //!< Unparsed element data
+            int32_t level;            //!< Nesting level
+            int32_t reserved;         //!< Zero, pads the record to a multiple of 8 bytes
+        };
+
+        //! Strings longer than this are stored without interning
+        static const std::string::size_type MAX_INTERNED_LENGTH = 64;
+
+        //! Path to SOSI source file
+        std::string mSourceFile;
+
+        //! Path to cache file
+        std::string mCacheFile;
+
+        //! Records collected while parsing
+        std::vector<Record> mRecords;
+
+        //! String pool collected while parsing
+        std::string mPool;
+
+        //! Interned strings, by pool offset
+        std::unordered_map<std::string, uint64_t> mInterned;
+
+        //! Mapped cache file content
+        const char* mMapped;
+
+        //! Size of mapped cache file content
+        size_t mMappedSize;
+
+        //! Buffer holding cache file content where memory mapping is unavailable
+        std::vector<char> mBuffer;
+
+        //! Compute identity of source file
+        /*!
+            \param header Header to receive size, modification time and hash.
+            \return False if the source file could not be read.
+         */
+        bool identify( Header& header );
+
+        //! Add string to pool
+        PoolString intern( const std::string& str );
+
+        //! Check that string lies within a pool of \a poolSize bytes
+        static bool inPool( const PoolString& str, uint64_t poolSize );
+
+        //! Map cache file into memory
+        bool map();
+
+        //! Release mapped cache file
+        void unmap();
+
+    public:
+
+        //! Constructor
+        /*!
+            \param sourceFile Path to the SOSI file to be cached.
+         */
+        ParseCache( const std::string& sourceFile );
+
+        //! Destructor
+        ~ParseCache();
+
+        //! Load cached elements into parser
+        /*!
+            Maps the cache file and verifies it against the source file. If the cache is
+            valid, all elements are appended to the parser in their original sequence.
+            Parser::complete() must still be called afterwards.
+            \param parser Parser to receive the elements.
+            \param lines Receives the number of lines in the source file.
+            \return False if no valid cache was found, in which case the parser is untouched.
+         */
+        bool load( Parser& parser, int& lines );
+
+        //! Record element
+        /*!
+            Called by the parser for each element it creates while the cache is attached.
+            \sa sosicon::Parser::setCache()
+         */
+        void record( const std::string& name, const std::string& serial, const std::string& data, int level );
+
+        //! Write cache file
+        /*!
+            Writes the recorded elements to the cache file.
+            \param lines Number of lines in the source file.
+            \return False if the cache file could not be written.
+         */
+        bool save( int lines );
+
+    }; // class ParseCache
+
+}; // namespace sosicon
+
+#endif
@@ -15,21 +15,168 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <cstdlib>
 #include "parser.h"
+#include "parse_cache.h"
+#include "sosi/sosi_origo_ne.h"
 
 sosicon::Parser::
 Parser() {
     mCurrentCharset = sosi::SosiCharsetSingleton::getInstance();
     mPendingElementLevel = 0;
+    mFeatureListenerCount = 0;
+    mOpenFeature = 0;
+    mCache = 0;
+    mBoxFilter = box_filter_off;
+    mFilter = 0;
     mElementStack.push_back( new sosi::SosiElement( "ROOT", "", "", 0, 0, mElementIndex ) );
 }
 
 sosicon::Parser::
 ~Parser() {
+    for( ParkedSurfaceMap::iterator i = mParkedSurfaces.begin(); i != mParkedSurfaces.end(); i++ ) {
+        ParkedSurface* parked = i->second;
+        if( --parked->missing == 0 ) {
+            releaseElement( parked->element );
+            delete parked;
+        }
+    }
+    for( std::vector<ISosiElement*>::iterator i = mDetached.begin(); i != mDetached.end(); i++ ) {
+        releaseElement( *i );
+    }
     mElementStack.front()->deleteChildren();
     delete mElementStack.front();
 }
 
+void sosicon::Parser::
+addFeatureListener( FeatureEventDispatcher::Listener* listener ) {
+    mFeatureEventDispatcher.addEventListener( listener );
+    mFeatureListenerCount++;
+}
+
+void sosicon::Parser::
+removeFeatureListener( FeatureEventDispatcher::Listener* listener ) {
+    mFeatureEventDispatcher.removeEventListener( listener );
+    mFeatureListenerCount = std::max( 0, mFeatureListenerCount - 1 );
+}
+
+void sosicon::Parser::
+appendElement( const std::string& name, const std::string& serial, const std::string& data, int level ) {
+    digestPendingElement();
+    mPendingElementName = name;
+    mPendingElementSerial = serial;
+    mPendingElementAttributes = data;
+    mPendingElementLevel = level;
+    digestPendingElement();
+}
+
+void sosicon::Parser::
+complete() {
+    digestPendingElement();
+    if( mOpenFeature ) {
+        completeFeature( mOpenFeature );
+        mOpenFeature = 0;
+    }
+    flushParkedSurfaces();
+
+    if( mFeatureListenerCount == 0 && ( mBoxFilter != box_filter_off || mFilter ) ) {
+        sosi::SosiChildrenList& children = mElementStack.front()->children();
+        sosi::SosiChildrenList::size_type n = 0;
+        for( sosi::SosiChildrenList::size_type i = 0; i < children.size(); i++ ) {
+            ISosiElement* child = children[ i ];
+            if( child->getType() != sosi::sosi_element_surface || selected( child ) ) {
+                children[ n++ ] = child;
+            }
+            else {
+                releaseElement( child );
+            }
+        }
+        children.resize( n );
+    }
+}
+
+void sosicon::Parser::
+completeFeature( ISosiElement* e ) {
+
+    if( mFeatureListenerCount == 0 ) {
+        filterFeature( e );
+        return;
+    }
+
+    ISosiElement* root = mElementStack.front();
+    std::string serial = e->getSerial(); // Copy, the element may be released below
+    bool retain = false;
+
+    switch( e->getType() ) {
+        case sosi::sosi_element_head:
+            initBoundingBox( e );
+            retain = true;
+            break;
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            if( selected( e ) ) {
+                dispatchFeature( e );
+            }
+            break;
+        case sosi::sosi_element_curve:
+            if( selected( e ) ) {
+                dispatchFeature( e );
+            }
+            stripToGeometry( e );
+            retain = mBoxFilter != box_filter_reject; // No surfaces will need it
+            break;
+        case sosi::sosi_element_surface:
+            {
+                std::set<std::string> missing;
+                sosi::SosiElementSearch srcRef( sosi::sosi_element_ref );
+                while( e->getChild( srcRef ) ) {
+                    sosi::SosiRefList refList( srcRef.element() );
+                    sosi::GeometryRef* geometry = 0;
+                    while( refList.getNextGeometry( geometry ) ) {
+                        for( sosi::GeometryRef::iterator i = geometry->begin(); i != geometry->end(); i++ ) {
+                            sosi::SosiElementMap::iterator found = mElementIndex.find( ( *i )->serial );
+                            if( found == mElementIndex.end() || found->second == 0 ) {
+                                missing.insert( ( *i )->serial );
+                            }
+                        }
+                    }
+                }
+                if( missing.empty() ) {
+                    if( selected( e ) ) {
+                        dispatchFeature( e );
+                    }
+                }
+                else {
+                    // Detach from root, keep alive until references are resolved
+                    root->children().pop_back();
+                    ParkedSurface* parked = new ParkedSurface();
+                    parked->element = e;
+                    parked->missing = static_cast<int>( missing.size() );
+                    for( std::set<std::string>::iterator i = missing.begin(); i != missing.end(); i++ ) {
+                        mParkedSurfaces.insert( std::make_pair( *i, parked ) );
+                    }
+                    return;
+                }
+            }
+            break;
+        default:
+            // Unknown element types with serial numbers (arcs etc.) may be referenced
+            retain = !serial.empty();
+            if( retain ) {
+                inBoundingBox( e );
+            }
+    }
+
+    if( !retain ) {
+        root->children().pop_back();
+        releaseElement( e );
+    }
+
+    if( !serial.empty() ) {
+        resolveParkedSurfaces( serial );
+    }
+}
+
 void sosicon::Parser::
 digestPendingElement() {
     ISosiElement* previousElement = mElementStack.back();
@@ -41,18 +188,50 @@ digestPendingElement() {
 
         previousElement = mElementStack.back();
 
+        std::string name = sosicon::utils::trim( mPendingElementName );
+        std::string serial = sosicon::utils::trim( mPendingElementSerial );
+        std::string data = sosicon::utils::trim( mPendingElementAttributes );
+
+        if( mCache ) {
+            mCache->record( name, serial, data, mPendingElementLevel );
+        }
+
         ISosiElement* currentElement =
             new sosi::SosiElement(
-                sosicon::utils::trim( mPendingElementName ),
-                sosicon::utils::trim( mPendingElementSerial ),
-                sosicon::utils::trim( mPendingElementAttributes ),
+                name,
+                serial,
+                data,
                 mPendingElementLevel,
                 mElementStack.front(),
                 mElementIndex );
 
+        if( mPendingElementLevel == 1 ) {
+            switch( currentElement->getType() ) {
+                case sosi::sosi_element_point:
+                case sosi::sosi_element_text:
+                case sosi::sosi_element_curve:
+                case sosi::sosi_element_surface:
+                    Profiler::addFeature();
+                    break;
+                default:
+                    ;
+            }
+        }
+
+        bool completing = mFeatureListenerCount > 0 || mBoxFilter != box_filter_off || mFilter;
+
+        if( completing && mPendingElementLevel == 1 && mOpenFeature ) {
+            completeFeature( mOpenFeature );
+            mOpenFeature = 0;
+        }
+
         mElementStack.push_back( currentElement );
         previousElement->addChild( currentElement );
 
+        if( completing && mPendingElementLevel == 1 ) {
+            mOpenFeature = currentElement;
+        }
+
         if( mCurrentCharset->getEncoding() == sosi::sosi_charset_undetermined &&
             currentElement->getType() == sosi::sosi_element_charset )
         {
@@ -65,6 +244,253 @@ digestPendingElement() {
     mPendingElementLevel = 0;
 }
 
+void sosicon::Parser::
+dispatchFeature( ISosiElement* e ) {
+    Profiler::Scope scope( Profiler::stage_convert );
+    FeatureEvent event( e );
+    mFeatureEventDispatcher.Dispatch( event );
+}
+
+void sosicon::Parser::
+expandExtent( ISosiElement* e, Extent& extent ) {
+    sosi::SosiElementSearch src( sosi::sosi_element_ne );
+    while( e->getChild( src ) ) {
+        ISosiElement* ne = src.element();
+        int stride = ne->getName() == "N\xD8H" ? 3 : 2;
+        const char* p = ne->getData().c_str();
+        char* end = 0;
+        double n = 0;
+        for( int i = 0; *p; ) {
+            double value = std::strtod( p, &end );
+            if( end == p ) {
+                p++; // Skip anything but numbers
+                continue;
+            }
+            p = end;
+            if( i == 0 ) {
+                n = value;
+            }
+            else if( i == 1 ) {
+                extent.minN = std::min( extent.minN, n );
+                extent.maxN = std::max( extent.maxN, n );
+                extent.minE = std::min( extent.minE, value );
+                extent.maxE = std::max( extent.maxE, value );
+            }
+            i = ( i + 1 ) % stride;
+        }
+    }
+}
+
+void sosicon::Parser::
+filterFeature( ISosiElement* e ) {
+    ISosiElement* root = mElementStack.front();
+    switch( e->getType() ) {
+        case sosi::sosi_element_head:
+            initBoundingBox( e );
+            break;
+        case sosi::sosi_element_point:
+        case sosi::sosi_element_text:
+            if( !selected( e ) ) {
+                root->children().pop_back();
+                releaseElement( e );
+            }
+            break;
+        case sosi::sosi_element_curve:
+            if( mBoxFilter == box_filter_reject ) {
+                root->children().pop_back();
+                releaseElement( e );
+            }
+            else if( !selected( e ) ) {
+                root->children().pop_back();
+                stripToGeometry( e );
+                mDetached.push_back( e );
+            }
+            break;
+        case sosi::sosi_element_surface:
+            break; // Tested in complete()
+        default:
+            if( !e->getSerial().empty() ) {
+                inBoundingBox( e );
+            }
+    }
+}
+
+void sosicon::Parser::
+flushParkedSurfaces() {
+    while( !mParkedSurfaces.empty() ) {
+        ParkedSurfaceMap::iterator i = mParkedSurfaces.begin();
+        ParkedSurface* parked = i->second;
+        mParkedSurfaces.erase( i );
+        if( --parked->missing == 0 ) {
+            if( selected( parked->element ) ) {
+                dispatchFeature( parked->element );
+            }
+            releaseElement( parked->element );
+            delete parked;
+        }
+    }
+}
+
+bool sosicon::Parser::
+inBoundingBox( ISosiElement* e ) {
+
+    if( mBoxFilter == box_filter_off || mBoxFilter == box_filter_pass ) {
+        return true;
+    }
+    if( mBoxFilter == box_filter_reject ) {
+        return false;
+    }
+
+    Extent extent = { +9999999999, +9999999999, -9999999999, -9999999999 };
+    if( e->getType() == sosi::sosi_element_surface ) {
+        sosi::SosiElementSearch srcRef( sosi::sosi_element_ref );
+        while( e->getChild( srcRef ) ) {
+            sosi::SosiRefList refList( srcRef.element() );
+            sosi::GeometryRef* geometry = 0;
+            while( refList.getNextGeometry( geometry ) ) {
+                for( sosi::GeometryRef::iterator i = geometry->begin(); i != geometry->end(); i++ ) {
+                    ExtentMap::iterator found = mExtents.find( ( *i )->serial );
+                    if( found != mExtents.end() ) {
+                        extent.minN = std::min( extent.minN, found->second.minN );
+                        extent.minE = std::min( extent.minE, found->second.minE );
+                        extent.maxN = std::max( extent.maxN, found->second.maxN );
+                        extent.maxE = std::max( extent.maxE, found->second.maxE );
+                    }
+                }
+            }
+        }
+        expandExtent( e, extent );
+    }
+    else {
+        expandExtent( e, extent );
+        if( !e->getSerial().empty() ) {
+            mExtents[ e->getSerial() ] = extent;
+        }
+    }
+
+    if( extent.minN > extent.maxN ) {
+        return true; // No coordinates
+    }
+    return extent.minN <= mRawBox.maxN && extent.maxN >= mRawBox.minN &&
+           extent.minE <= mRawBox.maxE && extent.maxE >= mRawBox.minE;
+}
+
+void sosicon::Parser::
+initBoundingBox( ISosiElement* head ) {
+
+    if( mBoxFilter == box_filter_off ) {
+        return;
+    }
+
+    double unit = 1.0; // Read as SosiUnit::init() does, but without its integer divisor
+    sosi::SosiOrigoNE origo;
+    sosi::SosiElementSearch transpar( sosi::sosi_element_transpar );
+    if( head->getChild( transpar ) ) {
+        sosi::SosiElementSearch srcUnit( sosi::sosi_element_unit );
+        sosi::SosiElementSearch srcOrigo( sosi::sosi_element_origo_ne );
+        if( transpar.element()->getChild( srcUnit ) ) {
+            std::stringstream ss( srcUnit.element()->getData() );
+            if( !( ss >> unit ) || !( unit > 0.0 ) ) {
+                unit = 1.0;
+            }
+        }
+        if( transpar.element()->getChild( srcOrigo ) ) {
+            origo.init( srcOrigo.element() );
+        }
+    }
+    mRawBox.minN = ( mBox.minN - origo.getN() ) / unit;
+    mRawBox.minE = ( mBox.minE - origo.getE() ) / unit;
+    mRawBox.maxN = ( mBox.maxN - origo.getN() ) / unit;
+    mRawBox.maxE = ( mBox.maxE - origo.getE() ) / unit;
+
+    // File extent, in real coordinates
+    sosi::SosiElementSearch area( sosi::sosi_element_area );
+    if( head->getChild( area ) ) {
+        sosi::SosiElementSearch srcMin( sosi::sosi_element_min_ne );
+        sosi::SosiElementSearch srcMax( sosi::sosi_element_max_ne );
+        if( area.element()->getChild( srcMin ) && area.element()->getChild( srcMax ) ) {
+            Extent file;
+            std::stringstream ss;
+            ss << srcMin.element()->getData() << " " << srcMax.element()->getData();
+            if( ss >> file.minN >> file.minE >> file.maxN >> file.maxE ) {
+                if( file.minN > mBox.maxN || file.maxN < mBox.minN || file.minE > mBox.maxE || file.maxE < mBox.minE ) {
+                    mBoxFilter = box_filter_reject;
+                }
+                else if( file.minN >= mBox.minN && file.maxN <= mBox.maxN && file.minE >= mBox.minE && file.maxE <= mBox.maxE ) {
+                    mBoxFilter = box_filter_pass;
+                }
+            }
+        }
+    }
+}
+
+void sosicon::Parser::
+releaseElement( ISosiElement* e ) {
+    e->deleteChildren();
+    delete e;
+}
+
+void sosicon::Parser::
+resolveParkedSurfaces( const std::string& serial ) {
+    std::pair<ParkedSurfaceMap::iterator, ParkedSurfaceMap::iterator> range = mParkedSurfaces.equal_range( serial );
+    if( range.first == range.second ) {
+        return;
+    }
+    std::vector<ParkedSurface*> waiting;
+    for( ParkedSurfaceMap::iterator i = range.first; i != range.second; i++ ) {
+        waiting.push_back( i->second );
+    }
+    mParkedSurfaces.erase( range.first, range.second );
+    for( std::vector<ParkedSurface*>::iterator i = waiting.begin(); i != waiting.end(); i++ ) {
+        ParkedSurface* parked = *i;
+        if( --parked->missing == 0 ) {
+            if( selected( parked->element ) ) {
+                dispatchFeature( parked->element );
+            }
+            releaseElement( parked->element );
+            delete parked;
+        }
+    }
+}
+
+bool sosicon::Parser::
+selected( ISosiElement* e ) {
+    bool inside = inBoundingBox( e ); // Always called, it records the extent
+    return inside && ( !mFilter || mFilter->match( e ) );
+}
+
+void sosicon::Parser::
+setBoundingBox( const std::vector<double>& bbox ) {
+    mExtents.clear();
+    if( bbox.size() == 4 ) {
+        mBox.minE = std::min( bbox[ 0 ], bbox[ 2 ] );
+        mBox.minN = std::min( bbox[ 1 ], bbox[ 3 ] );
+        mBox.maxE = std::max( bbox[ 0 ], bbox[ 2 ] );
+        mBox.maxN = std::max( bbox[ 1 ], bbox[ 3 ] );
+        mRawBox = mBox;
+        mBoxFilter = box_filter_features;
+    }
+    else {
+        mBoxFilter = box_filter_off;
+    }
+}
+
+void sosicon::Parser::
+stripToGeometry( ISosiElement* e ) {
+    sosi::SosiChildrenList& children = e->children();
+    sosi::SosiChildrenList::size_type n = 0;
+    for( sosi::SosiChildrenList::size_type i = 0; i < children.size(); i++ ) {
+        ISosiElement* child = children[ i ];
+        if( child->getType() == sosi::sosi_element_ne ) {
+            children[ n++ ] = child;
+        }
+        else {
+            releaseElement( child );
+        }
+    }
+    children.resize( n );
+}
+
 void sosicon::Parser::
 dump() {
     mElementStack.front()->dump();
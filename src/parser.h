@@ -24,14 +24,22 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include "utils.h"
 #include "command_line.h"
+#include "feature_event.h"
+#include "feature_filter.h"
+#include "profiler.h"
 #include "sosi/sosi_element.h"
 #include "sosi/sosi_charset_singleton.h"
+#include "sosi/sosi_ref_list.h"
 #include "interface/i_sosi_element.h"
 
 namespace sosicon {
 
+    class ParseCache;
+
     //! SOSI file parser
     /*!
         \author Espen Andersen
@@ -49,9 +57,44 @@ namespace sosicon {
         \note Since parser_ragel.cpp is automatically re-generated before each compile, no
               redacting may take place here. Any changes will be lost upon compile. Instead, its
               source script parser/parser_rl has to be edited.
+
+        By default, the complete file is kept in memory as an element tree, available through
+        getRootElement() once the file has been parsed. If one or more feature listeners are
+        attached (see addFeatureListener()), the parser switches to streaming mode instead:
+        each completed top-level feature is dispatched as a FeatureEvent and released right
+        after. Only the file header, plus the bare geometry of curves that may be referenced
+        from surfaces later on, are kept in the tree.
     */
     class Parser {
 
+        //! Surface waiting for referenced curves
+        struct ParkedSurface {
+            ISosiElement* element; //!< The FLATE element
+            int missing;           //!< Number of referenced serials not yet parsed
+        };
+
+        //! Lookup table for parked surfaces by missing serial
+        typedef std::multimap<std::string, ParkedSurface*> ParkedSurfaceMap;
+
+        //! Bounding box in file units, as read from NØ elements before unit and origo are applied
+        struct Extent {
+            double minN;           //!< Minimum north
+            double minE;           //!< Minimum east
+            double maxN;           //!< Maximum north
+            double maxE;           //!< Maximum east
+        };
+
+        //! Lookup table for feature extents by serial
+        typedef std::unordered_map<std::string, Extent> ExtentMap;
+
+        //! Bounding box filter state
+        enum BoxFilter {
+            box_filter_off,        //!< No filter, all features pass
+            box_filter_features,   //!< Features are tested one by one
+            box_filter_pass,       //!< The file lies within the box, all features pass
+            box_filter_reject      //!< The file lies outside the box, no features pass
+        };
+
         //! Working stack
         /*!
             Keeps track of element relationship while parsing the SOSI file. The root element
@@ -97,6 +140,128 @@ namespace sosicon {
          */
         std::string mPendingElementAttributes;
 
+        //! Feature listeners
+        /*!
+            Receives a FeatureEvent for each completed top-level feature. If any listeners are
+            attached, the parser runs in streaming mode.
+         */
+        FeatureEventDispatcher mFeatureEventDispatcher;
+
+        //! Number of attached feature listeners
+        int mFeatureListenerCount;
+
+        //! Top-level element currently being parsed
+        /*!
+            Streaming mode only. The element is complete when the next top-level element
+            begins, or when the end of the file is reached.
+         */
+        ISosiElement* mOpenFeature;
+
+        //! Surfaces waiting for referenced curves, keyed by missing serial
+        ParkedSurfaceMap mParkedSurfaces;
+
+        //! Parse cache receiving a copy of each element, if any
+        ParseCache* mCache;
+
+        //! Bounding box filter state
+        BoxFilter mBoxFilter;
+
+        //! Bounding box filter in real coordinates
+        Extent mBox;
+
+        //! Bounding box filter in file units
+        /*!
+            Set from mBox when the file header is complete, so that coordinates can be tested
+            without being converted.
+         */
+        Extent mRawBox;
+
+        //! Extents of curves and other features that may be referenced from surfaces
+        ExtentMap mExtents;
+
+        //! Attribute filter, or null
+        FeatureFilter* mFilter;
+
+        //! Curves outside the bounding box or rejected by the attribute filter
+        /*!
+            Tree mode only. Removed from the element tree, but kept alive for surfaces that
+            reference them.
+         */
+        std::vector<ISosiElement*> mDetached;
+
+        //! Handle completed top-level element in streaming mode
+        /*!
+            Dispatches the element to the feature listeners, or parks it if it is a surface
+            referencing curves not yet encountered. The element is then released, unless it may
+            be needed later for resolving references.
+            \param e The completed top-level element. Must be the last child of the root.
+         */
+        void completeFeature( ISosiElement* e );
+
+        //! Dispatch feature to listeners
+        void dispatchFeature( ISosiElement* e );
+
+        //! Expand extent by the coordinates of an element
+        /*!
+            Reads the NØ and NØH children of the element directly from their text, without
+            building coordinate objects.
+            \param e Feature element.
+            \param extent Extent to expand.
+         */
+        void expandExtent( ISosiElement* e, Extent& extent );
+
+        //! Handle completed top-level element in tree mode
+        /*!
+            Called instead of completeFeature() when a bounding box or attribute filter is set
+            but no feature listeners are attached. Points and texts not selected are released,
+            and curves not selected are removed from the tree. Surfaces are tested in
+            complete(), when all referenced curves are known.
+            \param e The completed top-level element. Must be the last child of the root.
+         */
+        void filterFeature( ISosiElement* e );
+
+        //! Test if feature lies within the bounding box filter
+        /*!
+            The extent of a surface is taken from the curves it references. The extent of
+            other features is recorded by serial number, for surfaces that come later. Features
+            without coordinates pass.
+            \param e Feature element.
+            \return True if the feature is to be exported.
+         */
+        bool inBoundingBox( ISosiElement* e );
+
+        //! Test if feature passes the bounding box and attribute filters
+        bool selected( ISosiElement* e );
+
+        //! Set up bounding box filter for the file
+        /*!
+            Converts the box to file units with the ENHET and ORIGO-NØ of the file header. If
+            the header gives the extent of the file (OMRÅDE), features are not tested one by
+            one if the file lies entirely inside or outside the box.
+            \param head HODE element.
+         */
+        void initBoundingBox( ISosiElement* head );
+
+        //! Dispatch remaining parked surfaces
+        /*!
+            Called at end of file. Surfaces still waiting for references at this point refer to
+            curves not present in the file, and are dispatched as they are.
+         */
+        void flushParkedSurfaces();
+
+        //! Release parked surfaces waiting for given serial
+        /*!
+            Called when a top-level element with a serial number has been completed. Any parked
+            surfaces for which this was the last missing reference are dispatched and released.
+         */
+        void resolveParkedSurfaces( const std::string& serial );
+
+        //! Delete element and its subtree
+        void releaseElement( ISosiElement* e );
+
+        //! Reduce element to its coordinate children
+        void stripToGeometry( ISosiElement* e );
+
         //! Save current SOSI element
         /*!
             The parser stores intermediate data in the mPendingElementXXX member variables. When 
@@ -119,8 +284,62 @@ namespace sosicon {
          */
         ~Parser();
 
+        //! Attach feature listener
+        /*!
+            Puts the parser in streaming mode. Must be called before parsing begins.
+            \param listener Receives one FeatureEvent for each completed PUNKT, KURVE, FLATE or
+                   TEKST feature.
+         */
+        void addFeatureListener( FeatureEventDispatcher::Listener* listener );
+
+        //! Detach feature listener
+        void removeFeatureListener( FeatureEventDispatcher::Listener* listener );
+
+        //! Append element
+        /*!
+            Adds a fully parsed element to the tree, as if it had been read from the SOSI file.
+            Used for restoring elements from the parse cache.
+            \param name Element name, without leading dots.
+            \param serial Serial number, or empty string.
+            \param data Unparsed element data.
+            \param level Nesting level (number of leading dots).
+            \sa sosicon::ParseCache::load()
+         */
+        void appendElement( const std::string& name, const std::string& serial, const std::string& data, int level );
+
+        //! Attach parse cache
+        /*!
+            Every element subsequently created by the parser is recorded in the given cache.
+            \param cache Cache to record into, or null to detach.
+            \sa sosicon::ParseCache::record()
+         */
+        void setCache( ParseCache* cache ) { mCache = cache; }
+
+        //! Set bounding box filter
+        /*!
+            Only features whose bounding box intersects the given box are dispatched, or kept
+            in the tree. Curves outside the box are still available for resolving references,
+            so surfaces crossing the box are complete. Must be called before parsing begins.
+            \param bbox Minimum east, minimum north, maximum east and maximum north, in the
+                   coordinate system of the file. An empty vector turns the filter off.
+         */
+        void setBoundingBox( const std::vector<double>& bbox );
+
+        //! Set attribute filter
+        /*!
+            Only features matching the filter are dispatched, or kept in the tree. As with the
+            bounding box, curves that do not match are still available for resolving
+            references. Must be called before parsing begins.
+            \param filter Compiled filter, or null. Must outlive the parser.
+         */
+        void setFeatureFilter( FeatureFilter* filter ) { mFilter = filter && !filter->empty() ? filter : 0; }
+
         //! Flush parsed data
-        void complete() { digestPendingElement(); };
+        /*!
+            Must be called after the last line has been parsed. In streaming mode, the last
+            feature and any surfaces still waiting for references are dispatched.
+         */
+        void complete();
 
         //! Debug output
         void dump();
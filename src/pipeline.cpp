@@ -0,0 +1,213 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <fstream>
+#include "pipeline.h"
+
+sosicon::Pipeline::
+Pipeline( CommandLine* cmd ) :
+    mLines( LINE_QUEUE_CAPACITY ),
+    mJobs( JOB_QUEUE_CAPACITY ),
+    mFinished( JOB_QUEUE_CAPACITY )
+{
+    mCmd = cmd;
+    mStopReader = false;
+    mPendingJobs = 0;
+}
+
+sosicon::Pipeline::
+~Pipeline() {
+    drain();
+    if( mWriter.joinable() ) {
+        mJobs.push( 0 );
+        mWriter.join();
+    }
+}
+
+void sosicon::Pipeline::
+drain() {
+    unsigned int rounds = 0;
+    reap();
+    while( mPendingJobs > 0 ) {
+        mFinished.waitForItem( rounds );
+        reap();
+    }
+}
+
+void sosicon::Pipeline::
+finish() {
+    drain();
+    Profiler::endFile();
+    if( !AsyncFileWriter::flushAll() ) {
+        sosicon::logstream << "Could not flush output files to disk\n";
+    }
+}
+
+bool sosicon::Pipeline::
+parse( const std::string& sourceFile, Parser& parser, int& lines, bool* cancel ) {
+
+    Profiler::beginFile( sourceFile );
+    Profiler::Scope scope( Profiler::stage_parse );
+    ParseCache cache( sourceFile );
+    bool cancelled = false;
+    lines = 0;
+    CurveCache::getInstance()->clear(); // Serial numbers are only unique within a file
+    parser.setBoundingBox( mCmd->mBbox );
+    parser.setFeatureFilter( &mCmd->mWhere );
+
+    bool cached = mCmd->mUseCache && cache.load( parser, lines );
+    if( !cached ) {
+        if( mCmd->mUseCache ) {
+            parser.setCache( &cache );
+        }
+        mStopReader = false;
+        std::thread reader( &Pipeline::readLines, this, sourceFile );
+        std::ifstream ifs( sourceFile.c_str(), std::ios::binary | std::ios::ate );
+        Progress progress( "Parsing", ifs ? static_cast<uint64_t>( ifs.tellg() ) : 0, true );
+        LineBlock* block = 0;
+        for( ;; ) {
+            mLines.pop( block );
+            if( !block ) {
+                break;
+            }
+            if( cancel && *cancel ) {
+                cancelled = true;
+                mStopReader = true;
+            }
+            if( !cancelled ) {
+                const char* text = block->text.empty() ? "" : &block->text[ 0 ];
+                std::vector<char>::size_type start = 0;
+                for( std::vector<std::vector<char>::size_type>::iterator i = block->ends.begin(); i != block->ends.end(); i++ ) {
+                    parser.ragelParseSosiLine( std::string( text + start, text + *i ) );
+                    start = *i;
+                }
+                lines += static_cast<int>( block->ends.size() );
+                progress.add( block->text.size() + block->ends.size() );
+                Profiler::addBytesIn( block->text.size() + block->ends.size() );
+            }
+            delete block;
+        }
+        reader.join();
+    }
+    parser.complete();
+    parser.setCache( 0 );
+
+    if( cancelled ) {
+        return false;
+    }
+    if( mCmd->mUseCache && !cached ) {
+        cache.save( lines );
+    }
+    sosicon::logstream << "\r" << lines << " lines parsed        \n";
+    return true;
+}
+
+void sosicon::Pipeline::
+readLines( std::string sourceFile ) {
+
+    FILE* f = fopen( sourceFile.c_str(), "rb" );
+    if( f ) {
+        std::vector<char> buffer( READ_BLOCK_SIZE );
+        LineBlock* block = new LineBlock();
+        std::size_t got = 0;
+        while( block && !mStopReader && ( got = fread( &buffer[ 0 ], 1, buffer.size(), f ) ) > 0 ) {
+            const char* pos = &buffer[ 0 ];
+            const char* end = pos + got;
+            while( pos < end ) {
+                const char* lf = static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+                if( !lf ) {
+                    block->text.insert( block->text.end(), pos, end );
+                    break;
+                }
+                block->text.insert( block->text.end(), pos, lf );
+                block->ends.push_back( block->text.size() );
+                pos = lf + 1;
+            }
+            if( block->ends.empty() ) {
+                continue; // Line longer than the read block, keep reading
+            }
+
+            // Carry the incomplete last line over to the next block
+            LineBlock* next = new LineBlock();
+            next->text.assign( block->text.begin() + block->ends.back(), block->text.end() );
+            block->text.resize( block->ends.back() );
+
+            unsigned int rounds = 0;
+            while( !mLines.tryPush( block ) ) {
+                if( mStopReader ) {
+                    delete block;
+                    delete next;
+                    next = 0;
+                    break;
+                }
+                mLines.waitForRoom( rounds ); // Woken by the parser, which pops until the end
+            }
+            block = next;
+        }
+        if( block && !mStopReader && !block->text.empty() ) {
+            block->ends.push_back( block->text.size() ); // Last line without line break
+            mLines.push( block );
+        }
+        else {
+            delete block;
+        }
+        fclose( f );
+    }
+    mLines.push( 0 );
+}
+
+void sosicon::Pipeline::
+reap() {
+    IPipelineJob* job = 0;
+    while( mFinished.tryPop( job ) ) {
+        job->complete();
+        delete job;
+        mPendingJobs--;
+    }
+}
+
+void sosicon::Pipeline::
+submit( IPipelineJob* job ) {
+    if( !mWriter.joinable() ) {
+        mWriter = std::thread( &Pipeline::writeJobs, this );
+    }
+    unsigned int rounds = 0;
+    reap();
+    while( mPendingJobs >= static_cast<int>( JOB_QUEUE_CAPACITY ) ) {
+        mFinished.waitForItem( rounds );
+        reap();
+    }
+    mPendingJobs++;
+    mJobs.push( job );
+}
+
+void sosicon::Pipeline::
+writeJobs() {
+    IPipelineJob* job = 0;
+    for( ;; ) {
+        mJobs.pop( job );
+        if( !job ) {
+            break;
+        }
+        {
+            Profiler::Scope scope( Profiler::stage_write );
+            job->run();
+        }
+        mFinished.push( job );
+    }
+}
@@ -0,0 +1,164 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logger.h"
+#include "async_file_writer.h"
+#include "bounded_queue.h"
+#include "command_line.h"
+#include "curve_cache.h"
+#include "parser.h"
+#include "parse_cache.h"
+#include "profiler.h"
+#include "progress.h"
+#include "interface/i_pipeline_job.h"
+
+namespace sosicon {
+
+    //! Conversion pipeline
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Shared driver for the converters. Splits a conversion into three stages, connected by
+        bounded lock-free queues (sosicon::BoundedQueue):
+
+        \verbatim
+        reader thread     Reads the source file in large blocks and cuts them into lines
+        converter thread  Parses lines, assembles features and copies out their data (the caller)
+        writer thread     Runs output jobs submitted by the converter
+        \endverbatim
+
+        Output files themselves are written through sosicon::AsyncFileWriter, whose I/O
+        thread flushes buffers while the stages above carry on.
+
+        Parsing and feature assembly stay on the converter's own thread, since the element
+        tree, its reference index and the character set singleton are not thread-safe. The
+        streaming converters copy the coordinates and attribute values of each feature into
+        batches there, and submit the batches as jobs that encode them on the writer thread
+        while parsing carries on. The shape file converter builds its records from the
+        complete tree, and only hands the finished files to the writer. The reader stays a
+        few blocks ahead of the parser.
+
+        parse() also takes care of the optional parse cache (see sosicon::ParseCache).
+    */
+    class Pipeline {
+
+        //! Complete lines read from the source file
+        struct LineBlock {
+            std::vector<char> text;                         //!< Line content, without line breaks
+            std::vector<std::vector<char>::size_type> ends; //!< End offset of each line in text
+        };
+
+        //! Bytes read from the source file at a time
+        static const std::size_t READ_BLOCK_SIZE = 1 << 20;
+
+        //! Number of line blocks the reader may run ahead of the parser
+        static const std::size_t LINE_QUEUE_CAPACITY = 8;
+
+        //! Number of output jobs waiting for the writer
+        static const std::size_t JOB_QUEUE_CAPACITY = 2;
+
+        //! Command line wrapper
+        CommandLine* mCmd;
+
+        //! Reader to parser. A null block marks the end of the file.
+        BoundedQueue<LineBlock*> mLines;
+
+        //! Tells the reader to give up early
+        std::atomic<bool> mStopReader;
+
+        //! Converter to writer. A null job stops the writer thread.
+        BoundedQueue<IPipelineJob*> mJobs;
+
+        //! Writer back to converter, for completion
+        BoundedQueue<IPipelineJob*> mFinished;
+
+        //! Writer thread, started on first submit()
+        std::thread mWriter;
+
+        //! Number of submitted jobs not yet completed
+        int mPendingJobs;
+
+        Pipeline( const Pipeline& );
+        Pipeline& operator = ( const Pipeline& );
+
+        //! Reader thread main loop
+        /*!
+            Reads the source file and feeds mLines with line blocks. Lines of any length are
+            supported. Always ends by pushing a null block.
+            \param sourceFile Path to the SOSI file.
+         */
+        void readLines( std::string sourceFile );
+
+        //! Writer thread main loop
+        void writeJobs();
+
+        //! Complete and delete finished jobs
+        void reap();
+
+    public:
+
+        //! Constructor
+        Pipeline( CommandLine* cmd );
+
+        //! Destructor
+        /*!
+            Waits for all submitted jobs and stops the writer thread.
+         */
+        ~Pipeline();
+
+        //! Parse source file
+        /*!
+            Feeds the SOSI file, or its parse cache if enabled and valid, into the parser and
+            completes it. With -cache, a new cache file is written after a full parse.
+            \param sourceFile Path to the SOSI file.
+            \param parser Receiving parser. Feature listeners must be attached in advance.
+            \param lines Receives the number of lines parsed.
+            \param cancel Optional flag polled between line blocks.
+            \return False if parsing was cancelled.
+         */
+        bool parse( const std::string& sourceFile, Parser& parser, int& lines, bool* cancel = 0 );
+
+        //! Queue job for the writer thread
+        /*!
+            Blocks while the job queue is full. The pipeline takes ownership of the job.
+         */
+        void submit( IPipelineJob* job );
+
+        //! Wait until all submitted jobs have completed
+        void drain();
+
+        //! Wait until all output is on disk
+        /*!
+            Drains the job queue, then waits for the I/O thread to write all pending buffers
+            and run any batched fsyncs (see sosicon::AsyncFileWriter). Reports failed fsyncs.
+         */
+        void finish();
+
+    }; // class Pipeline
+
+}; // namespace sosicon
+
+#endif
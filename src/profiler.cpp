@@ -0,0 +1,403 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#if defined( _WIN32 ) || defined( _WIN64 )
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+#include "utils.h"
+#include "profiler.h"
+
+std::atomic<bool> sosicon::Profiler::sEnabled( false );
+
+namespace {
+
+    using sosicon::Profiler;
+
+    //! Stage names in the report
+    const char* STAGE_NAMES[ Profiler::stage_count ] = {
+        "parse", "refs", "coordinates", "convert", "write"
+    };
+
+    //! Minimum time between peak RSS samples on one thread, in nanoseconds
+    const int64_t RSS_INTERVAL = 1000000;
+
+    //! Innermost scope of this thread
+    thread_local Profiler::Scope* tCurrentScope = 0;
+
+    //! Last peak RSS sample of this thread, in kB
+    thread_local long tPeakRss = 0;
+
+    //! Time of the last peak RSS sample of this thread
+    thread_local int64_t tPeakRssTime = 0;
+
+    //! Steady clock, in nanoseconds
+    int64_t wallTime() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    //! CPU time of the calling thread, in nanoseconds
+    int64_t threadCpuTime() {
+#if defined( _WIN32 ) || defined( _WIN64 )
+        FILETIME created, exited, kernel, user;
+        if( GetThreadTimes( GetCurrentThread(), &created, &exited, &kernel, &user ) ) {
+            int64_t k = ( static_cast<int64_t>( kernel.dwHighDateTime ) << 32 ) | kernel.dwLowDateTime;
+            int64_t u = ( static_cast<int64_t>( user.dwHighDateTime ) << 32 ) | user.dwLowDateTime;
+            return ( k + u ) * 100;
+        }
+        return 0;
+#else
+        timespec ts;
+        if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 ) {
+            return static_cast<int64_t>( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+        }
+        return 0;
+#endif
+    }
+
+    //! Peak resident set size of the process, in kB
+    long peakRss() {
+#if defined( _WIN32 ) || defined( _WIN64 )
+        PROCESS_MEMORY_COUNTERS pmc;
+        if( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof( pmc ) ) ) {
+            return static_cast<long>( pmc.PeakWorkingSetSize / 1024 );
+        }
+        return 0;
+#else
+        rusage ru;
+        if( getrusage( RUSAGE_SELF, &ru ) == 0 ) {
+            return ru.ru_maxrss;
+        }
+        return 0;
+#endif
+    }
+
+    //! Add figures b to a
+    void addFigures( Profiler::Figures& a, const Profiler::Figures& b ) {
+        a.calls += b.calls;
+        a.wall += b.wall;
+        a.cpu += b.cpu;
+        a.allocations += b.allocations;
+        a.allocatedBytes += b.allocatedBytes;
+        a.bytesIn += b.bytesIn;
+        a.bytesOut += b.bytesOut;
+        a.features += b.features;
+        if( b.peakRss > a.peakRss ) {
+            a.peakRss = b.peakRss;
+        }
+    }
+
+    //! Subtract figures b from a
+    void subtractFigures( Profiler::Figures& a, const Profiler::Figures& b ) {
+        a.wall -= b.wall;
+        a.cpu -= b.cpu;
+        a.allocations -= b.allocations;
+        a.allocatedBytes -= b.allocatedBytes;
+        a.bytesIn -= b.bytesIn;
+        a.bytesOut -= b.bytesOut;
+        a.features -= b.features;
+    }
+
+    //! Count an allocation of n bytes
+    inline void countAllocation( std::size_t n ) {
+        if( Profiler::enabled() ) {
+            Profiler::Counters& c = Profiler::counters();
+            c.allocations++;
+            c.allocatedBytes += n;
+        }
+    }
+
+    //! Allocate n bytes as operator new does
+    void* allocate( std::size_t n ) {
+        countAllocation( n );
+        for( ;; ) {
+            void* p = std::malloc( n ? n : 1 );
+            if( p ) {
+                return p;
+            }
+            std::new_handler handler = std::get_new_handler();
+            if( !handler ) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    //! Allocate n bytes as operator new( nothrow ) does
+    void* allocateNoThrow( std::size_t n ) {
+        try {
+            return allocate( n );
+        }
+        catch( ... ) {
+            return 0;
+        }
+    }
+
+    //! Format nanoseconds as seconds
+    std::string seconds( int64_t ns ) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision( 6 ) << static_cast<double>( ns ) / 1e9;
+        return ss.str();
+    }
+
+}; // namespace
+
+void* operator new( std::size_t n ) {
+    return allocate( n );
+}
+
+void* operator new[]( std::size_t n ) {
+    return allocate( n );
+}
+
+void* operator new( std::size_t n, const std::nothrow_t& ) noexcept {
+    return allocateNoThrow( n );
+}
+
+void* operator new[]( std::size_t n, const std::nothrow_t& ) noexcept {
+    return allocateNoThrow( n );
+}
+
+void operator delete( void* p ) noexcept {
+    std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept {
+    operator delete( p );
+}
+
+void operator delete[]( void* p, std::size_t ) noexcept {
+    operator delete[]( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) noexcept {
+    std::free( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept {
+    std::free( p );
+}
+
+void sosicon::Profiler::Scope::
+start( Stage stage ) {
+    Profiler& p = Profiler::instance();
+    mStage = stage;
+    mFile = p.mCurrentFile.load( std::memory_order_relaxed );
+    mActive = true;
+    mParent = tCurrentScope;
+    tCurrentScope = this;
+    sample( mStart );
+}
+
+void sosicon::Profiler::Scope::
+stop() {
+    Figures f;
+    sample( f );
+    int64_t now = f.wall;
+    subtractFigures( f, mStart );
+    if( mParent ) {
+        addFigures( mParent->mChildren, f );
+    }
+    tCurrentScope = mParent;
+    subtractFigures( f, mChildren );
+    f.calls = 1;
+    if( !mParent || now - tPeakRssTime > RSS_INTERVAL ) {
+        tPeakRss = peakRss();
+        tPeakRssTime = now;
+    }
+    f.peakRss = tPeakRss;
+    Profiler::instance().add( mStage, mFile, f );
+}
+
+sosicon::Profiler& sosicon::Profiler::
+instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+sosicon::Profiler::Counters& sosicon::Profiler::
+counters() {
+    static thread_local Counters c;
+    return c;
+}
+
+void sosicon::Profiler::
+sample( Figures& f ) {
+    Counters& c = counters();
+    f.wall = wallTime();
+    f.cpu = threadCpuTime();
+    f.allocations = c.allocations;
+    f.allocatedBytes = c.allocatedBytes;
+    f.bytesIn = c.bytesIn;
+    f.bytesOut = c.bytesOut;
+    f.features = c.features;
+}
+
+void sosicon::Profiler::
+add( Stage stage, int file, const Figures& f ) {
+    std::lock_guard<std::mutex> lock( mMutex );
+    addFigures( mStages[ stage ], f );
+    if( file >= 0 && file < static_cast<int>( mFiles.size() ) ) {
+        addFigures( mFiles[ file ].stages[ stage ], f );
+    }
+}
+
+void sosicon::Profiler::
+enable() {
+    Profiler& p = instance();
+    p.mStart = std::chrono::steady_clock::now();
+    sEnabled = true;
+}
+
+void sosicon::Profiler::
+beginFile( const std::string& name ) {
+    if( !enabled() ) {
+        return;
+    }
+    Profiler& p = instance();
+    std::lock_guard<std::mutex> lock( p.mMutex );
+    p.closeFile();
+    int file = 0;
+    while( file < static_cast<int>( p.mFiles.size() ) && p.mFiles[ file ].name != name ) {
+        file++;
+    }
+    if( file == static_cast<int>( p.mFiles.size() ) ) {
+        p.mFiles.push_back( File() );
+        p.mFiles.back().name = name;
+        p.mFiles.back().wall = 0;
+    }
+    p.mFileStart = std::chrono::steady_clock::now();
+    p.mCurrentFile = file;
+}
+
+void sosicon::Profiler::
+endFile() {
+    if( !enabled() ) {
+        return;
+    }
+    Profiler& p = instance();
+    std::lock_guard<std::mutex> lock( p.mMutex );
+    p.closeFile();
+}
+
+void sosicon::Profiler::
+closeFile() {
+    int file = mCurrentFile;
+    if( file >= 0 ) {
+        mFiles[ file ].wall += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mFileStart ).count();
+        mCurrentFile = -1;
+    }
+}
+
+void sosicon::Profiler::
+writeStage( std::ostream& os, const Figures& f, uint64_t features ) {
+    double wall = static_cast<double>( f.wall ) / 1e9;
+    os << "{ \"calls\": " << f.calls
+       << ", \"wall_seconds\": " << seconds( f.wall )
+       << ", \"cpu_seconds\": " << seconds( f.cpu )
+       << ", \"bytes_in\": " << f.bytesIn
+       << ", \"bytes_out\": " << f.bytesOut
+       << ", \"features\": " << f.features
+       << ", \"features_per_second\": " << std::fixed << std::setprecision( 0 )
+       << ( wall > 0 ? static_cast<double>( features ) / wall : 0.0 )
+       << ", \"allocations\": " << f.allocations
+       << ", \"allocated_bytes\": " << f.allocatedBytes
+       << ", \"peak_rss_kb\": " << f.peakRss << " }";
+}
+
+void sosicon::Profiler::
+writeStages( std::ostream& os, const Figures* stages, const std::string& indent ) {
+    uint64_t features = 0;
+    for( int i = 0; i < stage_count; i++ ) {
+        features += stages[ i ].features;
+    }
+    os << "{\n";
+    for( int i = 0; i < stage_count; i++ ) {
+        os << indent << "    \"" << STAGE_NAMES[ i ] << "\": ";
+        writeStage( os, stages[ i ], features );
+        os << ( i + 1 < stage_count ? ",\n" : "\n" );
+    }
+    os << indent << "}";
+}
+
+bool sosicon::Profiler::
+write( const std::string& fileName, const std::string& command ) {
+    Profiler& p = instance();
+    std::lock_guard<std::mutex> lock( p.mMutex );
+    p.closeFile();
+    std::ofstream os( fileName.c_str(), std::ios::binary );
+    if( !os ) {
+        return false;
+    }
+
+    Figures total;
+    for( int i = 0; i < stage_count; i++ ) {
+        addFigures( total, p.mStages[ i ] );
+    }
+    int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - p.mStart ).count();
+    int64_t cpu = static_cast<int64_t>( static_cast<double>( std::clock() ) / CLOCKS_PER_SEC * 1e9 );
+
+    os << "{\n"
+       << "    \"command\": " << utils::jsonQuote( command ) << ",\n"
+       << "    \"wall_seconds\": " << seconds( wall ) << ",\n"
+       << "    \"cpu_seconds\": " << seconds( cpu ) << ",\n"
+       << "    \"features\": " << total.features << ",\n"
+       << "    \"allocations\": " << total.allocations << ",\n"
+       << "    \"peak_rss_kb\": " << peakRss() << ",\n"
+       << "    \"stages\": ";
+    writeStages( os, p.mStages, "    " );
+    os << ",\n    \"files\": [";
+    for( std::vector<File>::size_type i = 0; i < p.mFiles.size(); i++ ) {
+        const File& f = p.mFiles[ i ];
+        uint64_t bytes = 0;
+        uint64_t features = 0;
+        std::ifstream ifs( f.name.c_str(), std::ios::binary | std::ios::ate );
+        if( ifs ) {
+            bytes = static_cast<uint64_t>( ifs.tellg() );
+        }
+        for( int j = 0; j < stage_count; j++ ) {
+            features += f.stages[ j ].features;
+        }
+        os << ( i ? ",\n" : "\n" )
+           << "        {\n"
+           << "            \"file\": " << utils::jsonQuote( f.name ) << ",\n"
+           << "            \"bytes\": " << bytes << ",\n"
+           << "            \"wall_seconds\": " << seconds( f.wall ) << ",\n"
+           << "            \"features\": " << features << ",\n"
+           << "            \"stages\": ";
+        writeStages( os, f.stages, "            " );
+        os << "\n        }";
+    }
+    os << ( p.mFiles.empty() ? "]\n" : "\n    ]\n" ) << "}\n";
+    return static_cast<bool>( os );
+}
@@ -0,0 +1,222 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace sosicon {
+
+    //! Per-stage profiling
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Measures where a conversion spends its time, enabled with -profile. Code marks each
+        stage with a Scope, which records wall and CPU time, allocations, bytes read and
+        written, and features read on the current thread. Scopes nest, and each one only
+        counts what is not counted by the scopes inside it. Parsing, for instance, excludes
+        the time spent in the converter's feature handler, which the parser calls.
+
+        Figures are kept for the whole run and for each source file. A scope is counted for the
+        file that was current when it started, from the time the pipeline starts parsing the file
+        until it moves on to the next one or the converter ends the file. Output written in the
+        background may therefore be counted for the next file, and converters that write all
+        files at the end do so after ending the last file, which leaves it in the run totals.
+
+        The report gives the throughput of each stage as the number of features read divided
+        by the wall time of the stage. Allocations are counted by replacing the global
+        operator new. When profiling is off, scopes and counters only test a flag.
+    */
+    class Profiler {
+
+    public:
+
+        //! Measured stages
+        enum Stage {
+            stage_parse,        //!< Reading and tokenizing the source file
+            stage_refs,         //!< Resolving the REF lists of surfaces
+            stage_coordinates,  //!< Decoding NØ coordinates
+            stage_convert,      //!< Building output from features
+            stage_write,        //!< Encoding and writing output files
+            stage_count         //!< Number of stages
+        };
+
+        //! Figures for one stage
+        struct Figures {
+            uint64_t calls;             //!< Number of scopes
+            int64_t wall;               //!< Wall time, in nanoseconds
+            int64_t cpu;                //!< Thread CPU time, in nanoseconds
+            uint64_t allocations;       //!< Number of operator new calls
+            uint64_t allocatedBytes;    //!< Bytes requested from operator new
+            uint64_t bytesIn;           //!< Bytes read
+            uint64_t bytesOut;          //!< Bytes written
+            uint64_t features;          //!< Features read, before any filters
+            long peakRss;               //!< Peak resident set size at the end of a scope, in kB
+            Figures() : calls( 0 ), wall( 0 ), cpu( 0 ), allocations( 0 ), allocatedBytes( 0 ),
+                        bytesIn( 0 ), bytesOut( 0 ), features( 0 ), peakRss( 0 ) { }
+        };
+
+        //! Counters of one thread. Updated without locking.
+        struct Counters {
+            uint64_t allocations;
+            uint64_t allocatedBytes;
+            uint64_t bytesIn;
+            uint64_t bytesOut;
+            uint64_t features;
+        };
+
+        //! Measure a stage while in scope
+        class Scope {
+            Stage mStage;           //!< Measured stage
+            int mFile;              //!< Source file index, or -1
+            bool mActive;           //!< False if profiling is off
+            Scope* mParent;         //!< Enclosing scope on this thread
+            Figures mStart;         //!< Figures at start
+            Figures mChildren;      //!< Figures counted by nested scopes
+            Scope( const Scope& );
+            Scope& operator = ( const Scope& );
+        public:
+            //! Start measuring
+            explicit Scope( Stage stage ) : mActive( false ) {
+                if( Profiler::enabled() ) {
+                    start( stage );
+                }
+            }
+            //! Stop measuring
+            ~Scope() {
+                if( mActive ) {
+                    stop();
+                }
+            }
+            void start( Stage stage );
+            void stop();
+        };
+
+    private:
+
+        //! Figures for one source file
+        struct File {
+            std::string name;               //!< Path of the file
+            int64_t wall;                   //!< Time the file was current, in nanoseconds
+            Figures stages[ stage_count ];  //!< Figures by stage
+        };
+
+        //! True if profiling is on
+        static std::atomic<bool> sEnabled;
+
+        //! Guards the figures
+        std::mutex mMutex;
+
+        //! Run totals by stage
+        Figures mStages[ stage_count ];
+
+        //! Source files, in order
+        std::vector<File> mFiles;
+
+        //! Index of the file being parsed, or -1
+        std::atomic<int> mCurrentFile;
+
+        //! Start of the current file
+        std::chrono::steady_clock::time_point mFileStart;
+
+        //! Start of the run
+        std::chrono::steady_clock::time_point mStart;
+
+        //! Constructor
+        Profiler() : mCurrentFile( -1 ) { }
+
+        //! The profiler
+        static Profiler& instance();
+
+        //! Stop counting work for the current file. Call with mMutex locked.
+        void closeFile();
+
+        //! Add figures of a finished scope
+        void add( Stage stage, int file, const Figures& f );
+
+        //! Current figures of the calling thread
+        static void sample( Figures& f );
+
+        //! Write one stage as a JSON object
+        static void writeStage( std::ostream& os, const Figures& f, uint64_t features );
+
+        //! Write figures by stage as a JSON object
+        static void writeStages( std::ostream& os, const Figures* stages, const std::string& indent );
+
+    public:
+
+        //! Counters of the calling thread
+        static Counters& counters();
+
+        //! Turn profiling on. Call before starting any threads.
+        static void enable();
+
+        //! True if profiling is on
+        static bool enabled() { return sEnabled.load( std::memory_order_relaxed ); }
+
+        //! Start counting work for a source file
+        /*!
+            Ends the current file. A file that is read more than once, as by converters that
+            make two passes, is reported once with the figures of all passes.
+            \param name Path of the file.
+        */
+        static void beginFile( const std::string& name );
+
+        //! Stop counting work for the current source file
+        static void endFile();
+
+        //! Count bytes read by the calling thread
+        static void addBytesIn( uint64_t n ) {
+            if( enabled() ) {
+                counters().bytesIn += n;
+            }
+        }
+
+        //! Count bytes written by the calling thread
+        static void addBytesOut( uint64_t n ) {
+            if( enabled() ) {
+                counters().bytesOut += n;
+            }
+        }
+
+        //! Count a feature read by the calling thread
+        static void addFeature() {
+            if( enabled() ) {
+                counters().features++;
+            }
+        }
+
+        //! Write JSON report
+        /*!
+            \param fileName Path to the report.
+            \param command Conversion command, like -2psql.
+            \return False if the file could not be written.
+        */
+        static bool write( const std::string& fileName, const std::string& command );
+
+    }; // class Profiler
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "progress.h"
+
+sosicon::Progress::
+Progress( const std::string& label, uint64_t total, bool bytes, int rate ) :
+    mLabel( label ), mTotal( total ), mBytes( bytes ),
+    mInterval( 1000000000LL / ( rate > 0 ? rate : 1 ) )
+{
+    mDone = 0;
+    mNext = now() + mInterval;
+}
+
+std::string sosicon::Progress::
+format( uint64_t done ) const {
+    std::stringstream ss;
+    ss << "\r" << mLabel << " ";
+    if( mTotal > 0 ) {
+        ss << ( done * 100 / mTotal ) << "% ";
+    }
+    if( mBytes ) {
+        ss.precision( 1 );
+        ss << std::fixed << "(" << done / 1048576.0;
+        if( mTotal > 0 ) {
+            ss << " of " << mTotal / 1048576.0;
+        }
+        ss << " MB)";
+    }
+    else {
+        ss << "(" << done;
+        if( mTotal > 0 ) {
+            ss << " of " << mTotal;
+        }
+        ss << ")";
+    }
+    ss << "   ";
+    return ss.str();
+}
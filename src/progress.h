@@ -0,0 +1,102 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+#include "logger.h"
+
+namespace sosicon {
+
+    //! Rate-limited progress line
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Counts work done towards a total, items or bytes, and reports it on a progress line
+        that replaces itself. Reports are timed rather than counted: at most a given number
+        per second are logged, however fast the work is added. add() takes no lock, so
+        parallel workers may share one Progress.
+    */
+    class Progress {
+
+        //! Steady clock ticks, in nanoseconds
+        typedef int64_t Ticks;
+
+        //! Text before the count
+        std::string mLabel;
+
+        //! Total, or 0 if unknown
+        uint64_t mTotal;
+
+        //! True if counting bytes
+        bool mBytes;
+
+        //! Shortest time between reports
+        Ticks mInterval;
+
+        //! Work done so far
+        std::atomic<uint64_t> mDone;
+
+        //! Earliest time of the next report
+        std::atomic<Ticks> mNext;
+
+        //! Current time
+        static Ticks now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+        }
+
+        //! Format progress line
+        std::string format( uint64_t done ) const;
+
+    public:
+
+        //! Default maximum number of reports per second
+        static const int DEFAULT_RATE = 4;
+
+        //! Constructor
+        /*!
+            \param label Text before the count, like "Parsing".
+            \param total Total amount of work, or 0 if unknown.
+            \param bytes True if the work is counted in bytes.
+            \param rate Maximum number of reports per second.
+        */
+        Progress( const std::string& label, uint64_t total, bool bytes = false, int rate = DEFAULT_RATE );
+
+        //! Add work done, and report if it is time to
+        void add( uint64_t n = 1 ) {
+            uint64_t done = mDone.fetch_add( n, std::memory_order_relaxed ) + n;
+            Ticks t = now();
+            Ticks next = mNext.load( std::memory_order_relaxed );
+            if( t >= next && mNext.compare_exchange_strong( next, t + mInterval, std::memory_order_relaxed ) ) {
+                sosicon::logstream << format( done ) << sosicon::flush;
+            }
+        }
+
+        //! Work done so far
+        uint64_t done() const { return mDone.load( std::memory_order_relaxed ); }
+
+    }; // class Progress
+
+}; // namespace sosicon
+
+#endif
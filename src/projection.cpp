@@ -0,0 +1,153 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "projection.h"
+
+namespace {
+
+    const double PI = 3.14159265358979323846;
+
+    const double DEG_TO_RAD = PI / 180.0;
+
+    //! Latitude limit of the square Web Mercator world
+    const double MAX_MERCATOR_LATITUDE = 85.0511287798066;
+
+}; // namespace
+
+bool sosicon::geometry::TransverseMercator::
+init( const std::string& wkt ) {
+
+    mValid = false;
+    if( wkt.find( "Transverse_Mercator" ) == std::string::npos ) {
+        return false;
+    }
+
+    double invF = 0, primeMeridian = 0, lat0 = 0, lon0 = 0;
+    if( !wktValue( wkt, "SPHEROID[", 0, mA ) || !wktValue( wkt, "SPHEROID[", 1, invF ) ||
+        !wktValue( wkt, "\"central_meridian\"", 0, lon0 ) ||
+        !wktValue( wkt, "\"scale_factor\"", 0, mK0 ) ||
+        !wktValue( wkt, "\"false_easting\"", 0, mFalseE ) ||
+        !wktValue( wkt, "\"false_northing\"", 0, mFalseN ) )
+    {
+        return false;
+    }
+    wktValue( wkt, "PRIMEM[", 0, primeMeridian );
+    wktValue( wkt, "\"latitude_of_origin\"", 0, lat0 );
+
+    double f = invF > 0 ? 1.0 / invF : 0;
+    mE2 = 2 * f - f * f;
+    mEp2 = mE2 / ( 1 - mE2 );
+    mLon0 = ( lon0 + primeMeridian ) * DEG_TO_RAD;
+    mM0 = meridianDistance( lat0 * DEG_TO_RAD );
+    mValid = mA > 0 && mK0 > 0;
+    return mValid;
+}
+
+void sosicon::geometry::TransverseMercator::
+inverse( double e, double n, double& lon, double& lat ) const {
+
+    double e2 = mE2;
+    double m = mM0 + ( n - mFalseN ) / mK0;
+    double mu = m / ( mA * ( 1 - e2 / 4 - 3 * e2 * e2 / 64 - 5 * e2 * e2 * e2 / 256 ) );
+    double sq = std::sqrt( 1 - e2 );
+    double e1 = ( 1 - sq ) / ( 1 + sq );
+    double e1_2 = e1 * e1;
+    double e1_3 = e1_2 * e1;
+    double e1_4 = e1_3 * e1;
+
+    // Footpoint latitude
+    double phi1 = mu + ( 3 * e1 / 2 - 27 * e1_3 / 32 ) * std::sin( 2 * mu )
+                     + ( 21 * e1_2 / 16 - 55 * e1_4 / 32 ) * std::sin( 4 * mu )
+                     + ( 151 * e1_3 / 96 ) * std::sin( 6 * mu )
+                     + ( 1097 * e1_4 / 512 ) * std::sin( 8 * mu );
+
+    double sinPhi1 = std::sin( phi1 );
+    double cosPhi1 = std::cos( phi1 );
+    double tanPhi1 = sinPhi1 / cosPhi1;
+    double c1 = mEp2 * cosPhi1 * cosPhi1;
+    double t1 = tanPhi1 * tanPhi1;
+    double w = 1 - e2 * sinPhi1 * sinPhi1;
+    double n1 = mA / std::sqrt( w );
+    double r1 = mA * ( 1 - e2 ) / ( w * std::sqrt( w ) );
+    double d = ( e - mFalseE ) / ( n1 * mK0 );
+    double d2 = d * d;
+    double d3 = d2 * d;
+    double d4 = d3 * d;
+    double d5 = d4 * d;
+    double d6 = d5 * d;
+
+    double phi = phi1 - ( n1 * tanPhi1 / r1 ) *
+                 ( d2 / 2
+                   - ( 5 + 3 * t1 + 10 * c1 - 4 * c1 * c1 - 9 * mEp2 ) * d4 / 24
+                   + ( 61 + 90 * t1 + 298 * c1 + 45 * t1 * t1 - 252 * mEp2 - 3 * c1 * c1 ) * d6 / 720 );
+    double lambda = mLon0 +
+                    ( d
+                      - ( 1 + 2 * t1 + c1 ) * d3 / 6
+                      + ( 5 - 2 * c1 + 28 * t1 - 3 * c1 * c1 + 8 * mEp2 + 24 * t1 * t1 ) * d5 / 120 ) / cosPhi1;
+
+    lat = phi / DEG_TO_RAD;
+    lon = lambda / DEG_TO_RAD;
+}
+
+double sosicon::geometry::TransverseMercator::
+meridianDistance( double phi ) const {
+    double e2 = mE2;
+    double e4 = e2 * e2;
+    double e6 = e4 * e2;
+    return mA * ( ( 1 - e2 / 4 - 3 * e4 / 64 - 5 * e6 / 256 ) * phi
+                  - ( 3 * e2 / 8 + 3 * e4 / 32 + 45 * e6 / 1024 ) * std::sin( 2 * phi )
+                  + ( 15 * e4 / 256 + 45 * e6 / 1024 ) * std::sin( 4 * phi )
+                  - ( 35 * e6 / 3072 ) * std::sin( 6 * phi ) );
+}
+
+bool sosicon::geometry::TransverseMercator::
+wktValue( const std::string& wkt, const std::string& key, int index, double& value ) {
+    std::string::size_type pos = wkt.find( key );
+    if( pos == std::string::npos ) {
+        return false;
+    }
+    for( int i = 0; i <= index; i++ ) {
+        pos = wkt.find( ',', pos );
+        if( pos == std::string::npos ) {
+            return false;
+        }
+        pos++;
+    }
+    const char* start = wkt.c_str() + pos;
+    char* end = 0;
+    value = std::strtod( start, &end );
+    return end != start;
+}
+
+void sosicon::geometry::
+webMercator( double lon, double lat, double& x, double& y ) {
+    if( lat > MAX_MERCATOR_LATITUDE ) {
+        lat = MAX_MERCATOR_LATITUDE;
+    }
+    else if( lat < -MAX_MERCATOR_LATITUDE ) {
+        lat = -MAX_MERCATOR_LATITUDE;
+    }
+    double phi = lat * DEG_TO_RAD;
+    x = ( lon + 180.0 ) / 360.0;
+    y = ( 1 - std::log( std::tan( phi ) + 1 / std::cos( phi ) ) / PI ) / 2;
+}
+
+void sosicon::geometry::
+webMercatorInverse( double x, double y, double& lon, double& lat ) {
+    lon = x * 360.0 - 180.0;
+    lat = std::atan( std::sinh( PI * ( 1 - 2 * y ) ) ) / DEG_TO_RAD;
+}
@@ -0,0 +1,122 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PROJECTION_H__
+#define __PROJECTION_H__
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+namespace sosicon {
+
+    namespace geometry {
+
+        //! Transverse Mercator projection
+        /*!
+            \author Espen Andersen
+            \copyright GNU General Public License
+
+            Converts projected coordinates back to geographic longitude and latitude, using the
+            series expansion in Snyder, Map Projections - A Working Manual (USGS 1987),
+            section 8. Within a UTM zone the error is well below a millimetre near the central
+            meridian, and below a metre at the zone edges.
+
+            All coordinate systems in the SOSI KOORDSYS table are Transverse Mercator
+            projections. Datum shifts are not applied, so coordinates come out in the datum
+            of the source: EUREF89 (ETRS89) matches WGS84 to within a metre, while NGO 1948
+            and ED50 are off by up to a few hundred metres.
+         */
+        class TransverseMercator {
+
+            double mA;        //!< Semi-major axis
+            double mE2;       //!< Eccentricity squared
+            double mEp2;      //!< Second eccentricity squared
+            double mK0;       //!< Scale factor on the central meridian
+            double mLon0;     //!< Central meridian, radians from Greenwich
+            double mM0;       //!< Meridian distance to the latitude of origin
+            double mFalseE;   //!< False easting
+            double mFalseN;   //!< False northing
+            bool mValid;      //!< True if the parameters have been set
+
+            //! Meridian distance from the equator to latitude phi
+            double meridianDistance( double phi ) const;
+
+            //! Read numeric value following key in WKT string
+            /*!
+                \param wkt WKT string.
+                \param key Text preceding the values, such as SPHEROID[.
+                \param index 0 for the first value after key, which follows the first comma.
+                \param value Receives the value.
+                \return False if the key or value is missing.
+             */
+            static bool wktValue( const std::string& wkt, const std::string& key, int index, double& value );
+
+        public:
+
+            //! Construct invalid projection
+            TransverseMercator() : mA( 0 ), mE2( 0 ), mEp2( 0 ), mK0( 1 ), mLon0( 0 ), mM0( 0 ),
+                                   mFalseE( 0 ), mFalseN( 0 ), mValid( false ) { }
+
+            //! Set up projection from the parameters of an ESRI WKT projection string
+            /*!
+                \param wkt Projection string, as found in the KOORDSYS table
+                       (see sosicon::sosi::CoordSys::prjString()).
+                \return False if the string does not describe a Transverse Mercator projection.
+             */
+            bool init( const std::string& wkt );
+
+            //! True if init() has succeeded
+            bool valid() const { return mValid; }
+
+            //! Convert projected coordinates to geographic
+            /*!
+                \param e East.
+                \param n North.
+                \param lon Receives longitude in degrees.
+                \param lat Receives latitude in degrees.
+             */
+            void inverse( double e, double n, double& lon, double& lat ) const;
+
+        }; // class TransverseMercator
+
+        //! Convert longitude and latitude to normalized Web Mercator coordinates
+        /*!
+            Both axes run from 0 to 1 across the world, with y pointing south, as in the
+            tile schemes of web maps. Latitudes beyond ±85.0511° are clamped.
+            \param lon Longitude in degrees.
+            \param lat Latitude in degrees.
+            \param x Receives x, 0 at 180°W.
+            \param y Receives y, 0 at 85.0511°N.
+         */
+        void webMercator( double lon, double lat, double& x, double& y );
+
+        //! Convert normalized Web Mercator coordinates to longitude and latitude
+        /*!
+            Inverse of webMercator().
+            \param x Normalized x.
+            \param y Normalized y.
+            \param lon Receives longitude in degrees.
+            \param lat Receives latitude in degrees.
+         */
+        void webMercatorInverse( double x, double y, double& lon, double& lat );
+
+    }; // namespace geometry
+
+}; // namespace sosicon
+
+#endif
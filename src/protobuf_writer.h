@@ -0,0 +1,108 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PROTOBUF_WRITER_H__
+#define __PROTOBUF_WRITER_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace sosicon {
+
+    //! Protocol Buffers encoder
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Minimal writer for the Protocol Buffers wire format, covering what the vector tile
+        schema needs: varints, length-delimited fields and packed repeated integers.
+        Nested messages are encoded into a writer of their own and appended with message().
+    */
+    class ProtobufWriter {
+
+        //! Encoded message
+        std::string mData;
+
+        //! Wire types
+        enum WireType {
+            wire_varint = 0,
+            wire_length_delimited = 2
+        };
+
+        //! Append field key
+        void key( unsigned int field, WireType type ) {
+            varint( ( static_cast<uint64_t>( field ) << 3 ) | type );
+        }
+
+    public:
+
+        //! Encode signed integer so that small magnitudes give short varints
+        static uint32_t zigzag( int32_t value ) {
+            return ( static_cast<uint32_t>( value ) << 1 ) ^ static_cast<uint32_t>( value >> 31 );
+        }
+
+        //! Append raw varint
+        void varint( uint64_t value ) {
+            while( value >= 0x80 ) {
+                mData += static_cast<char>( ( value & 0x7f ) | 0x80 );
+                value >>= 7;
+            }
+            mData += static_cast<char>( value );
+        }
+
+        //! Append unsigned integer field
+        void uint( unsigned int field, uint64_t value ) {
+            key( field, wire_varint );
+            varint( value );
+        }
+
+        //! Append string or bytes field
+        void bytes( unsigned int field, const std::string& value ) {
+            key( field, wire_length_delimited );
+            varint( value.size() );
+            mData += value;
+        }
+
+        //! Append nested message
+        void message( unsigned int field, const ProtobufWriter& msg ) {
+            bytes( field, msg.mData );
+        }
+
+        //! Append packed repeated unsigned integers
+        void packed( unsigned int field, const std::vector<uint32_t>& values ) {
+            ProtobufWriter content;
+            for( std::vector<uint32_t>::const_iterator i = values.begin(); i != values.end(); i++ ) {
+                content.varint( *i );
+            }
+            bytes( field, content.mData );
+        }
+
+        //! Encoded message
+        const std::string& data() const { return mData; }
+
+        //! True if nothing has been written
+        bool empty() const { return mData.empty(); }
+
+        //! Reset writer
+        void clear() { mData.clear(); }
+
+    }; // class ProtobufWriter
+
+}; // namespace sosicon
+
+#endif
@@ -17,6 +17,70 @@
  */
 #include "shapefile.h"
 
+namespace {
+
+    //! Widest numeric field written as N
+    const int MAX_NUMERIC_WIDTH = 20;
+
+    //! Most decimals in a numeric field
+    const int MAX_NUMERIC_DECIMALS = 15;
+
+    //! Width of a numeric field, with sign and decimal point
+    int numericWidth( const sosicon::ColumnType& type ) {
+        if( type.kind() == sosicon::ColumnType::kind_decimal ) {
+            return ( type.negative() ? 1 : 0 ) + type.precision() + 1;
+        }
+        return static_cast<int>( type.length() );
+    }
+
+    //! dBase field type for inferred column type
+    char dbfType( const sosicon::ColumnType& type ) {
+        switch( type.kind() ) {
+            case sosicon::ColumnType::kind_date:
+                return 'D';
+            case sosicon::ColumnType::kind_boolean:
+                return 'L';
+            case sosicon::ColumnType::kind_int32:
+            case sosicon::ColumnType::kind_int64:
+            case sosicon::ColumnType::kind_decimal:
+                if( numericWidth( type ) <= MAX_NUMERIC_WIDTH && type.scale() <= MAX_NUMERIC_DECIMALS ) {
+                    return 'N';
+                }
+                return 'C';
+            default:
+                return 'C';
+        }
+    }
+
+    //! Format value for a field of given dBase type
+    /*!
+        Numbers are right-aligned, with the same number of decimals in every record.
+        Logicals are written as T or F, or ? if missing.
+    */
+    std::string dbfValue( const sosicon::ColumnType& type, char dbf, const std::string& value, int length ) {
+        std::string res = value;
+        if( dbf == 'L' ) {
+            res = value.empty() ? "?" : ( sosicon::ColumnType::isTrue( value ) ? "T" : "F" );
+        }
+        else if( dbf == 'N' && !value.empty() ) {
+            if( type.scale() > 0 ) {
+                std::string::size_type point = res.find( '.' );
+                if( point == std::string::npos ) {
+                    point = res.length();
+                    res += '.';
+                }
+                res.resize( point + 1 + type.scale(), '0' );
+            }
+            if( static_cast<int>( res.length() ) < length ) {
+                res.insert( 0, length - res.length(), ' ' );
+            }
+        }
+        res.resize( length, ' ' );
+        return res;
+    }
+
+}; // namespace
+
 sosicon::shape::ShapeType sosicon::shape::
 getShapeEquivalent( sosi::ElementType sosiType ) {
     switch( sosiType ) {
@@ -52,14 +116,14 @@ adjustMasterMbr( double xMin, double yMin, double xMax, double yMax ) {
 }
 
 int sosicon::shape::Shapefile::
-build( ISosiElement* sosiTree, std::string objType, sosi::ElementType geomType ) {
+build( ISosiElement* sosiTree, const std::string& objType, sosi::ElementType geomType ) {
 
     int count = 0;
 
     mSosiTree = sosiTree;
 
     ISosiElement* sosi = 0;
-    sosi::SosiElementSearch src;
+    sosi::SosiElementSearch src( geomType );
     ShapeType shapeTypeEquivalent = shape_type_none;
 
     std::vector<std::string>& f = mFilterSosiId;
@@ -72,13 +136,10 @@ build( ISosiElement* sosiTree, std::string objType, sosi::ElementType geomType )
             ( f.size() == 0 || std::find( f.begin(), f.end(), sosi->getSerial() ) != f.end() )
           )
         {
-
-            if( sosi->getType() == geomType ) {
-                shapeTypeEquivalent = getShapeEquivalent( sosi->getType() );
-                buildShpElement( sosi, shapeTypeEquivalent );
-                insertDbfRecord( sosi );
-                ++count;
-            }
+            shapeTypeEquivalent = getShapeEquivalent( sosi->getType() );
+            buildShpElement( sosi, shapeTypeEquivalent );
+            insertDbfRecord( sosi );
+            ++count;
         }
     }
     if( count > 0 ) {
@@ -88,6 +149,8 @@ build( ISosiElement* sosiTree, std::string objType, sosi::ElementType geomType )
         buildDbf(); // database (attributes table)
         buildShx(); // index
 
+        DbfRecordSet().swap( mDbfRecordSet ); // Encoded, release before the file is written
+
     }
 
     return count;
@@ -131,7 +194,7 @@ buildShpHeader( ShapeType type ) {
 void sosicon::shape::Shapefile::
 buildShpElement( ISosiElement* sosi, ShapeType type ) {
 
-    CoordinateCollection cc;
+    CoordinateCollection cc( mTolerance, mTopology );
     cc.discoverCoords( sosi );
 
     switch( type ) {
@@ -189,30 +252,25 @@ buildShpPolygon( CoordinateCollection& cc ) {
 
 void sosicon::shape::Shapefile::
 buildShpRecCoordinate( int& pos, CoordinateCollection& cc ) {
-    ICoordinate* c = 0;
-    cc.getNextInGeom( c );
-    if( c ) {
-        buildShpRecCoordinate( pos, c );
+    const geometry::PointArray& xy = cc.getGeom();
+    if( xy.size() >= 2 ) {
+        byteOrder::doublesToLittleEndian( &xy[ 0 ], &mShpBuffer[ pos ], 2 );
+        adjustMasterMbr( xy[ 0 ], xy[ 1 ], xy[ 0 ], xy[ 1 ] );
+        pos += 16;
     }
 }
 
 void sosicon::shape::Shapefile::
-buildShpRecCoordinate( int& pos, ICoordinate* c ) {
-    byteOrder::doubleToLittleEndian( c->getE(), &mShpBuffer[ pos ] );
-    byteOrder::doubleToLittleEndian( c->getN(), &mShpBuffer[ pos + 8 ] );
-    adjustMasterMbr( c->getE(), c->getN(), c->getE(), c->getN() );
-    pos += 16;
+buildShpRecCoordinates( int& pos, CoordinateCollection& cc ) {
+    buildShpRecCoordinates( pos, cc.getGeom() );
+    buildShpRecCoordinates( pos, cc.getHoles() );
 }
 
 void sosicon::shape::Shapefile::
-buildShpRecCoordinates( int& pos, CoordinateCollection& cc ) {
-    std::vector<ICoordinate*> theGeom = cc.getGeom();
-    for( std::vector<ICoordinate*>::size_type i = 0; i < theGeom.size(); i++ ) {
-        buildShpRecCoordinate( pos, theGeom[ i ] );
-    }
-    std::vector<ICoordinate*> theHoles = cc.getHoles();
-    for( std::vector<ICoordinate*>::size_type i = 0; i < theHoles.size(); i++ ) {
-        buildShpRecCoordinate( pos, theHoles[ i ] );
+buildShpRecCoordinates( int& pos, const geometry::PointArray& xy ) {
+    if( !xy.empty() ) {
+        byteOrder::doublesToLittleEndian( &xy[ 0 ], &mShpBuffer[ pos ], xy.size() );
+        pos += static_cast<int>( xy.size() * sizeof( double ) );
     }
 }
 
@@ -288,6 +346,12 @@ buildDbf() {
     int recLen;
     recLen = 1; // Deleted flag == 1 byte
     for( DbfFieldLengths::iterator i = mDbfFieldLengths.begin(); i != mDbfFieldLengths.end(); i++ ) {
+        const ColumnType& type = mDbfFieldTypes[ i->first ];
+        switch( dbfType( type ) ) {
+            case 'D': i->second = 8; break;
+            case 'L': i->second = 1; break;
+            case 'N': i->second = numericWidth( type ); break;
+        }
         recLen += i->second;
     }
 
@@ -327,8 +391,10 @@ buildDbfFieldDescriptor( int& pos ) {
         std::copy( sz, sz + 11, &mDbfBuffer[ pos ] );
         utils::asciify( &mDbfBuffer[ pos ] );
 
-        // Field data type (char)
-        mDbfBuffer[ pos + 11 ] = 'C';
+        // Field data type
+        const ColumnType& type = mDbfFieldTypes[ i->first ];
+        char dbf = dbfType( type );
+        mDbfBuffer[ pos + 11 ] = dbf;
 
         // Field data address (N/A)
         for( int j = 12; j < 16; j++ ) {
@@ -336,8 +402,11 @@ buildDbfFieldDescriptor( int& pos ) {
         }
         mDbfBuffer[ pos + 16 ] = char( i->second );
 
+        // Decimal count
+        mDbfBuffer[ pos + 17 ] = char( dbf == 'N' ? type.scale() : 0 );
+
         // Reserved or N/A
-        for( int i = 17; i < 32; i++ ) {
+        for( int i = 18; i < 32; i++ ) {
             mDbfBuffer[ pos + i ] = 0x00;
         }
 
@@ -383,6 +452,11 @@ buildDbfHeader( int recLen ) {
 void sosicon::shape::Shapefile::
 buildDbfRecordSection( int& pos, int recLen ) {
 
+    std::vector<char> types;
+    for( DbfFieldLengths::iterator j = mDbfFieldLengths.begin(); j != mDbfFieldLengths.end(); j++ ) {
+        types.push_back( dbfType( mDbfFieldTypes[ j->first ] ) );
+    }
+
     for( DbfRecordSet::iterator i = mDbfRecordSet.begin(); i != mDbfRecordSet.end(); i++ ) {
         char* recordBuffer = 0;
         try {
@@ -394,14 +468,15 @@ buildDbfRecordSection( int& pos, int recLen ) {
         int fldOffset = 0;
         recordBuffer[ fldOffset++ ] = 0x20; // Record deleted flag
         DbfRecord& rec = *i;
+        std::vector<char>::size_type field = 0;
         for( DbfFieldLengths::iterator j = mDbfFieldLengths.begin(); j != mDbfFieldLengths.end(); j++ ) {
             std::string fieldName = j->first;
             std::string fieldValue;
             if( rec.find( fieldName ) != rec.end() ) {
                 fieldValue = rec[ fieldName ];
             }
-            int fieldLength = mDbfFieldLengths[ fieldName ];
-            fieldValue.resize( fieldLength, ' ' );
+            int fieldLength = j->second;
+            fieldValue = dbfValue( mDbfFieldTypes[ fieldName ], types[ field++ ], fieldValue, fieldLength );
             const char* sz = fieldValue.c_str();
             std::copy( sz, sz + fieldLength, &recordBuffer[ fldOffset ] );
             fldOffset += fieldLength;
@@ -493,16 +568,14 @@ expandShpBuffer( int byteLen ) {
 void sosicon::shape::Shapefile::
 extractDbfFields( ISosiElement* sosi, DbfRecord& rec ) {
 
-    std::string field;
-    std::string data;
     ISosiElement* child = 0;
     sosi::SosiElementSearch src;
 
     while( sosi->getChild( src ) ) {
         child = src.element();
         if( child->getType() != sosi::sosi_element_ne ) {
-            data = utils::trim( child->getData() );
-            saveToDbf( rec, child->getName(), data );
+            // Element data is trimmed by the parser
+            saveToDbf( rec, child->getName(), child->getData() );
             extractDbfFields( child, rec );
         }
     }
@@ -526,15 +599,14 @@ insertShxOffset( int contentLen ) {
 }
 
 void sosicon::shape::Shapefile::
-saveToDbf( DbfRecord& rec, std::string field, std::string data ) {
+saveToDbf( DbfRecord& rec, const std::string& field, const std::string& data ) {
     int length = static_cast< int >( data.size() );
     if( !data.empty() && length < 254 ) {
-        if( mDbfFieldLengths.find( field ) != mDbfFieldLengths.end() ) {
-            mDbfFieldLengths[ field ] = std::max( mDbfFieldLengths[ field ], length );
-        }
-        else {
-            mDbfFieldLengths[ field ] = length;
+        std::pair<DbfFieldLengths::iterator,bool> ins = mDbfFieldLengths.insert( std::make_pair( field, length ) );
+        if( !ins.second ) {
+            ins.first->second = std::max( ins.first->second, length );
         }
+        mDbfFieldTypes[ field ].expand( data );
         rec[ field ] = data;
     }
 }
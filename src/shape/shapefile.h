@@ -66,6 +66,9 @@ namespace sosicon {
             std::vector<std::string> mFilterSosiId;       //!< List of IDs of SOSI elements to be exported, if specified
             std::vector<std::string> mFilterSosiObjTypes; //!< Objtypes of selected elements to be exported, if specified
 
+            double mTolerance;         //!< Simplification tolerance, 0 if geometries are exported as they are
+            bool mTopology;            //!< Simplify shared curves rather than each feature
+
             char mShpHeader[ 100 ];    //!< Main SHP file header
             char* mShpBuffer;          //!< SHP file payload
             int mShpSize;              //!< Data length of SHP file buffer
@@ -87,6 +90,7 @@ namespace sosicon {
             double mYmax;              //!< Minimum bounding rectangle, max Y
 
             DbfFieldLengths mDbfFieldLengths; //!< Accumulation of DBF fields and their lenghts
+            DbfFieldTypes mDbfFieldTypes;     //!< Inferred type of each DBF field
             DbfRecordSet mDbfRecordSet;       //!< All DBF records
             ShxOffsets mShxOffsets;           //!< Index file offsets
 
@@ -159,17 +163,17 @@ namespace sosicon {
             */
             void buildShpRecCoordinate( int& pos, CoordinateCollection& cc );
 
-            //! Write coordinate pair to shapefile buffer
+            //! Write coordinate pairs to shapefile buffer
             /*!
-                Build shapefile coordinate from the provided coordinate pair and
-                update buffer position.
+                Copies an array of east, north pairs to the buffer and updates the
+                buffer position.
                 \param pos Reference to an integer holding current position within
                            the shapefile buffer Shapefile::mShpBuffer. The position
                            is updated to reflect the first "free" position after
                            writing to the buffer.
-                \param c The coordinate to be written to the buffer.
+                \param xy The coordinates to be written to the buffer.
             */
-            void buildShpRecCoordinate( int& pos, ICoordinate* c );
+            void buildShpRecCoordinates( int& pos, const geometry::PointArray& xy );
 
             //! Write multiple coordinate pairs to shapefile buffer
             /*!
@@ -244,6 +248,8 @@ namespace sosicon {
                 Part of DBF creation.
                 Iterates through individual fields found in current dataset and
                 creates a field descriptor header for the following dBase records.
+                Fields are typed from their values: dates as D, booleans as L, and
+                numbers as N, while everything else is stored as characters.
                 \see Shapefile::buildDbf
                 \see Shapefile::buildDbfHeader
                 \see Shapefile::buildDbfRecordSection
@@ -353,10 +359,10 @@ namespace sosicon {
             
             //! Update or insert new DBF field
             /*!
-                Appends or updates data for the DFB record, updating list of field names
-                and lengths.
+                Appends or updates data for the DFB record, updating list of field names,
+                lengths and types.
             */
-            void saveToDbf( DbfRecord& rec, std::string field, std::string data );
+            void saveToDbf( DbfRecord& rec, const std::string& field, const std::string& data );
 
         public:
 
@@ -366,6 +372,8 @@ namespace sosicon {
             */
             Shapefile() :
                 mSosiTree( 0 ),
+                mTolerance( 0 ),
+                mTopology( false ),
                 mShpBuffer( 0 ),
                 mShpSize( 0 ),
                 mShpBufferSize( 0 ),
@@ -383,11 +391,19 @@ namespace sosicon {
             virtual ~Shapefile();
 
             //! Described in IShapefile
-            virtual int build( ISosiElement* sosiTree, std::string objType, sosi::ElementType geomType );
+            virtual int build( ISosiElement* sosiTree, const std::string& objType, sosi::ElementType geomType );
 
             //! Described in IShapefile
             virtual void filterSosiId( std::vector<std::string> sosiId ) { mFilterSosiId = sosiId; };
 
+            //! Set simplification tolerance
+            /*!
+                Lines and polygons are simplified while being built.
+                \param tolerance See sosicon::CoordinateCollection::simplify(). 0 disables.
+                \param topology Preserve shared boundaries, see sosicon::CurveCache::get().
+            */
+            void setTolerance( double tolerance, bool topology ) { mTolerance = tolerance; mTopology = topology; };
+
             //! Described in IShapefileDbfPart
             virtual void writeDbf( std::ostream &os );
 
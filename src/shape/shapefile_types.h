@@ -22,6 +22,7 @@
 #include <map>
 #include <algorithm>
 #include <limits>
+#include "../column_type.h"
 
 namespace sosicon {
 
@@ -88,6 +89,7 @@ namespace sosicon {
         typedef std::map<std::string, std::string> DbfRecord;
         typedef std::vector<DbfRecord> DbfRecordSet;
         typedef std::map<std::string, int> DbfFieldLengths;
+        typedef std::map<std::string, ColumnType> DbfFieldTypes;
         typedef std::vector<ShxIndex> ShxOffsets;
 
     }; // namespace shape
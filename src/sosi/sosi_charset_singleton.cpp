@@ -29,8 +29,14 @@ SosiCharsetSingleton() {
 void sosicon::sosi::SosiCharsetSingleton::
 init( ISosiElement* sosiElement ) {
     mSosiElement = sosiElement;
-    mCharsetName = sosiElement->getData();
+    init( sosiElement->getData() );
+}
+
+void sosicon::sosi::SosiCharsetSingleton::
+init( const std::string& charsetName ) {
+    mCharsetName = charsetName;
     mInitialized = true;
+    mNames.clear();
          if( "ANSI"       == mCharsetName ) mCharset = sosi_charset_ansi;
     else if( "DECN7"      == mCharsetName ) mCharset = sosi_charset_decn7;
     else if( "DOSN8"      == mCharsetName ) mCharset = sosi_charset_dosn8;
@@ -71,6 +77,24 @@ toIso8859_1( const std::string& str ) {
     return res;
 }
 
+const std::string& sosicon::sosi::SosiCharsetSingleton::
+nameToIso8859_1( const std::string& name ) {
+    switch( mCharset ) {
+        case sosi_charset_decn7:
+        case sosi_charset_dosn8:
+        case sosi_charset_nd7:
+        case sosi_charset_utf8:
+            break;
+        default:
+            return name; // No conversion
+    }
+    std::map<std::string,std::string>::iterator i = mNames.find( name );
+    if( i == mNames.end() ) {
+        i = mNames.insert( std::make_pair( name, toIso8859_1( name ) ) ).first;
+    }
+    return i->second;
+}
+
 std::string sosicon::sosi::SosiCharsetSingleton::
 utf8ToIso8859_1( const char *in ) {
     std::string out;
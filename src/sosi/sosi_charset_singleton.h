@@ -26,6 +26,7 @@
 #include "../interface/i_sosi_head_member.h"
 #include "sosi_types.h"
 #include <iostream>
+#include <map>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -125,6 +126,13 @@ namespace sosicon {
             //! Name of character set
             std::string mCharsetName;
 
+            //! Element names converted to ISO8859-1
+            /*!
+                A file uses only a few distinct element names, so each is converted once and
+                shared by all elements. Cleared when the character set changes.
+             */
+            std::map<std::string,std::string> mNames;
+
             //! Construct new SOSI Charset element
             /*!
                 Declared private because it's a singleton.
@@ -159,11 +167,27 @@ namespace sosicon {
             //! Initialize SOSI Unit element
             virtual void init( ISosiElement* e );
 
+            //! Initialize from TEGNSETT value
+            /*!
+                Used where no element tree is available.
+                \param charsetName The TEGNSETT value, e.g. ISO8859-1.
+             */
+            void init( const std::string& charsetName );
+
             virtual bool initialized() { return mInitialized; }
 
             //! Convert string to ISO8859-1 (default Ragel charset)
             std::string toIso8859_1( const std::string& str );
 
+            //! Convert element name to ISO8859-1
+            /*!
+                Same as toIso8859_1(), but returns a reference to a shared copy instead of
+                building a new string on every call.
+                \param name Raw element name as read from the SOSI file.
+                \return Converted name. Valid until the character set is changed.
+             */
+            const std::string& nameToIso8859_1( const std::string& name );
+
         }; // class SosiCharsetSingleton
        /*! @} end group sosi_elements */
 
@@ -26,26 +26,79 @@ SosiElement( std::string name, std::string serial, std::string data, int level,
     mType = mTranslation.sosiNameToType( mName );
     mObjType = sosi::sosi_objtype_unknown;
     mRoot = root ? root : this;
+    mParent = 0;
+    mChildTypes = 0;
+    mSubtreeTypes = 0;
+    mTypeIndex = 0;
     if( !mSerial.empty() ) {
         mIndex[ mSerial ] = this;
     }
 }
 
+sosicon::sosi::SosiElement::
+~SosiElement() {
+    dropTypeIndex();
+    if( !mSerial.empty() ) {
+        SosiElementMap::iterator i = mIndex.find( mSerial );
+        if( i != mIndex.end() && i->second == this ) {
+            mIndex.erase( i );
+        }
+    }
+}
+
 void sosicon::sosi::SosiElement::
 addChild( ISosiElement* child ) {
     if( child->getType() == sosi::sosi_element_objtype ) {
         mObjTypeStr = child->getData();
         mObjType = mTranslation.sosiObjNameToType( mObjTypeStr );
     }
+    ElementTypeMask bit = elementTypeBit( child->getType() );
+    if( mTypeIndex ) {
+        SosiChildrenList::size_type t = static_cast<SosiChildrenList::size_type>( child->getType() );
+        if( t >= mTypeIndex->size() ) {
+            mTypeIndex->resize( t + 1 );
+        }
+        ( *mTypeIndex )[ t ].push_back( mChildren.size() );
+    }
     mChildren.push_back( child );
+    child->setParent( this );
+    mChildTypes |= bit;
+    addSubtreeTypes( bit | child->getSubtreeTypes() );
 };
 
+void sosicon::sosi::SosiElement::
+addSubtreeTypes( ElementTypeMask types ) {
+    if( ( mSubtreeTypes | types ) != mSubtreeTypes ) {
+        mSubtreeTypes |= types;
+        if( mParent ) {
+            mParent->addSubtreeTypes( types );
+        }
+    }
+}
+
+void sosicon::sosi::SosiElement::
+buildTypeIndex() {
+    dropTypeIndex();
+    mTypeIndex = new std::vector< std::vector<SosiChildrenList::size_type> >();
+    for( SosiChildrenList::size_type i = 0; i < mChildren.size(); i++ ) {
+        SosiChildrenList::size_type t = static_cast<SosiChildrenList::size_type>( mChildren[ i ]->getType() );
+        if( t >= mTypeIndex->size() ) {
+            mTypeIndex->resize( t + 1 );
+        }
+        ( *mTypeIndex )[ t ].push_back( i );
+    }
+}
+
 void sosicon::sosi::SosiElement::
 deleteChildren() {
     for( std::vector<ISosiElement*>::iterator i = mChildren.begin(); i != mChildren.end(); i++ ) {
         ( *i )->deleteChildren();
         delete *i;
     }
+    mChildren.clear();
+    dropTypeIndex();
+    mChildTypes = 0;
+    mSubtreeTypes = 0;
 }
 
 void sosicon::sosi::SosiElement::
@@ -60,14 +113,8 @@ dump( int indent ) {
 
 sosicon::ISosiElement* sosicon::sosi::SosiElement::
 find( std::string ref ) {
-    ISosiElement* e;
-    try {
-        e = mIndex[ ref ];
-    }
-    catch ( ... ) {
-        e = 0;
-    }
-    return e;
+    SosiElementMap::iterator i = mIndex.find( ref );
+    return i == mIndex.end() ? 0 : i->second;
 }
 
 bool sosicon::sosi::SosiElement::
@@ -90,18 +137,60 @@ nextChild( SosiElementSearch& src ) {
     return moreToGo;
 }
 
-std::string sosicon::sosi::SosiElement::
+const std::string& sosicon::sosi::SosiElement::
 getName() {
     SosiCharsetSingleton* cs = SosiCharsetSingleton::getInstance();
-    return cs->toIso8859_1( mName );
+    return cs->nameToIso8859_1( mName );
 }
 
 bool sosicon::sosi::SosiElement::
 getChild( SosiElementSearch& src ) {
-    bool res = nextChild( src );
     sosi::ElementType t = src.type();
-    while( res == true  && t != sosi::sosi_element_unknown && !src.matchTypes() ) {
+    if( t == sosi::sosi_element_unknown ) {
+        return nextChild( src );
+    }
+    if( !src.matchTypes( mChildTypes ) || mChildren.size() >= TYPE_INDEX_THRESHOLD ) {
+        return indexedChild( src );
+    }
+    bool res = nextChild( src );
+    while( res == true && !src.matchTypes() ) {
         res = nextChild( src );
     }
     return res;
 }
+
+bool sosicon::sosi::SosiElement::
+indexedChild( SosiElementSearch& src ) {
+    SosiChildrenList::size_type n = mChildren.size();
+    if( n == 0 ) {
+        return false;
+    }
+    SosiChildrenList::size_type from = src.element() == 0 ? 0 : src.index();
+    SosiChildrenList::size_type pos = n;
+    if( src.matchTypes( mChildTypes ) ) {
+        if( !mTypeIndex ) {
+            buildTypeIndex();
+        }
+        std::vector<sosi::ElementType>& types = src.types();
+        for( std::vector<sosi::ElementType>::iterator i = types.begin(); i != types.end(); i++ ) {
+            SosiChildrenList::size_type t = static_cast<SosiChildrenList::size_type>( *i );
+            if( t < mTypeIndex->size() ) {
+                std::vector<SosiChildrenList::size_type>& positions = ( *mTypeIndex )[ t ];
+                std::vector<SosiChildrenList::size_type>::iterator p = std::lower_bound( positions.begin(), positions.end(), from );
+                if( p != positions.end() && *p < pos ) {
+                    pos = *p;
+                }
+            }
+        }
+    }
+    if( pos < n ) {
+        src.index( pos );
+        src.element( mChildren[ pos ] );
+        src.next();
+        return true;
+    }
+    // Leave search at end of list, like an exhausted sequential search
+    src.index( n );
+    src.element( mChildren.back() );
+    return false;
+}
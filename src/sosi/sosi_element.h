@@ -18,6 +18,7 @@
 #ifndef __SOSI_ELEMENT_H__
 #define __SOSI_ELEMENT_H__
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include "../logger.h"
@@ -35,6 +36,9 @@ namespace sosicon {
         //! Number of entries in coordsys lookup table
         static const int MAX_COORDSYS_TABLE = 184;
 
+        //! Minimum number of children for type filtered searches to use a type index
+        static const SosiChildrenList::size_type TYPE_INDEX_THRESHOLD = 32;
+
         /*!
             \addtogroup sosi_elements SOSI Elements
             Implemented representation of SOSI file elements.
@@ -104,6 +108,37 @@ namespace sosicon {
             //! Reference to parser's lookup table
             SosiElementMap& mIndex;
 
+            //! Pointer to parent element
+            ISosiElement* mParent;
+
+            //! Types of direct children
+            ElementTypeMask mChildTypes;
+
+            //! Types of all descendants
+            /*!
+                Updated as elements are added anywhere below this element. Children removed
+                through children() are not subtracted, so the mask may contain types no longer
+                present.
+             */
+            ElementTypeMask mSubtreeTypes;
+
+            //! Child positions by element type
+            /*!
+                Built on first filtered search through a long list of children, so that
+                getChild() can jump straight to the next match. Dropped whenever the children
+                list is handed out for modification.
+             */
+            std::vector< std::vector<SosiChildrenList::size_type> >* mTypeIndex;
+
+            //! Build mTypeIndex
+            void buildTypeIndex();
+
+            //! Release mTypeIndex
+            void dropTypeIndex() { delete mTypeIndex; mTypeIndex = 0; };
+
+            //! Filtered search using mTypeIndex
+            bool indexedChild( SosiElementSearch& src );
+
             //! Increment to next child in list
             virtual bool nextChild( SosiElementSearch& src );
 
@@ -112,6 +147,13 @@ namespace sosicon {
             //! Construct new SOSI element
             SosiElement( std::string name, std::string serial, std::string data, int level, ISosiElement* root, SosiElementMap& index );
 
+            //! Destructor
+            /*!
+                Removes the element from the parser's lookup table. Children are not deleted,
+                use deleteChildren() first.
+             */
+            virtual ~SosiElement();
+
             //! Insert children element
             virtual void addChild( ISosiElement* child );
 
@@ -124,7 +166,20 @@ namespace sosicon {
             //! Find element by reference
             virtual ISosiElement* find( std::string ref );
 
-            std::vector<ISosiElement*>& children() { return mChildren; };
+            //! Get children list for modification
+            std::vector<ISosiElement*>& children() { dropTypeIndex(); return mChildren; };
+
+            //! Types of the direct children of this element
+            virtual ElementTypeMask getChildTypes() { return mChildTypes; };
+
+            //! Types of all elements below this element
+            virtual ElementTypeMask getSubtreeTypes() { return mSubtreeTypes; };
+
+            //! Merge types into the subtree mask of this element and its ancestors
+            virtual void addSubtreeTypes( ElementTypeMask types );
+
+            //! Set parent element
+            virtual void setParent( ISosiElement* parent ) { mParent = parent; };
 			
 			//! Get next child in list
             /*!
@@ -135,22 +190,22 @@ namespace sosicon {
             virtual bool getChild( SosiElementSearch& src );
 
             //! Get unparsed element data
-            virtual std::string getData() { return mData; };
+            virtual const std::string& getData() { return mData; };
 
             //! Get nesting level of current element
             virtual int getLevel() { return mLevel; };
 
             //! Get ObjType of current element
-            virtual std::string getObjType() { return mObjTypeStr; };
+            virtual const std::string& getObjType() { return mObjTypeStr; };
 
             //! Get name of current element
-            virtual std::string getName();
+            virtual const std::string& getName();
 
             //! Get root element
             virtual ISosiElement* getRoot() { return mRoot; };
 
             //! Get serial number (ID) of current element
-            virtual std::string getSerial() { return mSerial; };
+            virtual const std::string& getSerial() { return mSerial; };
 
             //! Get ElementType of current element
             virtual ElementType getType() { return mType; };
@@ -20,9 +20,13 @@
 
 bool sosicon::sosi::SosiElementSearch::
 matchTypes() {
-    sosi::ElementType t = mSosiElement->getType();
+    return ( mMask & elementTypeBit( mSosiElement->getType() ) ) != 0;
+};
+
+void sosicon::sosi::SosiElementSearch::
+updateMask() {
+    mMask = 0;
     for( std::vector<sosi::ElementType>::iterator i = mElementTypes.begin(); i != mElementTypes.end(); i++ ) {
-        if( t == *i ) return true;
+        mMask |= elementTypeBit( *i );
     }
-    return false;
-};
\ No newline at end of file
+}
\ No newline at end of file
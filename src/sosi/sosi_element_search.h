@@ -43,23 +43,34 @@ namespace sosicon {
 
         typedef SosiChildrenList::iterator SosiChildrenIterator;
 
+        //! Child element search
+        /*!
+            Holds the state of an iteration through the children of an element, optionally
+            filtered by element type. The type filter is kept both as a list and as an
+            ElementTypeMask, so that matching a child is a single bit test.
+            \sa sosicon::ISosiElement::getChild()
+         */
         class SosiElementSearch {
             SosiChildrenList::size_type mIndex;
             ISosiElement* mSosiElement;
             std::vector<sosi::ElementType> mElementTypes;
+            ElementTypeMask mMask;
+            void updateMask();
         public:
-            SosiElementSearch() : mIndex( 0 ), mSosiElement( 0 ) { };
-            SosiElementSearch( sosi::ElementType filter ) : mIndex( 0 ), mSosiElement( 0 ) { mElementTypes.push_back( filter ); };
-            SosiElementSearch( std::vector<sosi::ElementType>& filterList ) : mIndex( 0 ), mSosiElement( 0 ), mElementTypes( filterList ) { };
+            SosiElementSearch() : mIndex( 0 ), mSosiElement( 0 ), mMask( 0 ) { };
+            SosiElementSearch( sosi::ElementType filter ) : mIndex( 0 ), mSosiElement( 0 ) { mElementTypes.push_back( filter ); updateMask(); };
+            SosiElementSearch( std::vector<sosi::ElementType>& filterList ) : mIndex( 0 ), mSosiElement( 0 ), mElementTypes( filterList ) { updateMask(); };
             SosiChildrenList::size_type index() { return mIndex; };
             SosiChildrenList::size_type index( SosiChildrenList::size_type i ) { mIndex = i; return mIndex; };
             ISosiElement* element() { return mSosiElement; };
             ISosiElement* element( ISosiElement* e ) { mSosiElement = e; return mSosiElement; };
             sosi::ElementType type() { return mElementTypes.size() > 0 ? mElementTypes.back() : sosi::sosi_element_unknown; };
-            sosi::ElementType type( sosi::ElementType t ) { mElementTypes.push_back( t ); return t; };
+            sosi::ElementType type( sosi::ElementType t ) { mElementTypes.push_back( t ); mMask |= elementTypeBit( t ); return t; };
             std::vector<sosi::ElementType>& types() { return mElementTypes; };
-            std::vector<sosi::ElementType>& types( std::vector<sosi::ElementType>& t ) { mElementTypes = t; return mElementTypes; };
+            std::vector<sosi::ElementType>& types( std::vector<sosi::ElementType>& t ) { mElementTypes = t; updateMask(); return mElementTypes; };
+            ElementTypeMask mask() { return mMask; };
             bool matchTypes();
+            bool matchTypes( ElementTypeMask types ) { return ( mMask & types ) != 0; };
             void next() { mIndex++; };
         };
 
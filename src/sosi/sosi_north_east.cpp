@@ -36,8 +36,6 @@ SosiNorthEast( ISosiElement* e ) {
     mMinY = +9999999999;
     mMaxX = -9999999999;
     mMaxY = -9999999999;
-    std::string name = e->getName();
-    std::string data = e->getData();
     if( e->getName() == "N\xD8H" ) {
         ragelParseCoordinatesNeh( mSosiElement->getData() );
     }
@@ -114,11 +112,11 @@ append( double n, double e, double h ) {
 
 void sosicon::sosi::SosiNorthEast::
 initHeadMember( ISosiHeadMember& headMember, ElementType type ) {
-    if( !headMember.initialized() ) {
+    ISosiElement* root = mSosiElement->getRoot();
+    if( !headMember.initialized() && ( root->getSubtreeTypes() & elementTypeBit( type ) ) != 0 ) {
         SosiElementSearch head( sosi_element_head );
         SosiElementSearch transpar( sosi_element_transpar );
         SosiElementSearch target( type );
-        ISosiElement* root = mSosiElement->getRoot();
         if( root->getChild( head ) &&
             head.element()->getChild( transpar ) &&
             transpar.element()->getChild( target ) )
@@ -75,6 +75,16 @@ namespace sosicon {
             sosi_element_version                //!< SOSI version
         };
 
+        //! Set of element types, one bit per ElementType value
+        typedef unsigned long long ElementTypeMask;
+
+        static_assert( sosi_element_version < 64, "ElementType values must fit in ElementTypeMask" );
+
+        //! Convert ElementType to its ElementTypeMask bit
+        inline ElementTypeMask elementTypeBit( ElementType type ) {
+            return 1ULL << static_cast<unsigned int>( type );
+        }
+
         //! List of SOSI OBJTYPEs
         enum ObjType {
             sosi_objtype_unknown = 0,                         //!< Unknown or no feature
@@ -27,7 +27,7 @@ SosiUnit() {
 void sosicon::sosi::SosiUnit::
 init( ISosiElement* sosiElement ) {
     mSosiElement = sosiElement;
-    std::string data = sosiElement->getData();
+    const std::string& data = sosiElement->getData();
     double d = 0;
     std::stringstream ss;
     ss << data;
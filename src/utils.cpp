@@ -62,23 +62,69 @@ explode( char delimiter, std::string str ) {
     return lst;
 }
 
-bool sosicon::utils::
-isNumeric( const std::string& str ) {
-    const std::string::size_type len = str.length();
-    const std::string tmp = trim( str );
-    const char* sz = tmp.c_str();
-    if( sz[ 0 ] == '0' ) {
-        return false;
+string sosicon::utils::
+iso8859_1ToUtf8( const std::string& str ) {
+    string res;
+    res.reserve( str.length() );
+    for( string::const_iterator i = str.begin(); i != str.end(); i++ ) {
+        unsigned char c = static_cast<unsigned char>( *i );
+        if( c < 0x80 ) {
+            res += static_cast<char>( c );
+        }
+        else {
+            res += static_cast<char>( 0xc0 | ( c >> 6 ) );
+            res += static_cast<char>( 0x80 | ( c & 0x3f ) );
+        }
     }
-    for( std::string::size_type i = 0; i < len; i++ ) {
-        std::locale loc;
-        if( !std::isdigit( sz[ i ], loc ) ) {
+    return res;
+}
+
+bool sosicon::utils::
+utf8ToIso8859_1( const std::string& str, std::string& iso ) {
+    string res;
+    res.reserve( str.length() );
+    for( string::size_type i = 0; i < str.length(); i++ ) {
+        unsigned char c = static_cast<unsigned char>( str[ i ] );
+        if( c < 0x80 ) {
+            res += static_cast<char>( c );
+        }
+        else if( ( c == 0xc2 || c == 0xc3 ) && i + 1 < str.length() &&
+                 ( static_cast<unsigned char>( str[ i + 1 ] ) & 0xc0 ) == 0x80 ) {
+            res += static_cast<char>( ( ( c & 0x03 ) << 6 ) | ( str[ ++i ] & 0x3f ) );
+        }
+        else {
             return false;
         }
     }
+    iso.swap( res );
     return true;
 }
 
+string sosicon::utils::
+jsonQuote( const std::string& str ) {
+    string res = "\"";
+    for( string::const_iterator i = str.begin(); i != str.end(); i++ ) {
+        unsigned char c = static_cast<unsigned char>( *i );
+        switch( c ) {
+            case '"':  res += "\\\""; break;
+            case '\\': res += "\\\\"; break;
+            case '\n': res += "\\n"; break;
+            case '\r': res += "\\r"; break;
+            case '\t': res += "\\t"; break;
+            default:
+                if( c < 0x20 ) {
+                    char esc[ 8 ];
+                    snprintf( esc, sizeof esc, "\\u%04x", c );
+                    res += esc;
+                }
+                else {
+                    res += static_cast<char>( c );
+                }
+        }
+    }
+    return res + "\"";
+}
+
 void sosicon::utils::
 asciify( char* str ) {
     static unsigned char const transcodingTable[ 256 ] = {
@@ -120,7 +166,7 @@ nonExistingFilename( std::string defaultName ) {
     while( fileExists( candidatePath ) )
     {
         std::stringstream ss;
-        ss << dir << tit << "_" << std::setw( 2 ) << std::setfill( '0' ) << ++sequence << ".sql";
+        ss << dir << tit << "_" << std::setw( 2 ) << std::setfill( '0' ) << ++sequence << ext;
         candidatePath = ss.str();
     }
 
@@ -199,6 +245,14 @@ sosiEncodingToPsqlEncoding( sosi::Charset charset ) {
   return psqlCharset;
 }
 
+string sosicon::utils::
+simplifySuffix( double tolerance )
+{
+    std::stringstream ss;
+    ss << "_s" << tolerance;
+    return replaceAll( ".", "_", ss.str() );
+}
+
 string sosicon::utils::
 sqlNormalize( const std::string &str )
 {
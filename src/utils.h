@@ -64,16 +64,31 @@ namespace sosicon {
           return ( stat( name.c_str(), &buffer ) == 0 );
         }
 
-        //! Test if a string represents a numeric value
+        //! Convert ISO8859-1 string to UTF-8
         /*!
-            Returns true if the provided string contains numers only, and if the first
-            digit is not zero. Numbers with leading zeros should be treated as strings,
-            since they might be phone numbers, post numbers or municipal codes.
-            \param str The string value to test.
-            \return True if the string represents a numeric value with no leading zero,
-                    otherwise false.
+            \param str ISO8859-1 encoded string.
+            \return UTF-8 encoded copy of str.
         */
-        bool isNumeric( const std::string& str );
+        std::string iso8859_1ToUtf8( const std::string& str );
+
+        //! Convert UTF-8 string to ISO8859-1
+        /*!
+            \param str String that may be UTF-8 encoded.
+            \param iso Receives the ISO8859-1 copy of str.
+            \return False if str is not valid UTF-8 or has characters outside ISO8859-1. iso is
+                    then left unchanged.
+        */
+        bool utf8ToIso8859_1( const std::string& str, std::string& iso );
+
+        //! Make JSON string literal
+        /*!
+            Escapes quotes, backslashes and control characters, and encloses the result in
+            double quotes. Other characters are copied as they are, so the input should
+            already be UTF-8.
+            \param str The string to quote.
+            \return JSON string literal.
+        */
+        std::string jsonQuote( const std::string& str );
 
         //! Make acceptable ANSI version of string
         /*!
@@ -150,6 +165,15 @@ namespace sosicon {
         */
         std::string sqlNormalize( const std::string &str );
 
+        //! Layer name suffix for a simplification tolerance
+        /*!
+            Gives "_s<tolerance>", usable in file, table and column names. Decimal points are
+            written as underscores, so 0.5 gives "_s0_5".
+            \param tolerance Simplification tolerance.
+            \return Suffix string.
+         */
+        std::string simplifySuffix( double tolerance );
+
         //! Remove trailing forward- and backward slashes from path component
         std::string stripTrailingSlash( const std::string &str );
 
@@ -0,0 +1,159 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WKB_WRITER_H__
+#define __WKB_WRITER_H__
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <stdint.h>
+
+namespace sosicon {
+
+    //! Hex-encoded WKB encoder
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Writes OGC well-known binary in little-endian byte order, as hex text that can go
+        straight into a tabular file and be decoded by the database on load (UNHEX() in
+        MySQL, or the geometry input function in PostGIS). Rings are given in the form
+        returned by CoordinateCollection::getRings(): each outer ring followed by its holes,
+        with hole sizes negated.
+    */
+    class WkbWriter {
+
+        //! Encoded geometry
+        std::string mData;
+
+        //! WKB geometry type codes
+        enum WkbType {
+            wkb_point = 1,
+            wkb_linestring = 2,
+            wkb_polygon = 3,
+            wkb_multipolygon = 6
+        };
+
+        //! Append bytes
+        void bytes( const unsigned char* b, std::size_t size ) {
+            static const char hex[] = "0123456789ABCDEF";
+            for( std::size_t i = 0; i < size; i++ ) {
+                mData += hex[ b[ i ] >> 4 ];
+                mData += hex[ b[ i ] & 15 ];
+            }
+        }
+
+        //! Append 32-bit unsigned integer
+        void uint32( uint32_t value ) {
+            unsigned char b[ 4 ];
+            for( int i = 0; i < 4; i++ ) {
+                b[ i ] = static_cast<unsigned char>( value >> ( 8 * i ) );
+            }
+            bytes( b, 4 );
+        }
+
+        //! Append double
+        void float64( double value ) {
+            uint64_t bits;
+            std::memcpy( &bits, &value, sizeof bits );
+            unsigned char b[ 8 ];
+            for( int i = 0; i < 8; i++ ) {
+                b[ i ] = static_cast<unsigned char>( bits >> ( 8 * i ) );
+            }
+            bytes( b, 8 );
+        }
+
+        //! Append byte order and geometry type
+        void header( WkbType type ) {
+            mData += "01";
+            uint32( type );
+        }
+
+        //! Append point count and coordinates
+        void points( const double* xy, int count ) {
+            uint32( static_cast<uint32_t>( count ) );
+            for( int i = 0; i < 2 * count; i++ ) {
+                float64( xy[ i ] );
+            }
+        }
+
+    public:
+
+        //! Encoded geometry, as hex
+        const std::string& data() const { return mData; }
+
+        //! Start over with an empty buffer
+        void clear() { mData.clear(); }
+
+        //! Append point
+        /*!
+            \param xy East and north, or 0 for an empty point.
+        */
+        void point( const double* xy ) {
+            double nan = std::numeric_limits<double>::quiet_NaN();
+            header( wkb_point );
+            float64( xy ? xy[ 0 ] : nan );
+            float64( xy ? xy[ 1 ] : nan );
+        }
+
+        //! Append linestring
+        void lineString( const double* xy, int count ) {
+            header( wkb_linestring );
+            points( xy, count );
+        }
+
+        //! Append polygon, or multipolygon if there is more than one outer ring
+        /*!
+            \param xy Coordinates of all rings.
+            \param sizes Number of points in each ring, negative for holes.
+            \param parts Number of rings.
+        */
+        void polygon( const double* xy, const int* sizes, std::size_t parts ) {
+            uint32_t polygons = 0;
+            for( std::size_t i = 0; i < parts; i++ ) {
+                polygons += sizes[ i ] > 0 ? 1 : 0;
+            }
+            if( polygons > 1 ) {
+                header( wkb_multipolygon );
+                uint32( polygons );
+            }
+            else if( polygons == 0 ) {
+                header( wkb_polygon );
+                uint32( 0 );
+            }
+            for( std::size_t i = 0; i < parts; i++ ) {
+                if( sizes[ i ] > 0 ) {
+                    std::size_t j = i + 1;
+                    while( j < parts && sizes[ j ] < 0 ) {
+                        j++;
+                    }
+                    header( wkb_polygon );
+                    uint32( static_cast<uint32_t>( j - i ) );
+                }
+                int n = std::abs( sizes[ i ] );
+                points( xy, n );
+                xy += 2 * n;
+            }
+        }
+
+    }; // class WkbWriter
+
+}; // namespace sosicon
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "work_stealing_pool.h"
+
+sosicon::WorkStealingPool::
+WorkStealingPool( unsigned int threads ) {
+    mThreads = threads > 0 ? threads : std::thread::hardware_concurrency();
+    if( mThreads == 0 ) {
+        mThreads = 1;
+    }
+    for( unsigned int i = 0; i < mThreads; i++ ) {
+        mWorkers.push_back( std::unique_ptr<Worker>( new Worker() ) );
+    }
+}
+
+bool sosicon::WorkStealingPool::
+next( unsigned int self, IPipelineJob*& job ) {
+    {
+        Worker& own = *mWorkers[ self ];
+        std::lock_guard<std::mutex> guard( own.lock );
+        if( !own.jobs.empty() ) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+    for( unsigned int i = 1; i < mThreads; i++ ) {
+        Worker& victim = *mWorkers[ ( self + i ) % mThreads ];
+        std::lock_guard<std::mutex> guard( victim.lock );
+        if( !victim.jobs.empty() ) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false; // Jobs are never added while running, so all work is done
+}
+
+void sosicon::WorkStealingPool::
+run( const std::vector<IPipelineJob*>& jobs ) {
+
+    std::size_t n = jobs.size();
+    for( unsigned int i = 0; i < mThreads; i++ ) {
+        std::size_t from = n * i / mThreads;
+        std::size_t to = n * ( i + 1 ) / mThreads;
+        mWorkers[ i ]->jobs.assign( jobs.begin() + from, jobs.begin() + to );
+    }
+
+    if( mThreads == 1 || n < 2 ) {
+        work( 0 );
+    }
+    else {
+        std::vector<std::thread> threads;
+        for( unsigned int i = 1; i < mThreads; i++ ) {
+            threads.push_back( std::thread( &WorkStealingPool::work, this, i ) );
+        }
+        work( 0 );
+        for( std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); t++ ) {
+            t->join();
+        }
+    }
+
+    for( std::vector<IPipelineJob*>::const_iterator j = jobs.begin(); j != jobs.end(); j++ ) {
+        ( *j )->complete();
+    }
+}
+
+void sosicon::WorkStealingPool::
+work( unsigned int self ) {
+    IPipelineJob* job = 0;
+    while( next( self, job ) ) {
+        job->run();
+    }
+}
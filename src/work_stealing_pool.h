@@ -0,0 +1,88 @@
+/*
+ *  This file is part of the command-line tool sosicon.
+ *  Copyright (C) 2014  Espen Andersen, Norwegian Broadcast Corporation (NRK)
+ *
+ *  This is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORK_STEALING_POOL_H__
+#define __WORK_STEALING_POOL_H__
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "interface/i_pipeline_job.h"
+
+namespace sosicon {
+
+    //! Work-stealing thread pool
+    /*!
+        \author Espen Andersen
+        \copyright GNU General Public License
+
+        Runs a batch of independent jobs on all cores. Each worker thread is handed a
+        contiguous share of the batch, and takes jobs from the back of its own deque. A worker
+        that runs out steals from the front of the others, so a share that happens to hold
+        the expensive jobs is spread out without a central queue.
+
+        Jobs are sosicon::IPipelineJob objects: run() is called on a worker thread, and
+        complete() on the calling thread once the whole batch is done, in batch order.
+    */
+    class WorkStealingPool {
+
+        //! Jobs owned by one worker
+        struct Worker {
+            std::mutex lock;                    //!< Guards jobs
+            std::deque<IPipelineJob*> jobs;     //!< Pending jobs
+        };
+
+        //! Number of worker threads
+        unsigned int mThreads;
+
+        //! Per-thread job deques
+        std::vector<std::unique_ptr<Worker> > mWorkers;
+
+        //! Take next job from own deque, or steal one
+        bool next( unsigned int self, IPipelineJob*& job );
+
+        //! Worker thread main loop
+        void work( unsigned int self );
+
+        WorkStealingPool( const WorkStealingPool& );
+        WorkStealingPool& operator = ( const WorkStealingPool& );
+
+    public:
+
+        //! Constructor
+        /*!
+            \param threads Number of worker threads, or 0 for one per core.
+         */
+        explicit WorkStealingPool( unsigned int threads = 0 );
+
+        //! Number of worker threads
+        unsigned int size() const { return mThreads; }
+
+        //! Run batch of jobs
+        /*!
+            Returns when every job has been run and completed. The jobs are not deleted.
+            \param jobs Jobs to run.
+         */
+        void run( const std::vector<IPipelineJob*>& jobs );
+
+    }; // class WorkStealingPool
+
+}; // namespace sosicon
+
+#endif